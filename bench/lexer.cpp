@@ -0,0 +1,101 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/**
+ * Name: bench/lexer.cpp
+ * Construct: Module
+ * Desc: Microbenchmark of the lexer, scans a large source to the end a number
+ *   of times and reports the tokens and megabytes scanned per second. Only
+ *   `yylex` and `yyrestart` are used, so it runs against any lexer of the
+ *   grammar's tokens
+ * Usage:
+ *   sood-lexer-bench [<runs> [<file>...]]
+ * Notes:
+ *   - Without files the sample program below is repeated to ~8MB
+ */
+
+extern int yylex();
+extern void yyrestart(FILE *);
+
+/** Exercises the keywords and most of the multi-word keywords */
+static const char *SAMPLE = R"(# vim: ft=sood
+
+fib is a function of type integer with arguments of:
+    an integer n; and of statements:
+  if n is less than 2,
+    return n...
+  return (fib called with n minus 1 as an argument) plus
+         (fib called with n minus 2 as an argument)...
+
+scale is a function of type integer with arguments of:
+    an integer x, and an integer factor of default value 2; and of statements:
+  return x multiplied by factor...
+
+count is an integer of value 0.
+total is a float of value 1.5.
+name is a string of value 'counter\t'.
+squares is an integer array of size 100.
+grow is an integer array.
+i is an integer of value 0.
+while i is less than or equal to length of squares,
+  append i multiplied by i to grow.
+  if (i modulo 3 is equal to 0) and (i modulo 5 is not equal to 0),
+    write 'Fizz\n' to stdout...
+  else,
+    count is count plus grow at i divided by 2...
+  i is i plus 1...
+until count is more than 1000,
+  count is count plus (fib called with 10 as an argument)...
+write count to stdout.
+)";
+
+static std::string read_sources(int argc, char **argv) {
+  std::ostringstream source;
+  if (argc <= 2) {
+    std::string sample(SAMPLE);
+    for (std::size_t size = 0; size < (8 << 20); size += sample.size())
+      source << sample;
+    return source.str();
+  }
+  for (int i = 2; i < argc; i++) {
+    std::ifstream in(argv[i]);
+    if (!in) {
+      std::cerr << "Could not read " << argv[i] << std::endl;
+      std::exit(1);
+    }
+    source << in.rdbuf() << '\n';
+  }
+  return source.str();
+}
+
+int main(int argc, char **argv) {
+  int runs = argc > 1 ? std::atoi(argv[1]) : 10;
+  std::string source = read_sources(argc, argv);
+
+  std::size_t tokens = 0;
+  std::chrono::duration<double> best(0);
+  for (int run = 0; run < runs; run++) {
+    FILE *in = fmemopen(&source[0], source.size(), "r");
+    yyrestart(in);
+    auto start = std::chrono::steady_clock::now();
+    tokens = 0;
+    while (yylex())
+      tokens++;
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (!run || elapsed < best)
+      best = elapsed;
+    std::fclose(in);
+  }
+
+  std::printf("%zu bytes, %zu tokens, best of %d runs: %.3fs\n",
+              source.size(), tokens, runs, best.count());
+  std::printf("%.1f Mtokens/s, %.1f MB/s\n", tokens / best.count() / 1e6,
+              source.size() / best.count() / (1 << 20));
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Name: bench/startup.cpp
+ * Construct: Module
+ * Desc: Benchmark of the latency of starting compiled programs, runs each
+ *   executable given to completion a number of times and reports the time
+ *   from spawning it to its exit. Meant to compare a program linked as usual
+ *   with the same program linked with `--static-minimal`
+ * Usage:
+ *   sood-startup-bench <runs> <executable>...
+ * Notes:
+ *   - The executables are ran in turn, one run of each at a time, so a
+ *     change in the machine's load affects them alike
+ *   - Their output is discarded, a program which does little more than
+ *     start, as tests/helloworld.sood, measures only the start
+ */
+
+extern char **environ;
+
+/** Runs an executable to completion, returning the time taken */
+static std::chrono::duration<double> run_once(const char *path) {
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+
+  char *argv[] = {const_cast<char *>(path), nullptr};
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid;
+  if (posix_spawn(&pid, path, &actions, nullptr, argv, environ)) {
+    std::fprintf(stderr, "Could not run %s\n", path);
+    std::exit(1);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  posix_spawn_file_actions_destroy(&actions);
+
+  /** The top-level code is `void main()`, so the status isn't meaningful */
+  if (!WIFEXITED(status)) {
+    std::fprintf(stderr, "%s failed\n", path);
+    std::exit(1);
+  }
+  return elapsed;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::fprintf(stderr, "Usage: %s <runs> <executable>...\n", argv[0]);
+    return 1;
+  }
+  int runs = std::max(1, std::atoi(argv[1]));
+  int count = argc - 2;
+
+  std::vector<std::vector<double>> times(count);
+  for (int run = 0; run < runs; run++)
+    for (int i = 0; i < count; i++)
+      times[i].push_back(run_once(argv[i + 2]).count() * 1e6);
+
+  std::printf("%d runs of each, in microseconds\n", runs);
+  std::printf("%10s %10s %10s  %s\n", "min", "median", "mean", "executable");
+  for (int i = 0; i < count; i++) {
+    std::vector<double> &t = times[i];
+    std::sort(t.begin(), t.end());
+    double sum = 0;
+    for (double v : t)
+      sum += v;
+    std::printf("%10.1f %10.1f %10.1f  %s\n", t.front(), t[t.size() / 2],
+                sum / t.size(), argv[i + 2]);
+  }
+  return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef __AST_BINARY_HPP__
+#define __AST_BINARY_HPP__
+
+#include <string>
+
+class NBlock;
+class Node;
+
+bool write_binary_ast(NBlock &, const std::string &);
+NBlock *read_binary_ast(const std::string &);
+std::string binary_ast(Node &, bool);
+
+#endif
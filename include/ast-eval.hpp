@@ -0,0 +1,118 @@
+#ifndef __AST_EVAL_HPP__
+#define __AST_EVAL_HPP__
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class NBinaryExpression;
+class NBlock;
+class NExpression;
+class NFunctionDeclaration;
+class NStatement;
+struct EvalArray;
+
+/** The most statements and expressions evaluated for one call */
+const std::uint64_t EVAL_STEP_LIMIT = 1000000;
+
+/** The deepest calls may nest while evaluating one call */
+const unsigned EVAL_DEPTH_LIMIT = 256;
+
+/**
+ * Name: EvalValue
+ * Construct: Struct
+ * Desc: A value computed by the evaluator (see src/ast-eval.cpp), one of the
+ *   values the code generator keeps in a register, or, when running a whole
+ *   program (see src/tiered.cpp), a string or array
+ * Members:
+ *   - kind: An `integer` (`i64`), a `float` (`double`), the boolean result of
+ *     a comparison (`i1`), a string, or an array
+ *   - i: The value of an integer or boolean
+ *   - f: The value of a float
+ *   - s: The value of a string, strings are copied as they're assigned
+ *   - a: The elements of an array, arrays are shared as they're passed
+ */
+struct EvalValue {
+  enum Kind { INTEGER, FLOAT, BOOLEAN, STRING, ARRAY } kind;
+  std::int64_t i = 0;
+  double f = 0.0;
+  std::string s;
+  std::shared_ptr<EvalArray> a;
+
+  static EvalValue integer(std::int64_t);
+  static EvalValue floating(double);
+  static EvalValue boolean(bool);
+  static EvalValue text(const std::string &);
+};
+
+/**
+ * Name: EvalArray
+ * Construct: Struct
+ * Desc: The elements of an array, of integers or of floats
+ * Members:
+ *   - elem: The kind of the elements, `INTEGER` or `FLOAT`
+ *   - ints, floats: The elements, in whichever is of their kind
+ */
+struct EvalArray {
+  EvalValue::Kind elem;
+  std::vector<std::int64_t> ints;
+  std::vector<double> floats;
+};
+
+/** Thrown to abandon an evaluation, e.g. of an undefined operation */
+struct EvalAbort {};
+
+/**
+ * Name: Evaluator
+ * Construct: Class
+ * Desc: The state of one evaluation, of a call and the calls it makes
+ * Members:
+ *   - functions - The functions which may be called, by name
+ *   - steps - The statements and expressions evaluated so far
+ *   - step_limit - The most steps before the evaluation is abandoned
+ *   - depth - The number of calls in progress
+ *   - depth_limit - The most calls in progress before the evaluation is
+ *     abandoned
+ *   - locals - The variables of the call being evaluated
+ *   - returned - Whether the call being evaluated has reached a `return`
+ *   - return_value - The value it returned
+ * Notes:
+ *   - Only numbers are evaluated here, a subclass running whole programs
+ *     (see `TieredEvaluator`) adds the statements and values with effects
+ */
+class Evaluator {
+protected:
+  const std::map<std::string, NFunctionDeclaration *> &functions;
+  std::uint64_t steps = 0;
+  std::uint64_t step_limit;
+  unsigned depth = 0;
+  unsigned depth_limit;
+  std::map<std::string, EvalValue> locals;
+  bool returned = false;
+  EvalValue return_value;
+
+  void step();
+  EvalValue binary(NBinaryExpression &);
+  bool condition(NExpression &);
+  void run(NBlock &);
+  virtual void run(NStatement &);
+
+public:
+  Evaluator(const std::map<std::string, NFunctionDeclaration *> &functions,
+            std::uint64_t step_limit = EVAL_STEP_LIMIT,
+            unsigned depth_limit = EVAL_DEPTH_LIMIT)
+      : functions(functions), step_limit(step_limit),
+        depth_limit(depth_limit) {}
+  virtual ~Evaluator() {}
+  virtual EvalValue call(NFunctionDeclaration &, const std::vector<EvalValue> &);
+  virtual EvalValue eval(NExpression &);
+};
+
+EvalValue convert(EvalValue, EvalValue::Kind);
+bool evaluate_call(const std::map<std::string, NFunctionDeclaration *> &,
+                   NFunctionDeclaration &, const std::vector<EvalValue> &,
+                   EvalValue &);
+
+#endif
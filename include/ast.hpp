@@ -11,6 +11,8 @@ class NVariableDeclaration;
 class NStatement;
 class NExpression;
 class CodeGenContext;
+class BytecodeContext;
+struct BytecodeValue;
 
 /**
  * Name: OPS
@@ -41,19 +43,35 @@ typedef std::vector<NExpression *> NExpressionList;
 
 /* ------------- Base Nodes ------------- */
 
+/**
+ * Name: node_line, node_column
+ * Construct: Global variable
+ * Desc: The location given to nodes as they're created, the parser sets it
+ *   to the start of each grammar rule before the rule's action creates its
+ *   nodes (see `YYLLOC_DEFAULT` in src/parser.y)
+ */
+extern int node_line;
+extern int node_column;
+
 /**
  * Name: Node
  * Construct: Class
  * Desc: The generic base-node used in the formation of the AST, all other
  *   nodes are based on this one
+ * Members:
+ *   - line, column: The location of the node in the source, those of nodes
+ *     created by the compiler rather than the parser are 0
  */
 class Node {
 protected:
   virtual void print(std::ostream &) const = 0;
 
 public:
+  int line = node_line;
+  int column = node_column;
   virtual ~Node() {}
   virtual llvm::Value *code_generate(CodeGenContext &) = 0;
+  virtual BytecodeValue bytecode_generate(BytecodeContext &) = 0;
   friend std::ostream &operator<<(std::ostream &out, Node const &obj) {
     obj.print(out);
     return out;
@@ -92,6 +110,7 @@ public:
   std::int64_t val;
   NInteger(std::int64_t val) : val(val) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -107,6 +126,7 @@ public:
   double val;
   NFloat(double val) : val(val) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -116,15 +136,20 @@ public:
  * Desc: String value node, implemented with a C++ std::string
  * Members:
  *   - val: The C++ string value
+ *   - escaped: Whether the escapes of `val` have been replaced, which is
+ *     done once, as its code is first generated
  */
 class NString : public NExpression {
 public:
   std::string val;
+  bool escaped = false;
+  NString() {}
   NString(std::string val) {
     // Cut the surrounding quotes, could be more dynamic...
     this->val = val.substr(1, val.size() - 2);
   }
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -142,6 +167,7 @@ public:
   NIdentifier() {}
   NIdentifier(std::string val) : val(val) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -162,6 +188,7 @@ public:
   NFunctionCall(NIdentifier &id, NExpressionList args)
       : id(id), args(args) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -180,6 +207,7 @@ public:
   NExpression &rhs;
   NUnaryExpression(int op, NExpression &rhs) : rhs(rhs), op(op) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -201,6 +229,43 @@ public:
   NBinaryExpression(NExpression &lhs, int op, NExpression &rhs)
       : lhs(lhs), rhs(rhs), op(op) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
+  virtual void print(std::ostream &) const;
+};
+
+/**
+ * Name: NArrayIndex
+ * Construct: Class
+ * Desc: Node representing the element of an array at a given index, e.g.
+ *   `values at 3`
+ * Members:
+ *   - array: The identifier of the array
+ *   - index: The (zero-based) index of the element
+ */
+class NArrayIndex : public NExpression {
+public:
+  NIdentifier &array;
+  NExpression &index;
+  NArrayIndex(NIdentifier &array, NExpression &index)
+      : array(array), index(index) {}
+  virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
+  virtual void print(std::ostream &) const;
+};
+
+/**
+ * Name: NLength
+ * Construct: Class
+ * Desc: Node representing the length of an array, e.g. `length of values`
+ * Members:
+ *   - exp: The expression of which to take the length
+ */
+class NLength : public NExpression {
+public:
+  NExpression &exp;
+  NLength(NExpression &exp) : exp(exp) {}
+  virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -218,6 +283,7 @@ public:
   NStatementList stmts;
   NBlock() {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -235,6 +301,7 @@ public:
   NExpression &rhs;
   NAssignment(NIdentifier &lhs, NExpression &rhs) : lhs(lhs), rhs(rhs) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -256,6 +323,7 @@ public:
   NExpression &to;
   NRead(NExpression &from, NExpression &to) : from(from), to(to) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -275,6 +343,7 @@ public:
   NExpression &to;
   NWrite(NExpression &exp, NExpression &to) : exp(exp), to(to) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -290,6 +359,7 @@ public:
   NExpression &exp;
   NReturnStatement(NExpression &exp) : exp(exp) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -309,6 +379,7 @@ public:
   NExpression &exp;
   NExpressionStatement(NExpression &exp) : exp(exp) {}
   virtual llvm::Value *code_generate(CodeGenContext &context);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -335,6 +406,73 @@ public:
   NVariableDeclaration(NIdentifier &type, NIdentifier &lhs, NExpression *rhs)
       : type(type), lhs(lhs), rhs(rhs) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
+  virtual void print(std::ostream &) const;
+};
+
+/**
+ * Name: NArrayDeclaration
+ * Construct: Class
+ * Desc: Node representing the declaration of an array, either of a fixed
+ *   size, e.g. `values is an integer array of size 16.`, or growable (and
+ *   initially empty), e.g. `values is an integer array.`
+ * Members:
+ *   - type: The type of the array's elements
+ *   - lhs: The identifier of the array to be declared
+ *   - size: The expression used for the number of elements, `nullptr` for a
+ *     growable array
+ */
+class NArrayDeclaration : public NStatement {
+public:
+  const NIdentifier &type;
+  NIdentifier &lhs;
+  NExpression *size;
+  NArrayDeclaration(NIdentifier &type, NIdentifier &lhs)
+      : type(type), lhs(lhs) {
+    size = nullptr;
+  }
+  NArrayDeclaration(NIdentifier &type, NIdentifier &lhs, NExpression *size)
+      : type(type), lhs(lhs), size(size) {}
+  virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
+  virtual void print(std::ostream &) const;
+};
+
+/**
+ * Name: NArrayAssignment
+ * Construct: Class
+ * Desc: Node representing an assignment to the element of an array, e.g.
+ *   `values at 3 is 42.`
+ * Members:
+ *   - lhs: The element to be assigned a value
+ *   - rhs: The expression to assign to `lhs`
+ */
+class NArrayAssignment : public NStatement {
+public:
+  NArrayIndex &lhs;
+  NExpression &rhs;
+  NArrayAssignment(NArrayIndex &lhs, NExpression &rhs) : lhs(lhs), rhs(rhs) {}
+  virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
+  virtual void print(std::ostream &) const;
+};
+
+/**
+ * Name: NAppend
+ * Construct: Class
+ * Desc: Node representing the appending of an element to the end of an
+ *   array, e.g. `append 42 to values.`
+ * Members:
+ *   - exp: The expression to append
+ *   - array: The identifier of the array
+ */
+class NAppend : public NStatement {
+public:
+  NExpression &exp;
+  NIdentifier &array;
+  NAppend(NExpression &exp, NIdentifier &array) : exp(exp), array(array) {}
+  virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -354,6 +492,7 @@ public:
   NUntilStatement(NExpression &cond, NBlock &block)
       : cond(cond), block(block) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -373,6 +512,7 @@ public:
   NWhileStatement(NExpression &cond, NBlock &block)
       : cond(cond), block(block) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -388,6 +528,7 @@ public:
   NBlock &block;
   NElseStatement(NBlock &block) : block(block) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -413,6 +554,8 @@ public:
   NIfStatement(NExpression &cond, NBlock &block, NStatement *els)
       : cond(cond), block(block), els(els) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
+  bool code_generate_switch(CodeGenContext &);
   virtual void print(std::ostream &) const;
 };
 
@@ -437,8 +580,77 @@ public:
   NFunctionDeclaration(NIdentifier &type, NIdentifier &id, NVariableList args,
                        NBlock &block)
       : type(type), id(id), args(args), block(block) {}
+  llvm::Function *declare(CodeGenContext &);
+  virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
+  virtual void print(std::ostream &) const;
+};
+
+/**
+ * Name: NImport
+ * Construct: Class
+ * Desc: Node representing the import of a module, e.g. `import maths.`, the
+ *   functions of which are then called as though declared in the source
+ * Members:
+ *   - name: The identifier of the module, whose interface (see
+ *     `CodeGenContext::import_module`) is `<name>.sif`
+ */
+class NImport : public NStatement {
+public:
+  NIdentifier &name;
+  NImport(NIdentifier &name) : name(name) {}
   virtual llvm::Value *code_generate(CodeGenContext &);
+  virtual BytecodeValue bytecode_generate(BytecodeContext &);
   virtual void print(std::ostream &) const;
 };
 
+/**
+ * Name: ast_children
+ * Construct: Function
+ * Desc: The direct children of a node, in source order, used by the analyses
+ *   which need to walk the whole of a subtree
+ * Args:
+ *   - node: The node whose children to return
+ */
+std::vector<Node *> ast_children(Node &node);
+
+/**
+ * Name: delete_ast
+ * Construct: Function
+ * Desc: Deletes a subtree, every node of it
+ * Args:
+ *   - node: The root of the subtree
+ */
+void delete_ast(Node *node);
+
+/**
+ * Name: assigns_to
+ * Construct: Function
+ * Desc: Whether a node, or any node nested within it, assigns to (or
+ *   redeclares) the variable of the given name
+ * Args:
+ *   - node: The node to search
+ *   - name: The name of the variable
+ */
+bool assigns_to(Node *node, const std::string &name);
+
+/**
+ * Name: mentions
+ * Construct: Function
+ * Desc: Whether the variable of the given name is used within a node
+ * Args:
+ *   - node: The node to search
+ *   - name: The name of the variable
+ */
+bool mentions(Node *node, const std::string &name);
+
+/**
+ * Name: process_escape_chars
+ * Construct: Function
+ * Desc: Replaces the escapes of a string literal, see src/ast-codegen.cpp
+ * Args:
+ *   - input: The string to replace the escapes of
+ */
+void process_escape_chars(std::string &input);
+
 #endif
@@ -0,0 +1,294 @@
+#ifndef __BYTECODE_HPP__
+#define __BYTECODE_HPP__
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+class NBlock;
+
+/**
+ * Name: BYTECODE_OPS
+ * Construct: Enum
+ * Desc: The instructions of the bytecode, each of up to three operands `a`,
+ *   `b`, and `c` (see `Instruction`), `R` being the registers of the
+ *   function, `K` the constants, and `S` the string literals of the module:
+ *   - MOVE: R[a] = R[b]
+ *   - CONST: R[a] = K[c]
+ *   - STRING: R[a] = S[c]
+ *   - INT_TO_FLOAT, FLOAT_TO_INT: R[a] = R[b] converted, as by
+ *     `cast_relevantly` (unsigned from integers, signed to them)
+ *   - ADD ... MOD, FADD ... FMOD: R[a] = R[b] <op> R[c]
+ *   - NEG, FNEG, NOT: R[a] = <op> R[b]
+ *   - EQ ... GE, FEQ ... FGE: R[a] = R[b] <comparison> R[c], a boolean
+ *   - JUMP: To the instruction at `c`
+ *   - JUMP_IF, JUMP_IF_NOT: To `c`, if R[a] is (not) true
+ *   - JUMP_EQ ... JUMP_GE: To `c`, if the integers R[a] <comparison> R[b]
+ *   - CALL: R[a] = the function `c`, given the arguments R[b] onwards
+ *   - TAIL_CALL: Returns the result of the function `c`, given the arguments
+ *     R[b] onwards, which replaces the caller's frame
+ *   - RETURN, RETURN_STRING: Returns R[a], a string being assigned to the
+ *     caller's R[a]
+ *   - RETURN_VOID: Returns nothing
+ *   - UNREACHABLE: Reports a function which ran off its end without a value
+ *   - STRING_ASSIGN, STRING_APPEND: R[a] = R[b], or R[a] plus R[b]
+ *   - STRING_CONCAT: R[a] = R[b] plus R[c]
+ *   - STRING_EQ, STRING_NE: R[a] = R[b] <comparison> R[c], a boolean
+ *   - STRING_LENGTH, ARRAY_LENGTH: R[a] = the length of R[b]
+ *   - ARRAY_NEW: Gives the array R[a] R[b] zeroed elements
+ *   - ARRAY_CLEAR: Empties the array R[a]
+ *   - ARRAY_GET: R[a] = R[b] at R[c]
+ *   - ARRAY_SET: R[a] at R[b] = R[c]
+ *   - ARRAY_PUSH: Appends R[b] to R[a]
+ *   - WRITE_INTEGER, WRITE_STRING: Writes R[a] to stdout
+ * Notes:
+ *   - The VM's table of handlers (see src/bytecode-vm.cpp) is in this order
+ */
+enum BYTECODE_OPS {
+  BC_MOVE,
+  BC_CONST,
+  BC_STRING,
+  BC_INT_TO_FLOAT,
+  BC_FLOAT_TO_INT,
+  BC_ADD,
+  BC_SUB,
+  BC_MUL,
+  BC_DIV,
+  BC_MOD,
+  BC_FADD,
+  BC_FSUB,
+  BC_FMUL,
+  BC_FDIV,
+  BC_FMOD,
+  BC_NEG,
+  BC_FNEG,
+  BC_NOT,
+  BC_EQ,
+  BC_NE,
+  BC_LT,
+  BC_LE,
+  BC_GT,
+  BC_GE,
+  BC_FEQ,
+  BC_FNE,
+  BC_FLT,
+  BC_FLE,
+  BC_FGT,
+  BC_FGE,
+  BC_JUMP,
+  BC_JUMP_IF,
+  BC_JUMP_IF_NOT,
+  BC_JUMP_EQ,
+  BC_JUMP_NE,
+  BC_JUMP_LT,
+  BC_JUMP_LE,
+  BC_JUMP_GT,
+  BC_JUMP_GE,
+  BC_CALL,
+  BC_TAIL_CALL,
+  BC_RETURN,
+  BC_RETURN_STRING,
+  BC_RETURN_VOID,
+  BC_UNREACHABLE,
+  BC_STRING_ASSIGN,
+  BC_STRING_APPEND,
+  BC_STRING_CONCAT,
+  BC_STRING_EQ,
+  BC_STRING_NE,
+  BC_STRING_LENGTH,
+  BC_ARRAY_NEW,
+  BC_ARRAY_CLEAR,
+  BC_ARRAY_GET,
+  BC_ARRAY_SET,
+  BC_ARRAY_PUSH,
+  BC_ARRAY_LENGTH,
+  BC_WRITE_INTEGER,
+  BC_WRITE_STRING,
+  BC_OP_COUNT,
+};
+
+/**
+ * Name: BYTECODE_OPERANDS
+ * Construct: Enum
+ * Desc: What an operand of an instruction is, see `bytecode_operands`
+ */
+enum BYTECODE_OPERANDS {
+  BO_NONE,
+  BO_DEST,
+  BO_REG,
+  BO_CONST,
+  BO_LITERAL,
+  BO_TARGET,
+  BO_FUNCTION,
+};
+
+/**
+ * Name: BYTECODE_TYPES
+ * Construct: Enum
+ * Desc: The types of the values held by registers, known when the bytecode is
+ *   generated so the instructions need not check them. A string or array
+ *   register holds a pointer to the runtime's `SoodString` or `SoodArray`
+ */
+enum BYTECODE_TYPES {
+  BT_VOID,
+  BT_INTEGER,
+  BT_FLOAT,
+  BT_BOOLEAN,
+  BT_STRING,
+  BT_INTEGER_ARRAY,
+  BT_FLOAT_ARRAY,
+};
+
+/**
+ * Name: Instruction
+ * Construct: Struct
+ * Desc: A bytecode instruction, 64 bits of the opcode (see `BYTECODE_OPS`)
+ *   and its operands. Registers are 16 bits, so `c` holds the operand which
+ *   may be larger: a constant, string literal, function, or jump target
+ */
+struct Instruction {
+  std::uint64_t op : 8;
+  std::uint64_t a : 16;
+  std::uint64_t b : 16;
+  std::uint64_t c : 24;
+};
+
+/** The largest register, and value of the operand `c`, of an instruction */
+const std::uint32_t BC_MAX_REGISTER = 0xffff;
+const std::uint32_t BC_MAX_OPERAND = 0xffffff;
+
+/**
+ * Name: BC_VERSION
+ * Construct: Global variable
+ * Desc: The version of the bytecode, of its instructions and file format,
+ *   which must change with either so files and caches of the old version
+ *   are rejected
+ */
+const std::uint32_t BC_VERSION = 1;
+
+/**
+ * Name: Slot
+ * Construct: Union
+ * Desc: A register, or constant, holding any value of the bytecode
+ */
+union Slot {
+  std::int64_t i;
+  double f;
+  void *p;
+};
+
+/**
+ * Name: BytecodeValue
+ * Construct: Struct
+ * Desc: The result of generating the bytecode of a node (see
+ *   `Node::bytecode_generate`), the register holding the value and its type,
+ *   statements have no value (`BT_VOID`)
+ * Members:
+ *   - reg: The register
+ *   - type: The type of the value
+ *   - temporary: Whether the register is a temporary, which the instruction
+ *     computing it may write to a variable directly instead
+ */
+struct BytecodeValue {
+  std::uint32_t reg;
+  BYTECODE_TYPES type;
+  bool temporary;
+};
+
+/**
+ * Name: BytecodeFunction
+ * Construct: Struct
+ * Desc: A function of the bytecode, the first of a module is the top-level
+ *   code
+ * Members:
+ *   - name: The function's name
+ *   - params: The types of the parameters, passed in the first registers
+ *   - ret: The type of the result
+ *   - registers: The number of registers
+ *   - strings, arrays: The registers given storage of their own for a string
+ *     or array as the function is called, in the function's arena
+ *   - code: The instructions
+ */
+struct BytecodeFunction {
+  std::string name;
+  std::vector<BYTECODE_TYPES> params;
+  BYTECODE_TYPES ret = BT_VOID;
+  std::uint32_t registers = 0;
+  std::vector<std::uint16_t> strings;
+  std::vector<std::uint16_t> arrays;
+  std::vector<Instruction> code;
+};
+
+/**
+ * Name: BytecodeModule
+ * Construct: Struct
+ * Desc: A program compiled to bytecode, which is self-contained and may be
+ *   written to a file (see `write_bytecode`)
+ * Members:
+ *   - constants: The numeric constants
+ *   - strings: The string literals, their escapes replaced
+ *   - functions: The functions, the first being the top-level code
+ */
+struct BytecodeModule {
+  std::vector<Slot> constants;
+  std::vector<std::string> strings;
+  std::vector<BytecodeFunction> functions;
+};
+
+/**
+ * Name: BytecodeContext
+ * Construct: Class
+ * Desc: Used to manage the AST -> bytecode phase of the bytecode back end,
+ *   the counterpart of `CodeGenContext`
+ * Members:
+ *   - module: The bytecode generated
+ *   - function_ids: The functions declared so far, by name
+ *   - current: The function whose bytecode is being generated
+ *   - locals: The variables of that function, by name
+ *   - top: The first register not in use
+ *   - locals_top: The register after the last variable, temporaries below it
+ *     are never reused
+ *   - at_label: Whether the next instruction is a jump target, so the one
+ *     before it may not be changed
+ *   - constant_ids, string_ids: The constants and literals already added
+ */
+class BytecodeContext {
+  std::map<std::int64_t, std::uint32_t> constant_ids;
+  std::map<std::string, std::uint32_t> string_ids;
+  bool at_label = false;
+
+public:
+  BytecodeModule module;
+  std::map<std::string, std::uint32_t> function_ids;
+  std::uint32_t current = 0;
+  std::map<std::string, BytecodeValue> locals;
+  std::uint32_t top = 0;
+  std::uint32_t locals_top = 0;
+
+  BytecodeFunction &function() { return module.functions[current]; }
+  std::uint32_t emit(BYTECODE_OPS op, std::uint32_t a = 0, std::uint32_t b = 0,
+                     std::uint32_t c = 0);
+  std::uint32_t label();
+  void patch(std::uint32_t jump, std::uint32_t target);
+  bool retarget(BytecodeValue value, std::uint32_t reg);
+  bool tail_call(BytecodeValue value);
+  BytecodeValue temporary(BYTECODE_TYPES type);
+  BytecodeValue storage(BYTECODE_TYPES type);
+  BytecodeValue declare(const std::string &name, BYTECODE_TYPES type);
+  void release(std::uint32_t mark);
+  std::uint32_t integer(std::int64_t val);
+  std::uint32_t floating(double val);
+  std::uint32_t string(const std::string &val);
+  void code_generate(NBlock &root);
+};
+
+const BYTECODE_OPERANDS *bytecode_operands(BYTECODE_OPS op);
+const char *bytecode_op_name(BYTECODE_OPS op);
+void print_bytecode(const BytecodeModule &module, std::ostream &out);
+bool write_bytecode(const BytecodeModule &module, const std::string &filename);
+bool read_bytecode(BytecodeModule &module, const std::string &filename);
+int run_bytecode(const BytecodeModule &module);
+
+#endif
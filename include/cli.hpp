@@ -4,30 +4,84 @@
 /* clang-format off */ // The factory pattern will all expand
 
 const std::string DEFAULT_OUT = "a.sood.out";
+const std::string DEFAULT_SOCKET = "/tmp/sood.sock";
 
 struct SoodArgs {
   bool debug;
+  bool debug_info;
+  bool fast_cc;
+  bool inlining;
+  unsigned inline_threshold;
+  unsigned max_errors;
+  unsigned workers;
+  bool vectorize;
+  bool memoize;
+  bool profile;
+  bool perf_map;
+  bool pgo_instrument;
+  bool thin_lto;
+  bool static_minimal;
+  bool no_tail_calls;
   bool no_verify;
   bool print_ast;
   bool print_llvm_ir;
   bool run_llvm_ir;
+  bool tiered;
+  bool bytecode;
+  bool print_bytecode;
   bool stop_after_ast;
   bool stop_after_llvm_ir;
   bool stop_after_object;
+  bool emit_bc;
+  bool emit_ast;
+  bool emit_bytecode;
+  bool emit_interface;
   std::string input;
   std::string output;
+  std::string socket;
+  std::string cache_dir;
+  std::string pgo_use;
+  std::string import_path;
   SoodArgs set_debug(bool b) { debug = b; return *this; }
+  SoodArgs set_debug_info(bool b) { debug_info = b; return *this; }
+  SoodArgs set_fast_cc(bool b) { fast_cc = b; return *this; }
+  SoodArgs set_no_tail_calls(bool b) { no_tail_calls = b; return *this; }
+  SoodArgs set_inlining(bool b) { inlining = b; return *this; }
+  SoodArgs set_inline_threshold(unsigned u) { inline_threshold = u; return *this; }
+  SoodArgs set_max_errors(unsigned u) { max_errors = u; return *this; }
+  SoodArgs set_workers(unsigned u) { workers = u; return *this; }
+  SoodArgs set_vectorize(bool b) { vectorize = b; return *this; }
+  SoodArgs set_memoize(bool b) { memoize = b; return *this; }
+  SoodArgs set_profile(bool b) { profile = b; return *this; }
+  SoodArgs set_perf_map(bool b) { perf_map = b; return *this; }
+  SoodArgs set_pgo_instrument(bool b) { pgo_instrument = b; return *this; }
+  SoodArgs set_thin_lto(bool b) { thin_lto = b; return *this; }
+  SoodArgs set_static_minimal(bool b) { static_minimal = b; return *this; }
   SoodArgs set_no_verify(bool b) { no_verify = b; return *this; }
   SoodArgs set_print_ast(bool b) { print_ast = b; return *this; }
   SoodArgs set_print_llvm_ir(bool b) { print_llvm_ir = b; return *this; }
   SoodArgs set_stop_after_ast(bool b) { stop_after_ast = b; return *this; }
   SoodArgs set_run_llvm_ir(bool b) { run_llvm_ir = b; return *this; }
+  SoodArgs set_tiered(bool b) { tiered = b; return *this; }
+  SoodArgs set_bytecode(bool b) { bytecode = b; return *this; }
+  SoodArgs set_print_bytecode(bool b) { print_bytecode = b; return *this; }
   SoodArgs set_stop_after_object(bool b) { stop_after_object = b; return *this; }
   SoodArgs set_stop_after_llvm_ir(bool b) { stop_after_llvm_ir = b; return *this; }
+  SoodArgs set_emit_bc(bool b) { emit_bc = b; return *this; }
+  SoodArgs set_emit_ast(bool b) { emit_ast = b; return *this; }
+  SoodArgs set_emit_bytecode(bool b) { emit_bytecode = b; return *this; }
+  SoodArgs set_emit_interface(bool b) { emit_interface = b; return *this; }
   SoodArgs set_input(std::string s) { input = s; return *this; }
   SoodArgs set_output(std::string s) { output = s; return *this; }
+  SoodArgs set_socket(std::string s) { socket = s; return *this; }
+  SoodArgs set_cache_dir(std::string s) { cache_dir = s; return *this; }
+  SoodArgs set_pgo_use(std::string s) { pgo_use = s; return *this; }
+  SoodArgs set_import_path(std::string s) { import_path = s; return *this; }
 };
 
 /* clang-format on */
 
+class CodeGenContext;
+
 SoodArgs parse_args(int, char **);
+void set_codegen_options(CodeGenContext &, const SoodArgs &);
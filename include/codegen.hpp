@@ -1,27 +1,44 @@
 #ifndef __CODE_GEN_HPP__
 #define __CODE_GEN_HPP__
 
+#include <cstring>
 #include <iostream>
+#include <set>
 #include <stack>
 #include <typeinfo>
 
+#include <llvm/Analysis/TargetTransformInfo.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/ExecutionEngine/GenericValue.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/IR/CallingConv.h>
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/IRPrintingPasses.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Support/DynamicLibrary.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Host.h>
 #include "llvm/Support/TargetRegistry.h"
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/ThinLTOBitcodeWriter.h>
+#include <llvm/Transforms/InstCombine/InstCombine.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils.h>
+#include <llvm/Transforms/Utils/Local.h>
+#include <llvm/Transforms/Vectorize.h>
 
 struct CodeGenException : public std::exception {
   std::string message = "Generic code generation exception";
@@ -37,7 +54,10 @@ struct SoodStringException : public std::exception {
   const char *what() const throw() { return message.c_str(); }
 };
 
+class Node;
+class NArrayIndex;
 class NBlock;
+class NFunctionDeclaration;
 class CodeGenContext;
 
 extern llvm::LLVMContext LLVM_CTX;
@@ -46,10 +66,29 @@ extern llvm::IRBuilder<> BUILDER;
 extern llvm::Type *DOUBLE_TYPE;
 extern llvm::Type *INTEGER_TYPE;
 extern llvm::Type *STRING_TYPE;
+extern llvm::StructType *STRING_STRUCT_TYPE;
+extern llvm::Type *BYTE_PTR_TYPE;
+extern llvm::StructType *ARENA_STRUCT_TYPE;
+extern llvm::Type *ARENA_TYPE;
 
 typedef std::tuple<llvm::Value *, llvm::Type *> ValTypeTuple;
 
+/**
+ * Name: ImportedModule
+ * Construct: Struct
+ * Desc: A module imported by the program (see `CodeGenContext::import_module`)
+ * Members:
+ *   - interface: The path of the module's interface
+ *   - object: The path of the module's object code, linked with the program
+ */
+struct ImportedModule {
+  std::string interface;
+  std::string object;
+};
+
 llvm::Constant *get_i8_str_ptr(char const *, llvm::Twine const &);
+const std::map<std::string, void *> &runtime_symbols();
+const std::vector<llvm::JITEventListener *> &perf_listeners();
 
 /**
  * Name: CodeGenBlock
@@ -60,6 +99,8 @@ llvm::Constant *get_i8_str_ptr(char const *, llvm::Twine const &);
  *     instance
  *   - ret_val: A pointer to the return value of the block
  *   - locals: A list of the in-scope variables for the block
+ *   - array_lengths: The minimum lengths of the in-scope arrays whose size
+ *     was known at compile time
  * Notes:
  *   - The "global" function's locals are not currently available to
  *     child-blocks, this is yet to be implemented
@@ -72,6 +113,7 @@ public:
   llvm::BasicBlock *block;
   llvm::Value *ret_val;
   std::map<std::string, ValTypeTuple> locals;
+  std::map<std::string, std::int64_t> array_lengths;
 };
 
 /**
@@ -86,30 +128,146 @@ public:
  *   - printf_function - Creation of the `printf` function in the resulting IR,
  *     linked to libc after code generation
  *   - fmt_specifiers - Global string references for `"%s"` and `"%d"`
+ *   - fast_cc - Use LLVM's `fastcc` calling convention for the internal Sood
+ *     functions rather than the C calling convention
+ *   - tail_calls - Lower self-recursive tail calls to loops when optimizing
+ *   - inlining - Inline small internal functions and remove those left
+ *     unreferenced when optimizing
+ *   - inline_threshold - The largest cost (see `inline_cost`) of a
+ *     multi-block function which will still be inlined
+ *   - in_bounds - Array accesses whose index is proven to be within the
+ *     bounds of the array
+ *   - vectorize - Hint counted loops for vectorization and run the loop and
+ *     SLP vectorizers when optimizing
+ *   - memoize - Cache the results of the pure functions of integers when
+ *     optimizing (see src/codegen-purity.cpp)
+ *   - string_functions - The names of the functions which return a string,
+ *     rather than returning it directly these take a pointer to the string
+ *     to return into as their first argument
+ *   - string_return - The string to return into, while generating the code
+ *     of a function which returns a string
+ *   - arena - The arena (see `SoodArena`) of the function whose code is being
+ *     generated, or null if it has not yet needed one
+ *   - function_body - The block of the function whose code is being
+ *     generated, for analyses of the whole function
+ *   - function_decls - The functions declared in the source so far, by name,
+ *     which calls with literal arguments are evaluated with at compile time
+ *     (see src/ast-eval.cpp)
+ *   - target_machine - The target machine of the host, shared by every
+ *     CodeGenContext of the process (see `get_target_machine`)
+ *   - debug_info - Emit DWARF debug information for the source (see
+ *     src/codegen-debug.cpp)
+ *   - source_file - The path of the source, named by the debug information
+ *   - di_builder, di_file, di_types - The builder of the debug information,
+ *     created on first use, its file and its types by LLVM type
+ *   - di_scope - The debug scope (subprogram) of the function whose code is
+ *     being generated, or null without debug information
+ *   - profile - Count the calls of, and cycles spent in, each function and
+ *     report them as the program exits (see src/codegen-profile.cpp)
+ *   - perf_map - Describe the code ran with `code_run` to `perf`
+ *   - pgo_instrument - Count the edges taken by the program, written to a raw
+ *     profile as it exits (see `CodeGenContext::apply_pgo`)
+ *   - pgo_use - The path of a profile to optimize with, if any
+ *   - thin_lto - Write bitcode with a ThinLTO summary (see `write_bitcode`)
+ *   - import_paths - The directories searched for the interfaces of imported
+ *     modules, in order
+ *   - imported_modules - The modules imported, by name
+ *   - imported_functions - The functions of the imported modules, by their
+ *     names in Sood (see src/codegen-import.cpp)
+ *   - module_name - The name of the module when generated to be imported by
+ *     others (see `code_generate_module`), else empty
  */
 class CodeGenContext {
   std::stack<CodeGenBlock *> blocks;
-  llvm::Function *fn_main;
+  llvm::Function *fn_main = nullptr;
   llvm::Function *create_fn_printf();
+  llvm::TargetMachine *target_machine = nullptr;
+  void inline_small_functions();
+  void remove_dead_functions();
+  void apply_pgo();
+  void infer_purity();
+  std::unique_ptr<llvm::DIBuilder> di_builder;
+  llvm::DIFile *di_file = nullptr;
+  std::map<llvm::Type *, llvm::DIType *> di_types;
+  void create_debug_unit();
+  llvm::DIType *debug_type(llvm::Type *);
 
 public:
   llvm::Module *module;
   llvm::Function *printf_function;
   std::map<std::string, llvm::Value *> fmt_specifiers;
+  bool fast_cc = false;
+  bool tail_calls = true;
+  bool inlining = false;
+  unsigned inline_threshold = 32;
+  bool vectorize = false;
+  bool memoize = false;
+  std::set<NArrayIndex *> in_bounds;
+  std::set<std::string> string_functions;
+  llvm::Value *string_return = nullptr;
+  llvm::Value *arena = nullptr;
+  NBlock *function_body = nullptr;
+  std::map<std::string, NFunctionDeclaration *> function_decls;
+  bool debug_info = false;
+  std::string source_file;
+  llvm::DIScope *di_scope = nullptr;
+  bool profile = false;
+  bool perf_map = false;
+  bool pgo_instrument = false;
+  std::string pgo_use;
+  bool thin_lto = false;
+  std::vector<std::string> import_paths;
+  std::map<std::string, ImportedModule> imported_modules;
+  std::map<std::string, llvm::Function *> imported_functions;
+  std::string module_name;
 
   CodeGenContext(std::string module_name = "mod_main");
+  explicit CodeGenContext(llvm::Module *module);
 
   void code_generate(NBlock &root);
+  llvm::Function *
+  code_generate_top_level(NBlock &root, const std::string &name,
+                          std::map<std::string, ValTypeTuple> &locals);
+  void code_generate_module(NBlock &root, const std::string &name);
+  void import_module(const std::string &name);
+  llvm::Function *get_function(const std::string &name);
+  void optimize();
+  void release_arena(llvm::Function *fn);
+  llvm::DISubprogram *debug_function(llvm::Function *, const std::string &,
+                                     const Node &);
+  void set_debug_location(const Node &);
+  void finalize_debug_info();
+  void instrument_profile();
   void print_llvm_ir();
-  void print_llvm_ir_to_file(std::string &);
-  void verify_module();
+  void print_llvm_ir_to_file(const std::string &);
+  bool verify_module(llvm::raw_ostream &out = llvm::outs());
+  llvm::TargetMachine *get_target_machine();
+  llvm::ExecutionEngine *code_load();
   llvm::GenericValue code_run();
   int write_object(std::string &);
+  int write_object(llvm::raw_pwrite_stream &);
+  int write_bitcode(llvm::raw_ostream &);
+  int write_interface(NBlock &root, const std::string &path,
+                      const std::string &object);
   ValTypeTuple get_local(std::string s) { return blocks.top()->locals[s]; }
   void set_local(std::string s, llvm::Value *val, llvm::Type *type) {
     blocks.top()->locals[s] = std::make_pair(val, type);
   }
   std::map<std::string, ValTypeTuple> &locals() { return blocks.top()->locals; }
+  void set_array_length(std::string s, std::int64_t len) {
+    blocks.top()->array_lengths[s] = len;
+  }
+  void clear_array_length(std::string s) {
+    blocks.top()->array_lengths.erase(s);
+  }
+  bool get_array_length(std::string s, std::int64_t &len) {
+    auto it = blocks.top()->array_lengths.find(s);
+    if (it == blocks.top()->array_lengths.end())
+      return false;
+    len = it->second;
+    return true;
+  }
+  llvm::Function *runtime_function(std::string, llvm::FunctionType *);
   llvm::BasicBlock *current_block() { return blocks.top()->block; }
   void push_block(llvm::BasicBlock *block) {
     blocks.push(new CodeGenBlock());
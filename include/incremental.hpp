@@ -0,0 +1,13 @@
+#ifndef __INCREMENTAL_HPP__
+#define __INCREMENTAL_HPP__
+
+#include <string>
+#include <vector>
+
+class NBlock;
+struct SoodArgs;
+
+bool compile_incremental(NBlock &, const SoodArgs &,
+                         std::vector<std::string> &);
+
+#endif
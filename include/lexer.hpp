@@ -0,0 +1,46 @@
+#ifndef __LEXER_HPP__
+#define __LEXER_HPP__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Name: TokenText
+ * Construct: Struct
+ * Desc: The text of an identifier or literal token, a view into the lexer's
+ *   copy of the source rather than a string of its own, so scanning a token
+ *   never allocates
+ * Members:
+ *   - data: The first character of the token
+ *   - size: The number of characters of the token
+ * Notes:
+ *   - The view is only valid until the lexer is restarted (see `yyrestart`),
+ *     the parser copies what it keeps into the AST
+ */
+struct TokenText {
+  const char *data;
+  std::size_t size;
+  std::string str() const { return std::string(data, size); }
+};
+
+/**
+ * Name: SyntaxError
+ * Construct: Struct
+ * Desc: An error of the lexer/parser, the parser recovers from most and
+ *   carries on so every error of the source is reported in one run
+ * Members:
+ *   - line: The line of the error
+ *   - column: The column of the error
+ *   - message: What the error is
+ */
+struct SyntaxError {
+  int line;
+  int column;
+  std::string message;
+};
+
+extern std::vector<SyntaxError> syntax_errors;
+extern std::size_t max_syntax_errors;
+
+#endif
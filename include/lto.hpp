@@ -0,0 +1,13 @@
+#ifndef __LTO_HPP__
+#define __LTO_HPP__
+
+#include <string>
+#include <vector>
+
+struct SoodArgs;
+
+bool link_time_optimize(const SoodArgs &, const std::vector<std::string> &,
+                        std::vector<std::string> &);
+void remove_temporary_objects();
+
+#endif
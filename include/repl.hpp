@@ -0,0 +1,8 @@
+#ifndef __REPL_HPP__
+#define __REPL_HPP__
+
+struct SoodArgs;
+
+int repl(const SoodArgs &);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef __SERVE_HPP__
+#define __SERVE_HPP__
+
+struct SoodArgs;
+
+int serve(const SoodArgs &);
+
+#endif
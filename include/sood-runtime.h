@@ -0,0 +1,125 @@
+#ifndef __SOOD_RUNTIME_H__
+#define __SOOD_RUNTIME_H__
+
+#include <stdint.h>
+
+/**
+ * Name: include/sood-runtime.h
+ * Construct: Header
+ * Desc: The Sood runtime, a small C library linked with the object code of
+ *   every Sood program (and into the compiler, for `-R`). The code generated
+ *   for the language's heap values calls these functions
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Name: SoodArena
+ * Construct: Struct
+ * Desc: A region from which the values of a Sood function are allocated, all
+ *   of which are released together when the function returns. Every value
+ *   records the arena it was allocated from, so a callee which grows a value
+ *   of its caller allocates from the caller's arena
+ * Members:
+ *   - chunks: The chunks allocated from, most recent first
+ */
+typedef struct SoodArenaChunk SoodArenaChunk;
+typedef struct {
+  SoodArenaChunk *chunks;
+} SoodArena;
+
+/**
+ * Name: SoodArray
+ * Construct: Struct
+ * Desc: The representation of every Sood array, the code generator's array
+ *   types (see `array_type_of`) share this layout
+ * Members:
+ *   - data: The array's elements
+ *   - length: The number of elements in the array
+ *   - capacity: The number of elements for which `data` has space, or `-1`
+ *     if `data` is not owned by the runtime (e.g. it is on the stack)
+ *   - arena: The arena `data` is allocated from, or NULL for the C heap
+ */
+typedef struct {
+  void *data;
+  int64_t length;
+  int64_t capacity;
+  SoodArena *arena;
+} SoodArray;
+
+/** The size of the inline buffer of a `SoodString`, including the NUL */
+#define SOOD_STRING_SMALL 24
+
+/**
+ * Name: SoodString
+ * Construct: Struct
+ * Desc: The representation of every Sood string, the code generator's
+ *   string type (see `STRING_TYPE`) shares this layout. Strings short enough
+ *   are kept in `small` without allocating, the characters are always
+ *   followed by a NUL so `data` can be passed to `printf`
+ * Members:
+ *   - data: The string's characters, either `small`, a heap allocation owned
+ *     by the string, or (for a string literal) a constant
+ *   - length: The number of characters in the string
+ *   - capacity: The number of characters for which `data` has space, or `-1`
+ *     if `data` is not owned by the runtime (e.g. it is a literal)
+ *   - arena: The arena `data` is allocated from, or NULL for the C heap
+ *   - small: The inline storage of short strings
+ * Notes:
+ *   - A string may point into itself so must not be copied byte-for-byte,
+ *     use `sood_string_assign`
+ */
+typedef struct {
+  char *data;
+  int64_t length;
+  int64_t capacity;
+  SoodArena *arena;
+  char small[SOOD_STRING_SMALL];
+} SoodString;
+
+/**
+ * Name: SoodProfileSite
+ * Construct: Struct
+ * Desc: The counters of a function profiled with `--profile`, updated by the
+ *   function's own code on entry and exit, the code generator's profile site
+ *   type shares this layout
+ * Members:
+ *   - name: The name of the function
+ *   - calls: The number of calls of the function
+ *   - cycles: The cycles spent in the function and its callees, a recursive
+ *     call's cycles are counted once, by the outermost call
+ *   - depth: The number of calls of the function yet to return
+ */
+typedef struct {
+  const char *name;
+  int64_t calls;
+  int64_t cycles;
+  int64_t depth;
+} SoodProfileSite;
+
+void *sood_arena_alloc(SoodArena *arena, int64_t size);
+void *sood_arena_realloc(SoodArena *arena, void *ptr, int64_t old_size,
+                         int64_t size);
+void sood_arena_free(SoodArena *arena, void *ptr);
+void sood_arena_release(SoodArena *arena);
+
+void sood_array_new(SoodArray *arr, int64_t elem_size, int64_t length);
+void *sood_array_push(SoodArray *arr, int64_t elem_size);
+void sood_array_bounds_fail(int64_t index, int64_t length);
+
+void sood_string_init(SoodString *str, SoodArena *arena);
+void sood_string_assign(SoodString *dst, const SoodString *src);
+void sood_string_append(SoodString *dst, const SoodString *src);
+void sood_string_concat(SoodString *dst, const SoodString *lhs,
+                        const SoodString *rhs);
+int32_t sood_string_equal(const SoodString *lhs, const SoodString *rhs);
+
+void sood_profile_register(SoodProfileSite *sites, int64_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
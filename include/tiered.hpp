@@ -0,0 +1,10 @@
+#ifndef __TIERED_HPP__
+#define __TIERED_HPP__
+
+class CodeGenContext;
+class NBlock;
+struct SoodArgs;
+
+int run_tiered(CodeGenContext &, NBlock &, const SoodArgs &);
+
+#endif
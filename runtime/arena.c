@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sood-runtime.h"
+
+/**
+ * Name: runtime/arena.c
+ * Construct: Module
+ * Desc: Region allocation for the values of a Sood function, allocating is
+ *   a bump of a pointer and everything is released at once when the function
+ *   returns
+ */
+
+/** The size of a chunk, requests larger than this get a chunk of their own */
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+/** The number of released chunks kept for reuse rather than freed */
+#define ARENA_SPARE_CHUNKS 16
+
+/** The alignment of every allocation */
+#define ARENA_ALIGN 16
+
+struct SoodArenaChunk {
+  SoodArenaChunk *next;
+  int64_t size;
+  int64_t used;
+  _Alignas(ARENA_ALIGN) char data[];
+};
+
+/**
+ * Name: spare_chunks
+ * Construct: Global variable
+ * Desc: Chunks released by an arena, kept so a function called in a loop
+ *   doesn't allocate and free a chunk on every call
+ */
+static SoodArenaChunk *spare_chunks = NULL;
+static int spare_chunk_count = 0;
+
+static void arena_out_of_memory(int64_t size) {
+  fprintf(stderr, "Sood: could not allocate %ld bytes\n", (long)size);
+  exit(1);
+}
+
+static int64_t align_up(int64_t size) {
+  return (size + ARENA_ALIGN - 1) & ~(int64_t)(ARENA_ALIGN - 1);
+}
+
+/** Adds a chunk with space for at least `size` bytes to the arena */
+static SoodArenaChunk *arena_add_chunk(SoodArena *arena, int64_t size) {
+  SoodArenaChunk *chunk;
+  if (size <= ARENA_CHUNK_SIZE && spare_chunks) {
+    chunk = spare_chunks;
+    spare_chunks = chunk->next;
+    spare_chunk_count--;
+  } else {
+    int64_t chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+    chunk = malloc(sizeof(SoodArenaChunk) + chunk_size);
+    if (!chunk)
+      arena_out_of_memory(size);
+    chunk->size = chunk_size;
+  }
+  chunk->used = 0;
+  chunk->next = arena->chunks;
+  arena->chunks = chunk;
+  return chunk;
+}
+
+/**
+ * Name: sood_arena_alloc
+ * Construct: Function
+ * Desc: Allocates from an arena, or from the C heap if the arena is NULL
+ * Args:
+ *   - arena: The arena to allocate from, or NULL
+ *   - size: The number of bytes to allocate
+ */
+void *sood_arena_alloc(SoodArena *arena, int64_t size) {
+  if (!arena)
+    return malloc(size);
+
+  size = align_up(size);
+  SoodArenaChunk *chunk = arena->chunks;
+  if (!chunk || chunk->size - chunk->used < size)
+    chunk = arena_add_chunk(arena, size);
+  void *ptr = chunk->data + chunk->used;
+  chunk->used += size;
+  return ptr;
+}
+
+/**
+ * Name: sood_arena_realloc
+ * Construct: Function
+ * Desc: Grows an allocation of an arena (or of the C heap if the arena is
+ *   NULL), the most recent allocation of an arena is grown in place if the
+ *   chunk has room, otherwise the contents are copied to a new allocation
+ * Args:
+ *   - arena: The arena of the allocation, or NULL
+ *   - ptr: The allocation, or NULL
+ *   - old_size: The size of the allocation
+ *   - size: The new size of the allocation
+ */
+void *sood_arena_realloc(SoodArena *arena, void *ptr, int64_t old_size,
+                         int64_t size) {
+  if (!arena)
+    return realloc(ptr, size);
+
+  SoodArenaChunk *chunk = arena->chunks;
+  if (ptr && chunk &&
+      (char *)ptr + align_up(old_size) == chunk->data + chunk->used &&
+      align_up(size) - align_up(old_size) <= chunk->size - chunk->used) {
+    chunk->used += align_up(size) - align_up(old_size);
+    return ptr;
+  }
+
+  void *data = sood_arena_alloc(arena, size);
+  if (ptr)
+    memcpy(data, ptr, old_size < size ? old_size : size);
+  return data;
+}
+
+/**
+ * Name: sood_arena_free
+ * Construct: Function
+ * Desc: Frees an allocation of the C heap, the allocations of an arena are
+ *   only freed by releasing the arena
+ * Args:
+ *   - arena: The arena of the allocation, or NULL
+ *   - ptr: The allocation
+ */
+void sood_arena_free(SoodArena *arena, void *ptr) {
+  if (!arena)
+    free(ptr);
+}
+
+/**
+ * Name: sood_arena_release
+ * Construct: Function
+ * Desc: Releases everything allocated from an arena, the code generator
+ *   calls this as a function which uses an arena returns
+ * Args:
+ *   - arena: The arena to release
+ */
+void sood_arena_release(SoodArena *arena) {
+  SoodArenaChunk *chunk = arena->chunks;
+  while (chunk) {
+    SoodArenaChunk *next = chunk->next;
+    if (chunk->size == ARENA_CHUNK_SIZE &&
+        spare_chunk_count < ARENA_SPARE_CHUNKS) {
+      chunk->next = spare_chunks;
+      spare_chunks = chunk;
+      spare_chunk_count++;
+    } else {
+      free(chunk);
+    }
+    chunk = next;
+  }
+  arena->chunks = NULL;
+}
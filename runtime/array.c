@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sood-runtime.h"
+
+/**
+ * Name: runtime/array.c
+ * Construct: Module
+ * Desc: Allocation and growth of Sood arrays
+ */
+
+/** The capacity of a growable array on its first append */
+#define ARRAY_MIN_CAPACITY 8
+
+static void array_out_of_memory(int64_t elems, int64_t elem_size) {
+  fprintf(stderr, "Sood: could not allocate an array of %ld elements of %ld bytes\n",
+          (long)elems, (long)elem_size);
+  exit(1);
+}
+
+/**
+ * Name: sood_array_new
+ * Construct: Function
+ * Desc: Allocates the (zero-initialized) elements of an array of the given
+ *   length, used for arrays too large for, or of a size unknown until, run
+ *   time. An array redeclared (e.g. in a loop) reuses its elements if they
+ *   have space
+ * Args:
+ *   - arr: The array to initialize
+ *   - elem_size: The size, in bytes, of each element
+ *   - length: The number of elements
+ */
+void sood_array_new(SoodArray *arr, int64_t elem_size, int64_t length) {
+  if (length < 0)
+    length = 0;
+  if (length > arr->capacity) {
+    if (arr->capacity > 0)
+      sood_arena_free(arr->arena, arr->data);
+    arr->data = sood_arena_alloc(arr->arena, length * elem_size);
+    if (!arr->data)
+      array_out_of_memory(length, elem_size);
+    arr->capacity = length;
+  }
+  if (length)
+    memset(arr->data, 0, length * elem_size);
+  arr->length = length;
+}
+
+/**
+ * Name: sood_array_push
+ * Construct: Function
+ * Desc: Makes space for one more element at the end of an array and returns
+ *   a pointer to it, the capacity doubles when full so appending is
+ *   amortized constant time. Elements not owned by the runtime (on the stack)
+ *   are first copied to the array's arena
+ * Args:
+ *   - arr: The array to append to
+ *   - elem_size: The size, in bytes, of each element
+ */
+void *sood_array_push(SoodArray *arr, int64_t elem_size) {
+  if (arr->length >= arr->capacity) {
+    int64_t capacity = arr->length < ARRAY_MIN_CAPACITY / 2
+                           ? ARRAY_MIN_CAPACITY
+                           : arr->length * 2;
+    void *data;
+    if (arr->capacity <= 0) {
+      data = sood_arena_alloc(arr->arena, capacity * elem_size);
+      if (data && arr->length)
+        memcpy(data, arr->data, arr->length * elem_size);
+    } else {
+      data = sood_arena_realloc(arr->arena, arr->data,
+                                arr->capacity * elem_size,
+                                capacity * elem_size);
+    }
+    if (!data)
+      array_out_of_memory(capacity, elem_size);
+    arr->data = data;
+    arr->capacity = capacity;
+  }
+  return (char *)arr->data + arr->length++ * elem_size;
+}
+
+/**
+ * Name: sood_array_bounds_fail
+ * Construct: Function
+ * Desc: Reports an out of bounds index and exits, the code generator only
+ *   calls this when a bounds check fails
+ * Args:
+ *   - index: The offending index
+ *   - length: The length of the array
+ */
+void sood_array_bounds_fail(int64_t index, int64_t length) {
+  fprintf(stderr, "Sood: index %ld out of bounds for array of length %ld\n",
+          (long)index, (long)length);
+  exit(1);
+}
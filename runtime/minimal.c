@@ -0,0 +1,408 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Name: runtime/minimal.c
+ * Construct: Module
+ * Desc: The C library of a program linked with `--static-minimal`, in place
+ *   of libc: the program's entry point, `printf` for the code generator's
+ *   writes, and the few functions the rest of the runtime calls, over raw
+ *   system calls. Without the dynamic loader or libc's initialization, a
+ *   program's start is a handful of instructions
+ * Notes:
+ *   - Only x86-64 Linux is supported, the build only includes this in
+ *     `sood-runtime-minimal` there
+ *   - This is built without builtins or stack protection, see
+ *     runtime/CMakeLists.txt, as nothing here may call back into libc or
+ *     read the thread pointer (which is never set)
+ *   - `stdio.h` and `stdlib.h` aren't included, `FILE` is this file's
+ *     `OutStream`, the other modules only pass `stderr` through
+ */
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "The minimal runtime only supports x86-64 Linux"
+#endif
+
+/* -------- System calls -------- */
+
+#define SYS_WRITE 1
+#define SYS_MMAP 9
+#define SYS_MUNMAP 11
+#define SYS_IOCTL 16
+#define SYS_EXIT_GROUP 231
+
+#define EINTR 4
+#define PROT_READ 0x1
+#define PROT_WRITE 0x2
+#define MAP_PRIVATE 0x02
+#define MAP_ANONYMOUS 0x20
+#define TCGETS 0x5401
+
+/** Makes a system call, returning its result or a negated `errno` */
+static long syscall6(long n, long a, long b, long c, long d, long e, long f) {
+  register long r10 __asm__("r10") = d;
+  register long r8 __asm__("r8") = e;
+  register long r9 __asm__("r9") = f;
+  long ret;
+  __asm__ volatile("syscall"
+                   : "=a"(ret)
+                   : "a"(n), "D"(a), "S"(b), "d"(c), "r"(r10), "r"(r8),
+                     "r"(r9)
+                   : "rcx", "r11", "memory");
+  return ret;
+}
+
+static void *sys_mmap(size_t size) {
+  long ret = syscall6(SYS_MMAP, 0, (long)size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return ret < 0 && ret > -4096 ? NULL : (void *)ret;
+}
+
+static void sys_munmap(void *ptr, size_t size) {
+  syscall6(SYS_MUNMAP, (long)ptr, (long)size, 0, 0, 0, 0);
+}
+
+__attribute__((noreturn)) static void sys_exit(int status) {
+  for (;;)
+    syscall6(SYS_EXIT_GROUP, status, 0, 0, 0, 0, 0);
+}
+
+/* -------- Memory -------- */
+
+void *memcpy(void *dst, const void *src, size_t n) {
+  unsigned char *d = dst;
+  const unsigned char *s = src;
+  while (n--)
+    *d++ = *s++;
+  return dst;
+}
+
+void *memmove(void *dst, const void *src, size_t n) {
+  unsigned char *d = dst;
+  const unsigned char *s = src;
+  if (d < s)
+    return memcpy(dst, src, n);
+  while (n--)
+    d[n] = s[n];
+  return dst;
+}
+
+void *memset(void *dst, int c, size_t n) {
+  unsigned char *d = dst;
+  while (n--)
+    *d++ = (unsigned char)c;
+  return dst;
+}
+
+int memcmp(const void *lhs, const void *rhs, size_t n) {
+  const unsigned char *l = lhs, *r = rhs;
+  for (; n; n--, l++, r++)
+    if (*l != *r)
+      return *l - *r;
+  return 0;
+}
+
+size_t strlen(const char *str) {
+  const char *end = str;
+  while (*end)
+    end++;
+  return end - str;
+}
+
+/* -------- Heap -------- */
+
+/** Blocks of 16 bytes to 128 KiB, each a power of two, are reused */
+#define HEAP_CLASSES 14
+#define HEAP_MIN_BLOCK 16
+
+/** The size of the regions mapped for blocks of the size classes */
+#define HEAP_REGION (1 << 20)
+
+/**
+ * Name: HeapHeader
+ * Construct: Struct
+ * Desc: Precedes every block of the heap, 16 bytes so blocks stay aligned
+ *   as `malloc`'s must be
+ * Members:
+ *   - size: The usable size of the block
+ *   - cls: The block's size class, or `HEAP_CLASSES` for a block mapped of
+ *     its own
+ */
+typedef struct {
+  size_t size;
+  size_t cls;
+} HeapHeader;
+
+/**
+ * Name: heap_free_lists
+ * Construct: Global variable
+ * Desc: The freed blocks of each size class, each linked through its first
+ *   word, and the rest of the region most recently mapped
+ */
+static void *heap_free_lists[HEAP_CLASSES];
+static char *heap_region = NULL;
+static size_t heap_region_left = 0;
+
+void *malloc(size_t size) {
+  size_t cls = 0;
+  while (cls < HEAP_CLASSES && ((size_t)HEAP_MIN_BLOCK << cls) < size)
+    cls++;
+
+  /** Larger blocks are mapped, and unmapped as they're freed */
+  if (cls == HEAP_CLASSES) {
+    size_t total = (sizeof(HeapHeader) + size + 4095) & ~(size_t)4095;
+    HeapHeader *header = sys_mmap(total);
+    if (!header)
+      return NULL;
+    header->size = total - sizeof(HeapHeader);
+    header->cls = HEAP_CLASSES;
+    return header + 1;
+  }
+
+  if (heap_free_lists[cls]) {
+    void *block = heap_free_lists[cls];
+    heap_free_lists[cls] = *(void **)block;
+    return block;
+  }
+
+  size_t total = sizeof(HeapHeader) + ((size_t)HEAP_MIN_BLOCK << cls);
+  if (heap_region_left < total) {
+    heap_region = sys_mmap(HEAP_REGION);
+    if (!heap_region) {
+      heap_region_left = 0;
+      return NULL;
+    }
+    heap_region_left = HEAP_REGION;
+  }
+  HeapHeader *header = (HeapHeader *)heap_region;
+  heap_region += total;
+  heap_region_left -= total;
+  header->size = (size_t)HEAP_MIN_BLOCK << cls;
+  header->cls = cls;
+  return header + 1;
+}
+
+void free(void *ptr) {
+  if (!ptr)
+    return;
+  HeapHeader *header = (HeapHeader *)ptr - 1;
+  if (header->cls == HEAP_CLASSES) {
+    sys_munmap(header, header->size + sizeof(HeapHeader));
+    return;
+  }
+  *(void **)ptr = heap_free_lists[header->cls];
+  heap_free_lists[header->cls] = ptr;
+}
+
+void *realloc(void *ptr, size_t size) {
+  if (!ptr)
+    return malloc(size);
+  HeapHeader *header = (HeapHeader *)ptr - 1;
+  if (size <= header->size)
+    return ptr;
+  void *data = malloc(size);
+  if (!data)
+    return NULL;
+  memcpy(data, ptr, header->size);
+  free(ptr);
+  return data;
+}
+
+/* -------- Output -------- */
+
+#define OUT_BUFFER 4096
+
+/**
+ * Name: OutStream
+ * Construct: Struct
+ * Desc: A buffered file descriptor written to, libc's `FILE` for the
+ *   runtime. stderr, and stdout if it's a terminal, are written at the end
+ *   of each call, a redirected stdout only when its buffer is full or the
+ *   program exits
+ * Members:
+ *   - fd: The file descriptor
+ *   - buffered: Whether the stream is only written when its buffer is full,
+ *     or -1 if that isn't known yet
+ *   - length: The number of bytes buffered
+ *   - data: The buffer
+ */
+typedef struct {
+  int fd;
+  int buffered;
+  size_t length;
+  char data[OUT_BUFFER];
+} OutStream;
+
+static OutStream out_stream = {1, -1, 0, {0}};
+static OutStream err_stream = {2, 0, 0, {0}};
+OutStream *stdout = &out_stream;
+OutStream *stderr = &err_stream;
+
+static void stream_flush(OutStream *stream) {
+  const char *data = stream->data;
+  size_t length = stream->length;
+  while (length) {
+    long written = syscall6(SYS_WRITE, stream->fd, (long)data, (long)length,
+                            0, 0, 0);
+    if (written == -EINTR)
+      continue;
+    if (written <= 0)
+      break;
+    data += written;
+    length -= written;
+  }
+  stream->length = 0;
+}
+
+static void stream_write(OutStream *stream, const char *data, size_t length) {
+  while (length) {
+    if (stream->length == OUT_BUFFER)
+      stream_flush(stream);
+    size_t room = OUT_BUFFER - stream->length;
+    size_t n = length < room ? length : room;
+    memcpy(stream->data + stream->length, data, n);
+    stream->length += n;
+    data += n;
+    length -= n;
+  }
+}
+
+/** Writes an integer in decimal */
+static void stream_integer(OutStream *stream, uint64_t value, int negative) {
+  char digits[21];
+  int n = sizeof(digits);
+  do {
+    digits[--n] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  if (negative)
+    digits[--n] = '-';
+  stream_write(stream, digits + n, sizeof(digits) - n);
+}
+
+/**
+ * Name: stream_format
+ * Construct: Function
+ * Desc: Writes a format of `printf`, of the conversions the runtime uses:
+ *   `%d`, `%i`, `%u`, `%s`, `%c`, and `%%`, with an `l` or `z` length
+ * Args:
+ *   - stream: The stream written to
+ *   - fmt: The format
+ *   - args: The values of its conversions
+ */
+static int stream_format(OutStream *stream, const char *fmt, va_list args) {
+  if (stream->buffered < 0) {
+    char termios[64];
+    stream->buffered =
+        syscall6(SYS_IOCTL, stream->fd, TCGETS, (long)termios, 0, 0, 0) != 0;
+  }
+
+  for (const char *c = fmt; *c; c++) {
+    if (*c != '%') {
+      const char *end = c;
+      while (end[1] && end[1] != '%')
+        end++;
+      stream_write(stream, c, end - c + 1);
+      c = end;
+      continue;
+    }
+    int wide = 0;
+    if (c[1] == 'l' || c[1] == 'z') {
+      wide = 1;
+      c++;
+      if (c[1] == 'l')
+        c++;
+    }
+    switch (*++c) {
+    case 'd':
+    case 'i': {
+      int64_t value = wide ? va_arg(args, long) : va_arg(args, int);
+      stream_integer(stream, value < 0 ? -(uint64_t)value : (uint64_t)value,
+                     value < 0);
+      break;
+    }
+    case 'u':
+      stream_integer(stream,
+                     wide ? va_arg(args, unsigned long)
+                          : va_arg(args, unsigned int),
+                     0);
+      break;
+    case 's': {
+      const char *str = va_arg(args, const char *);
+      if (!str)
+        str = "(null)";
+      stream_write(stream, str, strlen(str));
+      break;
+    }
+    case 'c': {
+      char ch = (char)va_arg(args, int);
+      stream_write(stream, &ch, 1);
+      break;
+    }
+    case '%':
+      stream_write(stream, "%", 1);
+      break;
+    case '\0':
+      c--;
+      break;
+    default:
+      stream_write(stream, c - 1, 2);
+      break;
+    }
+  }
+
+  if (!stream->buffered)
+    stream_flush(stream);
+  return 0;
+}
+
+int printf(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int ret = stream_format(stdout, fmt, args);
+  va_end(args);
+  return ret;
+}
+
+int fprintf(OutStream *stream, const char *fmt, ...) {
+  /** What was written before an error is written first */
+  if (stream != stdout)
+    stream_flush(stdout);
+  va_list args;
+  va_start(args, fmt);
+  int ret = stream_format(stream, fmt, args);
+  va_end(args);
+  return ret;
+}
+
+/* -------- Entry -------- */
+
+__attribute__((noreturn)) void exit(int status) {
+  stream_flush(stdout);
+  stream_flush(stderr);
+  sys_exit(status);
+}
+
+/** The top-level code of the program, generated as `void main()` so its
+ *   result is meaningless */
+extern int main(void);
+
+/** Called by `_start`, with the stack aligned */
+__attribute__((used, noreturn)) static void start_program(void) {
+  main();
+  exit(0);
+}
+
+/**
+ * The process' entry point, the kernel leaves the arguments and environment
+ *   on the stack, which the top-level code doesn't use
+ */
+__asm__(".text\n"
+        ".global _start\n"
+        ".type _start, @function\n"
+        "_start:\n"
+        "  xor %ebp, %ebp\n"
+        "  and $-16, %rsp\n"
+        "  call start_program\n"
+        "  hlt\n");
@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Name: runtime/pgo.c
+ * Construct: Module
+ * Desc: Writes the counters of a program built with `--pgo-instrument` to a
+ *   raw profile as it exits, for `llvm-profdata merge` and then
+ *   `--pgo-use`. The counters are inserted and laid out by LLVM's
+ *   instrumentation passes, in the `__llvm_prf_*` sections, and the layout of
+ *   the profile is that of the LLVM the compiler is built with, described by
+ *   its `InstrProfData.inc`
+ * Notes:
+ *   - This is linked only into instrumented programs, which reference
+ *     `__llvm_profile_runtime` (see `link_objects` of src/main.cpp), else the
+ *     sections are absent and nothing is written
+ *   - The profile is written to `$LLVM_PROFILE_FILE`, or `default.profraw`
+ */
+
+/** The constants of the profile (magic, versions), then its layouts */
+#include <llvm/ProfileData/InstrProfData.inc>
+
+typedef intptr_t IntPtrT;
+
+enum ValueKind {
+#define VALUE_PROF_KIND(Enumerator, Value, Descr) Enumerator = Value,
+#include <llvm/ProfileData/InstrProfData.inc>
+};
+
+/**
+ * Name: ProfileData
+ * Construct: Struct
+ * Desc: The record of an instrumented function in `__llvm_prf_data`, its name
+ *   hash, CFG hash and counters
+ */
+typedef struct __attribute__((aligned(8))) ProfileData {
+#define INSTR_PROF_DATA(Type, LLVMType, Name, Initializer) Type Name;
+#include <llvm/ProfileData/InstrProfData.inc>
+} ProfileData;
+
+/**
+ * Name: ProfileHeader
+ * Construct: Struct
+ * Desc: The header of a raw profile, the sizes and addresses of the sections
+ *   which follow it
+ */
+typedef struct ProfileHeader {
+#define INSTR_PROF_RAW_HEADER(Type, Name, Initializer) Type Name;
+#include <llvm/ProfileData/InstrProfData.inc>
+} ProfileHeader;
+
+/** The bounds of the sections, defined by the linker where they're present */
+extern ProfileData __start___llvm_prf_data[] __attribute__((weak));
+extern ProfileData __stop___llvm_prf_data[] __attribute__((weak));
+extern uint64_t __start___llvm_prf_cnts[] __attribute__((weak));
+extern uint64_t __stop___llvm_prf_cnts[] __attribute__((weak));
+extern char __start___llvm_prf_names[] __attribute__((weak));
+extern char __stop___llvm_prf_names[] __attribute__((weak));
+
+/** The version of the instrumentation, defined by each instrumented module */
+extern uint64_t __llvm_profile_raw_version __attribute__((weak));
+
+/** Referenced by the linker for instrumented programs, to link this module */
+int __llvm_profile_runtime;
+
+static uint64_t __llvm_profile_get_magic(void) {
+  return INSTR_PROF_RAW_MAGIC_64;
+}
+
+static uint64_t __llvm_profile_get_version(void) {
+  return __llvm_profile_raw_version;
+}
+
+/** Build ids are optional, and none are written */
+#define __llvm_write_binary_ids(Writer) 0
+
+/** The bytes of padding after a section, to align the next one */
+static uint64_t padding(uint64_t size) { return (8 - size % 8) % 8; }
+
+/** Writes the profile, ran as the program exits */
+static void pgo_write(void) {
+  const ProfileData *DataBegin = __start___llvm_prf_data;
+  const uint64_t *CountersBegin = __start___llvm_prf_cnts;
+  const char *NamesBegin = __start___llvm_prf_names;
+  uint64_t DataSize = __stop___llvm_prf_data - DataBegin;
+  uint64_t CountersSize = __stop___llvm_prf_cnts - CountersBegin;
+  uint64_t NamesSize = __stop___llvm_prf_names - NamesBegin;
+  uint64_t PaddingBytesBeforeCounters = 0;
+  uint64_t PaddingBytesAfterCounters = 0;
+
+  ProfileHeader header = {
+#define INSTR_PROF_RAW_HEADER(Type, Name, Initializer) Initializer,
+#include <llvm/ProfileData/InstrProfData.inc>
+  };
+
+  const char *path = getenv("LLVM_PROFILE_FILE");
+  if (!path || !*path)
+    path = "default.profraw";
+  FILE *out = fopen(path, "wb");
+  if (!out) {
+    fprintf(stderr, "Could not write the profile to %s\n", path);
+    return;
+  }
+
+  static const char zeros[8];
+  fwrite(&header, sizeof(header), 1, out);
+  fwrite(DataBegin, sizeof(ProfileData), DataSize, out);
+  fwrite(CountersBegin, sizeof(uint64_t), CountersSize, out);
+  fwrite(NamesBegin, 1, NamesSize, out);
+  fwrite(zeros, 1, padding(NamesSize), out);
+  fclose(out);
+}
+
+/** Writes the profile at exit, if the program is instrumented */
+__attribute__((constructor)) static void pgo_register(void) {
+  if (__start___llvm_prf_data && &__llvm_profile_raw_version)
+    atexit(pgo_write);
+}
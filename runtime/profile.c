@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sood-runtime.h"
+
+/**
+ * Name: runtime/profile.c
+ * Construct: Module
+ * Desc: The report of a program profiled with `--profile`, the counting
+ *   itself is inlined in the program's functions. Each module registers its
+ *   functions' counters as the program starts, and the table of calls and
+ *   cycles by function is written to stderr as it exits
+ */
+
+/**
+ * Name: ProfileModule
+ * Construct: Struct
+ * Desc: The counters of the functions of a module
+ * Members:
+ *   - sites: The counters of the module's functions
+ *   - count: The number of functions of the module
+ *   - next: The module registered before this one
+ */
+typedef struct ProfileModule {
+  SoodProfileSite *sites;
+  int64_t count;
+  struct ProfileModule *next;
+} ProfileModule;
+
+static ProfileModule *profile_modules = NULL;
+
+/** Orders the counters by cycles, most first */
+static int by_cycles(const void *lhs, const void *rhs) {
+  const SoodProfileSite *l = *(const SoodProfileSite *const *)lhs;
+  const SoodProfileSite *r = *(const SoodProfileSite *const *)rhs;
+  return l->cycles < r->cycles ? 1 : l->cycles > r->cycles ? -1 : 0;
+}
+
+/** Writes the table of the functions called, ran as the program exits */
+static void profile_report(void) {
+  int64_t count = 0;
+  for (ProfileModule *mod = profile_modules; mod; mod = mod->next)
+    count += mod->count;
+
+  SoodProfileSite **sites = malloc(count * sizeof(SoodProfileSite *));
+  if (!sites)
+    return;
+  int64_t called = 0;
+  for (ProfileModule *mod = profile_modules; mod; mod = mod->next)
+    for (int64_t i = 0; i < mod->count; i++)
+      if (mod->sites[i].calls)
+        sites[called++] = &mod->sites[i];
+  qsort(sites, called, sizeof(SoodProfileSite *), by_cycles);
+
+  /** After the program's own output, were both to go to one file */
+  fflush(stdout);
+  fprintf(stderr, "\nSood profile (cycles include callees)\n");
+  fprintf(stderr, "%14s %18s %14s  %s\n", "calls", "cycles", "cycles/call",
+          "function");
+  for (int64_t i = 0; i < called; i++)
+    fprintf(stderr, "%14ld %18ld %14ld  %s\n", (long)sites[i]->calls,
+            (long)sites[i]->cycles, (long)(sites[i]->cycles / sites[i]->calls),
+            sites[i]->name);
+  free(sites);
+}
+
+/**
+ * Name: sood_profile_register
+ * Construct: Function
+ * Desc: Registers the counters of a module's functions for the report, called
+ *   by the module's constructor
+ * Args:
+ *   - sites: The counters of the module's functions
+ *   - count: The number of functions of the module
+ */
+void sood_profile_register(SoodProfileSite *sites, int64_t count) {
+  ProfileModule *mod = malloc(sizeof(ProfileModule));
+  if (!mod)
+    return;
+  if (!profile_modules)
+    atexit(profile_report);
+  mod->sites = sites;
+  mod->count = count;
+  mod->next = profile_modules;
+  profile_modules = mod;
+}
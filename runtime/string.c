@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sood-runtime.h"
+
+/**
+ * Name: runtime/string.c
+ * Construct: Module
+ * Desc: Storage, assignment, concatenation, and comparison of Sood strings
+ */
+
+static void string_out_of_memory(int64_t length) {
+  fprintf(stderr, "Sood: could not allocate a string of %ld characters\n",
+          (long)length);
+  exit(1);
+}
+
+/** Whether the string's characters are an allocation it owns */
+static int string_owns_data(const SoodString *str) {
+  return str->capacity >= 0 && str->data != str->small;
+}
+
+/**
+ * Name: string_reserve
+ * Construct: Function
+ * Desc: Makes space for at least `length` characters (and the NUL), moving
+ *   the string to `small` or its arena as needed
+ * Args:
+ *   - str: The string to reserve space in
+ *   - length: The number of characters needed
+ *   - keep: Whether the current characters must be kept, when they are the
+ *     capacity is at least doubled so repeated appends take amortized
+ *     constant time, when not the capacity is exactly what is needed
+ */
+static void string_reserve(SoodString *str, int64_t length, int keep) {
+  if (length <= str->capacity)
+    return;
+
+  char *data;
+  int64_t capacity;
+  if (length < SOOD_STRING_SMALL) {
+    /** Only a string not owning its characters (a literal) gets here */
+    data = str->small;
+    capacity = SOOD_STRING_SMALL - 1;
+  } else {
+    capacity = keep && str->capacity * 2 > length ? str->capacity * 2 : length;
+    if (keep && string_owns_data(str)) {
+      data = sood_arena_realloc(str->arena, str->data, str->capacity + 1,
+                                capacity + 1);
+    } else {
+      data = sood_arena_alloc(str->arena, capacity + 1);
+      if (data && keep)
+        memcpy(data, str->data, str->length);
+      if (string_owns_data(str))
+        sood_arena_free(str->arena, str->data);
+    }
+    if (!data)
+      string_out_of_memory(capacity);
+  }
+
+  if (keep && data == str->small && str->data != str->small)
+    memcpy(data, str->data, str->length);
+  str->data = data;
+  str->capacity = capacity;
+}
+
+/**
+ * Name: sood_string_init
+ * Construct: Function
+ * Desc: Initializes the storage of a string variable to the empty string
+ * Args:
+ *   - str: The string to initialize
+ *   - arena: The arena to allocate the string's characters from, or NULL
+ */
+void sood_string_init(SoodString *str, SoodArena *arena) {
+  str->data = str->small;
+  str->length = 0;
+  str->capacity = SOOD_STRING_SMALL - 1;
+  str->arena = arena;
+  str->small[0] = '\0';
+}
+
+/**
+ * Name: sood_string_assign
+ * Construct: Function
+ * Desc: Copies one string to another. A literal which doesn't fit the
+ *   destination's current space isn't copied, the destination shares its
+ *   (constant) characters until it is next modified
+ * Args:
+ *   - dst: The string to assign to
+ *   - src: The string to assign
+ */
+void sood_string_assign(SoodString *dst, const SoodString *src) {
+  if (dst == src)
+    return;
+
+  if (src->capacity < 0 && src->length > dst->capacity) {
+    if (string_owns_data(dst))
+      sood_arena_free(dst->arena, dst->data);
+    dst->data = src->data;
+    dst->length = src->length;
+    dst->capacity = -1;
+    return;
+  }
+
+  string_reserve(dst, src->length, 0);
+  memcpy(dst->data, src->data, src->length);
+  dst->length = src->length;
+  dst->data[dst->length] = '\0';
+}
+
+/**
+ * Name: sood_string_append
+ * Construct: Function
+ * Desc: Appends one string to the end of another, as the capacity grows
+ *   geometrically, building a string by repeatedly appending to it takes
+ *   time linear in its final length
+ * Args:
+ *   - dst: The string to append to
+ *   - src: The string to append, which may be `dst` itself
+ */
+void sood_string_append(SoodString *dst, const SoodString *src) {
+  int64_t src_length = src->length;
+  int64_t length = dst->length + src_length;
+  string_reserve(dst, length, 1);
+  /** `src->data` is read after reserving as `src` may be `dst` */
+  memmove(dst->data + dst->length, src->data, src_length);
+  dst->length = length;
+  dst->data[length] = '\0';
+}
+
+/**
+ * Name: sood_string_concat
+ * Construct: Function
+ * Desc: Sets a string to the concatenation of two others, the space needed
+ *   is reserved once, up front
+ * Args:
+ *   - dst: The string to hold the result
+ *   - lhs: The first string, which may be `dst`
+ *   - rhs: The second string, which may be `dst`
+ */
+void sood_string_concat(SoodString *dst, const SoodString *lhs,
+                        const SoodString *rhs) {
+  if (dst == lhs) {
+    sood_string_append(dst, rhs);
+    return;
+  }
+
+  int64_t lhs_length = lhs->length;
+  int64_t rhs_length = rhs->length;
+  int64_t length = lhs_length + rhs_length;
+  if (dst == rhs) {
+    string_reserve(dst, length, 1);
+    memmove(dst->data + lhs_length, dst->data, rhs_length);
+  } else {
+    string_reserve(dst, length, 0);
+    memcpy(dst->data + lhs_length, rhs->data, rhs_length);
+  }
+  memcpy(dst->data, lhs->data, lhs_length);
+  dst->length = length;
+  dst->data[length] = '\0';
+}
+
+/**
+ * Name: sood_string_equal
+ * Construct: Function
+ * Desc: Whether two strings hold the same characters, strings of differing
+ *   lengths are unequal without looking at their characters
+ * Args:
+ *   - lhs: The first string
+ *   - rhs: The second string
+ */
+int32_t sood_string_equal(const SoodString *lhs, const SoodString *rhs) {
+  return lhs->length == rhs->length &&
+         memcmp(lhs->data, rhs->data, lhs->length) == 0;
+}
@@ -0,0 +1,622 @@
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "ast-binary.hpp"
+#include "ast.hpp"
+
+/**
+ * Name: src/ast-binary.cpp
+ * Construct: Module
+ * Desc: The binary form of the AST (`--emit-ast`, `.sast` files), for ASTs
+ *   generated once and compiled many times. Reading it back maps the file
+ *   into memory and creates the nodes in a single pass over their records,
+ *   with no lexing or parsing. The file is:
+ *   - A header (see `SastHeader`)
+ *   - The records of the nodes, each a `SastRecord` followed by `count`
+ *     32-bit words. A node's children are words holding the offsets of their
+ *     records, which always precede it, 0 for no child. Strings are words
+ *     holding offsets into the string table
+ *   - The string table, each string a 32-bit length followed by its bytes,
+ *     padded to a multiple of 4 bytes, and each distinct string written once
+ * Notes:
+ *   - The words are in the byte order of the host, a file of the other byte
+ *     order is rejected by its magic number
+ *   - The operators of expressions are the values of `OPS` (see
+ *     include/ast.hpp), the version must change with them
+ */
+
+/** "SAST" as read on a little-endian host */
+static const std::uint32_t SAST_MAGIC = 0x54534153;
+static const std::uint32_t SAST_VERSION = 1;
+
+/**
+ * Name: SastHeader
+ * Construct: Struct
+ * Desc: The start of a binary AST file
+ * Members:
+ *   - magic, version: `SAST_MAGIC` and `SAST_VERSION`
+ *   - node_count: The number of records
+ *   - strings: The offset of the string table, and the end of the records
+ *   - strings_size: The size, in bytes, of the string table
+ *   - root: The offset of the record of the program's block
+ */
+struct SastHeader {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t node_count;
+  std::uint32_t strings;
+  std::uint32_t strings_size;
+  std::uint32_t root;
+};
+
+/**
+ * Name: SastRecord
+ * Construct: Struct
+ * Desc: The start of the record of a node
+ * Members:
+ *   - tag: The class of the node (see `SastTag`)
+ *   - line, column: The location of the node in the source
+ *   - count: The number of words of the record following this
+ */
+struct SastRecord {
+  std::uint32_t tag;
+  std::uint32_t line;
+  std::uint32_t column;
+  std::uint32_t count;
+};
+
+/**
+ * Name: SastTag
+ * Construct: Enum
+ * Desc: The class of a node, and the words of its record:
+ *   - INTEGER, FLOAT: The value, in two words
+ *   - STRING, IDENTIFIER: The value
+ *   - FUNCTION_CALL: The identifier, then each argument
+ *   - UNARY: The operator and operand
+ *   - BINARY: The operator, lhs and rhs
+ *   - BLOCK: Each statement
+ *   - VARIABLE_DECLARATION, ARRAY_DECLARATION: The type, identifier, and
+ *     initializer or size (if any)
+ *   - FUNCTION_DECLARATION: The type, identifier, block, then each argument
+ *   - IF: The condition, block, and `else` (if any)
+ *   - The rest: Their children in the order of their constructor's arguments
+ */
+enum SastTag : std::uint32_t {
+  SAST_INTEGER = 1,
+  SAST_FLOAT,
+  SAST_STRING,
+  SAST_IDENTIFIER,
+  SAST_FUNCTION_CALL,
+  SAST_UNARY,
+  SAST_BINARY,
+  SAST_ARRAY_INDEX,
+  SAST_LENGTH,
+  SAST_BLOCK,
+  SAST_ASSIGNMENT,
+  SAST_READ,
+  SAST_WRITE,
+  SAST_RETURN,
+  SAST_EXPRESSION_STATEMENT,
+  SAST_VARIABLE_DECLARATION,
+  SAST_ARRAY_DECLARATION,
+  SAST_ARRAY_ASSIGNMENT,
+  SAST_APPEND,
+  SAST_UNTIL,
+  SAST_WHILE,
+  SAST_ELSE,
+  SAST_IF,
+  SAST_FUNCTION_DECLARATION,
+  SAST_IMPORT,
+};
+
+/**
+ * Name: SastWriter
+ * Construct: Class
+ * Desc: Writes the records of an AST, children before their parents, and
+ *   collects the strings for the string table
+ * Members:
+ *   - nodes: The words of the records, the header's space included
+ *   - strings: The words of the string table
+ *   - string_offsets: The offset of each string in the table
+ *   - node_count: The number of records written
+ *   - locations: Whether the locations of the nodes are written, otherwise
+ *     they're written as 0
+ */
+class SastWriter {
+  std::vector<std::uint32_t> nodes;
+  std::vector<std::uint32_t> strings;
+  std::map<std::string, std::uint32_t> string_offsets;
+  std::uint32_t node_count = 0;
+  bool locations;
+
+  std::uint32_t string(const std::string &);
+  std::uint32_t record(const Node &, SastTag,
+                       const std::vector<std::uint32_t> &);
+
+public:
+  SastWriter(bool locations = true)
+      : nodes(sizeof(SastHeader) / 4), locations(locations) {}
+  std::uint32_t write(Node *);
+  std::string bytes(std::uint32_t);
+  bool save(std::uint32_t, const std::string &);
+};
+
+/** The offset of a string in the table, adding it if it's new */
+std::uint32_t SastWriter::string(const std::string &str) {
+  auto it = string_offsets.find(str);
+  if (it != string_offsets.end())
+    return it->second;
+  std::uint32_t offset = strings.size() * 4;
+  strings.push_back(str.size());
+  std::size_t start = strings.size();
+  strings.resize(start + (str.size() + 3) / 4);
+  std::memcpy(strings.data() + start, str.data(), str.size());
+  string_offsets.insert({str, offset});
+  return offset;
+}
+
+/** Appends the record of a node, returning its offset */
+std::uint32_t SastWriter::record(const Node &node, SastTag tag,
+                                 const std::vector<std::uint32_t> &words) {
+  std::uint32_t offset = nodes.size() * 4;
+  nodes.push_back(tag);
+  nodes.push_back(locations ? node.line : 0);
+  nodes.push_back(locations ? node.column : 0);
+  nodes.push_back(words.size());
+  nodes.insert(nodes.end(), words.begin(), words.end());
+  node_count++;
+  return offset;
+}
+
+/**
+ * Name: SastWriter::write
+ * Construct: Method
+ * Desc: Writes the records of a subtree, returning the offset of the record
+ *   of its root, or 0 for no node
+ * Args:
+ *   - node: The root of the subtree, may be null
+ */
+std::uint32_t SastWriter::write(Node *node) {
+  if (!node)
+    return 0;
+
+  if (NInteger *num = dynamic_cast<NInteger *>(node)) {
+    std::uint32_t words[2];
+    std::memcpy(words, &num->val, sizeof(words));
+    return record(*node, SAST_INTEGER, {words[0], words[1]});
+  }
+  if (NFloat *num = dynamic_cast<NFloat *>(node)) {
+    std::uint32_t words[2];
+    std::memcpy(words, &num->val, sizeof(words));
+    return record(*node, SAST_FLOAT, {words[0], words[1]});
+  }
+  if (NString *str = dynamic_cast<NString *>(node))
+    return record(*node, SAST_STRING, {string(str->val)});
+  if (NIdentifier *id = dynamic_cast<NIdentifier *>(node))
+    return record(*node, SAST_IDENTIFIER, {string(id->val)});
+  if (NFunctionCall *call = dynamic_cast<NFunctionCall *>(node)) {
+    std::vector<std::uint32_t> words = {write(&call->id)};
+    for (NExpression *arg : call->args)
+      words.push_back(write(arg));
+    return record(*node, SAST_FUNCTION_CALL, words);
+  }
+  if (NUnaryExpression *un = dynamic_cast<NUnaryExpression *>(node))
+    return record(*node, SAST_UNARY,
+                  {static_cast<std::uint32_t>(un->op), write(&un->rhs)});
+  if (NBinaryExpression *bin = dynamic_cast<NBinaryExpression *>(node)) {
+    std::uint32_t lhs = write(&bin->lhs);
+    return record(*node, SAST_BINARY,
+                  {static_cast<std::uint32_t>(bin->op), lhs, write(&bin->rhs)});
+  }
+  if (NArrayIndex *idx = dynamic_cast<NArrayIndex *>(node)) {
+    std::uint32_t array = write(&idx->array);
+    return record(*node, SAST_ARRAY_INDEX, {array, write(&idx->index)});
+  }
+  if (NLength *len = dynamic_cast<NLength *>(node))
+    return record(*node, SAST_LENGTH, {write(&len->exp)});
+  if (NBlock *block = dynamic_cast<NBlock *>(node)) {
+    std::vector<std::uint32_t> words;
+    for (NStatement *stmt : block->stmts)
+      words.push_back(write(stmt));
+    return record(*node, SAST_BLOCK, words);
+  }
+  if (NAssignment *assign = dynamic_cast<NAssignment *>(node)) {
+    std::uint32_t lhs = write(&assign->lhs);
+    return record(*node, SAST_ASSIGNMENT, {lhs, write(&assign->rhs)});
+  }
+  if (NRead *read = dynamic_cast<NRead *>(node)) {
+    std::uint32_t from = write(&read->from);
+    return record(*node, SAST_READ, {from, write(&read->to)});
+  }
+  if (NWrite *wrt = dynamic_cast<NWrite *>(node)) {
+    std::uint32_t exp = write(&wrt->exp);
+    return record(*node, SAST_WRITE, {exp, write(&wrt->to)});
+  }
+  if (NReturnStatement *ret = dynamic_cast<NReturnStatement *>(node))
+    return record(*node, SAST_RETURN, {write(&ret->exp)});
+  if (NExpressionStatement *stmt = dynamic_cast<NExpressionStatement *>(node))
+    return record(*node, SAST_EXPRESSION_STATEMENT, {write(&stmt->exp)});
+  if (NVariableDeclaration *decl = dynamic_cast<NVariableDeclaration *>(node)) {
+    std::uint32_t type = write(const_cast<NIdentifier *>(&decl->type));
+    std::uint32_t lhs = write(&decl->lhs);
+    return record(*node, SAST_VARIABLE_DECLARATION,
+                  {type, lhs, write(decl->rhs)});
+  }
+  if (NArrayDeclaration *decl = dynamic_cast<NArrayDeclaration *>(node)) {
+    std::uint32_t type = write(const_cast<NIdentifier *>(&decl->type));
+    std::uint32_t lhs = write(&decl->lhs);
+    return record(*node, SAST_ARRAY_DECLARATION,
+                  {type, lhs, write(decl->size)});
+  }
+  if (NArrayAssignment *assign = dynamic_cast<NArrayAssignment *>(node)) {
+    std::uint32_t lhs = write(&assign->lhs);
+    return record(*node, SAST_ARRAY_ASSIGNMENT, {lhs, write(&assign->rhs)});
+  }
+  if (NAppend *append = dynamic_cast<NAppend *>(node)) {
+    std::uint32_t exp = write(&append->exp);
+    return record(*node, SAST_APPEND, {exp, write(&append->array)});
+  }
+  if (NUntilStatement *until = dynamic_cast<NUntilStatement *>(node)) {
+    std::uint32_t cond = write(&until->cond);
+    return record(*node, SAST_UNTIL, {cond, write(&until->block)});
+  }
+  if (NWhileStatement *whl = dynamic_cast<NWhileStatement *>(node)) {
+    std::uint32_t cond = write(&whl->cond);
+    return record(*node, SAST_WHILE, {cond, write(&whl->block)});
+  }
+  if (NElseStatement *els = dynamic_cast<NElseStatement *>(node))
+    return record(*node, SAST_ELSE, {write(&els->block)});
+  if (NIfStatement *ifs = dynamic_cast<NIfStatement *>(node)) {
+    std::uint32_t cond = write(&ifs->cond);
+    std::uint32_t block = write(&ifs->block);
+    return record(*node, SAST_IF, {cond, block, write(ifs->els)});
+  }
+  if (NFunctionDeclaration *fn = dynamic_cast<NFunctionDeclaration *>(node)) {
+    std::uint32_t type = write(const_cast<NIdentifier *>(&fn->type));
+    std::uint32_t id = write(&fn->id);
+    std::vector<std::uint32_t> words = {type, id, write(&fn->block)};
+    for (NVariableDeclaration *arg : fn->args)
+      words.push_back(write(arg));
+    return record(*node, SAST_FUNCTION_DECLARATION, words);
+  }
+  if (NImport *imp = dynamic_cast<NImport *>(node))
+    return record(*node, SAST_IMPORT, {write(&imp->name)});
+
+  throw std::runtime_error("No binary form for node");
+}
+
+/**
+ * Name: SastWriter::bytes
+ * Construct: Method
+ * Desc: Returns the header, the records, and the string table, the contents
+ *   of the file
+ * Args:
+ *   - root: The offset of the record of the root node
+ */
+std::string SastWriter::bytes(std::uint32_t root) {
+  SastHeader header = {SAST_MAGIC,
+                       SAST_VERSION,
+                       node_count,
+                       static_cast<std::uint32_t>(nodes.size() * 4),
+                       static_cast<std::uint32_t>(strings.size() * 4),
+                       root};
+  std::memcpy(nodes.data(), &header, sizeof(header));
+
+  std::string out(reinterpret_cast<const char *>(nodes.data()),
+                  nodes.size() * 4);
+  out.append(reinterpret_cast<const char *>(strings.data()),
+             strings.size() * 4);
+  return out;
+}
+
+/**
+ * Name: SastWriter::save
+ * Construct: Method
+ * Desc: Writes the header, the records, and the string table to a file
+ * Args:
+ *   - root: The offset of the record of the program's block
+ *   - filename: The path of the file
+ */
+bool SastWriter::save(std::uint32_t root, const std::string &filename) {
+  std::string contents = bytes(root);
+  std::ofstream out(filename, std::ios::binary);
+  out.write(contents.data(), contents.size());
+  return static_cast<bool>(out);
+}
+
+/**
+ * Name: write_binary_ast
+ * Construct: Function
+ * Desc: Writes the binary form of an AST to a file
+ * Args:
+ *   - root: The program's block
+ *   - filename: The path of the file
+ */
+bool write_binary_ast(NBlock &root, const std::string &filename) {
+  SastWriter writer;
+  std::uint32_t offset = writer.write(&root);
+  if (!writer.save(offset, filename)) {
+    spdlog::error("Could not write AST to {}", filename);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Name: binary_ast
+ * Construct: Function
+ * Desc: Returns the binary form of a subtree, an exact encoding of it, as
+ *   used to fingerprint the units of incremental compilation
+ * Args:
+ *   - root: The root of the subtree
+ *   - locations: Whether to include the locations of the nodes
+ */
+std::string binary_ast(Node &root, bool locations) {
+  SastWriter writer(locations);
+  std::uint32_t offset = writer.write(&root);
+  return writer.bytes(offset);
+}
+
+/**
+ * Name: SastReader
+ * Construct: Class
+ * Desc: Creates the nodes of a mapped binary AST, checking each offset and
+ *   the class of each child as it goes, so a malformed file is an error
+ *   rather than a crash
+ * Members:
+ *   - data, size: The mapped file
+ *   - header: The file's header
+ *   - nodes: The nodes created, by the offset of their records
+ */
+class SastReader {
+  const char *data;
+  std::size_t size;
+  SastHeader header;
+  std::unordered_map<std::uint32_t, Node *> nodes;
+
+  std::string string(std::uint32_t);
+  template <typename T> T *child(std::uint32_t, bool optional = false);
+  Node *create(const SastRecord &, const std::uint32_t *);
+
+public:
+  SastReader(const char *data, std::size_t size) : data(data), size(size) {}
+  NBlock *read();
+};
+
+/** The string at an offset of the string table */
+std::string SastReader::string(std::uint32_t offset) {
+  if (offset % 4 || std::uint64_t(offset) + 4 > header.strings_size)
+    throw std::runtime_error("string offset out of range");
+  const char *str = data + header.strings + offset;
+  std::uint32_t len;
+  std::memcpy(&len, str, 4);
+  if (std::uint64_t(offset) + 4 + len > header.strings_size)
+    throw std::runtime_error("string out of range");
+  return std::string(str + 4, len);
+}
+
+/** The node of an earlier record, which must be of class `T` */
+template <typename T>
+T *SastReader::child(std::uint32_t offset, bool optional) {
+  if (!offset && optional)
+    return nullptr;
+  auto it = nodes.find(offset);
+  if (it == nodes.end())
+    throw std::runtime_error("child is not an earlier record");
+  T *node = dynamic_cast<T *>(it->second);
+  if (!node)
+    throw std::runtime_error("child is of the wrong class");
+  return node;
+}
+
+/**
+ * Name: SastReader::create
+ * Construct: Method
+ * Desc: Creates the node of a record, whose children have been created
+ * Args:
+ *   - rec: The record
+ *   - w: The words of the record
+ */
+Node *SastReader::create(const SastRecord &rec, const std::uint32_t *w) {
+  std::uint32_t n = rec.count;
+  auto expect = [n](std::uint32_t min, std::uint32_t max) {
+    if (n < min || n > max)
+      throw std::runtime_error("record has the wrong number of words");
+  };
+
+  switch (rec.tag) {
+  case SAST_INTEGER: {
+    expect(2, 2);
+    std::int64_t val;
+    std::memcpy(&val, w, sizeof(val));
+    return new NInteger(val);
+  }
+  case SAST_FLOAT: {
+    expect(2, 2);
+    double val;
+    std::memcpy(&val, w, sizeof(val));
+    return new NFloat(val);
+  }
+  case SAST_STRING: {
+    expect(1, 1);
+    NString *str = new NString();
+    str->val = string(w[0]);
+    return str;
+  }
+  case SAST_IDENTIFIER:
+    expect(1, 1);
+    return new NIdentifier(string(w[0]));
+  case SAST_FUNCTION_CALL: {
+    expect(1, UINT32_MAX);
+    NExpressionList args;
+    for (std::uint32_t i = 1; i < n; i++)
+      args.push_back(child<NExpression>(w[i]));
+    return new NFunctionCall(*child<NIdentifier>(w[0]), args);
+  }
+  case SAST_UNARY:
+    expect(2, 2);
+    return new NUnaryExpression(w[0], *child<NExpression>(w[1]));
+  case SAST_BINARY:
+    expect(3, 3);
+    return new NBinaryExpression(*child<NExpression>(w[1]), w[0],
+                                 *child<NExpression>(w[2]));
+  case SAST_ARRAY_INDEX:
+    expect(2, 2);
+    return new NArrayIndex(*child<NIdentifier>(w[0]),
+                           *child<NExpression>(w[1]));
+  case SAST_LENGTH:
+    expect(1, 1);
+    return new NLength(*child<NExpression>(w[0]));
+  case SAST_BLOCK: {
+    NBlock *block = new NBlock();
+    for (std::uint32_t i = 0; i < n; i++)
+      block->stmts.push_back(child<NStatement>(w[i]));
+    return block;
+  }
+  case SAST_ASSIGNMENT:
+    expect(2, 2);
+    return new NAssignment(*child<NIdentifier>(w[0]),
+                           *child<NExpression>(w[1]));
+  case SAST_READ:
+    expect(2, 2);
+    return new NRead(*child<NExpression>(w[0]), *child<NExpression>(w[1]));
+  case SAST_WRITE:
+    expect(2, 2);
+    return new NWrite(*child<NExpression>(w[0]), *child<NExpression>(w[1]));
+  case SAST_RETURN:
+    expect(1, 1);
+    return new NReturnStatement(*child<NExpression>(w[0]));
+  case SAST_EXPRESSION_STATEMENT:
+    expect(1, 1);
+    return new NExpressionStatement(*child<NExpression>(w[0]));
+  case SAST_VARIABLE_DECLARATION:
+    expect(3, 3);
+    return new NVariableDeclaration(*child<NIdentifier>(w[0]),
+                                    *child<NIdentifier>(w[1]),
+                                    child<NExpression>(w[2], true));
+  case SAST_ARRAY_DECLARATION:
+    expect(3, 3);
+    return new NArrayDeclaration(*child<NIdentifier>(w[0]),
+                                 *child<NIdentifier>(w[1]),
+                                 child<NExpression>(w[2], true));
+  case SAST_ARRAY_ASSIGNMENT:
+    expect(2, 2);
+    return new NArrayAssignment(*child<NArrayIndex>(w[0]),
+                                *child<NExpression>(w[1]));
+  case SAST_APPEND:
+    expect(2, 2);
+    return new NAppend(*child<NExpression>(w[0]), *child<NIdentifier>(w[1]));
+  case SAST_UNTIL:
+    expect(2, 2);
+    return new NUntilStatement(*child<NExpression>(w[0]),
+                               *child<NBlock>(w[1]));
+  case SAST_WHILE:
+    expect(2, 2);
+    return new NWhileStatement(*child<NExpression>(w[0]),
+                               *child<NBlock>(w[1]));
+  case SAST_ELSE:
+    expect(1, 1);
+    return new NElseStatement(*child<NBlock>(w[0]));
+  case SAST_IF:
+    expect(3, 3);
+    return new NIfStatement(*child<NExpression>(w[0]), *child<NBlock>(w[1]),
+                            child<NStatement>(w[2], true));
+  case SAST_FUNCTION_DECLARATION: {
+    expect(3, UINT32_MAX);
+    NVariableList args;
+    for (std::uint32_t i = 3; i < n; i++)
+      args.push_back(child<NVariableDeclaration>(w[i]));
+    return new NFunctionDeclaration(*child<NIdentifier>(w[0]),
+                                    *child<NIdentifier>(w[1]), args,
+                                    *child<NBlock>(w[2]));
+  }
+  case SAST_IMPORT:
+    expect(1, 1);
+    return new NImport(*child<NIdentifier>(w[0]));
+  }
+  throw std::runtime_error("unknown record tag");
+}
+
+/**
+ * Name: SastReader::read
+ * Construct: Method
+ * Desc: Checks the header and creates the nodes of every record in order,
+ *   returning the program's block
+ */
+NBlock *SastReader::read() {
+  if (size < sizeof(header))
+    throw std::runtime_error("file is too short");
+  std::memcpy(&header, data, sizeof(header));
+  if (header.magic != SAST_MAGIC)
+    throw std::runtime_error("not a binary AST");
+  if (header.version != SAST_VERSION)
+    throw std::runtime_error("written by another version of the compiler");
+  if (header.strings % 4 || header.strings < sizeof(header) ||
+      std::uint64_t(header.strings) + header.strings_size > size)
+    throw std::runtime_error("string table out of range");
+
+  nodes.reserve(header.node_count);
+  std::uint32_t offset = sizeof(header);
+  while (offset < header.strings) {
+    SastRecord rec;
+    if (offset + sizeof(rec) > header.strings)
+      throw std::runtime_error("record out of range");
+    std::memcpy(&rec, data + offset, sizeof(rec));
+    std::uint32_t words = offset + sizeof(rec);
+    if ((header.strings - words) / 4 < rec.count)
+      throw std::runtime_error("record out of range");
+    Node *node =
+        create(rec, reinterpret_cast<const std::uint32_t *>(data + words));
+    node->line = rec.line;
+    node->column = rec.column;
+    nodes.insert({offset, node});
+    offset = words + rec.count * 4;
+  }
+
+  return child<NBlock>(header.root);
+}
+
+/**
+ * Name: read_binary_ast
+ * Construct: Function
+ * Desc: Maps a binary AST file written by `write_binary_ast` into memory
+ *   and creates its nodes, returning the program's block or null (having
+ *   reported why) if the file can't be read
+ * Args:
+ *   - filename: The path of the file
+ */
+NBlock *read_binary_ast(const std::string &filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) == -1) {
+    spdlog::error("Could not open AST {}", filename);
+    if (fd != -1)
+      close(fd);
+    return nullptr;
+  }
+
+  std::size_t size = st.st_size;
+  void *data = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)
+                    : MAP_FAILED;
+  close(fd);
+  if (data == MAP_FAILED) {
+    spdlog::error("Could not map AST {}", filename);
+    return nullptr;
+  }
+
+  NBlock *root = nullptr;
+  try {
+    root = SastReader(static_cast<const char *>(data), size).read();
+  } catch (const std::runtime_error &e) {
+    spdlog::error("Malformed AST {}: {}", filename, e.what());
+  }
+  munmap(data, size);
+  return root;
+}
@@ -0,0 +1,915 @@
+#include "ast.hpp"
+#include "bytecode.hpp"
+#include "codegen.hpp"
+
+/**
+ * Name: src/ast-bytecode.cpp
+ * Construct: Module
+ * Desc: The AST -> bytecode phase of the bytecode back end (`--bytecode`),
+ *   the counterpart of src/ast-codegen.cpp, whose semantics it follows so a
+ *   program runs alike on either back end
+ * Notes:
+ *   - The types of every value are known here, so the instructions are typed
+ *     (e.g. `ADD` and `FADD`) and the VM never checks them
+ *   - Float arithmetic and the unary operators (`not`, `negative`) are
+ *     supported, although the LLVM back end doesn't yet generate them
+ *   - Imports are only supported by the LLVM back end, an imported module's
+ *     functions being object code
+ */
+
+/** The value of a statement, which has none */
+static BytecodeValue no_value() { return BytecodeValue{0, BT_VOID, false}; }
+
+/**
+ * Name: bytecode_type_of
+ * Construct: Function
+ * Desc: Returns the bytecode type of a type's identifier, as `type_of` does
+ *   for the LLVM back end, arrays (`<type> array`) being passed to functions
+ *   by reference
+ * Args:
+ *   - type: The identifier of the type
+ */
+static BYTECODE_TYPES bytecode_type_of(const NIdentifier &type) {
+  if (type.val == "integer")
+    return BT_INTEGER;
+  if (type.val == "float")
+    return BT_FLOAT;
+  if (type.val == "string")
+    return BT_STRING;
+  if (type.val == "void")
+    return BT_VOID;
+  if (type.val == "integer array")
+    return BT_INTEGER_ARRAY;
+  if (type.val == "float array")
+    return BT_FLOAT_ARRAY;
+  if (type.val.size() > 6 &&
+      type.val.compare(type.val.size() - 6, 6, " array") == 0)
+    throw CodeGenException("Arrays may only hold integers or floats");
+  throw CodeGenException("Unknown variable type");
+}
+
+/** Whether a type is one of the array types */
+static bool is_array(BYTECODE_TYPES type) {
+  return type == BT_INTEGER_ARRAY || type == BT_FLOAT_ARRAY;
+}
+
+/**
+ * Name: convert
+ * Construct: Function
+ * Desc: Converts a value to the type of what it's assigned to, as
+ *   `cast_relevantly`: integers to floats unsigned, floats to integers
+ *   signed, and booleans (held as `0` or `1`) used as integers
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ *   - value: The value to convert
+ *   - type: The type to convert it to
+ *   - name: What it's assigned to, for the error
+ */
+static BytecodeValue convert(BytecodeContext &ctx, BytecodeValue value,
+                             BYTECODE_TYPES type, const std::string &name) {
+  if (value.type == type)
+    return value;
+  if (value.type == BT_BOOLEAN && type == BT_INTEGER) {
+    value.type = BT_INTEGER;
+    return value;
+  }
+  if ((value.type == BT_INTEGER || value.type == BT_BOOLEAN) &&
+      type == BT_FLOAT) {
+    BytecodeValue _float = ctx.temporary(BT_FLOAT);
+    ctx.emit(BC_INT_TO_FLOAT, _float.reg, value.reg);
+    return _float;
+  }
+  if (value.type == BT_FLOAT && type == BT_INTEGER) {
+    BytecodeValue _int = ctx.temporary(BT_INTEGER);
+    ctx.emit(BC_FLOAT_TO_INT, _int.reg, value.reg);
+    return _int;
+  }
+  throw CodeGenException("Mismatched type assigned to " + name);
+}
+
+/** Writes a value to a register, retargeting its instruction if it can */
+static void move(BytecodeContext &ctx, BytecodeValue value, std::uint32_t reg) {
+  if (value.reg != reg && !ctx.retarget(value, reg))
+    ctx.emit(BC_MOVE, reg, value.reg);
+}
+
+/** Looks up a variable, throwing a CodeGenException if it does not exist */
+static BytecodeValue get_local(BytecodeContext &ctx, const std::string &name) {
+  auto it = ctx.locals.find(name);
+  if (it == ctx.locals.end())
+    throw CodeGenException("Identifier " + name +
+                           " not found in current context");
+  return it->second;
+}
+
+/* -------- Types  -------- */
+
+/**
+ * Name: NInteger::bytecode_generate
+ * Construct: Method
+ * Desc: Loads the integer from the module's constants
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NInteger::bytecode_generate(BytecodeContext &ctx) {
+  BytecodeValue _int = ctx.temporary(BT_INTEGER);
+  ctx.emit(BC_CONST, _int.reg, 0, ctx.integer(val));
+  return _int;
+}
+
+/**
+ * Name: NFloat::bytecode_generate
+ * Construct: Method
+ * Desc: Loads the float from the module's constants
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NFloat::bytecode_generate(BytecodeContext &ctx) {
+  BytecodeValue _float = ctx.temporary(BT_FLOAT);
+  ctx.emit(BC_CONST, _float.reg, 0, ctx.floating(val));
+  return _float;
+}
+
+/**
+ * Name: NString::bytecode_generate
+ * Construct: Method
+ * Desc: Loads a pointer to the string literal, a constant string (see
+ *   `SoodString`) made by the VM from the module's strings
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NString::bytecode_generate(BytecodeContext &ctx) {
+  if (!escaped) {
+    process_escape_chars(val);
+    escaped = true;
+  }
+  BytecodeValue _str = ctx.temporary(BT_STRING);
+  ctx.emit(BC_STRING, _str.reg, 0, ctx.string(val));
+  return _str;
+}
+
+/**
+ * Name: NIdentifier::bytecode_generate
+ * Construct: Method
+ * Desc: A variable is its register, so using one generates no code, strings
+ *   and arrays are used by reference as the register holds their address
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NIdentifier::bytecode_generate(BytecodeContext &ctx) {
+  return get_local(ctx, val);
+}
+
+/* ----- Operative expressions ------ */
+
+/**
+ * Name: NUnaryExpression::bytecode_generate
+ * Construct: Method
+ * Desc: Negates a number (`negative`), or the truth of a condition (`not`),
+ *   which is tested as by `to_condition`
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NUnaryExpression::bytecode_generate(BytecodeContext &ctx) {
+  BytecodeValue _rhs = rhs.bytecode_generate(ctx);
+
+  if (op == OP_NEGATIVE && _rhs.type == BT_INTEGER) {
+    BytecodeValue _neg = ctx.temporary(BT_INTEGER);
+    ctx.emit(BC_NEG, _neg.reg, _rhs.reg);
+    return _neg;
+  }
+  if (op == OP_NEGATIVE && _rhs.type == BT_FLOAT) {
+    BytecodeValue _neg = ctx.temporary(BT_FLOAT);
+    ctx.emit(BC_FNEG, _neg.reg, _rhs.reg);
+    return _neg;
+  }
+  if (op == OP_NOT && (_rhs.type == BT_INTEGER || _rhs.type == BT_BOOLEAN)) {
+    BytecodeValue _not = ctx.temporary(BT_BOOLEAN);
+    ctx.emit(BC_NOT, _not.reg, _rhs.reg);
+    return _not;
+  }
+  if (op == OP_NOT && _rhs.type == BT_FLOAT) {
+    BytecodeValue _zero = ctx.temporary(BT_FLOAT);
+    ctx.emit(BC_CONST, _zero.reg, 0, ctx.floating(0.0));
+    BytecodeValue _not = ctx.temporary(BT_BOOLEAN);
+    ctx.emit(BC_FEQ, _not.reg, _rhs.reg, _zero.reg);
+    return _not;
+  }
+  throw CodeGenException("Invalid unary operator");
+}
+
+/**
+ * Name: string_binary_operation
+ * Construct: Function
+ * Desc: Concatenates or compares two strings, as the function of the same
+ *   name of the LLVM back end: a concatenation is made in storage of its
+ *   own, to which the following strings of a chain are appended
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ *   - exp: The binary expression
+ *   - _lhs: The string of the LHS
+ *   - _rhs: The string of the RHS
+ */
+static BytecodeValue string_binary_operation(BytecodeContext &ctx,
+                                             NBinaryExpression &exp,
+                                             BytecodeValue _lhs,
+                                             BytecodeValue _rhs) {
+  if (_lhs.type != BT_STRING || _rhs.type != BT_STRING)
+    throw CodeGenException("Strings may only be operated on with strings");
+
+  switch (exp.op) {
+  case OP_PLUS: {
+    NBinaryExpression *_chain = dynamic_cast<NBinaryExpression *>(&exp.lhs);
+    if (_chain && _chain->op == OP_PLUS) {
+      ctx.emit(BC_STRING_APPEND, _lhs.reg, _rhs.reg);
+      return _lhs;
+    }
+    BytecodeValue _str = ctx.storage(BT_STRING);
+    ctx.emit(BC_STRING_CONCAT, _str.reg, _lhs.reg, _rhs.reg);
+    return _str;
+  }
+  case OP_EQUAL_TO:
+  case OP_NOT_EQUAL_TO: {
+    BytecodeValue _cmp = ctx.temporary(BT_BOOLEAN);
+    ctx.emit(exp.op == OP_EQUAL_TO ? BC_STRING_EQ : BC_STRING_NE, _cmp.reg,
+             _lhs.reg, _rhs.reg);
+    return _cmp;
+  }
+  default:
+    throw CodeGenException("Strings may only be concatenated or compared "
+                           "for equality");
+  }
+}
+
+/** Whether an operator is a comparison, `OP_EQUAL_TO` to `OP_MORE_THAN...` */
+static bool is_comparison(int op) {
+  return op >= OP_EQUAL_TO && op <= OP_MORE_THAN_EQUAL_TO;
+}
+
+/**
+ * Name: binary_operation
+ * Construct: Function
+ * Desc: Operates on the values of the LHS and RHS of a binary expression,
+ *   an integer operated on with a float is converted to a float first
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ *   - exp: The binary expression
+ *   - _lhs: The value of the LHS
+ *   - _rhs: The value of the RHS
+ */
+static BytecodeValue binary_operation(BytecodeContext &ctx,
+                                      NBinaryExpression &exp,
+                                      BytecodeValue _lhs, BytecodeValue _rhs) {
+  if (_lhs.type == BT_STRING || _rhs.type == BT_STRING)
+    return string_binary_operation(ctx, exp, _lhs, _rhs);
+
+  for (BYTECODE_TYPES type : {_lhs.type, _rhs.type})
+    if (type != BT_INTEGER && type != BT_FLOAT && type != BT_BOOLEAN)
+      throw CodeGenException("Only numbers and strings may be operated on");
+
+  BYTECODE_TYPES _type =
+      _lhs.type == BT_FLOAT || _rhs.type == BT_FLOAT ? BT_FLOAT : BT_INTEGER;
+  _lhs = convert(ctx, _lhs, _type, "binary operation");
+  _rhs = convert(ctx, _rhs, _type, "binary operation");
+
+  /** The integer and float instructions are each in the operators' order */
+  int _op;
+  BYTECODE_TYPES _result = _type;
+  if (is_comparison(exp.op)) {
+    _op = (_type == BT_FLOAT ? BC_FEQ : BC_EQ) + (exp.op - OP_EQUAL_TO);
+    _result = BT_BOOLEAN;
+  } else if (exp.op >= OP_PLUS && exp.op <= OP_MODULO) {
+    _op = (_type == BT_FLOAT ? BC_FADD : BC_ADD) + (exp.op - OP_PLUS);
+  } else {
+    throw CodeGenException("Invalid binary operator");
+  }
+
+  BytecodeValue _val = ctx.temporary(_result);
+  ctx.emit(BYTECODE_OPS(_op), _val.reg, _lhs.reg, _rhs.reg);
+  return _val;
+}
+
+/**
+ * Name: condition_jump
+ * Construct: Function
+ * Desc: Generates a condition as jumps, taken when its truth is `jump_if`,
+ *   and otherwise falling through. `and`/`alternatively` (which
+ *   short-circuit) and `not` are jumps themselves, and a comparison of
+ *   integers is a single jump (e.g. `JUMP_LT`) rather than a comparison and
+ *   a jump. Any other value is tested as by `to_condition`
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ *   - cond: The condition
+ *   - jump_if: Whether to jump when the condition is true, or false
+ *   - jumps: The jumps, to which the caller sets the target (see
+ *     `BytecodeContext::patch`)
+ */
+static void condition_jump(BytecodeContext &ctx, NExpression &cond,
+                           bool jump_if, std::vector<std::uint32_t> &jumps) {
+  NBinaryExpression *_bin = dynamic_cast<NBinaryExpression *>(&cond);
+  if (_bin && (_bin->op == OP_AND || _bin->op == OP_ALTERNATIVELY)) {
+    /** When the LHS decides the result it jumps, or skips the RHS */
+    bool _decided = _bin->op == OP_ALTERNATIVELY;
+    if (_decided == jump_if) {
+      condition_jump(ctx, _bin->lhs, jump_if, jumps);
+      condition_jump(ctx, _bin->rhs, jump_if, jumps);
+      return;
+    }
+    std::vector<std::uint32_t> _skip;
+    condition_jump(ctx, _bin->lhs, !jump_if, _skip);
+    condition_jump(ctx, _bin->rhs, jump_if, jumps);
+    std::uint32_t _after = ctx.label();
+    for (std::uint32_t jump : _skip)
+      ctx.patch(jump, _after);
+    return;
+  }
+
+  NUnaryExpression *_un = dynamic_cast<NUnaryExpression *>(&cond);
+  if (_un && _un->op == OP_NOT) {
+    condition_jump(ctx, _un->rhs, !jump_if, jumps);
+    return;
+  }
+
+  BytecodeValue _val;
+  if (_bin && is_comparison(_bin->op)) {
+    BytecodeValue _lhs = _bin->lhs.bytecode_generate(ctx);
+    BytecodeValue _rhs = _bin->rhs.bytecode_generate(ctx);
+    if ((_lhs.type == BT_INTEGER || _lhs.type == BT_BOOLEAN) &&
+        (_rhs.type == BT_INTEGER || _rhs.type == BT_BOOLEAN)) {
+      /** Negating a comparison, EQ <-> NE, LT <-> GE, and LE <-> GT */
+      static const int NEGATED[] = {1, 0, 5, 4, 3, 2};
+      int _cmp = _bin->op - OP_EQUAL_TO;
+      if (!jump_if)
+        _cmp = NEGATED[_cmp];
+      jumps.push_back(
+          ctx.emit(BYTECODE_OPS(BC_JUMP_EQ + _cmp), _lhs.reg, _rhs.reg));
+      return;
+    }
+    _val = binary_operation(ctx, *_bin, _lhs, _rhs);
+  } else {
+    _val = cond.bytecode_generate(ctx);
+  }
+
+  if (_val.type == BT_FLOAT) {
+    BytecodeValue _zero = ctx.temporary(BT_FLOAT);
+    ctx.emit(BC_CONST, _zero.reg, 0, ctx.floating(0.0));
+    BytecodeValue _cmp = ctx.temporary(BT_BOOLEAN);
+    ctx.emit(BC_FNE, _cmp.reg, _val.reg, _zero.reg);
+    _val = _cmp;
+  }
+  if (_val.type != BT_INTEGER && _val.type != BT_BOOLEAN)
+    throw CodeGenException("Invalid condition type");
+  jumps.push_back(ctx.emit(jump_if ? BC_JUMP_IF : BC_JUMP_IF_NOT, _val.reg));
+}
+
+/**
+ * Name: NBinaryExpression::bytecode_generate
+ * Construct: Method
+ * Desc: Operates on the LHS and RHS (see `binary_operation`), `and` and
+ *   `alternatively` short-circuit, their jumps (see `condition_jump`)
+ *   setting the result
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NBinaryExpression::bytecode_generate(BytecodeContext &ctx) {
+  if (op == OP_AND || op == OP_ALTERNATIVELY) {
+    BytecodeValue _val = ctx.temporary(BT_BOOLEAN);
+    std::vector<std::uint32_t> _false;
+    condition_jump(ctx, *this, false, _false);
+    ctx.emit(BC_CONST, _val.reg, 0, ctx.integer(1));
+    std::uint32_t _jump = ctx.emit(BC_JUMP);
+    std::uint32_t _false_label = ctx.label();
+    for (std::uint32_t jump : _false)
+      ctx.patch(jump, _false_label);
+    ctx.emit(BC_CONST, _val.reg, 0, ctx.integer(0));
+    ctx.patch(_jump, ctx.label());
+    return _val;
+  }
+
+  BytecodeValue _lhs = lhs.bytecode_generate(ctx);
+  BytecodeValue _rhs = rhs.bytecode_generate(ctx);
+  return binary_operation(ctx, *this, _lhs, _rhs);
+}
+
+/* ------ Chunks ------*/
+
+/**
+ * Name: NBlock::bytecode_generate
+ * Construct: Method
+ * Desc: Generates the statements of the block, the temporaries of each being
+ *   free for the next
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NBlock::bytecode_generate(BytecodeContext &ctx) {
+  for (NStatement *stmt : stmts) {
+    std::uint32_t _mark = ctx.top;
+    stmt->bytecode_generate(ctx);
+    ctx.release(_mark);
+  }
+  return no_value();
+}
+
+/**
+ * Name: assign_string
+ * Construct: Function
+ * Desc: Assigns the value of an expression to a string, appending in place
+ *   where the expression appends to the string itself (`s is s plus t`), as
+ *   the function of the same name of the LLVM back end
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ *   - _str: The string to assign to
+ *   - name: The name of the string
+ *   - exp: The expression whose value to assign
+ */
+static void assign_string(BytecodeContext &ctx, BytecodeValue _str,
+                          const std::string &name, NExpression &exp) {
+  std::vector<NExpression *> _appended;
+  NExpression *_first = &exp;
+  NBinaryExpression *_bin;
+  while ((_bin = dynamic_cast<NBinaryExpression *>(_first)) &&
+         _bin->op == OP_PLUS) {
+    _appended.insert(_appended.begin(), &_bin->rhs);
+    _first = &_bin->lhs;
+  }
+
+  NIdentifier *_ident = dynamic_cast<NIdentifier *>(_first);
+  bool _in_place = _ident && _ident->val == name && !_appended.empty();
+  for (std::size_t i = 1; _in_place && i < _appended.size(); i++)
+    _in_place = !mentions(_appended[i], name);
+
+  if (_in_place) {
+    for (NExpression *_exp : _appended) {
+      BytecodeValue _rhs = _exp->bytecode_generate(ctx);
+      if (_rhs.type != BT_STRING)
+        throw CodeGenException("Strings may only be operated on with strings");
+      ctx.emit(BC_STRING_APPEND, _str.reg, _rhs.reg);
+    }
+    return;
+  }
+
+  BytecodeValue _rhs = exp.bytecode_generate(ctx);
+  if (_rhs.type != BT_STRING)
+    throw CodeGenException("Only a string may be assigned to string " + name);
+  ctx.emit(BC_STRING_ASSIGN, _str.reg, _rhs.reg);
+}
+
+/**
+ * Name: NAssignment::bytecode_generate
+ * Construct: Method
+ * Desc: Writes the value of the RHS, converted to the variable's type, to
+ *   the variable's register, strings are assigned by `assign_string`
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NAssignment::bytecode_generate(BytecodeContext &ctx) {
+  auto it = ctx.locals.find(lhs.val);
+  if (it == ctx.locals.end())
+    throw CodeGenException("Variable " + lhs.val +
+                           " not defined in current block");
+  BytecodeValue _lhs = it->second;
+  if (is_array(_lhs.type))
+    throw CodeGenException("Array " + lhs.val +
+                           " cannot be assigned, assign its elements instead");
+  if (_lhs.type == BT_STRING) {
+    assign_string(ctx, _lhs, lhs.val, rhs);
+    return no_value();
+  }
+  move(ctx, convert(ctx, rhs.bytecode_generate(ctx), _lhs.type, lhs.val),
+       _lhs.reg);
+  return no_value();
+}
+
+/**
+ * Name: NWrite::bytecode_generate
+ * Construct: Method
+ * Desc: Writes an integer or string to stdout, as `printf` does for the LLVM
+ *   back end
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ * Notes:
+ *   - Floats aren't written, the LLVM back end passes them to `%d`
+ */
+BytecodeValue NWrite::bytecode_generate(BytecodeContext &ctx) {
+  BytecodeValue _exp = exp.bytecode_generate(ctx);
+  if (_exp.type == BT_INTEGER)
+    ctx.emit(BC_WRITE_INTEGER, _exp.reg);
+  else if (_exp.type == BT_STRING)
+    ctx.emit(BC_WRITE_STRING, _exp.reg);
+  else
+    throw CodeGenException("Write not yet implemented");
+  return no_value();
+}
+
+/**
+ * Name: NRead::bytecode_generate
+ * Construct: Method
+ * Desc: See notes
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ * Notes:
+ *   - Not yet implemented
+ */
+BytecodeValue NRead::bytecode_generate(BytecodeContext &) {
+  throw CodeGenException("Read not yet implemented");
+}
+
+/**
+ * Name: NReturnStatement::bytecode_generate
+ * Construct: Method
+ * Desc: Returns the value, converted to the function's type, a string being
+ *   assigned to the caller's string
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NReturnStatement::bytecode_generate(BytecodeContext &ctx) {
+  BYTECODE_TYPES _ret = ctx.function().ret;
+  if (_ret == BT_VOID)
+    throw CodeGenException("Only a function with a type may return a value");
+
+  BytecodeValue _exp = exp.bytecode_generate(ctx);
+  if (_ret == BT_STRING) {
+    if (_exp.type != BT_STRING)
+      throw CodeGenException("Only a string may be returned by function " +
+                             ctx.function().name);
+    ctx.emit(BC_RETURN_STRING, _exp.reg);
+    return no_value();
+  }
+  _exp = convert(ctx, _exp, _ret, "return");
+  if (!ctx.tail_call(_exp))
+    ctx.emit(BC_RETURN, _exp.reg);
+  return no_value();
+}
+
+/**
+ * Name: NExpressionStatement::bytecode_generate
+ * Construct: Method
+ * Desc: Generates the expression, whose value is unused
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NExpressionStatement::bytecode_generate(BytecodeContext &ctx) {
+  exp.bytecode_generate(ctx);
+  return no_value();
+}
+
+/**
+ * Name: NVariableDeclaration::bytecode_generate
+ * Construct: Method
+ * Desc: Declares the variable in a register of its own (see
+ *   `BytecodeContext::declare`), initialized to the RHS or, if it's null,
+ *   zero or the empty string
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NVariableDeclaration::bytecode_generate(BytecodeContext &ctx) {
+  BYTECODE_TYPES _type = bytecode_type_of(type);
+  if (_type == BT_VOID || is_array(_type))
+    throw CodeGenException("Unknown variable type");
+  BytecodeValue _lhs = ctx.declare(lhs.val, _type);
+
+  if (_type == BT_STRING) {
+    /** Redeclared in a loop, the string must be emptied each iteration */
+    if (rhs) {
+      assign_string(ctx, _lhs, lhs.val, *rhs);
+    } else {
+      BytecodeValue _empty = ctx.temporary(BT_STRING);
+      ctx.emit(BC_STRING, _empty.reg, 0, ctx.string(""));
+      ctx.emit(BC_STRING_ASSIGN, _lhs.reg, _empty.reg);
+    }
+    return no_value();
+  }
+  if (rhs)
+    move(ctx, convert(ctx, rhs->bytecode_generate(ctx), _type, lhs.val),
+         _lhs.reg);
+  else
+    ctx.emit(BC_CONST, _lhs.reg, 0, ctx.integer(0));
+  return no_value();
+}
+
+/**
+ * Name: NFunctionDeclaration::bytecode_generate
+ * Construct: Method
+ * Desc: Generates the function's bytecode in a function of the module of its
+ *   own, declared before its block so it may call itself. The parameters
+ *   are the first registers, a string parameter being copied only if the
+ *   function assigns to it
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NFunctionDeclaration::bytecode_generate(BytecodeContext &ctx) {
+  BytecodeFunction _fn;
+  _fn.name = id.val;
+  _fn.ret = bytecode_type_of(type);
+  if (is_array(_fn.ret))
+    throw CodeGenException("Function " + id.val + " cannot return an array");
+  for (NVariableDeclaration *arg : args)
+    _fn.params.push_back(bytecode_type_of(arg->type));
+  if (ctx.module.functions.size() > BC_MAX_OPERAND)
+    throw CodeGenException("Too many functions for the bytecode");
+  ctx.module.functions.push_back(_fn);
+  std::uint32_t _id = ctx.module.functions.size() - 1;
+  ctx.function_ids[id.val] = _id;
+
+  /** The caller's state is restored after */
+  std::uint32_t _current = _id, _top = 0, _locals_top = 0;
+  std::map<std::string, BytecodeValue> _locals;
+  std::swap(_current, ctx.current);
+  std::swap(_locals, ctx.locals);
+  std::swap(_top, ctx.top);
+  std::swap(_locals_top, ctx.locals_top);
+
+  std::vector<BytecodeValue> _params;
+  for (NVariableDeclaration *arg : args) {
+    BytecodeValue _param = ctx.temporary(bytecode_type_of(arg->type));
+    _param.temporary = false;
+    _params.push_back(_param);
+  }
+  ctx.locals_top = ctx.top;
+  for (std::size_t i = 0; i < args.size(); i++) {
+    const std::string &_name = args[i]->lhs.val;
+    if (_params[i].type == BT_STRING && assigns_to(&block, _name)) {
+      BytecodeValue _str = ctx.storage(BT_STRING);
+      ctx.emit(BC_STRING_ASSIGN, _str.reg, _params[i].reg);
+      _params[i] = _str;
+    }
+    ctx.locals[_name] = _params[i];
+  }
+
+  block.bytecode_generate(ctx);
+
+  /** Void functions return here, typed ones have run off the end */
+  ctx.emit(_fn.ret == BT_VOID ? BC_RETURN_VOID : BC_UNREACHABLE);
+
+  std::swap(_current, ctx.current);
+  std::swap(_locals, ctx.locals);
+  std::swap(_top, ctx.top);
+  std::swap(_locals_top, ctx.locals_top);
+  return no_value();
+}
+
+/**
+ * Name: NFunctionCall::bytecode_generate
+ * Construct: Method
+ * Desc: Calls a function declared in the source, the arguments, converted to
+ *   the parameters' types, are written to consecutive registers which the
+ *   callee's parameters are copied from. A returned string is assigned to
+ *   storage of the caller's
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NFunctionCall::bytecode_generate(BytecodeContext &ctx) {
+  auto it = ctx.function_ids.find(id.val);
+  if (it == ctx.function_ids.end())
+    throw CodeGenException("Attempted call on unknown function");
+  std::uint32_t _id = it->second;
+  std::vector<BYTECODE_TYPES> _params = ctx.module.functions[_id].params;
+  BYTECODE_TYPES _ret = ctx.module.functions[_id].ret;
+  if (args.size() != _params.size())
+    throw CodeGenException("Function " + id.val + " takes " +
+                           std::to_string(_params.size()) + " arguments");
+
+  BytecodeValue _result = _ret == BT_STRING ? ctx.storage(BT_STRING)
+                          : _ret == BT_VOID ? no_value()
+                                            : ctx.temporary(_ret);
+
+  std::vector<BytecodeValue> _slots;
+  for (BYTECODE_TYPES param : _params)
+    _slots.push_back(ctx.temporary(param));
+  for (std::size_t i = 0; i < args.size(); i++)
+    move(ctx,
+         convert(ctx, args[i]->bytecode_generate(ctx), _params[i],
+                 "argument " + std::to_string(i + 1) + " of " + id.val),
+         _slots[i].reg);
+
+  ctx.emit(BC_CALL, _result.reg, _slots.empty() ? 0 : _slots[0].reg, _id);
+  return _result;
+}
+
+/**
+ * Name: NImport::bytecode_generate
+ * Construct: Method
+ * Desc: See notes
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ * Notes:
+ *   - An imported module is object code, so imports are only supported by
+ *     the LLVM back end
+ */
+BytecodeValue NImport::bytecode_generate(BytecodeContext &) {
+  throw CodeGenException("Imports are not supported by the bytecode back end");
+}
+
+/* ------ arrays ------ */
+
+/**
+ * Name: get_array
+ * Construct: Function
+ * Desc: Looks up the array of the given name, throwing a CodeGenException if
+ *   it does not exist or is not an array
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ *   - array: The identifier of the array
+ */
+static BytecodeValue get_array(BytecodeContext &ctx, const NIdentifier &array) {
+  BytecodeValue _arr = get_local(ctx, array.val);
+  if (!is_array(_arr.type))
+    throw CodeGenException("Identifier " + array.val + " is not an array");
+  return _arr;
+}
+
+/** The type of the elements of an array */
+static BYTECODE_TYPES element_type_of(BytecodeValue _arr) {
+  return _arr.type == BT_INTEGER_ARRAY ? BT_INTEGER : BT_FLOAT;
+}
+
+/** Converts the value of an index (or size) expression to an integer */
+static BytecodeValue to_index(BytecodeContext &ctx, BytecodeValue _val) {
+  if (_val.type != BT_INTEGER && _val.type != BT_FLOAT)
+    throw CodeGenException("Array indices and sizes must be numeric");
+  return convert(ctx, _val, BT_INTEGER, "index");
+}
+
+/**
+ * Name: NArrayIndex::bytecode_generate
+ * Construct: Method
+ * Desc: Loads the element of the array at the index, which the VM checks is
+ *   in bounds
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NArrayIndex::bytecode_generate(BytecodeContext &ctx) {
+  BytecodeValue _arr = get_array(ctx, array);
+  BytecodeValue _idx = to_index(ctx, index.bytecode_generate(ctx));
+  BytecodeValue _elem = ctx.temporary(element_type_of(_arr));
+  ctx.emit(BC_ARRAY_GET, _elem.reg, _arr.reg, _idx.reg);
+  return _elem;
+}
+
+/**
+ * Name: NLength::bytecode_generate
+ * Construct: Method
+ * Desc: Loads the current length of an array or string
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NLength::bytecode_generate(BytecodeContext &ctx) {
+  BytecodeValue _exp = exp.bytecode_generate(ctx);
+  if (!is_array(_exp.type) && _exp.type != BT_STRING)
+    throw CodeGenException("Length is only available for arrays and strings");
+  BytecodeValue _len = ctx.temporary(BT_INTEGER);
+  ctx.emit(_exp.type == BT_STRING ? BC_STRING_LENGTH : BC_ARRAY_LENGTH,
+           _len.reg, _exp.reg);
+  return _len;
+}
+
+/**
+ * Name: NArrayDeclaration::bytecode_generate
+ * Construct: Method
+ * Desc: Declares an array, whose storage is the function's (see
+ *   `BytecodeContext::storage`) and whose elements are allocated by the
+ *   runtime from the function's arena, zero-initialized. A growable array is
+ *   emptied, so when redeclared in a loop the elements already allocated
+ *   are reused
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NArrayDeclaration::bytecode_generate(BytecodeContext &ctx) {
+  BYTECODE_TYPES _elem_type = bytecode_type_of(type);
+  if (_elem_type != BT_INTEGER && _elem_type != BT_FLOAT)
+    throw CodeGenException("Arrays may only hold integers or floats");
+  BytecodeValue _size;
+  if (size)
+    _size = to_index(ctx, size->bytecode_generate(ctx));
+  BytecodeValue _arr = ctx.declare(
+      lhs.val, _elem_type == BT_INTEGER ? BT_INTEGER_ARRAY : BT_FLOAT_ARRAY);
+  if (size)
+    ctx.emit(BC_ARRAY_NEW, _arr.reg, _size.reg);
+  else
+    ctx.emit(BC_ARRAY_CLEAR, _arr.reg);
+  return no_value();
+}
+
+/**
+ * Name: NArrayAssignment::bytecode_generate
+ * Construct: Method
+ * Desc: Stores the value of the RHS (converted to the element type) to the
+ *   element of the array at the index
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NArrayAssignment::bytecode_generate(BytecodeContext &ctx) {
+  BytecodeValue _arr = get_array(ctx, lhs.array);
+  BytecodeValue _idx = to_index(ctx, lhs.index.bytecode_generate(ctx));
+  BytecodeValue _rhs = convert(ctx, rhs.bytecode_generate(ctx),
+                               element_type_of(_arr), lhs.array.val);
+  ctx.emit(BC_ARRAY_SET, _arr.reg, _idx.reg, _rhs.reg);
+  return no_value();
+}
+
+/**
+ * Name: NAppend::bytecode_generate
+ * Construct: Method
+ * Desc: Appends an element to the end of an array, the runtime grows the
+ *   array's storage if needed
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NAppend::bytecode_generate(BytecodeContext &ctx) {
+  BytecodeValue _arr = get_array(ctx, array);
+  BytecodeValue _val = convert(ctx, exp.bytecode_generate(ctx),
+                               element_type_of(_arr), array.val);
+  ctx.emit(BC_ARRAY_PUSH, _arr.reg, _val.reg);
+  return no_value();
+}
+
+/* ------ constructs ------ */
+
+/**
+ * Name: NIfStatement::bytecode_generate
+ * Construct: Method
+ * Desc: Jumps past the "then" block if the condition is false (see
+ *   `condition_jump`), to the "else" (`els`) statement if there is one
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NIfStatement::bytecode_generate(BytecodeContext &ctx) {
+  std::vector<std::uint32_t> _else;
+  condition_jump(ctx, cond, false, _else);
+  block.bytecode_generate(ctx);
+  if (els) {
+    std::uint32_t _jump = ctx.emit(BC_JUMP);
+    std::uint32_t _else_label = ctx.label();
+    for (std::uint32_t jump : _else)
+      ctx.patch(jump, _else_label);
+    els->bytecode_generate(ctx);
+    ctx.patch(_jump, ctx.label());
+    return no_value();
+  }
+  std::uint32_t _after = ctx.label();
+  for (std::uint32_t jump : _else)
+    ctx.patch(jump, _after);
+  return no_value();
+}
+
+/**
+ * Name: NElseStatement::bytecode_generate
+ * Construct: Method
+ * Desc: The "else" is simply its block
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NElseStatement::bytecode_generate(BytecodeContext &ctx) {
+  return block.bytecode_generate(ctx);
+}
+
+/**
+ * Name: loop_bytecode_generate
+ * Construct: Function
+ * Desc: Emits the loop structure shared by `while` and `until`, a jump to the
+ *   condition, which follows the block and jumps back to it, so each
+ *   iteration runs a single jump
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ *   - cond: The loop's condition
+ *   - block: The loop's block of statements
+ *   - until: Whether the loop exits when the condition is true (`until`) or
+ *     false (`while`)
+ */
+static void loop_bytecode_generate(BytecodeContext &ctx, NExpression &cond,
+                                   NBlock &block, bool until) {
+  std::uint32_t _enter = ctx.emit(BC_JUMP);
+  std::uint32_t _body = ctx.label();
+  block.bytecode_generate(ctx);
+  ctx.patch(_enter, ctx.label());
+  std::vector<std::uint32_t> _repeat;
+  condition_jump(ctx, cond, !until, _repeat);
+  for (std::uint32_t jump : _repeat)
+    ctx.patch(jump, _body);
+}
+
+/**
+ * Name: NWhileStatement::bytecode_generate
+ * Construct: Method
+ * Desc: Repeats the block while the condition is true (see
+ *   `loop_bytecode_generate`)
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NWhileStatement::bytecode_generate(BytecodeContext &ctx) {
+  loop_bytecode_generate(ctx, cond, block, false);
+  return no_value();
+}
+
+/**
+ * Name: NUntilStatement::bytecode_generate
+ * Construct: Method
+ * Desc: Repeats the block until the condition is true (see
+ *   `loop_bytecode_generate`)
+ * Args:
+ *   - ctx: The BytecodeContext instance
+ */
+BytecodeValue NUntilStatement::bytecode_generate(BytecodeContext &ctx) {
+  loop_bytecode_generate(ctx, cond, block, true);
+  return no_value();
+}
@@ -1,20 +1,221 @@
+#include <algorithm>
+
+#include "ast-eval.hpp"
 #include "ast.hpp"
 #include "codegen.hpp"
 #include "parser.hpp"
 
-/** Returns an LLVM type based on the identifier */
+/**
+ * Name: STACK_ARRAY_LIMIT
+ * Construct: Global constant
+ * Desc: The largest number of elements of a fixed-size array, whose size is
+ *   known at compile time, which is allocated on the stack, any larger (or
+ *   growable) array is allocated by the runtime
+ */
+const std::int64_t STACK_ARRAY_LIMIT = 128;
+
+/**
+ * Name: ARRAY_FIELDS
+ * Construct: Enum
+ * Desc: The indices of the fields of an array, see `SoodArray` in
+ *   include/sood-runtime.h
+ */
+enum ARRAY_FIELDS {
+  ARRAY_DATA,
+  ARRAY_LENGTH,
+  ARRAY_CAPACITY,
+  ARRAY_ARENA,
+};
+
+/**
+ * Name: STRING_FIELDS
+ * Construct: Enum
+ * Desc: The indices of the fields of a string, see `SoodString` in
+ *   include/sood-runtime.h
+ */
+enum STRING_FIELDS {
+  STRING_DATA,
+  STRING_LENGTH,
+  STRING_CAPACITY,
+  STRING_ARENA,
+  STRING_SMALL,
+};
+
+/**
+ * Name: array_type_of
+ * Construct: Function
+ * Desc: Returns the (named) struct type of an array of the given element type,
+ *   the layout of which matches `SoodArray` of the runtime
+ * Args:
+ *   - elem: The LLVM type of the array's elements
+ */
+static llvm::StructType *array_type_of(llvm::Type *elem) {
+  static std::map<llvm::Type *, llvm::StructType *> array_types;
+  if (elem != INTEGER_TYPE && elem != DOUBLE_TYPE)
+    throw CodeGenException("Arrays may only hold integers or floats");
+  auto it = array_types.find(elem);
+  if (it != array_types.end())
+    return it->second;
+  llvm::StructType *_type = llvm::StructType::create(
+      LLVM_CTX, {elem->getPointerTo(), INTEGER_TYPE, INTEGER_TYPE, ARENA_TYPE},
+      elem == INTEGER_TYPE ? "sood_array.integer" : "sood_array.float");
+  array_types[elem] = _type;
+  return _type;
+}
+
+/** Whether the type is one of the types returned by `array_type_of` */
+static bool is_array_type(llvm::Type *type) {
+  llvm::StructType *_type = llvm::dyn_cast<llvm::StructType>(type);
+  return _type && _type->hasName() &&
+         _type->getName().startswith("sood_array.");
+}
+
+/** The element type of one of the types returned by `array_type_of` */
+static llvm::Type *element_type_of(llvm::Type *array_type) {
+  return array_type->getStructElementType(ARRAY_DATA)
+      ->getPointerElementType();
+}
+
+/**
+ * Returns an LLVM type based on the identifier, arrays (`<type> array`) are
+ *   passed to functions by reference
+ */
 static llvm::Type *type_of(const NIdentifier &type) {
+  const std::string suffix = " array";
+  if (type.val.size() > suffix.size() &&
+      type.val.compare(type.val.size() - suffix.size(), suffix.size(),
+                       suffix) == 0) {
+    NIdentifier _elem(type.val.substr(0, type.val.size() - suffix.size()));
+    return array_type_of(type_of(_elem))->getPointerTo();
+  }
   if (type.val == "integer")
     return llvm::Type::getInt64Ty(LLVM_CTX);
   if (type.val == "float")
     return llvm::Type::getDoubleTy(LLVM_CTX);
   if (type.val == "string")
-    return llvm::Type::getInt8PtrTy(LLVM_CTX);
+    return STRING_TYPE;
   if (type.val == "void")
     return llvm::Type::getVoidTy(LLVM_CTX);
   throw CodeGenException("Unknown variable type");
 }
 
+/**
+ * Name: create_entry_alloca
+ * Construct: Function
+ * Desc: Allocates space for a variable in the entry block of the current
+ *   function, regardless of where the declaration appears, so a declaration
+ *   inside a loop doesn't grow the stack on each iteration and the variable
+ *   can later be promoted to a register
+ * Args:
+ *   - type: The LLVM type of the variable
+ *   - name: The name of the variable
+ */
+static llvm::AllocaInst *create_entry_alloca(llvm::Type *type,
+                                             const std::string &name) {
+  llvm::BasicBlock &_entry =
+      BUILDER.GetInsertBlock()->getParent()->getEntryBlock();
+  llvm::IRBuilder<> _builder(&_entry, _entry.begin());
+  return _builder.CreateAlloca(type, nullptr, name);
+}
+
+/**
+ * Name: set_entry_init_point
+ * Construct: Function
+ * Desc: Sets the insert point of the global IR builder (see `BUILDER`) to
+ *   just after the allocas of the current function's entry block, where
+ *   storage allocated by `create_entry_alloca` is initialized once per call
+ *   of the function rather than each time its declaration is reached
+ */
+static void set_entry_init_point() {
+  llvm::BasicBlock &_entry =
+      BUILDER.GetInsertBlock()->getParent()->getEntryBlock();
+  llvm::BasicBlock::iterator _it = _entry.begin();
+  while (_it != _entry.end() && llvm::isa<llvm::AllocaInst>(*_it))
+    ++_it;
+  BUILDER.SetInsertPoint(&_entry, _it);
+}
+
+/**
+ * Name: function_arena
+ * Construct: Function
+ * Desc: Returns the arena (see `SoodArena`) of the current function, creating
+ *   it on first use, from which the function's strings and arrays allocate.
+ *   The arena is released as the function returns (see
+ *   `CodeGenContext::release_arena`), as no Sood value outlives the function
+ *   declaring it: strings are returned by copying them to the caller's
+ *   string, and arrays can't be returned
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ */
+static llvm::Value *function_arena(CodeGenContext &ctx) {
+  if (!ctx.arena) {
+    llvm::AllocaInst *_arena = create_entry_alloca(ARENA_STRUCT_TYPE, "_arena");
+    llvm::IRBuilderBase::InsertPointGuard _guard(BUILDER);
+    set_entry_init_point();
+    BUILDER.CreateStore(llvm::Constant::getNullValue(ARENA_STRUCT_TYPE),
+                        _arena);
+    ctx.arena = _arena;
+  }
+  return ctx.arena;
+}
+
+/* -------- Strings  -------- */
+
+/**
+ * Name: string_runtime_call
+ * Construct: Function
+ * Desc: Calls one of the runtime's string functions (see `SoodString`), all
+ *   of which take only strings
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - name: The name of the runtime function
+ *   - ret_type: The return type of the runtime function
+ *   - args: The strings to pass
+ */
+static llvm::CallInst *
+string_runtime_call(CodeGenContext &ctx, const std::string &name,
+                    llvm::Type *ret_type, std::vector<llvm::Value *> args) {
+  std::vector<llvm::Type *> _arg_types(args.size(), STRING_TYPE);
+  llvm::Function *_fn = ctx.runtime_function(
+      name, llvm::FunctionType::get(ret_type, _arg_types, false));
+  return BUILDER.CreateCall(_fn, args);
+}
+
+/**
+ * Name: create_string_storage
+ * Construct: Function
+ * Desc: Allocates (see `create_entry_alloca`) and initializes, to the empty
+ *   string of the function's arena, the storage of a string variable or
+ *   temporary. The initialization is also in the entry block, so in a loop
+ *   the storage, and any characters it has allocated, are reused by each
+ *   iteration
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - name: The name of the variable
+ */
+static llvm::Value *create_string_storage(CodeGenContext &ctx,
+                                          const std::string &name) {
+  llvm::Value *_arena = function_arena(ctx);
+  llvm::AllocaInst *_str = create_entry_alloca(STRING_STRUCT_TYPE, name);
+  llvm::IRBuilderBase::InsertPointGuard _guard(BUILDER);
+  set_entry_init_point();
+  llvm::Function *_init = ctx.runtime_function(
+      "sood_string_init",
+      llvm::FunctionType::get(BUILDER.getVoidTy(), {STRING_TYPE, ARENA_TYPE},
+                              false));
+  BUILDER.CreateCall(_init, {_str, _arena});
+  return _str;
+}
+
+/** Loads the given field (see `STRING_FIELDS`) of a string */
+static llvm::Value *string_field(llvm::Value *_str, STRING_FIELDS field,
+                                 const llvm::Twine &name) {
+  return BUILDER.CreateLoad(
+      STRING_STRUCT_TYPE->getElementType(field),
+      BUILDER.CreateStructGEP(STRING_STRUCT_TYPE, _str, field, name + "_ptr"),
+      name);
+}
+
 /* -------- Types  -------- */
 
 /**
@@ -74,14 +275,28 @@ void process_escape_chars(std::string &input) {
 /**
  * Name: NString::code_generate
  * Construct: Method
- * Desc: Creates a global string with the contents of the `val` member and
- *   return a poitner to it
+ * Desc: Creates a global string with the contents of the `val` member, and a
+ *   constant string (see `SoodString`) of it, and return a pointer to the
+ *   latter. The length is known here so is never counted at run time
  * Args:
  *   - ctx: The CodeGenContext instance
  */
 llvm::Value *NString::code_generate(CodeGenContext &ctx) {
-  process_escape_chars(val);
-  return get_i8_str_ptr(val.c_str(), "l_str");
+  /** A node may be generated again, e.g. a loop of `--tiered` (tiered.cpp) */
+  if (!escaped) {
+    process_escape_chars(val);
+    escaped = true;
+  }
+  llvm::Constant *_str = llvm::ConstantStruct::get(
+      STRING_STRUCT_TYPE,
+      {get_i8_str_ptr(val.c_str(), "l_str"),
+       BUILDER.getInt64(std::strlen(val.c_str())), BUILDER.getInt64(-1),
+       llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(ARENA_TYPE)),
+       llvm::ConstantAggregateZero::get(
+           STRING_STRUCT_TYPE->getElementType(STRING_SMALL))});
+  return new llvm::GlobalVariable(*ctx.module, STRING_STRUCT_TYPE, true,
+                                  llvm::GlobalValue::PrivateLinkage, _str,
+                                  "l_str_val");
 }
 
 /**
@@ -100,6 +315,10 @@ llvm::Value *NIdentifier::code_generate(CodeGenContext &ctx) {
     throw CodeGenException(msg.c_str());
   }
   ValTypeTuple _ident = ctx.get_local(val);
+  /** Arrays and strings are used by reference, e.g. when passed to a function */
+  if (is_array_type(std::get<llvm::Type *>(_ident)) ||
+      std::get<llvm::Type *>(_ident) == STRING_TYPE)
+    return std::get<llvm::Value *>(_ident);
   return BUILDER.CreateLoad(std::get<llvm::Value *>(_ident), "_val_load");
 }
 
@@ -129,6 +348,131 @@ llvm::Value *NUnaryExpression::code_generate(CodeGenContext &ctx) {
   }
 }
 
+/**
+ * Name: string_binary_operation
+ * Construct: Function
+ * Desc: Concatenates or compares two strings. A concatenation is made in a
+ *   temporary string, which, in a chain of concatenations (`a plus b plus
+ *   c`), the following strings are appended to rather than each making a
+ *   copy
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - exp: The binary expression
+ *   - _lhs: The string of the LHS
+ *   - _rhs: The string of the RHS
+ */
+static llvm::Value *string_binary_operation(CodeGenContext &ctx,
+                                            NBinaryExpression &exp,
+                                            llvm::Value *_lhs,
+                                            llvm::Value *_rhs) {
+  if (_lhs->getType() != STRING_TYPE || _rhs->getType() != STRING_TYPE)
+    throw CodeGenException("Strings may only be operated on with strings");
+
+  switch (exp.op) {
+  case OP_PLUS: {
+    NBinaryExpression *_chain = dynamic_cast<NBinaryExpression *>(&exp.lhs);
+    if (_chain && _chain->op == OP_PLUS) {
+      string_runtime_call(ctx, "sood_string_append", BUILDER.getVoidTy(),
+                          {_lhs, _rhs});
+      return _lhs;
+    }
+    llvm::Value *_str = create_string_storage(ctx, "_str_tmp");
+    string_runtime_call(ctx, "sood_string_concat", BUILDER.getVoidTy(),
+                        {_str, _lhs, _rhs});
+    return _str;
+  }
+  case OP_EQUAL_TO:
+    return BUILDER.CreateICmpNE(
+        string_runtime_call(ctx, "sood_string_equal", BUILDER.getInt32Ty(),
+                            {_lhs, _rhs}),
+        BUILDER.getInt32(0), "s_equal");
+  case OP_NOT_EQUAL_TO:
+    return BUILDER.CreateICmpEQ(
+        string_runtime_call(ctx, "sood_string_equal", BUILDER.getInt32Ty(),
+                            {_lhs, _rhs}),
+        BUILDER.getInt32(0), "s_not_equal");
+  default:
+    throw CodeGenException("Strings may only be concatenated or compared "
+                           "for equality");
+  }
+}
+
+/**
+ * Name: to_condition
+ * Construct: Function
+ * Desc: Boolean operations already produce an `i1`, which is used as is, any
+ *   other integer or floating point value is compared against zero
+ * Args:
+ *   - _val: The LLVM value of the condition expression
+ *   - name: The name given to the comparison, if one is needed
+ */
+static llvm::Value *to_condition(llvm::Value *_val, const llvm::Twine &name) {
+  llvm::Type *_type = _val->getType();
+  if (_type->isIntegerTy(1))
+    return _val;
+  if (_type->isIntegerTy())
+    return BUILDER.CreateICmpNE(_val, llvm::ConstantInt::get(_type, 0), name);
+  if (_type->isDoubleTy())
+    return BUILDER.CreateFCmpONE(_val, llvm::ConstantFP::get(_type, 0.0),
+                                 name);
+  throw CodeGenException("Invalid condition type");
+}
+
+/**
+ * Name: short_circuit
+ * Construct: Function
+ * Desc: Generates `and`/`alternatively` so that the RHS is only evaluated
+ *   when the LHS does not already decide the result, branching around the RHS
+ *   and joining both paths with a phi
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - expr: The `OP_AND` or `OP_ALTERNATIVELY` expression
+ * Notes:
+ *   - Both sides are taken as conditions (see `to_condition`) and the result
+ *     is an `i1`, as for the comparisons
+ *   - The RHS may itself branch (e.g. a nested `and`), so the phi's incoming
+ *     block is wherever the RHS ends rather than the block it starts in
+ */
+static llvm::Value *short_circuit(CodeGenContext &ctx,
+                                  NBinaryExpression &expr) {
+  bool _and = expr.op == OP_AND;
+  std::string _name = _and ? "also" : "alternatively";
+
+  llvm::Value *_lhs = expr.lhs.code_generate(ctx);
+  if (!_lhs)
+    throw CodeGenException("Couldn't generate code for binary comparison");
+  _lhs = to_condition(_lhs, _name + "_lhs");
+
+  /**
+   * Blocks are placed straight after the current one, keeping the layout in
+   * source order when this is the condition of an `if` or loop
+   */
+  llvm::BasicBlock *_lhs_end = BUILDER.GetInsertBlock();
+  llvm::Function *_fn = _lhs_end->getParent();
+  llvm::BasicBlock *_rhs_block = llvm::BasicBlock::Create(
+      LLVM_CTX, _name + "_rhs", _fn, _lhs_end->getNextNode());
+  llvm::BasicBlock *_aftr = llvm::BasicBlock::Create(
+      LLVM_CTX, _name + "_cnt", _fn, _rhs_block->getNextNode());
+  if (_and)
+    BUILDER.CreateCondBr(_lhs, _rhs_block, _aftr);
+  else
+    BUILDER.CreateCondBr(_lhs, _aftr, _rhs_block);
+
+  BUILDER.SetInsertPoint(_rhs_block);
+  llvm::Value *_rhs = expr.rhs.code_generate(ctx);
+  if (!_rhs)
+    throw CodeGenException("Couldn't generate code for binary comparison");
+  _rhs = to_condition(_rhs, _name + "_rhs");
+  llvm::BasicBlock *_rhs_end = BUILDER.GetInsertBlock();
+  BUILDER.CreateBr(_aftr);
+
+  BUILDER.SetInsertPoint(_aftr);
+  llvm::PHINode *_phi = BUILDER.CreatePHI(BUILDER.getInt1Ty(), 2, _name);
+  _phi->addIncoming(BUILDER.getInt1(!_and), _lhs_end);
+  _phi->addIncoming(_rhs, _rhs_end);
+  return _phi;
+}
+
 /**
  * Name: NUnaryExpression::code_generate
  * Construct: Method
@@ -139,10 +483,14 @@ llvm::Value *NUnaryExpression::code_generate(CodeGenContext &ctx) {
  * Args:
  *   - ctx: The CodeGenContext instance
  * Notes:
- *   - Currently, any boolean or arithmetic expression applied to a string
- *     will fail, this is a future task
+ *   - Strings may only be concatenated (`plus`) and compared for equality,
+ *     see `string_binary_operation`
+ *   - `and` and `alternatively` short-circuit, see `short_circuit`
  */
 llvm::Value *NBinaryExpression::code_generate(CodeGenContext &ctx) {
+  if (op == OP_AND || op == OP_ALTERNATIVELY)
+    return short_circuit(ctx, *this);
+
   llvm::Value *_lhs = lhs.code_generate(ctx);
   llvm::Value *_rhs = rhs.code_generate(ctx);
 
@@ -163,7 +511,9 @@ llvm::Value *NBinaryExpression::code_generate(CodeGenContext &ctx) {
     _lhs_type = DOUBLE_TYPE;
   }
 
-  // TODO: Strings...
+  if (_lhs_type == STRING_TYPE || _rhs_type == STRING_TYPE)
+    return string_binary_operation(ctx, *this, _lhs, _rhs);
+
   switch (op) {
   case OP_PLUS:
     return BUILDER.CreateAdd(_lhs, _rhs, "add");
@@ -175,10 +525,6 @@ llvm::Value *NBinaryExpression::code_generate(CodeGenContext &ctx) {
     return BUILDER.CreateSDiv(_lhs, _rhs, "div");
   case OP_MODULO: // ?
     return BUILDER.CreateSRem(_lhs, _rhs, "srem_mod");
-  case OP_AND:
-    return BUILDER.CreateAnd(_lhs, _rhs, "also");
-  case OP_ALTERNATIVELY:
-    return BUILDER.CreateOr(_lhs, _rhs, "alternatively");
   case OP_EQUAL_TO: // Order matters?
     if (_lhs_type == DOUBLE_TYPE)
       return BUILDER.CreateFCmpOEQ(_lhs, _rhs, "f_equal");
@@ -234,6 +580,7 @@ llvm::Value *NBlock::code_generate(CodeGenContext &ctx) {
   llvm::Value *last = nullptr;
   NStatementList::const_iterator it;
   for (it = stmts.begin(); it != stmts.end(); it++) {
+    ctx.set_debug_location(**it);
     last = (*it)->code_generate(ctx);
   }
   return last;
@@ -247,9 +594,7 @@ llvm::Value *NBlock::code_generate(CodeGenContext &ctx) {
  *   - _rhs: The LLVM value of the RHS expression
  *   - _lhs_type: The value/type tuple from the locals of the `CodeGenBlock`
  * Notes:
- *   - Currently, this function does nothing with string and attempts to
- *     assign an integer to a string or vice versa will fail, this is a future
- *     task
+ *   - Strings are not cast, see `assign_string`
  */
 llvm::Value *cast_relevantly(llvm::Value *_rhs, ValTypeTuple _lhs_tuple) {
   llvm::Value *_lhs;
@@ -268,14 +613,108 @@ llvm::Value *cast_relevantly(llvm::Value *_rhs, ValTypeTuple _lhs_tuple) {
                               "_rhs_cast_to_double");
 
   if (_lhs_type == INTEGER_TYPE && _rhs_type == DOUBLE_TYPE)
-    _rhs = BUILDER.CreateCast(llvm::Instruction::FPToSI, _lhs, INTEGER_TYPE,
+    _rhs = BUILDER.CreateCast(llvm::Instruction::FPToSI, _rhs, INTEGER_TYPE,
                               "_rhs_cast_to_int");
 
-  if (_lhs_type == STRING_TYPE && _rhs_type != STRING_TYPE)
-    _rhs = nullptr;
   return _rhs;
 }
 
+/**
+ * Name: may_grow
+ * Construct: Function
+ * Desc: Whether the array of the given name may change length within a node,
+ *   either appended to directly or passed to a function which may append to
+ *   it
+ * Args:
+ *   - node: The node to search
+ *   - name: The name of the array
+ */
+static bool may_grow(Node *node, const std::string &name) {
+  if (NFunctionCall *_call = dynamic_cast<NFunctionCall *>(node))
+    for (NExpression *arg : _call->args)
+      if (NIdentifier *_ident = dynamic_cast<NIdentifier *>(arg))
+        if (_ident->val == name)
+          return true;
+  if (assigns_to(node, name))
+    return true;
+  for (Node *child : ast_children(*node))
+    if (may_grow(child, name))
+      return true;
+  return false;
+}
+
+/**
+ * Name: forget_array_lengths
+ * Construct: Function
+ * Desc: Forgets the lengths known at compile time of the arrays declared
+ *   within a node, for a loop, whose redeclarations apply to the accesses
+ *   before them from the next iteration on
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - node: The node to search
+ */
+static void forget_array_lengths(CodeGenContext &ctx, Node *node) {
+  if (dynamic_cast<NFunctionDeclaration *>(node))
+    return;
+  if (NArrayDeclaration *_decl = dynamic_cast<NArrayDeclaration *>(node))
+    ctx.clear_array_length(_decl->lhs.val);
+  for (Node *child : ast_children(*node))
+    forget_array_lengths(ctx, child);
+}
+
+/**
+ * Name: assign_string
+ * Construct: Function
+ * Desc: Assigns the value of an expression to a string. Where the expression
+ *   appends to the string itself (`s is s plus t`) the string is appended to
+ *   in place, so building a string in a loop takes linear rather than
+ *   quadratic time, otherwise the value is copied (see `sood_string_assign`)
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - _str: The string to assign to
+ *   - name: The name of the string, or empty if it has none
+ *   - exp: The expression whose value to assign
+ */
+static llvm::Value *assign_string(CodeGenContext &ctx, llvm::Value *_str,
+                                  const std::string &name, NExpression &exp) {
+  std::vector<NExpression *> _appended;
+  NExpression *_first = &exp;
+  NBinaryExpression *_bin;
+  while ((_bin = dynamic_cast<NBinaryExpression *>(_first)) &&
+         _bin->op == OP_PLUS) {
+    _appended.insert(_appended.begin(), &_bin->rhs);
+    _first = &_bin->lhs;
+  }
+
+  /**
+   * Only the first of the appended strings may use the string itself, the
+   *   later ones would see it already appended to
+   */
+  NIdentifier *_ident = dynamic_cast<NIdentifier *>(_first);
+  bool _in_place = !name.empty() && _ident && _ident->val == name &&
+                   !_appended.empty();
+  for (std::size_t i = 1; _in_place && i < _appended.size(); i++)
+    _in_place = !mentions(_appended[i], name);
+
+  if (_in_place) {
+    for (NExpression *_exp : _appended) {
+      llvm::Value *_rhs = _exp->code_generate(ctx);
+      if (_rhs->getType() != STRING_TYPE)
+        throw CodeGenException("Strings may only be operated on with strings");
+      string_runtime_call(ctx, "sood_string_append", BUILDER.getVoidTy(),
+                          {_str, _rhs});
+    }
+    return _str;
+  }
+
+  llvm::Value *_rhs = exp.code_generate(ctx);
+  if (_rhs->getType() != STRING_TYPE)
+    throw CodeGenException("Only a string may be assigned to string " + name);
+  string_runtime_call(ctx, "sood_string_assign", BUILDER.getVoidTy(),
+                      {_str, _rhs});
+  return _str;
+}
+
 /**
  * Name: NAssignment::code_generate
  * Construct: Method
@@ -293,6 +732,11 @@ llvm::Value *NAssignment::code_generate(CodeGenContext &ctx) {
   if (!_lhs)
     throw CodeGenException("Variable " + lhs.val +
                            " not defined in current block");
+  if (is_array_type(std::get<llvm::Type *>(_lhs_tuple)))
+    throw CodeGenException("Array " + lhs.val +
+                           " cannot be assigned, assign its elements instead");
+  if (std::get<llvm::Type *>(_lhs_tuple) == STRING_TYPE)
+    return assign_string(ctx, _lhs, lhs.val, rhs);
   llvm::Value *_rhs = cast_relevantly(rhs.code_generate(ctx), _lhs_tuple);
   if (_rhs)
     return BUILDER.CreateStore(_rhs, _lhs);
@@ -320,6 +764,8 @@ llvm::Value *NWrite::code_generate(CodeGenContext &ctx) {
     printf_args.push_back(ctx.fmt_specifiers.at("string"));
   else
     throw CodeGenException("Write not yet implemented");
+  if (_exp_type == STRING_TYPE)
+    _exp = string_field(_exp, STRING_DATA, "_str_data");
   printf_args.push_back(_exp);
   return BUILDER.CreateCall(ctx.printf_function, printf_args, "_printf_call");
 }
@@ -337,23 +783,65 @@ llvm::Value *NRead::code_generate(CodeGenContext &ctx) {
   throw CodeGenException("Read not yet implemented");
 }
 
+/**
+ * Name: passes_local_storage
+ * Construct: Function
+ * Desc: Whether any of a call's arguments point to the caller's stack, e.g.
+ *   an array declared in the caller, such a call may not be a tail call as
+ *   the caller's frame must outlive it
+ * Args:
+ *   - call: The call instruction
+ */
+static bool passes_local_storage(llvm::CallInst *call) {
+  for (llvm::Value *arg : call->args())
+    if (llvm::isa<llvm::AllocaInst>(arg->stripPointerCasts()))
+      return true;
+  return false;
+}
+
 /**
  * Name: NReturnStatement::code_generate
  * Construct: Method
  * Desc: Uses the global IR builder (see `BUILDER`) to create a return
  *   instruction (which returns from a function in a block). Multiple exit
- *   points can be specified in a functionn however the LLVM module
- *   verification will complain about this, e.g:
- *   """
- *     Terminator found in the middle of a basic block!
- *     label %xxxx
- *   """
- *   However, this thankfully does not break the compilation.
+ *   points can be specified in a function, each return is followed by a new
+ *   (unreachable) block so the verifier doesn't find a terminator in the
+ *   middle of a basic block
  * Args:
  *   - ctx: The CodeGenContext instance
  */
 llvm::Value *NReturnStatement::code_generate(CodeGenContext &ctx) {
-  return BUILDER.CreateRet(exp.code_generate(ctx));
+  llvm::Function *_fn = BUILDER.GetInsertBlock()->getParent();
+
+  /** A string is returned by assigning it to the caller's string */
+  if (ctx.string_return) {
+    assign_string(ctx, ctx.string_return, "", exp);
+    llvm::Value *_ret = BUILDER.CreateRetVoid();
+    BUILDER.SetInsertPoint(llvm::BasicBlock::Create(LLVM_CTX, "ret_cnt", _fn));
+    return _ret;
+  }
+
+  llvm::Value *_exp = exp.code_generate(ctx);
+
+  /**
+   * A call to the enclosing function whose result is returned directly is a
+   *   self-recursive tail call, marking it `tail` lets the tail call
+   *   elimination pass (see `CodeGenContext::optimize`) turn it into a loop
+   */
+  if (llvm::CallInst *_call = llvm::dyn_cast<llvm::CallInst>(_exp))
+    if (_call->getCalledFunction() == _fn && !passes_local_storage(_call))
+      _call->setTailCall();
+
+  llvm::Value *_ret = BUILDER.CreateRet(_exp);
+
+  /**
+   * Anything following the return is unreachable but the enclosing construct
+   *   will still emit its branch, so give it a block of its own rather than
+   *   placing a terminator in the middle of this one
+   */
+  BUILDER.SetInsertPoint(llvm::BasicBlock::Create(LLVM_CTX, "ret_cnt", _fn));
+
+  return _ret;
 }
 
 /**
@@ -382,17 +870,16 @@ llvm::Value *NExpressionStatement::code_generate(CodeGenContext &ctx) {
  *   passed to it, so:
  *     integer -> 0
  *     float -> 0.0
- *     string -> ""
  * Args:
  *   - type: The LLVM type for which a zero initializer should be created
+ * Notes:
+ *   - Strings are initialized by `create_string_storage`
  */
 static llvm::Value *zero_value_for(llvm::Type *type) {
   if (type == DOUBLE_TYPE)
     return llvm::ConstantFP::get(DOUBLE_TYPE, 0.0);
   if (type == INTEGER_TYPE)
     return llvm::ConstantInt::get(INTEGER_TYPE, 0, true);
-  if (type == STRING_TYPE)
-    return get_i8_str_ptr("", "str_init_val");
   throw CodeGenException("Unknown variable type");
 }
 
@@ -400,7 +887,7 @@ static llvm::Value *zero_value_for(llvm::Type *type) {
  * Name: NVariableDeclaration::code_generate
  * Construct: Method
  * Desc: Allocates space for a variable of the relevant type under the name of
- *   the identifier in question. If the RHS is not null, an assignment (store
+ *   the identifier in question (see `create_entry_alloca`). If the RHS is not null, an assignment (store
  *   instruction) is used to initialize the variable, if the RHS value is null,
  *   a zero value initializer is used
  * Args:
@@ -408,7 +895,14 @@ static llvm::Value *zero_value_for(llvm::Type *type) {
  */
 llvm::Value *NVariableDeclaration::code_generate(CodeGenContext &ctx) {
   llvm::Type *_lhs_type = type_of(type);
-  llvm::Value *_lhs = BUILDER.CreateAlloca(_lhs_type, 0, lhs.val.c_str());
+  if (_lhs_type == STRING_TYPE) {
+    llvm::Value *_str = create_string_storage(ctx, lhs.val);
+    ctx.set_local(lhs.val, _str, STRING_TYPE);
+    /** Redeclared in a loop, the string must be emptied each iteration */
+    NString _empty("''");
+    return assign_string(ctx, _str, lhs.val, rhs ? *rhs : _empty);
+  }
+  llvm::Value *_lhs = create_entry_alloca(_lhs_type, lhs.val);
   ctx.set_local(lhs.val, _lhs, _lhs_type);
   if (rhs) {
     BUILDER.CreateStore(rhs->code_generate(ctx), _lhs);
@@ -419,18 +913,15 @@ llvm::Value *NVariableDeclaration::code_generate(CodeGenContext &ctx) {
 }
 
 /**
- * Name: NFunctionDeclaration::code_generate
+ * Name: NFunctionDeclaration::declare
  * Construct: Method
- * Desc: Creates a function under the identifier's name (`id`), create
- *   variable declarations and optional initilizers for each of the function's
- *   arguments, and generate the code for the function's block
+ * Desc: Creates the prototype of the function, without its code, used both
+ *   to generate the function and to declare it in a module which only calls
+ *   it (see src/incremental.cpp)
  * Args:
  *   - ctx: The CodeGenContext instance
  */
-llvm::Value *NFunctionDeclaration::code_generate(CodeGenContext &ctx) {
-
-  llvm::BasicBlock *_current_block = BUILDER.GetInsertBlock();
-
+llvm::Function *NFunctionDeclaration::declare(CodeGenContext &ctx) {
   std::vector<llvm::Type *> arg_types;
   NVariableList::const_iterator it;
 
@@ -445,11 +936,48 @@ llvm::Value *NFunctionDeclaration::code_generate(CodeGenContext &ctx) {
    * Create the function prototype with the arguments above and the specified
    * return type
    */
+  llvm::Type *_ret_type = type_of(type);
+  if (_ret_type->isPointerTy() &&
+      is_array_type(_ret_type->getPointerElementType()))
+    throw CodeGenException("Function " + id.val + " cannot return an array");
+
+  /**
+   * The storage of a string is the caller's, so a function returning a
+   *   string takes the caller's string to assign the result to
+   */
+  if (_ret_type == STRING_TYPE) {
+    arg_types.insert(arg_types.begin(), STRING_TYPE);
+    _ret_type = BUILDER.getVoidTy();
+    ctx.string_functions.insert(id.val);
+  }
+
   llvm::FunctionType *_fn_type = llvm::FunctionType::get(
-      type_of(type), llvm::makeArrayRef(arg_types), false);
+      _ret_type, llvm::makeArrayRef(arg_types), false);
 
   llvm::Function *_fn = llvm::Function::Create(
       _fn_type, llvm::GlobalValue::InternalLinkage, id.val.c_str(), ctx.module);
+  if (ctx.fast_cc)
+    _fn->setCallingConv(llvm::CallingConv::Fast);
+  return _fn;
+}
+
+/**
+ * Name: NFunctionDeclaration::code_generate
+ * Construct: Method
+ * Desc: Creates a function under the identifier's name (`id`), create
+ *   variable declarations and optional initilizers for each of the function's
+ *   arguments, and generate the code for the function's block
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ */
+llvm::Value *NFunctionDeclaration::code_generate(CodeGenContext &ctx) {
+
+  llvm::BasicBlock *_current_block = BUILDER.GetInsertBlock();
+
+  NVariableList::const_iterator it;
+  llvm::Function *_fn = declare(ctx);
+  ctx.function_decls[id.val] = this;
+  bool _returns_string = type_of(type) == STRING_TYPE;
 
   llvm::BasicBlock *_block =
       llvm::BasicBlock::Create(LLVM_CTX, id.val + "__entry", _fn, 0);
@@ -457,15 +985,60 @@ llvm::Value *NFunctionDeclaration::code_generate(CodeGenContext &ctx) {
   /** Put the new block on the CodeGenBlock stack */
   ctx.push_block(_block);
 
+  /** Bounds proven by an enclosing loop are not of this function's arrays */
+  std::set<NArrayIndex *> _in_bounds;
+  std::swap(_in_bounds, ctx.in_bounds);
+
   BUILDER.SetInsertPoint(_block);
 
+  /** The function's own debug scope, the caller's is restored after */
+  llvm::DIScope *_di_scope = ctx.debug_function(_fn, id.val, *this);
+  llvm::DebugLoc _di_location = BUILDER.getCurrentDebugLocation();
+  std::swap(_di_scope, ctx.di_scope);
+  ctx.set_debug_location(*this);
+
   llvm::Function::arg_iterator arg_it = _fn->arg_begin();
 
+  llvm::Value *_string_return = nullptr;
+  if (_returns_string) {
+    _string_return = arg_it++;
+    _string_return->setName("_str_ret");
+  }
+  std::swap(_string_return, ctx.string_return);
+
+  /** The function's arena is created if its values need one */
+  llvm::Value *_arena = nullptr;
+  NBlock *_body = &block;
+  std::swap(_arena, ctx.arena);
+  std::swap(_body, ctx.function_body);
+
   /** Create the arguments for the function (not just the types this time) */
   for (it = args.begin(); it != args.end(); it++) {
     // llvm::Value *arg_val = (*it)->code_generate(ctx);
     llvm::Value *_arg_value = arg_it++;
     _arg_value->setName((*it)->lhs.val.c_str());
+    /** Arrays are passed by reference so need no local copy */
+    llvm::Type *_arg_type = _arg_value->getType();
+    if (_arg_type->isPointerTy() &&
+        is_array_type(_arg_type->getPointerElementType())) {
+      ctx.set_local((*it)->lhs.val, _arg_value,
+                    _arg_type->getPointerElementType());
+      continue;
+    }
+    /**
+     * A string argument is the caller's so is only copied if the function
+     *   assigns to it
+     */
+    if (_arg_type == STRING_TYPE) {
+      if (assigns_to(&block, (*it)->lhs.val)) {
+        llvm::Value *_str = create_string_storage(ctx, (*it)->lhs.val);
+        string_runtime_call(ctx, "sood_string_assign", BUILDER.getVoidTy(),
+                            {_str, _arg_value});
+        _arg_value = _str;
+      }
+      ctx.set_local((*it)->lhs.val, _arg_value, STRING_TYPE);
+      continue;
+    }
     llvm::Value *_in_f_arg =
         BUILDER.CreateAlloca(type_of((*it)->type), 0, (*it)->lhs.val);
     BUILDER.CreateStore(_arg_value, _in_f_arg);
@@ -474,38 +1047,443 @@ llvm::Value *NFunctionDeclaration::code_generate(CodeGenContext &ctx) {
 
   block.code_generate(ctx);
 
-  if (type.val == "void")
-    BUILDER.CreateRet(nullptr);
+  /**
+   * The last block will already be terminated if the function's final
+   *   statement was a `return`, otherwise void functions return here and
+   *   typed functions have run off the end without a value
+   */
+  if (!BUILDER.GetInsertBlock()->getTerminator()) {
+    if (type.val == "void")
+      BUILDER.CreateRet(nullptr);
+    else
+      BUILDER.CreateUnreachable();
+  }
+
+  ctx.release_arena(_fn);
 
   /** After generating the code, pop the CodeGenBlock */
   ctx.pop_block();
-
-  BUILDER.SetInsertPoint(_current_block);
+  std::swap(_in_bounds, ctx.in_bounds);
+  std::swap(_string_return, ctx.string_return);
+  std::swap(_arena, ctx.arena);
+  std::swap(_body, ctx.function_body);
+  std::swap(_di_scope, ctx.di_scope);
+  BUILDER.SetCurrentDebugLocation(_di_location);
+
+  /** A function generated on its own (see src/incremental.cpp) has no caller */
+  if (_current_block)
+    BUILDER.SetInsertPoint(_current_block);
+  else
+    BUILDER.ClearInsertionPoint();
 
   return _fn;
 }
 
+/**
+ * Name: evaluate_at_compile_time
+ * Construct: Function
+ * Desc: Evaluates a call whose arguments are all integer or float literals,
+ *   of a function declared in the source, at compile time (see
+ *   src/ast-eval.cpp)
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - call: The call
+ * Returns: The constant the call returns, or nullptr if it could not be
+ *   evaluated and must be called
+ */
+static llvm::Constant *evaluate_at_compile_time(CodeGenContext &ctx,
+                                                NFunctionCall &call) {
+  auto it = ctx.function_decls.find(call.id.val);
+  if (it == ctx.function_decls.end())
+    return nullptr;
+
+  std::vector<EvalValue> _args;
+  for (NExpression *arg : call.args) {
+    EvalValue _arg;
+    if (NInteger *_int = dynamic_cast<NInteger *>(arg)) {
+      _arg.kind = EvalValue::INTEGER;
+      _arg.i = _int->val;
+    } else if (NFloat *_float = dynamic_cast<NFloat *>(arg)) {
+      _arg.kind = EvalValue::FLOAT;
+      _arg.f = _float->val;
+    } else {
+      return nullptr;
+    }
+    _args.push_back(_arg);
+  }
+
+  EvalValue _result;
+  if (!evaluate_call(ctx.function_decls, *it->second, _args, _result))
+    return nullptr;
+  if (_result.kind == EvalValue::FLOAT)
+    return llvm::ConstantFP::get(DOUBLE_TYPE, _result.f);
+  return llvm::ConstantInt::get(INTEGER_TYPE, _result.i, true);
+}
+
 /**
  * Name: NFunctionCall::code_generate
  * Construct: Method
- * Desc: Create a call to an existing function using the global LLVM IR
- *   builder (see `BUILDER`)
+ * Desc: Create a call to an existing function, declared in the source or
+ *   imported, using the global LLVM IR builder (see `BUILDER`)
  * Args:
  *   - ctx: The CodeGenContext instance
+ * Notes:
+ *   - A call evaluated at compile time (see `evaluate_at_compile_time`) is
+ *     replaced by its result
  */
 llvm::Value *NFunctionCall::code_generate(CodeGenContext &ctx) {
-  llvm::Function *fn = ctx.module->getFunction(id.val.c_str());
+  llvm::Function *fn = ctx.get_function(id.val);
 
   if (!fn)
     throw CodeGenException("Attempted call on unknown function");
 
+  /** Pure calls of literals cost nothing at runtime */
+  if (llvm::Constant *_result = evaluate_at_compile_time(ctx, *this))
+    return _result;
+
   std::vector<llvm::Value *> _args;
 
+  /** A returned string is assigned to a temporary (see `string_return`) */
+  llvm::Value *_str = nullptr;
+  if (ctx.string_functions.count(id.val)) {
+    _str = create_string_storage(ctx, "_str_ret");
+    _args.push_back(_str);
+  }
+
   NExpressionList::const_iterator it;
   for (it = args.begin(); it != args.end(); it++)
     _args.push_back((*it)->code_generate(ctx));
 
-  return BUILDER.CreateCall(fn, _args, "_f_call");
+  llvm::CallInst *_call = BUILDER.CreateCall(fn, _args);
+  if (!_str && !fn->getReturnType()->isVoidTy())
+    _call->setName("_f_call");
+  _call->setCallingConv(fn->getCallingConv());
+  return _str ? _str : _call;
+}
+
+/**
+ * Name: NImport::code_generate
+ * Construct: Method
+ * Desc: Imports the module, declaring its functions for the rest of the
+ *   program (see `CodeGenContext::import_module`)
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ */
+llvm::Value *NImport::code_generate(CodeGenContext &ctx) {
+  ctx.import_module(name.val);
+  return nullptr;
+}
+
+/* ------ arrays ------ */
+
+/**
+ * Name: get_array
+ * Construct: Function
+ * Desc: Looks up the array of the given name, throwing a CodeGenException if
+ *   it does not exist or is not an array
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - array: The identifier of the array
+ */
+static ValTypeTuple get_array(CodeGenContext &ctx, const NIdentifier &array) {
+  if (ctx.locals().find(array.val) == ctx.locals().end())
+    throw CodeGenException("Identifier " + array.val +
+                           " not found in current context");
+  ValTypeTuple _arr = ctx.get_local(array.val);
+  if (!is_array_type(std::get<llvm::Type *>(_arr)))
+    throw CodeGenException("Identifier " + array.val + " is not an array");
+  return _arr;
+}
+
+/** A pointer to the given field (see `ARRAY_FIELDS`) of an array */
+static llvm::Value *array_field(ValTypeTuple _arr, ARRAY_FIELDS field,
+                                const llvm::Twine &name) {
+  return BUILDER.CreateStructGEP(std::get<llvm::Type *>(_arr),
+                                 std::get<llvm::Value *>(_arr), field, name);
+}
+
+/** Loads the length of an array */
+static llvm::Value *array_length(ValTypeTuple _arr) {
+  return BUILDER.CreateLoad(INTEGER_TYPE,
+                            array_field(_arr, ARRAY_LENGTH, "_arr_len_ptr"),
+                            "_arr_len");
+}
+
+/** Converts the value of an index (or size) expression to an integer */
+static llvm::Value *to_index(llvm::Value *_val) {
+  if (_val->getType() == DOUBLE_TYPE)
+    return BUILDER.CreateFPToSI(_val, INTEGER_TYPE, "_idx_cast");
+  if (_val->getType() != INTEGER_TYPE)
+    throw CodeGenException("Array indices and sizes must be numeric");
+  return _val;
+}
+
+/**
+ * Name: bounds_failure
+ * Construct: Function
+ * Desc: Branches to a call to the runtime's bounds failure (which reports
+ *   the index and exits) if `_fail` is true, the branch is weighted as
+ *   unlikely. The builder is left in the continuation block
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - _fail: The `i1` condition under which the check fails
+ *   - _idx: The offending index, for the report
+ *   - _len: The length of the array, for the report
+ */
+static void bounds_failure(CodeGenContext &ctx, llvm::Value *_fail,
+                           llvm::Value *_idx, llvm::Value *_len) {
+  llvm::Function *_fn = BUILDER.GetInsertBlock()->getParent();
+  llvm::BasicBlock *_fail_block =
+      llvm::BasicBlock::Create(LLVM_CTX, "bounds_fail", _fn);
+  llvm::BasicBlock *_ok_block =
+      llvm::BasicBlock::Create(LLVM_CTX, "bounds_ok", _fn);
+  BUILDER.CreateCondBr(_fail, _fail_block, _ok_block,
+                       llvm::MDBuilder(LLVM_CTX).createBranchWeights(1, 1 << 20));
+
+  BUILDER.SetInsertPoint(_fail_block);
+  llvm::Function *_bounds_fail = ctx.runtime_function(
+      "sood_array_bounds_fail",
+      llvm::FunctionType::get(BUILDER.getVoidTy(), {INTEGER_TYPE, INTEGER_TYPE},
+                              false));
+  _bounds_fail->setDoesNotReturn();
+  _bounds_fail->addFnAttr(llvm::Attribute::Cold);
+  BUILDER.CreateCall(_bounds_fail, {_idx, _len});
+  BUILDER.CreateUnreachable();
+
+  BUILDER.SetInsertPoint(_ok_block);
+}
+
+/**
+ * Name: bounds_check_elided
+ * Construct: Function
+ * Desc: Whether an index is proven to be within the bounds of the array, this
+ *   is either a constant index into an array whose (minimum) length is known
+ *   at compile time, or an access by the induction variable of an enclosing
+ *   counted loop, run on every iteration, whose range has already been
+ *   checked (see `hoist_bounds_checks`). A
+ *   constant index proven out of bounds is a compile time error
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - node: The array index node
+ */
+static bool bounds_check_elided(CodeGenContext &ctx, NArrayIndex &node) {
+  std::int64_t _len;
+  NInteger *_const = dynamic_cast<NInteger *>(&node.index);
+  if (_const && ctx.get_array_length(node.array.val, _len)) {
+    if (_const->val < 0 || _const->val >= _len)
+      throw CodeGenException("Index " + std::to_string(_const->val) +
+                             " out of bounds for array " + node.array.val);
+    return true;
+  }
+  return ctx.in_bounds.count(&node);
+}
+
+/**
+ * Name: array_element_ptr
+ * Construct: Function
+ * Desc: Returns a pointer to the element of an array at an index, checking
+ *   that the index is in bounds unless this is proven at compile time (see
+ *   `bounds_check_elided`)
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - node: The array index node
+ */
+static llvm::Value *array_element_ptr(CodeGenContext &ctx, NArrayIndex &node) {
+  ValTypeTuple _arr = get_array(ctx, node.array);
+  llvm::Value *_idx = to_index(node.index.code_generate(ctx));
+
+  if (!bounds_check_elided(ctx, node)) {
+    llvm::Value *_len = array_length(_arr);
+    bounds_failure(ctx, BUILDER.CreateICmpUGE(_idx, _len, "out_of_bounds"),
+                   _idx, _len);
+  }
+
+  llvm::Type *_elem_type = element_type_of(std::get<llvm::Type *>(_arr));
+  llvm::Value *_data =
+      BUILDER.CreateLoad(_elem_type->getPointerTo(),
+                         array_field(_arr, ARRAY_DATA, "_arr_data_ptr"),
+                         "_arr_data");
+  return BUILDER.CreateInBoundsGEP(_elem_type, _data, _idx, "_arr_elem");
+}
+
+/**
+ * Name: NArrayIndex::code_generate
+ * Construct: Method
+ * Desc: Loads the element of the array at the index (see
+ *   `array_element_ptr`)
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ */
+llvm::Value *NArrayIndex::code_generate(CodeGenContext &ctx) {
+  llvm::Type *_elem_type =
+      element_type_of(std::get<llvm::Type *>(get_array(ctx, array)));
+  return BUILDER.CreateLoad(_elem_type, array_element_ptr(ctx, *this),
+                            "_arr_elem_load");
+}
+
+/**
+ * Name: NLength::code_generate
+ * Construct: Method
+ * Desc: Loads the current length of an array or string, neither of which
+ *   is counted
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ */
+llvm::Value *NLength::code_generate(CodeGenContext &ctx) {
+  NIdentifier *_ident = dynamic_cast<NIdentifier *>(&exp);
+  if (_ident && ctx.locals().find(_ident->val) != ctx.locals().end() &&
+      is_array_type(std::get<llvm::Type *>(ctx.get_local(_ident->val))))
+    return array_length(get_array(ctx, *_ident));
+  llvm::Value *_exp = exp.code_generate(ctx);
+  if (_exp->getType() != STRING_TYPE)
+    throw CodeGenException("Length is only available for arrays and strings");
+  return string_field(_exp, STRING_LENGTH, "_str_len");
+}
+
+/**
+ * Name: NArrayDeclaration::code_generate
+ * Construct: Method
+ * Desc: Declares an array, the array itself (see `SoodArray`) is always
+ *   allocated on the stack but its elements are either:
+ *   - Allocated on the stack, for a fixed-size array whose size is a literal
+ *     no larger than `STACK_ARRAY_LIMIT`. The capacity is set to `-1` so the
+ *     runtime knows to move the elements to the function's arena (see
+ *     `function_arena`) if the array grows
+ *   - Allocated by the runtime from the function's arena, for any other
+ *     fixed-size array
+ *   - Not yet allocated, for a growable array
+ *   In all cases the elements are zero-initialized
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ */
+llvm::Value *NArrayDeclaration::code_generate(CodeGenContext &ctx) {
+  llvm::Type *_elem_type = type_of(type);
+  llvm::StructType *_arr_type = array_type_of(_elem_type);
+  llvm::Value *_size = size ? to_index(size->code_generate(ctx)) : nullptr;
+
+  llvm::Value *_arr_ptr = create_entry_alloca(_arr_type, lhs.val);
+  ctx.set_local(lhs.val, _arr_ptr, _arr_type);
+  ValTypeTuple _arr = ctx.get_local(lhs.val);
+
+  /**
+   * The length is only known after a declaration in the function's own
+   *   block, one within an `if` or loop may not have run
+   */
+  NInteger *_const = dynamic_cast<NInteger *>(size);
+  NStatementList &_stmts = ctx.function_body->stmts;
+  bool _dominates =
+      std::find(_stmts.begin(), _stmts.end(), this) != _stmts.end();
+  if (_const && _const->val >= 0 && _dominates)
+    ctx.set_array_length(lhs.val, _const->val);
+  else
+    ctx.clear_array_length(lhs.val);
+
+  bool _on_stack =
+      size && _const && _const->val >= 0 && _const->val <= STACK_ARRAY_LIMIT;
+
+  /**
+   * An array on the stack only needs an arena if it may grow, the elements
+   *   are then moved to the arena by the runtime
+   */
+  llvm::Value *_arena =
+      !_on_stack || may_grow(ctx.function_body, lhs.val)
+          ? function_arena(ctx)
+          : llvm::ConstantPointerNull::get(
+                llvm::cast<llvm::PointerType>(ARENA_TYPE));
+
+  if (_on_stack) {
+    llvm::Type *_data_type = llvm::ArrayType::get(_elem_type, _const->val);
+    llvm::Value *_data = create_entry_alloca(_data_type, lhs.val + "_data");
+    BUILDER.CreateMemSet(
+        _data, BUILDER.getInt8(0),
+        _const->val * (_elem_type->getPrimitiveSizeInBits() / 8),
+        llvm::MaybeAlign(8));
+    BUILDER.CreateStore(
+        BUILDER.CreateConstInBoundsGEP2_64(_data_type, _data, 0, 0, "_arr_data"),
+        array_field(_arr, ARRAY_DATA, "_arr_data_ptr"));
+    BUILDER.CreateStore(_size, array_field(_arr, ARRAY_LENGTH, "_arr_len_ptr"));
+    BUILDER.CreateStore(BUILDER.getInt64(-1),
+                        array_field(_arr, ARRAY_CAPACITY, "_arr_cap_ptr"));
+    BUILDER.CreateStore(_arena, array_field(_arr, ARRAY_ARENA, "_arr_arena_ptr"));
+    return _arr_ptr;
+  }
+
+  /**
+   * The elements of any other array are the runtime's, the array is emptied
+   *   once in the entry block so, when redeclared in a loop, the elements
+   *   already allocated are reused
+   */
+  {
+    llvm::IRBuilderBase::InsertPointGuard _guard(BUILDER);
+    set_entry_init_point();
+    BUILDER.CreateStore(
+        llvm::ConstantPointerNull::get(_elem_type->getPointerTo()),
+        array_field(_arr, ARRAY_DATA, "_arr_data_ptr"));
+    BUILDER.CreateStore(BUILDER.getInt64(0),
+                        array_field(_arr, ARRAY_CAPACITY, "_arr_cap_ptr"));
+    BUILDER.CreateStore(_arena, array_field(_arr, ARRAY_ARENA, "_arr_arena_ptr"));
+  }
+
+  if (!size) {
+    BUILDER.CreateStore(BUILDER.getInt64(0),
+                        array_field(_arr, ARRAY_LENGTH, "_arr_len_ptr"));
+  } else {
+    llvm::Function *_array_new = ctx.runtime_function(
+        "sood_array_new",
+        llvm::FunctionType::get(BUILDER.getVoidTy(),
+                                {BYTE_PTR_TYPE, INTEGER_TYPE, INTEGER_TYPE},
+                                false));
+    BUILDER.CreateCall(
+        _array_new,
+        {BUILDER.CreateBitCast(_arr_ptr, BYTE_PTR_TYPE),
+         llvm::ConstantExpr::getSizeOf(_elem_type), _size});
+  }
+
+  return _arr_ptr;
+}
+
+/**
+ * Name: NArrayAssignment::code_generate
+ * Construct: Method
+ * Desc: Stores the value of the RHS (cast to the element type) to the element
+ *   of the array at the index (see `array_element_ptr`)
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ */
+llvm::Value *NArrayAssignment::code_generate(CodeGenContext &ctx) {
+  llvm::Type *_elem_type =
+      element_type_of(std::get<llvm::Type *>(get_array(ctx, lhs.array)));
+  llvm::Value *_elem = array_element_ptr(ctx, lhs);
+  llvm::Value *_rhs = cast_relevantly(rhs.code_generate(ctx),
+                                      std::make_tuple(_elem, _elem_type));
+  return BUILDER.CreateStore(_rhs, _elem);
+}
+
+/**
+ * Name: NAppend::code_generate
+ * Construct: Method
+ * Desc: Appends an element to the end of an array, the runtime grows the
+ *   array's storage if needed and returns a pointer to the new element
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ */
+llvm::Value *NAppend::code_generate(CodeGenContext &ctx) {
+  ValTypeTuple _arr = get_array(ctx, array);
+  llvm::Type *_elem_type = element_type_of(std::get<llvm::Type *>(_arr));
+  llvm::Value *_val = cast_relevantly(exp.code_generate(ctx),
+                                      std::make_tuple(nullptr, _elem_type));
+
+  llvm::Function *_array_push = ctx.runtime_function(
+      "sood_array_push",
+      llvm::FunctionType::get(BYTE_PTR_TYPE, {BYTE_PTR_TYPE, INTEGER_TYPE},
+                              false));
+  llvm::Value *_slot = BUILDER.CreateCall(
+      _array_push,
+      {BUILDER.CreateBitCast(std::get<llvm::Value *>(_arr), BYTE_PTR_TYPE),
+       llvm::ConstantExpr::getSizeOf(_elem_type)},
+      "_arr_slot");
+  return BUILDER.CreateStore(
+      _val, BUILDER.CreateBitCast(_slot, _elem_type->getPointerTo()));
 }
 
 /* ------ constructs ------ */
@@ -521,13 +1499,18 @@ llvm::Value *NFunctionCall::code_generate(CodeGenContext &ctx) {
  * Notes:
  *   - Multiple "else if" blocks will essentially call this function
  *     recursively managing the insert/current blocks each time
+ *   - Chains dispatching on one variable are lowered to a `switch` instead,
+ *     see `NIfStatement::code_generate_switch`
  */
 llvm::Value *NIfStatement::code_generate(CodeGenContext &ctx) {
 
+  if (code_generate_switch(ctx))
+    return nullptr;
+
   llvm::Value *_cond = cond.code_generate(ctx);
   if (!_cond)
     throw CodeGenException("Invalid condition for `if`");
-  _cond = BUILDER.CreateICmpNE(_cond, BUILDER.getInt1(0), "if_cond");
+  _cond = to_condition(_cond, "if_cond");
 
   // Get current block
   llvm::Function *_fn = BUILDER.GetInsertBlock()->getParent();
@@ -559,6 +1542,105 @@ llvm::Value *NIfStatement::code_generate(CodeGenContext &ctx) {
   return nullptr;
 }
 
+/**
+ * Name: switch_case
+ * Construct: Function
+ * Desc: Recognizes the condition of an arm of a dispatch chain, an equality
+ *   test between a variable and an integer literal, in either order
+ * Args:
+ *   - cond: The condition of the `if`/`else if`
+ *   - name: The variable the chain dispatches on, if known, otherwise set to
+ *     the variable of this condition
+ * Returns: The integer literal, or nullptr if not an arm on `name`
+ */
+static NInteger *switch_case(NExpression &cond, std::string &name) {
+  NBinaryExpression *_cmp = dynamic_cast<NBinaryExpression *>(&cond);
+  if (!_cmp || _cmp->op != OP_EQUAL_TO)
+    return nullptr;
+
+  NIdentifier *_ident = dynamic_cast<NIdentifier *>(&_cmp->lhs);
+  NInteger *_case = dynamic_cast<NInteger *>(&_cmp->rhs);
+  if (!_ident || !_case) {
+    _ident = dynamic_cast<NIdentifier *>(&_cmp->rhs);
+    _case = dynamic_cast<NInteger *>(&_cmp->lhs);
+  }
+  if (!_ident || !_case)
+    return nullptr;
+
+  if (name.empty())
+    name = _ident->val;
+  return _ident->val == name ? _case : nullptr;
+}
+
+/**
+ * Name: NIfStatement::code_generate_switch
+ * Construct: Method
+ * Desc: Lowers an "if"/"else if" chain whose conditions all test the same
+ *   integer variable for equality against integer literals into a single
+ *   `switch`, which the backend can turn into a jump table or binary search
+ *   rather than a linear chain of compares
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ * Returns: True if the chain was lowered, false if the caller should fall
+ *   back to the compare chain, in which case nothing has been generated
+ * Notes:
+ *   - The conditions of the chain have no side effects and only one arm runs,
+ *     so the variable is loaded once, before dispatch
+ *   - A repeated literal can never be reached (the earlier arm is taken), so
+ *     its arm is dropped
+ */
+bool NIfStatement::code_generate_switch(CodeGenContext &ctx) {
+  std::string _name;
+  std::vector<std::pair<NInteger *, NBlock *>> _arms;
+  NStatement *_tail = this;
+  while (NIfStatement *_if = dynamic_cast<NIfStatement *>(_tail)) {
+    NInteger *_case = switch_case(_if->cond, _name);
+    if (!_case)
+      break;
+    _arms.emplace_back(_case, &_if->block);
+    _tail = _if->els;
+  }
+  if (_arms.size() < 2 || ctx.locals().find(_name) == ctx.locals().end() ||
+      std::get<llvm::Type *>(ctx.get_local(_name)) != INTEGER_TYPE)
+    return false;
+
+  llvm::Value *_val = NIdentifier(_name).code_generate(ctx);
+  llvm::Function *_fn = BUILDER.GetInsertBlock()->getParent();
+
+  /**
+   * Anything left of the chain, a trailing `else` or an `else if` on some
+   *   other condition, becomes the default
+   */
+  llvm::BasicBlock *_else = llvm::BasicBlock::Create(LLVM_CTX, "if_else");
+  llvm::BasicBlock *_aftr = llvm::BasicBlock::Create(LLVM_CTX, "if_cnt");
+  llvm::SwitchInst *_switch =
+      BUILDER.CreateSwitch(_val, _else, (unsigned)_arms.size());
+
+  for (auto &_arm : _arms) {
+    llvm::ConstantInt *_const =
+        llvm::cast<llvm::ConstantInt>(_arm.first->code_generate(ctx));
+    if (_switch->findCaseValue(_const) != _switch->case_default())
+      continue;
+    llvm::BasicBlock *_then =
+        llvm::BasicBlock::Create(LLVM_CTX, "if_then", _fn);
+    _switch->addCase(_const, _then);
+    BUILDER.SetInsertPoint(_then);
+    if (!_arm.second->code_generate(ctx))
+      throw CodeGenException("Could not generate `then` block");
+    BUILDER.CreateBr(_aftr);
+  }
+
+  BUILDER.SetInsertPoint(_else);
+  _fn->getBasicBlockList().push_back(_else);
+  if (_tail)
+    _tail->code_generate(ctx);
+  BUILDER.CreateBr(_aftr);
+
+  BUILDER.SetInsertPoint(_aftr);
+  _fn->getBasicBlockList().push_back(_aftr);
+  return true;
+}
+
 /**
  * Name: NElseStatement::code_generate
  * Construct: Method
@@ -572,38 +1654,342 @@ llvm::Value *NElseStatement::code_generate(CodeGenContext &ctx) {
 }
 
 /**
- * Name: NWhileStatement::code_generate
- * Construct: Method
- * Desc: Splits to a new block (the conditional block) and branches
- *   conditionally on the truthfulness of the condition (`cond`) to either
- *   the statement's block or to the continuation of the parent block
+ * Name: counted_loop_step
+ * Construct: Function
+ * Desc: Recognizes a counted loop, that is, a loop whose condition compares a
+ *   variable (the induction variable) against an integer, a variable not
+ *   modified by the loop, or the length of an array which does not grow
+ *   within the loop, and whose block ends by incrementing or
+ *   decrementing the induction variable by a constant, e.g.
+ *     while i is less than n,
+ *       ...
+ *       i is i plus 1...
+ *   The final assignment is returned (it is emitted in the loop's latch) or
+ *   `nullptr` if the loop is not a counted loop
+ * Args:
+ *   - cond: The loop's condition
+ *   - block: The loop's block of statements
+ */
+static NAssignment *counted_loop_step(NExpression &cond, NBlock &block) {
+  NBinaryExpression *_cmp = dynamic_cast<NBinaryExpression *>(&cond);
+  if (!_cmp || block.stmts.empty())
+    return nullptr;
+
+  switch (_cmp->op) {
+  case OP_EQUAL_TO:
+  case OP_NOT_EQUAL_TO:
+  case OP_LESS_THAN:
+  case OP_LESS_THAN_EQUAL_TO:
+  case OP_MORE_THAN:
+  case OP_MORE_THAN_EQUAL_TO:
+    break;
+  default:
+    return nullptr;
+  }
+
+  NIdentifier *_iv = dynamic_cast<NIdentifier *>(&_cmp->lhs);
+  if (!_iv)
+    return nullptr;
+
+  NIdentifier *_bound = dynamic_cast<NIdentifier *>(&_cmp->rhs);
+  NLength *_len = dynamic_cast<NLength *>(&_cmp->rhs);
+  NIdentifier *_len_of = _len ? dynamic_cast<NIdentifier *>(&_len->exp) : nullptr;
+  if (_bound) {
+    if (assigns_to(&block, _bound->val))
+      return nullptr;
+  } else if (_len_of) {
+    if (may_grow(&block, _len_of->val))
+      return nullptr;
+  } else if (!dynamic_cast<NInteger *>(&_cmp->rhs)) {
+    return nullptr;
+  }
+
+  NAssignment *_step = dynamic_cast<NAssignment *>(block.stmts.back());
+  if (!_step || _step->lhs.val != _iv->val)
+    return nullptr;
+
+  NBinaryExpression *_inc = dynamic_cast<NBinaryExpression *>(&_step->rhs);
+  if (!_inc || (_inc->op != OP_PLUS && _inc->op != OP_MINUS))
+    return nullptr;
+
+  NIdentifier *_inc_lhs = dynamic_cast<NIdentifier *>(&_inc->lhs);
+  if (!_inc_lhs || _inc_lhs->val != _iv->val ||
+      !dynamic_cast<NInteger *>(&_inc->rhs))
+    return nullptr;
+
+  for (auto it = block.stmts.begin(); it != block.stmts.end() - 1; it++)
+    if (assigns_to(*it, _iv->val))
+      return nullptr;
+
+  return _step;
+}
+
+/**
+ * Name: may_return
+ * Construct: Function
+ * Desc: Whether a node contains a `return`, not descending into nested
+ *   function declarations
+ * Args:
+ *   - node: The node to search
+ */
+static bool may_return(Node *node) {
+  if (dynamic_cast<NFunctionDeclaration *>(node))
+    return false;
+  if (dynamic_cast<NReturnStatement *>(node))
+    return true;
+  for (Node *child : ast_children(*node))
+    if (may_return(child))
+      return true;
+  return false;
+}
+
+/**
+ * Name: collect_indexed_arrays
+ * Construct: Function
+ * Desc: Collects the accesses of arrays indexed by the given variable within
+ *   a node which run whenever the node does, so not those in the blocks of
+ *   nested `if`s and loops, nor in the RHS of a short-circuiting `and` or
+ *   `alternatively`, nor in nested function declarations
+ * Args:
+ *   - node: The node to search
+ *   - index: The name of the index variable
+ *   - accesses: The vector to which the accesses are added
+ */
+static void collect_indexed_arrays(Node *node, const std::string &index,
+                                   std::vector<NArrayIndex *> &accesses) {
+  if (dynamic_cast<NFunctionDeclaration *>(node))
+    return;
+  if (NIfStatement *_if = dynamic_cast<NIfStatement *>(node))
+    return collect_indexed_arrays(&_if->cond, index, accesses);
+  if (NWhileStatement *_while = dynamic_cast<NWhileStatement *>(node))
+    return collect_indexed_arrays(&_while->cond, index, accesses);
+  if (NUntilStatement *_until = dynamic_cast<NUntilStatement *>(node))
+    return collect_indexed_arrays(&_until->cond, index, accesses);
+  NBinaryExpression *_bin = dynamic_cast<NBinaryExpression *>(node);
+  if (_bin && (_bin->op == OP_AND || _bin->op == OP_ALTERNATIVELY))
+    return collect_indexed_arrays(&_bin->lhs, index, accesses);
+  if (NArrayIndex *_idx = dynamic_cast<NArrayIndex *>(node)) {
+    NIdentifier *_ident = dynamic_cast<NIdentifier *>(&_idx->index);
+    if (_ident && _ident->val == index)
+      accesses.push_back(_idx);
+  }
+  for (Node *child : ast_children(*node))
+    collect_indexed_arrays(child, index, accesses);
+}
+
+/**
+ * Name: hoist_bounds_checks
+ * Construct: Function
+ * Desc: For a counted loop whose induction variable only increases towards an
+ *   upper bound, and which cannot return part way through, the bounds of
+ *   each array indexed by the induction variable on every iteration are
+ *   checked once, before the loop, for the whole range of the induction
+ *   variable. As arrays never shrink, those checks within the loop are then
+ *   redundant and are elided (see `bounds_check_elided`), accesses which
+ *   only run on some iterations keep their own checks
  * Args:
  *   - ctx: The CodeGenContext instance
+ *   - cond: The loop's condition
+ *   - block: The loop's block of statements
+ *   - step: The loop's step (see `counted_loop_step`)
+ *   - until: Whether the loop is an `until` loop
+ * Notes:
+ *   - An out of bounds index is therefore reported before the loop's first
+ *     iteration rather than on the iteration which would have used it
  */
-llvm::Value *NWhileStatement::code_generate(CodeGenContext &ctx) {
+static std::vector<NArrayIndex *>
+hoist_bounds_checks(CodeGenContext &ctx, NExpression &cond, NBlock &block,
+                    NAssignment *step, bool until) {
+  std::vector<NArrayIndex *> _proven;
+  if (!step || may_return(&block))
+    return _proven;
+
+  NBinaryExpression *_inc = static_cast<NBinaryExpression *>(&step->rhs);
+  std::int64_t _step = static_cast<NInteger &>(_inc->rhs).val;
+  if (_inc->op != OP_PLUS || _step <= 0)
+    return _proven;
+
+  /** The condition under which the loop continues, `iv < bound` or `<=` */
+  NBinaryExpression *_cmp = static_cast<NBinaryExpression *>(&cond);
+  bool _inclusive;
+  if (_cmp->op == (until ? OP_MORE_THAN_EQUAL_TO : OP_LESS_THAN))
+    _inclusive = false;
+  else if (_cmp->op == (until ? OP_MORE_THAN : OP_LESS_THAN_EQUAL_TO))
+    _inclusive = true;
+  else
+    return _proven;
+
+  std::string _iv = static_cast<NIdentifier &>(_cmp->lhs).val;
+  if (ctx.locals().find(_iv) == ctx.locals().end() ||
+      std::get<llvm::Type *>(ctx.get_local(_iv)) != INTEGER_TYPE)
+    return _proven;
+  NIdentifier *_bound = dynamic_cast<NIdentifier *>(&_cmp->rhs);
+  if (_bound && (ctx.locals().find(_bound->val) == ctx.locals().end() ||
+                 std::get<llvm::Type *>(ctx.get_local(_bound->val)) !=
+                     INTEGER_TYPE))
+    return _proven;
+
+  std::vector<NArrayIndex *> _accesses;
+  for (NStatement *stmt : block.stmts)
+    if (stmt != step)
+      collect_indexed_arrays(stmt, _iv, _accesses);
+
+  std::set<std::string> _arrays;
+  for (NArrayIndex *_access : _accesses) {
+    const std::string &_name = _access->array.val;
+    if (ctx.locals().find(_name) == ctx.locals().end() ||
+        !is_array_type(std::get<llvm::Type *>(ctx.get_local(_name))) ||
+        assigns_to(&block, _name))
+      continue;
+    _arrays.insert(_name);
+    _proven.push_back(_access);
+  }
+  if (_proven.empty())
+    return _proven;
+
+  /**
+   * The last value of the induction variable, stepping from the start, is
+   *   found from the last value allowed by the condition, `bound - 1` or
+   *   `bound`, which (unlike `bound + 1`) cannot overflow while the loop runs
+   */
+  llvm::Value *_start = _cmp->lhs.code_generate(ctx);
+  llvm::Value *_end = _cmp->rhs.code_generate(ctx);
+  llvm::Value *_runs;
+  llvm::Value *_limit;
+  if (_inclusive) {
+    _runs = BUILDER.CreateICmpSLE(_start, _end, "_loop_runs");
+    _limit = _end;
+  } else {
+    _runs = BUILDER.CreateICmpSLT(_start, _end, "_loop_runs");
+    _limit = BUILDER.CreateSub(_end, BUILDER.getInt64(1), "_iv_limit");
+  }
+  llvm::Value *_negative =
+      BUILDER.CreateICmpSLT(_start, BUILDER.getInt64(0), "_iv_negative");
+  llvm::Value *_last = BUILDER.CreateSub(
+      _limit,
+      BUILDER.CreateURem(BUILDER.CreateSub(_limit, _start, "_iv_range"),
+                         BUILDER.getInt64(_step), "_iv_overshoot"),
+      "_iv_last");
+  llvm::Value *_worst = BUILDER.CreateSelect(_negative, _start, _last);
+
+  for (const std::string &_name : _arrays) {
+    llvm::Value *_len = array_length(ctx.get_local(_name));
+    llvm::Value *_fail = BUILDER.CreateAnd(
+        _runs,
+        BUILDER.CreateOr(_negative,
+                         BUILDER.CreateICmpSGE(_last, _len, "_iv_past_end")),
+        "_hoisted_out_of_bounds");
+    bounds_failure(ctx, _fail, _worst, _len);
+  }
+
+  return _proven;
+}
+
+/**
+ * Name: set_loop_metadata
+ * Construct: Function
+ * Desc: Attaches a loop ID (`!llvm.loop`) to the back-edge of a loop, for a
+ *   counted loop, with vectorization enabled, the ID carries a hint for the
+ *   loop vectorizer
+ * Args:
+ *   - back_edge: The branch from the loop's latch to its header
+ *   - vectorize: Whether to add the vectorization hint
+ */
+static void set_loop_metadata(llvm::BranchInst *back_edge, bool vectorize) {
+  llvm::SmallVector<llvm::Metadata *, 2> _ops;
+  _ops.push_back(nullptr); // Self-reference, replaced below
+  if (vectorize)
+    _ops.push_back(llvm::MDNode::get(
+        LLVM_CTX, {llvm::MDString::get(LLVM_CTX, "llvm.loop.vectorize.enable"),
+                   llvm::ConstantAsMetadata::get(BUILDER.getTrue())}));
+  llvm::MDNode *_loop_id = llvm::MDNode::getDistinct(LLVM_CTX, _ops);
+  _loop_id->replaceOperandWith(0, _loop_id);
+  back_edge->setMetadata(llvm::LLVMContext::MD_loop, _loop_id);
+}
+
+/**
+ * Name: loop_code_generate
+ * Construct: Function
+ * Desc: Emits the canonical loop structure shared by `while` and `until`:
+ *     <prefix>_cond:  the header, branches to either the block or the exit
+ *     <prefix>_block: the statements of the loop
+ *     <prefix>_latch: the single back-edge to the header
+ *     <prefix>_aftr:  the exit, continuation of the parent block
+ *   For counted loops (see `counted_loop_step`), the induction variable's step
+ *   is emitted in the latch so the loop takes the shape of a `for` loop, and
+ *   the bounds checks on the induction variable are hoisted out of the loop
+ *   (see `hoist_bounds_checks`)
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - cond: The loop's condition
+ *   - block: The loop's block of statements
+ *   - until: Whether the loop exits when the condition is true (`until`) or
+ *     false (`while`)
+ *   - prefix: The prefix of the names of the loop's blocks
+ */
+static void loop_code_generate(CodeGenContext &ctx, NExpression &cond,
+                               NBlock &block, bool until,
+                               const std::string &prefix) {
   llvm::Function *_fn = BUILDER.GetInsertBlock()->getParent();
-  llvm::BasicBlock *_while =
-      llvm::BasicBlock::Create(LLVM_CTX, "while_cond", _fn);
+  llvm::BasicBlock *_header =
+      llvm::BasicBlock::Create(LLVM_CTX, prefix + "_cond", _fn);
   llvm::BasicBlock *_block =
-      llvm::BasicBlock::Create(LLVM_CTX, "while_block", _fn);
+      llvm::BasicBlock::Create(LLVM_CTX, prefix + "_block", _fn);
+  llvm::BasicBlock *_latch =
+      llvm::BasicBlock::Create(LLVM_CTX, prefix + "_latch", _fn);
   llvm::BasicBlock *_after =
-      llvm::BasicBlock::Create(LLVM_CTX, "while_aftr", _fn);
+      llvm::BasicBlock::Create(LLVM_CTX, prefix + "_aftr", _fn);
 
-  BUILDER.CreateBr(_while);
-  BUILDER.SetInsertPoint(_while);
+  NAssignment *_step = counted_loop_step(cond, block);
+  forget_array_lengths(ctx, &block);
+  std::set<NArrayIndex *> _in_bounds = ctx.in_bounds;
+  for (NArrayIndex *_access :
+       hoist_bounds_checks(ctx, cond, block, _step, until))
+    ctx.in_bounds.insert(_access);
+
+  BUILDER.CreateBr(_header);
+  BUILDER.SetInsertPoint(_header);
   llvm::Value *_cond = cond.code_generate(ctx);
   if (!_cond)
     throw CodeGenException("Invalid condition");
-  _cond = BUILDER.CreateICmpNE(_cond, BUILDER.getInt1(false), "while_cond");
-  BUILDER.CreateCondBr(_cond, _block, _after);
+  _cond = to_condition(_cond, prefix + "_cond");
+  if (until)
+    BUILDER.CreateCondBr(_cond, _after, _block);
+  else
+    BUILDER.CreateCondBr(_cond, _block, _after);
 
   BUILDER.SetInsertPoint(_block);
-  if (!block.code_generate(ctx))
-    throw CodeGenException("Invalid while block");
-  BUILDER.CreateBr(_while);
+  for (NStatement *stmt : block.stmts) {
+    if (stmt == _step)
+      continue;
+    ctx.set_debug_location(*stmt);
+    stmt->code_generate(ctx);
+  }
+  BUILDER.CreateBr(_latch);
+  ctx.in_bounds = _in_bounds;
+
+  BUILDER.SetInsertPoint(_latch);
+  if (_step) {
+    ctx.set_debug_location(*_step);
+    _step->code_generate(ctx);
+  }
+  set_loop_metadata(BUILDER.CreateBr(_header), _step && ctx.vectorize);
 
   BUILDER.SetInsertPoint(_after);
+}
 
+/**
+ * Name: NWhileStatement::code_generate
+ * Construct: Method
+ * Desc: Splits to a new block (the conditional block) and branches
+ *   conditionally on the truthfulness of the condition (`cond`) to either
+ *   the statement's block or to the continuation of the parent block (see
+ *   `loop_code_generate`)
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ */
+llvm::Value *NWhileStatement::code_generate(CodeGenContext &ctx) {
+  loop_code_generate(ctx, cond, block, false, "while");
   return nullptr;
 }
 
@@ -612,33 +1998,12 @@ llvm::Value *NWhileStatement::code_generate(CodeGenContext &ctx) {
  * Construct: Method
  * Desc: Splits to a new block (the conditional block) and branches
  *   conditionally on the falsity of the condition (`cond`) to either the
- *   statement's block or to the continuation of the parent block
+ *   statement's block or to the continuation of the parent block (see
+ *   `loop_code_generate`)
  * Args:
  *   - ctx: The CodeGenContext instance
  */
 llvm::Value *NUntilStatement::code_generate(CodeGenContext &ctx) {
-  llvm::Function *_fn = BUILDER.GetInsertBlock()->getParent();
-  llvm::BasicBlock *_until =
-      llvm::BasicBlock::Create(LLVM_CTX, "until_cond", _fn);
-  llvm::BasicBlock *_block =
-      llvm::BasicBlock::Create(LLVM_CTX, "until_block", _fn);
-  llvm::BasicBlock *_after =
-      llvm::BasicBlock::Create(LLVM_CTX, "until_aftr", _fn);
-
-  BUILDER.CreateBr(_until);
-  BUILDER.SetInsertPoint(_until);
-  llvm::Value *_cond = cond.code_generate(ctx);
-  if (!_cond)
-    throw CodeGenException("Invalid condition");
-  _cond = BUILDER.CreateICmpNE(_cond, BUILDER.getInt1(true), "until_cond");
-  BUILDER.CreateCondBr(_cond, _block, _after);
-
-  BUILDER.SetInsertPoint(_block);
-  if (!block.code_generate(ctx))
-    throw CodeGenException("Invalid until block");
-  BUILDER.CreateBr(_until);
-
-  BUILDER.SetInsertPoint(_after);
-
+  loop_code_generate(ctx, cond, block, true, "until");
   return nullptr;
 }
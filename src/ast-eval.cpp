@@ -0,0 +1,329 @@
+#include "ast-eval.hpp"
+#include "ast.hpp"
+
+/**
+ * Name: src/ast-eval.cpp
+ * Construct: Module
+ * Desc: An evaluator of the AST, used by the code generator to run a call
+ *   whose arguments are all literals at compile time and use its result in
+ *   place of the call (see `NFunctionCall::code_generate`). Only the pure,
+ *   numeric part of the language is evaluated, a call which writes, reads,
+ *   uses a string or array, or runs past the step or depth limits is left to
+ *   run as usual
+ * Notes:
+ *   - Each operation is evaluated as the code generated for it computes it,
+ *     including its conversions, anything whose result is undefined there
+ *     (e.g. a division by zero) stops the evaluation
+ *   - The tiered runner (see src/tiered.cpp) extends the evaluator to whole
+ *     programs
+ */
+
+/** The kind of value of a variable of the given type */
+static EvalValue::Kind kind_of(const NIdentifier &type) {
+  if (type.val == "integer")
+    return EvalValue::INTEGER;
+  if (type.val == "float")
+    return EvalValue::FLOAT;
+  throw EvalAbort();
+}
+
+EvalValue EvalValue::integer(std::int64_t i) {
+  return {EvalValue::INTEGER, i, 0.0, "", nullptr};
+}
+
+EvalValue EvalValue::floating(double f) {
+  return {EvalValue::FLOAT, 0, f, "", nullptr};
+}
+
+EvalValue EvalValue::boolean(bool b) {
+  return {EvalValue::BOOLEAN, b, 0.0, "", nullptr};
+}
+
+EvalValue EvalValue::text(const std::string &s) {
+  return {EvalValue::STRING, 0, 0.0, s, nullptr};
+}
+
+/**
+ * Name: convert
+ * Construct: Function
+ * Desc: Converts a value assigned to a variable of the given kind, as
+ *   `cast_relevantly` does, integers become floats (unsigned) and floats are
+ *   truncated to integers
+ * Args:
+ *   - value: The value assigned
+ *   - kind: The kind of the variable
+ */
+EvalValue convert(EvalValue value, EvalValue::Kind kind) {
+  if (value.kind == kind)
+    return value;
+  if (value.kind == EvalValue::INTEGER && kind == EvalValue::FLOAT)
+    return EvalValue::floating((double)(std::uint64_t)value.i);
+  if (value.kind == EvalValue::FLOAT && kind == EvalValue::INTEGER) {
+    /** Out of range, the conversion's result is undefined */
+    if (!(value.f > -9223372036854775809.0 && value.f < 9223372036854775808.0))
+      throw EvalAbort();
+    return EvalValue::integer((std::int64_t)value.f);
+  }
+  throw EvalAbort();
+}
+
+/** Counts a step, abandoning the evaluation past its limit */
+void Evaluator::step() {
+  if (++steps > step_limit)
+    throw EvalAbort();
+}
+
+/**
+ * Name: Evaluator::call
+ * Construct: Method
+ * Desc: Evaluates a call of a function, binding its arguments as the
+ *   arguments of a call are passed, without conversion
+ * Args:
+ *   - fn: The function called
+ *   - args: The values of the arguments
+ */
+EvalValue Evaluator::call(NFunctionDeclaration &fn,
+                          const std::vector<EvalValue> &args) {
+  EvalValue::Kind _kind = kind_of(fn.type);
+  if (args.size() != fn.args.size() || ++depth > depth_limit)
+    throw EvalAbort();
+
+  std::map<std::string, EvalValue> _locals;
+  for (std::size_t i = 0; i < args.size(); i++) {
+    if (args[i].kind != kind_of(fn.args[i]->type))
+      throw EvalAbort();
+    _locals[fn.args[i]->lhs.val] = args[i];
+  }
+  std::swap(_locals, locals);
+
+  run(fn.block);
+
+  /** Running off the end of a function, its result is undefined */
+  if (!returned || return_value.kind != _kind)
+    throw EvalAbort();
+  returned = false;
+  std::swap(_locals, locals);
+  depth--;
+  return return_value;
+}
+
+/**
+ * Name: Evaluator::eval
+ * Construct: Method
+ * Desc: Evaluates an expression
+ * Args:
+ *   - exp: The expression
+ */
+EvalValue Evaluator::eval(NExpression &exp) {
+  step();
+  if (NInteger *_int = dynamic_cast<NInteger *>(&exp))
+    return EvalValue::integer(_int->val);
+  if (NFloat *_float = dynamic_cast<NFloat *>(&exp))
+    return EvalValue::floating(_float->val);
+  if (NIdentifier *_ident = dynamic_cast<NIdentifier *>(&exp)) {
+    auto it = locals.find(_ident->val);
+    if (it == locals.end())
+      throw EvalAbort();
+    return it->second;
+  }
+  if (NBinaryExpression *_bin = dynamic_cast<NBinaryExpression *>(&exp))
+    return binary(*_bin);
+  if (NFunctionCall *_call = dynamic_cast<NFunctionCall *>(&exp)) {
+    auto it = functions.find(_call->id.val);
+    if (it == functions.end())
+      throw EvalAbort();
+    std::vector<EvalValue> _args;
+    for (NExpression *arg : _call->args)
+      _args.push_back(eval(*arg));
+    return call(*it->second, _args);
+  }
+  throw EvalAbort();
+}
+
+/**
+ * Name: Evaluator::condition
+ * Construct: Method
+ * Desc: Evaluates the condition of an `if` or loop, or an operand of `and`
+ *   or `alternatively`, as `to_condition` does
+ * Args:
+ *   - exp: The condition
+ */
+bool Evaluator::condition(NExpression &exp) {
+  EvalValue _value = eval(exp);
+  if (_value.kind == EvalValue::FLOAT)
+    return _value.f < 0.0 || _value.f > 0.0;
+  return _value.i != 0;
+}
+
+/**
+ * Name: Evaluator::binary
+ * Construct: Method
+ * Desc: Evaluates a binary operation as `NBinaryExpression::code_generate`
+ *   does, converting an integer operand to a float (unsigned) if the other is
+ *   a float
+ * Args:
+ *   - exp: The binary expression
+ * Notes:
+ *   - Integers wrap on overflow, and only integers have arithmetic
+ *   - Strings are concatenated or compared, as `string_binary_operation`
+ *     does, only with strings
+ */
+EvalValue Evaluator::binary(NBinaryExpression &exp) {
+  if (exp.op == OP_AND)
+    return EvalValue::boolean(condition(exp.lhs) && condition(exp.rhs));
+  if (exp.op == OP_ALTERNATIVELY)
+    return EvalValue::boolean(condition(exp.lhs) || condition(exp.rhs));
+
+  EvalValue _lhs = eval(exp.lhs);
+  EvalValue _rhs = eval(exp.rhs);
+  if (_lhs.kind == EvalValue::STRING && _rhs.kind == EvalValue::STRING) {
+    switch (exp.op) {
+    case OP_PLUS:
+      return EvalValue::text(_lhs.s + _rhs.s);
+    case OP_EQUAL_TO:
+      return EvalValue::boolean(_lhs.s == _rhs.s);
+    case OP_NOT_EQUAL_TO:
+      return EvalValue::boolean(_lhs.s != _rhs.s);
+    default:
+      throw EvalAbort();
+    }
+  }
+  if (_lhs.kind != EvalValue::INTEGER && _lhs.kind != EvalValue::FLOAT)
+    throw EvalAbort();
+  if (_rhs.kind != EvalValue::INTEGER && _rhs.kind != EvalValue::FLOAT)
+    throw EvalAbort();
+  if (_lhs.kind == EvalValue::FLOAT || _rhs.kind == EvalValue::FLOAT) {
+    double _l = convert(_lhs, EvalValue::FLOAT).f;
+    double _r = convert(_rhs, EvalValue::FLOAT).f;
+    switch (exp.op) {
+    case OP_EQUAL_TO:
+      return EvalValue::boolean(_l == _r);
+    case OP_NOT_EQUAL_TO:
+      return EvalValue::boolean(_l < _r || _l > _r);
+    case OP_LESS_THAN:
+      return EvalValue::boolean(_l < _r);
+    case OP_LESS_THAN_EQUAL_TO:
+      return EvalValue::boolean(_l <= _r);
+    case OP_MORE_THAN:
+      return EvalValue::boolean(_l > _r);
+    case OP_MORE_THAN_EQUAL_TO:
+      return EvalValue::boolean(_l >= _r);
+    default:
+      throw EvalAbort();
+    }
+  }
+
+  std::uint64_t _l = _lhs.i, _r = _rhs.i;
+  switch (exp.op) {
+  case OP_PLUS:
+    return EvalValue::integer(_l + _r);
+  case OP_MINUS:
+    return EvalValue::integer(_l - _r);
+  case OP_MULTIPLIED_BY:
+    return EvalValue::integer(_l * _r);
+  case OP_DIVIDED_BY:
+  case OP_MODULO:
+    if (_rhs.i == 0 || (_lhs.i == INT64_MIN && _rhs.i == -1))
+      throw EvalAbort();
+    return EvalValue::integer(exp.op == OP_DIVIDED_BY ? _lhs.i / _rhs.i
+                                                      : _lhs.i % _rhs.i);
+  case OP_EQUAL_TO:
+    return EvalValue::boolean(_lhs.i == _rhs.i);
+  case OP_NOT_EQUAL_TO:
+    return EvalValue::boolean(_lhs.i != _rhs.i);
+  case OP_LESS_THAN:
+    return EvalValue::boolean(_lhs.i < _rhs.i);
+  case OP_LESS_THAN_EQUAL_TO:
+    return EvalValue::boolean(_lhs.i <= _rhs.i);
+  case OP_MORE_THAN:
+    return EvalValue::boolean(_lhs.i > _rhs.i);
+  case OP_MORE_THAN_EQUAL_TO:
+    return EvalValue::boolean(_lhs.i >= _rhs.i);
+  default:
+    throw EvalAbort();
+  }
+}
+
+/** Runs the statements of a block until one returns */
+void Evaluator::run(NBlock &block) {
+  for (NStatement *stmt : block.stmts) {
+    run(*stmt);
+    if (returned)
+      return;
+  }
+}
+
+/**
+ * Name: Evaluator::run
+ * Construct: Method
+ * Desc: Runs a statement, any statement with an effect outside of the
+ *   function's variables abandons the evaluation
+ * Args:
+ *   - stmt: The statement
+ */
+void Evaluator::run(NStatement &stmt) {
+  step();
+  if (NReturnStatement *_ret = dynamic_cast<NReturnStatement *>(&stmt)) {
+    return_value = eval(_ret->exp);
+    returned = true;
+  } else if (NVariableDeclaration *_decl =
+                 dynamic_cast<NVariableDeclaration *>(&stmt)) {
+    EvalValue::Kind _kind = kind_of(_decl->type);
+    EvalValue _value = _kind == EvalValue::FLOAT ? EvalValue::floating(0.0)
+                                                 : EvalValue::integer(0);
+    /** An initializer is stored without conversion */
+    if (_decl->rhs) {
+      _value = eval(*_decl->rhs);
+      if (_value.kind != _kind)
+        throw EvalAbort();
+    }
+    locals[_decl->lhs.val] = _value;
+  } else if (NAssignment *_assign = dynamic_cast<NAssignment *>(&stmt)) {
+    auto it = locals.find(_assign->lhs.val);
+    if (it == locals.end())
+      throw EvalAbort();
+    it->second = convert(eval(_assign->rhs), it->second.kind);
+  } else if (NExpressionStatement *_exp =
+                 dynamic_cast<NExpressionStatement *>(&stmt)) {
+    eval(_exp->exp);
+  } else if (NIfStatement *_if = dynamic_cast<NIfStatement *>(&stmt)) {
+    if (condition(_if->cond))
+      run(_if->block);
+    else if (_if->els)
+      run(*_if->els);
+  } else if (NElseStatement *_else = dynamic_cast<NElseStatement *>(&stmt)) {
+    run(_else->block);
+  } else if (NWhileStatement *_while = dynamic_cast<NWhileStatement *>(&stmt)) {
+    while (!returned && condition(_while->cond))
+      run(_while->block);
+  } else if (NUntilStatement *_until = dynamic_cast<NUntilStatement *>(&stmt)) {
+    while (!returned && !condition(_until->cond))
+      run(_until->block);
+  } else {
+    throw EvalAbort();
+  }
+}
+
+/**
+ * Name: evaluate_call
+ * Construct: Function
+ * Desc: Evaluates a call of a function at compile time
+ * Args:
+ *   - functions: The functions declared so far, which the call may call
+ *   - fn: The function called
+ *   - args: The values of the call's arguments
+ *   - result: Set to the value the call returns
+ * Returns: Whether the call was evaluated, it is not if it has any effect
+ *   other than its result, uses a value other than a number, or runs for more
+ *   than `EVAL_STEP_LIMIT` steps or `EVAL_DEPTH_LIMIT` nested calls
+ */
+bool evaluate_call(const std::map<std::string, NFunctionDeclaration *> &functions,
+                   NFunctionDeclaration &fn, const std::vector<EvalValue> &args,
+                   EvalValue &result) {
+  try {
+    result = Evaluator(functions).call(fn, args);
+    return true;
+  } catch (EvalAbort &) {
+    return false;
+  }
+}
@@ -0,0 +1,161 @@
+#include "ast.hpp"
+
+/**
+ * Name: src/ast-walk.cpp
+ * Construct: Module
+ * Desc: Generic traversal of the AST, the analyses over the AST (for example,
+ *   the recognition of counted loops) use this rather than each knowing the
+ *   members of every node
+ */
+
+/**
+ * Name: ast_children
+ * Construct: Function
+ * Desc: The direct children of a node, in source order. Identifiers which
+ *   only name something (the type of a declaration, the name of a called
+ *   function) are not included, identifiers used as values are
+ * Args:
+ *   - node: The node whose children to return
+ */
+std::vector<Node *> ast_children(Node &node) {
+  std::vector<Node *> children;
+
+  if (NBlock *block = dynamic_cast<NBlock *>(&node)) {
+    for (NStatement *stmt : block->stmts)
+      children.push_back(stmt);
+  } else if (NFunctionCall *call = dynamic_cast<NFunctionCall *>(&node)) {
+    for (NExpression *arg : call->args)
+      children.push_back(arg);
+  } else if (NUnaryExpression *un = dynamic_cast<NUnaryExpression *>(&node)) {
+    children.push_back(&un->rhs);
+  } else if (NBinaryExpression *bin = dynamic_cast<NBinaryExpression *>(&node)) {
+    children.push_back(&bin->lhs);
+    children.push_back(&bin->rhs);
+  } else if (NArrayIndex *idx = dynamic_cast<NArrayIndex *>(&node)) {
+    children.push_back(&idx->array);
+    children.push_back(&idx->index);
+  } else if (NLength *len = dynamic_cast<NLength *>(&node)) {
+    children.push_back(&len->exp);
+  } else if (NAssignment *assign = dynamic_cast<NAssignment *>(&node)) {
+    children.push_back(&assign->lhs);
+    children.push_back(&assign->rhs);
+  } else if (NArrayAssignment *assign =
+                 dynamic_cast<NArrayAssignment *>(&node)) {
+    children.push_back(&assign->lhs);
+    children.push_back(&assign->rhs);
+  } else if (NAppend *append = dynamic_cast<NAppend *>(&node)) {
+    children.push_back(&append->exp);
+    children.push_back(&append->array);
+  } else if (NRead *read = dynamic_cast<NRead *>(&node)) {
+    children.push_back(&read->from);
+    children.push_back(&read->to);
+  } else if (NWrite *write = dynamic_cast<NWrite *>(&node)) {
+    children.push_back(&write->exp);
+  } else if (NReturnStatement *ret = dynamic_cast<NReturnStatement *>(&node)) {
+    children.push_back(&ret->exp);
+  } else if (NExpressionStatement *exp_stmt =
+                 dynamic_cast<NExpressionStatement *>(&node)) {
+    children.push_back(&exp_stmt->exp);
+  } else if (NVariableDeclaration *decl =
+                 dynamic_cast<NVariableDeclaration *>(&node)) {
+    if (decl->rhs)
+      children.push_back(decl->rhs);
+  } else if (NArrayDeclaration *decl =
+                 dynamic_cast<NArrayDeclaration *>(&node)) {
+    if (decl->size)
+      children.push_back(decl->size);
+  } else if (NUntilStatement *until = dynamic_cast<NUntilStatement *>(&node)) {
+    children.push_back(&until->cond);
+    children.push_back(&until->block);
+  } else if (NWhileStatement *whl = dynamic_cast<NWhileStatement *>(&node)) {
+    children.push_back(&whl->cond);
+    children.push_back(&whl->block);
+  } else if (NElseStatement *els = dynamic_cast<NElseStatement *>(&node)) {
+    children.push_back(&els->block);
+  } else if (NIfStatement *ifs = dynamic_cast<NIfStatement *>(&node)) {
+    children.push_back(&ifs->cond);
+    children.push_back(&ifs->block);
+    if (ifs->els)
+      children.push_back(ifs->els);
+  } else if (NFunctionDeclaration *fn =
+                 dynamic_cast<NFunctionDeclaration *>(&node)) {
+    for (NVariableDeclaration *arg : fn->args)
+      children.push_back(arg);
+    children.push_back(&fn->block);
+  }
+
+  return children;
+}
+
+/**
+ * Name: delete_ast
+ * Construct: Function
+ * Desc: Deletes a subtree, as the nodes don't own their children each is
+ *   deleted here, the identifiers which only name something included
+ * Args:
+ *   - node: The root of the subtree
+ */
+void delete_ast(Node *node) {
+  std::vector<Node *> children = ast_children(*node);
+  if (NFunctionCall *call = dynamic_cast<NFunctionCall *>(node)) {
+    children.push_back(&call->id);
+  } else if (NVariableDeclaration *decl =
+                 dynamic_cast<NVariableDeclaration *>(node)) {
+    children.push_back(const_cast<NIdentifier *>(&decl->type));
+    children.push_back(&decl->lhs);
+  } else if (NArrayDeclaration *decl =
+                 dynamic_cast<NArrayDeclaration *>(node)) {
+    children.push_back(const_cast<NIdentifier *>(&decl->type));
+    children.push_back(&decl->lhs);
+  } else if (NFunctionDeclaration *fn =
+                 dynamic_cast<NFunctionDeclaration *>(node)) {
+    children.push_back(const_cast<NIdentifier *>(&fn->type));
+    children.push_back(&fn->id);
+  } else if (NImport *imp = dynamic_cast<NImport *>(node)) {
+    children.push_back(&imp->name);
+  }
+  delete node;
+  for (Node *child : children)
+    delete_ast(child);
+}
+
+/**
+ * Name: assigns_to
+ * Construct: Function
+ * Desc: Whether a node, or any node nested within it, assigns to (or
+ *   redeclares) the variable of the given name, used by both back ends
+ * Args:
+ *   - node: The node to search
+ *   - name: The name of the variable
+ */
+bool assigns_to(Node *node, const std::string &name) {
+  if (NAssignment *_assign = dynamic_cast<NAssignment *>(node))
+    return _assign->lhs.val == name;
+  if (NVariableDeclaration *_decl = dynamic_cast<NVariableDeclaration *>(node))
+    return _decl->lhs.val == name;
+  if (NArrayDeclaration *_decl = dynamic_cast<NArrayDeclaration *>(node))
+    return _decl->lhs.val == name;
+  if (NAppend *_append = dynamic_cast<NAppend *>(node))
+    return _append->array.val == name;
+  for (Node *child : ast_children(*node))
+    if (assigns_to(child, name))
+      return true;
+  return false;
+}
+
+/**
+ * Name: mentions
+ * Construct: Function
+ * Desc: Whether the variable of the given name is used within a node
+ * Args:
+ *   - node: The node to search
+ *   - name: The name of the variable
+ */
+bool mentions(Node *node, const std::string &name) {
+  if (NIdentifier *_ident = dynamic_cast<NIdentifier *>(node))
+    return _ident->val == name;
+  for (Node *child : ast_children(*node))
+    if (mentions(child, name))
+      return true;
+  return false;
+}
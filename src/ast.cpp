@@ -40,6 +40,35 @@ void NAssignment::print(std::ostream &out) const {
   out << '\n' << indt.indent() << "}" << '\n';
 }
 
+void NAppend::print(std::ostream &out) const {
+  out << indt.indent() << "append { exp: " << exp << ", to: " << array << " }"
+      << '\n';
+}
+
+void NArrayAssignment::print(std::ostream &out) const {
+  out << indt.indent() << "array_assignment {" << '\n';
+  indt.inc();
+  out << indt.indent() << "lhs: " << lhs << "," << '\n';
+  out << indt.indent() << "rhs: " << rhs;
+  indt.dec();
+  out << '\n' << indt.indent() << "}" << '\n';
+}
+
+void NArrayDeclaration::print(std::ostream &out) const {
+  out << indt.indent() << "array_decl { type: " << type << ", lhs: " << lhs;
+  if (size) {
+    out << ", size: ";
+    indt.inc(2);
+    out << *size;
+    indt.dec(2);
+  }
+  out << " }" << '\n';
+}
+
+void NArrayIndex::print(std::ostream &out) const {
+  out << "array_index { array: " << array << ", index: " << index << " }";
+}
+
 void NBinaryExpression::print(std::ostream &out) const {
   out << "binary_expression {" << '\n';
   indt.inc();
@@ -147,6 +176,10 @@ void NIdentifier::print(std::ostream &out) const {
   out << "ident(" << val << ")";
 }
 
+void NImport::print(std::ostream &out) const {
+  out << indt.indent() << "import { name: " << name << " }" << '\n';
+}
+
 void NInteger::print(std::ostream &out) const { out << "int(" << val << ")"; }
 
 void NRead::print(std::ostream &out) const {
@@ -159,6 +192,10 @@ void NWrite::print(std::ostream &out) const {
       << '\n';
 }
 
+void NLength::print(std::ostream &out) const {
+  out << "length { exp: " << exp << " }";
+}
+
 void NReturnStatement::print(std::ostream &out) const {
   out << indt.indent() << "return { exp: " << exp << " }" << '\n';
 }
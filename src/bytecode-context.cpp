@@ -0,0 +1,691 @@
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <spdlog/spdlog.h>
+#include <sstream>
+#include <stdexcept>
+
+#include "ast.hpp"
+#include "bytecode.hpp"
+#include "codegen.hpp"
+
+/**
+ * Name: src/bytecode-context.cpp
+ * Construct: Module
+ * Desc: The bytecode back end (`--bytecode`), an alternative to LLVM for
+ *   programs whose compile would take longer than their run. The AST is
+ *   lowered, in a single pass (see src/ast-bytecode.cpp), to a register
+ *   bytecode ran by the VM of src/bytecode-vm.cpp. This is the context of
+ *   that pass, and the bytecode's file format (`--emit-bytecode`, `.sbc`
+ *   files), which is:
+ *   - A header (see `SbcHeader`)
+ *   - The constants, each 64 bits
+ *   - The string literals, each a 32-bit length followed by its bytes
+ *   - The functions, each its name (as a string), a 32-bit count of its
+ *     parameters followed by their types, its result type, registers, 32-bit
+ *     counts of its string and array registers each followed by them, and a
+ *     32-bit count of its instructions followed by them, each 64 bits of
+ *     `op | a << 8 | b << 24 | c << 40`
+ * Notes:
+ *   - The words are in the byte order of the host, a file of the other byte
+ *     order is rejected by its magic number
+ *   - The types of the registers aren't recorded, so a file is only checked
+ *     for being well formed (see `verify_bytecode`), it is trusted to be
+ *     the compiler's as much as object code would be
+ */
+
+/** "SBC\0" as read on a little-endian host */
+static const std::uint32_t SBC_MAGIC = 0x00434253;
+
+/**
+ * Name: SbcHeader
+ * Construct: Struct
+ * Desc: The start of a bytecode file
+ * Members:
+ *   - magic, version: `SBC_MAGIC` and `BC_VERSION`
+ *   - constants, strings, functions: The number of each
+ */
+struct SbcHeader {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t constants;
+  std::uint32_t strings;
+  std::uint32_t functions;
+};
+
+/* -------- Operands -------- */
+
+/** The names of the instructions, in the order of `BYTECODE_OPS` */
+static const char *OP_NAMES[BC_OP_COUNT] = {
+    "MOVE",          "CONST",         "STRING",        "INT_TO_FLOAT",
+    "FLOAT_TO_INT",  "ADD",           "SUB",           "MUL",
+    "DIV",           "MOD",           "FADD",          "FSUB",
+    "FMUL",          "FDIV",          "FMOD",          "NEG",
+    "FNEG",          "NOT",           "EQ",            "NE",
+    "LT",            "LE",            "GT",            "GE",
+    "FEQ",           "FNE",           "FLT",           "FLE",
+    "FGT",           "FGE",           "JUMP",          "JUMP_IF",
+    "JUMP_IF_NOT",   "JUMP_EQ",       "JUMP_NE",       "JUMP_LT",
+    "JUMP_LE",       "JUMP_GT",       "JUMP_GE",       "CALL",
+    "TAIL_CALL",     "RETURN",        "RETURN_STRING", "RETURN_VOID",
+    "UNREACHABLE",   "STRING_ASSIGN", "STRING_APPEND", "STRING_CONCAT",
+    "STRING_EQ",     "STRING_NE",     "STRING_LENGTH", "ARRAY_NEW",
+    "ARRAY_CLEAR",   "ARRAY_GET",     "ARRAY_SET",     "ARRAY_PUSH",
+    "ARRAY_LENGTH",  "WRITE_INTEGER", "WRITE_STRING",
+};
+
+/** The name of an instruction */
+const char *bytecode_op_name(BYTECODE_OPS op) { return OP_NAMES[op]; }
+
+/**
+ * Name: bytecode_operands
+ * Construct: Function
+ * Desc: What each of the operands `a`, `b`, and `c` of an instruction is,
+ *   used to print, check, and rewrite instructions without knowing each
+ * Args:
+ *   - op: The instruction
+ */
+const BYTECODE_OPERANDS *bytecode_operands(BYTECODE_OPS op) {
+  static const BYTECODE_OPERANDS NONE[3] = {BO_NONE, BO_NONE, BO_NONE};
+  static const BYTECODE_OPERANDS UNARY[3] = {BO_DEST, BO_REG, BO_NONE};
+  static const BYTECODE_OPERANDS BINARY[3] = {BO_DEST, BO_REG, BO_REG};
+  static const BYTECODE_OPERANDS CONST[3] = {BO_DEST, BO_NONE, BO_CONST};
+  static const BYTECODE_OPERANDS LITERAL[3] = {BO_DEST, BO_NONE, BO_LITERAL};
+  static const BYTECODE_OPERANDS JUMP[3] = {BO_NONE, BO_NONE, BO_TARGET};
+  static const BYTECODE_OPERANDS JUMP_IF[3] = {BO_REG, BO_NONE, BO_TARGET};
+  static const BYTECODE_OPERANDS JUMP_CMP[3] = {BO_REG, BO_REG, BO_TARGET};
+  static const BYTECODE_OPERANDS CALL[3] = {BO_DEST, BO_REG, BO_FUNCTION};
+  static const BYTECODE_OPERANDS TAIL_CALL[3] = {BO_NONE, BO_REG, BO_FUNCTION};
+  static const BYTECODE_OPERANDS USE[3] = {BO_REG, BO_NONE, BO_NONE};
+  static const BYTECODE_OPERANDS USE_TWO[3] = {BO_REG, BO_REG, BO_NONE};
+  static const BYTECODE_OPERANDS USE_THREE[3] = {BO_REG, BO_REG, BO_REG};
+
+  switch (op) {
+  case BC_CONST:
+    return CONST;
+  case BC_STRING:
+    return LITERAL;
+  case BC_MOVE:
+  case BC_INT_TO_FLOAT:
+  case BC_FLOAT_TO_INT:
+  case BC_NEG:
+  case BC_FNEG:
+  case BC_NOT:
+  case BC_STRING_LENGTH:
+  case BC_ARRAY_LENGTH:
+    return UNARY;
+  case BC_JUMP:
+    return JUMP;
+  case BC_JUMP_IF:
+  case BC_JUMP_IF_NOT:
+    return JUMP_IF;
+  case BC_JUMP_EQ:
+  case BC_JUMP_NE:
+  case BC_JUMP_LT:
+  case BC_JUMP_LE:
+  case BC_JUMP_GT:
+  case BC_JUMP_GE:
+    return JUMP_CMP;
+  case BC_CALL:
+    return CALL;
+  case BC_TAIL_CALL:
+    return TAIL_CALL;
+  case BC_RETURN:
+  case BC_RETURN_STRING:
+  case BC_ARRAY_CLEAR:
+  case BC_WRITE_INTEGER:
+  case BC_WRITE_STRING:
+    return USE;
+  /** A string or array is changed through its register, not the register */
+  case BC_STRING_ASSIGN:
+  case BC_STRING_APPEND:
+  case BC_ARRAY_NEW:
+  case BC_ARRAY_PUSH:
+    return USE_TWO;
+  case BC_STRING_CONCAT:
+  case BC_ARRAY_SET:
+    return USE_THREE;
+  case BC_RETURN_VOID:
+  case BC_UNREACHABLE:
+  case BC_OP_COUNT:
+    return NONE;
+  default:
+    return BINARY;
+  }
+}
+
+/* -------- Generation -------- */
+
+/**
+ * Name: BytecodeContext::emit
+ * Construct: Method
+ * Desc: Appends an instruction to the current function, returning its index
+ * Args:
+ *   - op: The instruction
+ *   - a, b, c: Its operands
+ */
+std::uint32_t BytecodeContext::emit(BYTECODE_OPS op, std::uint32_t a,
+                                    std::uint32_t b, std::uint32_t c) {
+  std::vector<Instruction> &_code = function().code;
+  if (_code.size() > BC_MAX_OPERAND)
+    throw CodeGenException("Function " + function().name +
+                           " is too large for the bytecode");
+  Instruction _inst;
+  _inst.op = op;
+  _inst.a = a;
+  _inst.b = b;
+  _inst.c = c;
+  _code.push_back(_inst);
+  at_label = false;
+  return _code.size() - 1;
+}
+
+/** The index of the next instruction, which becomes a jump target */
+std::uint32_t BytecodeContext::label() {
+  at_label = true;
+  return function().code.size();
+}
+
+/** Sets the target of a jump emitted before its target was known */
+void BytecodeContext::patch(std::uint32_t jump, std::uint32_t target) {
+  function().code[jump].c = target;
+}
+
+/**
+ * Name: BytecodeContext::retarget
+ * Construct: Method
+ * Desc: Makes the instruction which computed a temporary write to another
+ *   register instead, so `x is x plus 1` is a single `ADD` rather than an
+ *   `ADD` and a `MOVE`
+ * Args:
+ *   - value: The temporary
+ *   - reg: The register it's wanted in
+ * Returns: Whether the instruction was changed, otherwise a `MOVE` is needed
+ */
+bool BytecodeContext::retarget(BytecodeValue value, std::uint32_t reg) {
+  std::vector<Instruction> &_code = function().code;
+  if (!value.temporary || at_label || _code.empty())
+    return false;
+  Instruction &_last = _code.back();
+  if (bytecode_operands(BYTECODE_OPS(_last.op))[0] != BO_DEST ||
+      _last.a != value.reg)
+    return false;
+  _last.a = reg;
+  return true;
+}
+
+/**
+ * Name: BytecodeContext::tail_call
+ * Construct: Method
+ * Desc: Makes the call which computed a value about to be returned a
+ *   `TAIL_CALL`, so recursion in return position, as of
+ *   tests/tail-recursion.sood, runs in constant space as it does when
+ *   compiled with LLVM
+ * Args:
+ *   - value: The value returned
+ * Returns: Whether the call was changed, otherwise the value is returned
+ * Notes:
+ *   - The callee's frame replaces the caller's, so a string or array passed
+ *     to it, which may be the caller's own, rules it out
+ */
+bool BytecodeContext::tail_call(BytecodeValue value) {
+  std::vector<Instruction> &_code = function().code;
+  if (!value.temporary || at_label || _code.empty())
+    return false;
+  Instruction &_last = _code.back();
+  if (_last.op != BC_CALL || _last.a != value.reg)
+    return false;
+  const BytecodeFunction &_callee = module.functions[_last.c];
+  if (_callee.ret != function().ret)
+    return false;
+  for (BYTECODE_TYPES param : _callee.params)
+    if (param != BT_INTEGER && param != BT_FLOAT && param != BT_BOOLEAN)
+      return false;
+  _last.op = BC_TAIL_CALL;
+  _last.a = 0;
+  return true;
+}
+
+/** A new register, for a value no longer needed after its statement */
+BytecodeValue BytecodeContext::temporary(BYTECODE_TYPES type) {
+  if (top > BC_MAX_REGISTER)
+    throw CodeGenException("Function " + function().name +
+                           " has too many registers for the bytecode");
+  BytecodeValue _value = {top++, type, true};
+  function().registers = std::max(function().registers, top);
+  return _value;
+}
+
+/**
+ * Name: BytecodeContext::storage
+ * Construct: Method
+ * Desc: A new register holding a string or array of the function's own,
+ *   empty as the function is called, for a variable or the result of a
+ *   string operation
+ * Args:
+ *   - type: The type of the string or array
+ */
+BytecodeValue BytecodeContext::storage(BYTECODE_TYPES type) {
+  /** It's bound on entry, so may not be a register used by earlier code */
+  top = function().registers;
+  BytecodeValue _value = temporary(type);
+  _value.temporary = false;
+  if (type == BT_STRING)
+    function().strings.push_back(_value.reg);
+  else
+    function().arrays.push_back(_value.reg);
+  /** Its storage is bound to the register, which must not be reused */
+  locals_top = top;
+  return _value;
+}
+
+/**
+ * Name: BytecodeContext::declare
+ * Construct: Method
+ * Desc: Declares a variable of the current function, in a register of its
+ *   own, as redeclaring a variable declares a new one in the LLVM back end
+ * Args:
+ *   - name: The name of the variable
+ *   - type: Its type
+ */
+BytecodeValue BytecodeContext::declare(const std::string &name,
+                                       BYTECODE_TYPES type) {
+  BytecodeValue _value = type == BT_STRING || type == BT_INTEGER_ARRAY ||
+                                 type == BT_FLOAT_ARRAY
+                             ? storage(type)
+                             : temporary(type);
+  _value.temporary = false;
+  locals_top = top;
+  locals[name] = _value;
+  return _value;
+}
+
+/** Frees the temporaries allocated since `mark`, as a statement ends */
+void BytecodeContext::release(std::uint32_t mark) {
+  top = std::max(mark, locals_top);
+}
+
+/** The index of an integer constant, adding it if it's new */
+std::uint32_t BytecodeContext::integer(std::int64_t val) {
+  auto it = constant_ids.find(val);
+  if (it != constant_ids.end())
+    return it->second;
+  if (module.constants.size() > BC_MAX_OPERAND)
+    throw CodeGenException("Too many constants for the bytecode");
+  Slot _slot;
+  _slot.i = val;
+  module.constants.push_back(_slot);
+  constant_ids[val] = module.constants.size() - 1;
+  return module.constants.size() - 1;
+}
+
+/** The index of a float constant, which shares its bits' integer's slot */
+std::uint32_t BytecodeContext::floating(double val) {
+  std::int64_t _bits;
+  std::memcpy(&_bits, &val, sizeof(_bits));
+  return integer(_bits);
+}
+
+/** The index of a string literal, adding it if it's new */
+std::uint32_t BytecodeContext::string(const std::string &val) {
+  auto it = string_ids.find(val);
+  if (it != string_ids.end())
+    return it->second;
+  if (module.strings.size() > BC_MAX_OPERAND)
+    throw CodeGenException("Too many strings for the bytecode");
+  module.strings.push_back(val);
+  string_ids[val] = module.strings.size() - 1;
+  return module.strings.size() - 1;
+}
+
+/**
+ * Name: BytecodeContext::code_generate
+ * Construct: Method
+ * Desc: Generates the bytecode of a program, its top-level code being the
+ *   module's first function
+ * Args:
+ *   - root: The root block (see `NBlock`) of the AST
+ */
+void BytecodeContext::code_generate(NBlock &root) {
+  BytecodeFunction _main;
+  _main.name = "main";
+  module.functions.push_back(_main);
+  current = 0;
+  root.bytecode_generate(*this);
+  emit(BC_RETURN_VOID);
+}
+
+/* -------- Printing -------- */
+
+/** The names of the types, in the order of `BYTECODE_TYPES` */
+static const char *TYPE_NAMES[] = {
+    "void", "integer", "float", "boolean", "string", "integer array",
+    "float array",
+};
+
+/**
+ * Name: print_bytecode
+ * Construct: Function
+ * Desc: Prints the instructions of each function of a module, with their
+ *   constants and literals (`--print-bytecode`)
+ * Args:
+ *   - module: The module
+ *   - out: The stream to print to
+ */
+void print_bytecode(const BytecodeModule &module, std::ostream &out) {
+  for (std::size_t id = 0; id < module.functions.size(); id++) {
+    const BytecodeFunction &fn = module.functions[id];
+    out << "function " << id << " " << fn.name << "(";
+    for (std::size_t i = 0; i < fn.params.size(); i++)
+      out << (i ? ", " : "") << TYPE_NAMES[fn.params[i]];
+    out << ") " << TYPE_NAMES[fn.ret] << ", " << fn.registers
+        << " registers\n";
+
+    for (std::size_t pc = 0; pc < fn.code.size(); pc++) {
+      const Instruction &inst = fn.code[pc];
+      BYTECODE_OPS op = BYTECODE_OPS(inst.op);
+      out << std::setw(6) << pc << "  " << std::left << std::setw(14)
+          << bytecode_op_name(op) << std::right;
+      const BYTECODE_OPERANDS *kinds = bytecode_operands(op);
+      std::uint32_t operands[3] = {std::uint32_t(inst.a),
+                                   std::uint32_t(inst.b),
+                                   std::uint32_t(inst.c)};
+      std::string sep = "";
+      for (int i = 0; i < 3; i++) {
+        if (kinds[i] == BO_NONE)
+          continue;
+        out << sep;
+        sep = ", ";
+        switch (kinds[i]) {
+        case BO_DEST:
+        case BO_REG:
+          out << "r" << operands[i];
+          break;
+        case BO_CONST:
+          out << "k" << operands[i] << " ("
+              << module.constants[operands[i]].i << ")";
+          break;
+        case BO_LITERAL:
+          out << "s" << operands[i];
+          break;
+        case BO_TARGET:
+          out << "@" << operands[i];
+          break;
+        case BO_FUNCTION:
+          out << module.functions[operands[i]].name;
+          break;
+        default:
+          break;
+        }
+      }
+      out << "\n";
+    }
+  }
+}
+
+/* -------- Files -------- */
+
+/**
+ * Name: SbcWriter
+ * Construct: Class
+ * Desc: Appends the words of a bytecode file to a buffer
+ */
+class SbcWriter {
+public:
+  std::string buffer;
+  void word(std::uint32_t w) { buffer.append((const char *)&w, 4); }
+  void quad(std::uint64_t q) { buffer.append((const char *)&q, 8); }
+  void string(const std::string &str) {
+    word(str.size());
+    buffer += str;
+  }
+};
+
+/**
+ * Name: write_bytecode
+ * Construct: Function
+ * Desc: Writes a module to a bytecode file, which `read_bytecode` reads back
+ *   to be ran without lexing, parsing, or generating code
+ * Args:
+ *   - module: The module
+ *   - filename: The path of the file
+ */
+bool write_bytecode(const BytecodeModule &module, const std::string &filename) {
+  SbcWriter out;
+  SbcHeader header = {SBC_MAGIC, BC_VERSION,
+                      std::uint32_t(module.constants.size()),
+                      std::uint32_t(module.strings.size()),
+                      std::uint32_t(module.functions.size())};
+  out.buffer.append((const char *)&header, sizeof(header));
+
+  for (const Slot &k : module.constants)
+    out.quad(k.i);
+  for (const std::string &str : module.strings)
+    out.string(str);
+  for (const BytecodeFunction &fn : module.functions) {
+    out.string(fn.name);
+    out.word(fn.params.size());
+    for (BYTECODE_TYPES type : fn.params)
+      out.word(type);
+    out.word(fn.ret);
+    out.word(fn.registers);
+    out.word(fn.strings.size());
+    for (std::uint16_t reg : fn.strings)
+      out.word(reg);
+    out.word(fn.arrays.size());
+    for (std::uint16_t reg : fn.arrays)
+      out.word(reg);
+    out.word(fn.code.size());
+    for (const Instruction &inst : fn.code)
+      out.quad(std::uint64_t(inst.op) | std::uint64_t(inst.a) << 8 |
+               std::uint64_t(inst.b) << 24 | std::uint64_t(inst.c) << 40);
+  }
+
+  std::ofstream file(filename, std::ios::binary);
+  file.write(out.buffer.data(), out.buffer.size());
+  if (!file) {
+    spdlog::error("Could not write bytecode to {}", filename);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Name: SbcReader
+ * Construct: Class
+ * Desc: Reads the words of a bytecode file, throwing if it ends early
+ * Members:
+ *   - data, size: The file's contents
+ *   - offset: The offset of the next word
+ */
+class SbcReader {
+  const char *data;
+  std::size_t size;
+  std::size_t offset = 0;
+
+public:
+  SbcReader(const std::string &buffer)
+      : data(buffer.data()), size(buffer.size()) {}
+  void read(void *dst, std::size_t len) {
+    if (len > size - offset)
+      throw std::runtime_error("file ends early");
+    std::memcpy(dst, data + offset, len);
+    offset += len;
+  }
+  std::uint32_t word() {
+    std::uint32_t w;
+    read(&w, 4);
+    return w;
+  }
+  std::uint64_t quad() {
+    std::uint64_t q;
+    read(&q, 8);
+    return q;
+  }
+  std::string string() {
+    std::uint32_t len = word();
+    if (len > size - offset)
+      throw std::runtime_error("string out of range");
+    offset += len;
+    return std::string(data + offset - len, len);
+  }
+  /** A count of things of at least `each` bytes, checked against the file */
+  std::uint32_t count(std::size_t each) {
+    std::uint32_t n = word();
+    if (n > (size - offset) / each)
+      throw std::runtime_error("count out of range");
+    return n;
+  }
+  bool done() { return offset == size; }
+};
+
+/** A type read from a file, checked to be one */
+static BYTECODE_TYPES read_type(SbcReader &in) {
+  std::uint32_t type = in.word();
+  if (type > BT_FLOAT_ARRAY)
+    throw std::runtime_error("unknown type");
+  return BYTECODE_TYPES(type);
+}
+
+/**
+ * Name: verify_bytecode
+ * Construct: Function
+ * Desc: Checks that every operand of every instruction is in range and that
+ *   every function ends by returning or jumping, so a damaged file is an
+ *   error rather than a crash of the VM
+ * Args:
+ *   - module: The module read
+ */
+static void verify_bytecode(const BytecodeModule &module) {
+  if (module.functions.empty() || !module.functions[0].params.empty())
+    throw std::runtime_error("no top-level code");
+  for (const BytecodeFunction &fn : module.functions) {
+    if (fn.registers > BC_MAX_REGISTER + 1 ||
+        fn.params.size() > fn.registers)
+      throw std::runtime_error("registers out of range in " + fn.name);
+    for (std::uint16_t reg : fn.strings)
+      if (reg >= fn.registers)
+        throw std::runtime_error("string out of range in " + fn.name);
+    for (std::uint16_t reg : fn.arrays)
+      if (reg >= fn.registers)
+        throw std::runtime_error("array out of range in " + fn.name);
+
+    if (fn.code.empty())
+      throw std::runtime_error("no code in " + fn.name);
+    BYTECODE_OPS last = BYTECODE_OPS(fn.code.back().op);
+    if (last != BC_RETURN && last != BC_RETURN_STRING &&
+        last != BC_RETURN_VOID && last != BC_UNREACHABLE && last != BC_JUMP &&
+        last != BC_TAIL_CALL)
+      throw std::runtime_error("code runs off the end of " + fn.name);
+
+    for (const Instruction &inst : fn.code) {
+      if (inst.op >= BC_OP_COUNT)
+        throw std::runtime_error("unknown instruction in " + fn.name);
+      const BYTECODE_OPERANDS *kinds = bytecode_operands(BYTECODE_OPS(inst.op));
+      std::uint32_t operands[3] = {std::uint32_t(inst.a),
+                                   std::uint32_t(inst.b),
+                                   std::uint32_t(inst.c)};
+      for (int i = 0; i < 3; i++) {
+        std::uint32_t n = operands[i];
+        bool ok = true;
+        switch (kinds[i]) {
+        case BO_DEST:
+        case BO_REG:
+          ok = n < fn.registers;
+          break;
+        case BO_CONST:
+          ok = n < module.constants.size();
+          break;
+        case BO_LITERAL:
+          ok = n < module.strings.size();
+          break;
+        case BO_TARGET:
+          ok = n < fn.code.size();
+          break;
+        case BO_FUNCTION:
+          ok = n < module.functions.size() &&
+               std::uint64_t(inst.b) + module.functions[n].params.size() <=
+                   fn.registers;
+          break;
+        default:
+          break;
+        }
+        if (!ok)
+          throw std::runtime_error("operand out of range in " + fn.name);
+      }
+    }
+  }
+}
+
+/**
+ * Name: read_bytecode
+ * Construct: Function
+ * Desc: Reads a bytecode file written by `write_bytecode`, returning false
+ *   (having reported why) if it can't be read
+ * Args:
+ *   - module: The module to read into
+ *   - filename: The path of the file
+ */
+bool read_bytecode(BytecodeModule &module, const std::string &filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    spdlog::error("Could not open bytecode {}", filename);
+    return false;
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  std::string buffer = contents.str();
+
+  try {
+    SbcReader in(buffer);
+    SbcHeader header;
+    in.read(&header, sizeof(header));
+    if (header.magic != SBC_MAGIC)
+      throw std::runtime_error("not a bytecode file");
+    if (header.version != BC_VERSION)
+      throw std::runtime_error("written by another version of the compiler");
+
+    if (header.constants > buffer.size() / 8)
+      throw std::runtime_error("count out of range");
+    module.constants.resize(header.constants);
+    for (Slot &k : module.constants)
+      k.i = in.quad();
+    if (header.strings > buffer.size() / 4)
+      throw std::runtime_error("count out of range");
+    module.strings.resize(header.strings);
+    for (std::string &str : module.strings)
+      str = in.string();
+    if (header.functions > buffer.size() / 4)
+      throw std::runtime_error("count out of range");
+    module.functions.resize(header.functions);
+    for (BytecodeFunction &fn : module.functions) {
+      fn.name = in.string();
+      fn.params.resize(in.count(4));
+      for (BYTECODE_TYPES &type : fn.params)
+        type = read_type(in);
+      fn.ret = read_type(in);
+      fn.registers = in.word();
+      fn.strings.resize(in.count(4));
+      for (std::uint16_t &reg : fn.strings)
+        reg = in.word();
+      fn.arrays.resize(in.count(4));
+      for (std::uint16_t &reg : fn.arrays)
+        reg = in.word();
+      fn.code.resize(in.count(8));
+      for (Instruction &inst : fn.code) {
+        std::uint64_t q = in.quad();
+        inst.op = q & 0xff;
+        inst.a = (q >> 8) & 0xffff;
+        inst.b = (q >> 24) & 0xffff;
+        inst.c = q >> 40;
+      }
+    }
+    if (!in.done())
+      throw std::runtime_error("data after the last function");
+    verify_bytecode(module);
+  } catch (const std::runtime_error &e) {
+    spdlog::error("Malformed bytecode {}: {}", filename, e.what());
+    return false;
+  }
+  return true;
+}
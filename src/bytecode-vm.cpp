@@ -0,0 +1,449 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include "bytecode.hpp"
+#include "sood-runtime.h"
+
+/**
+ * Name: src/bytecode-vm.cpp
+ * Construct: Module
+ * Desc: The VM of the bytecode back end, which runs a module generated by
+ *   src/ast-bytecode.cpp (or read from a file, see `read_bytecode`). Each
+ *   instruction's handler ends by jumping straight to the next's (threaded
+ *   dispatch, through GCC's computed gotos), where a compiler without them
+ *   falls back to a `switch`
+ * Notes:
+ *   - The strings and arrays are the runtime's (see include/sood-runtime.h),
+ *     as are the arenas, so values behave as in a compiled program
+ */
+
+/** The size of the VM's stack, in slots, 64 MiB */
+static const std::size_t STACK_SLOTS = 1 << 23;
+
+/** The most calls which may be nested */
+static const std::size_t MAX_CALLS = 1 << 20;
+
+/** The number of slots a string or array of a frame takes */
+static const std::uint32_t STRING_SLOTS = sizeof(SoodString) / sizeof(Slot);
+static const std::uint32_t ARRAY_SLOTS = sizeof(SoodArray) / sizeof(Slot);
+static_assert(sizeof(SoodString) % sizeof(Slot) == 0 &&
+                  sizeof(SoodArray) % sizeof(Slot) == 0 &&
+                  sizeof(SoodArena) == sizeof(Slot),
+              "The runtime's values must fit whole slots");
+
+/**
+ * Name: FrameLayout
+ * Construct: Struct
+ * Desc: Where a function's values are in its frame on the VM's stack, which
+ *   is its registers, followed by the storage of its strings and arrays, and
+ *   its arena
+ * Members:
+ *   - fn: The function
+ *   - strings, arrays, arena: The offsets of each, in slots
+ *   - size: The size of the frame, in slots
+ */
+struct FrameLayout {
+  const BytecodeFunction *fn;
+  std::uint32_t strings;
+  std::uint32_t arrays;
+  std::uint32_t arena;
+  std::uint32_t size;
+};
+
+/**
+ * Name: Call
+ * Construct: Struct
+ * Desc: A call yet to return, where the caller continues
+ * Members:
+ *   - ret: The caller's instruction after the call
+ *   - regs: The caller's registers
+ *   - layout: The caller's frame layout
+ *   - dst: The caller's register for the result
+ */
+struct Call {
+  const Instruction *ret;
+  Slot *regs;
+  const FrameLayout *layout;
+  std::uint32_t dst;
+};
+
+/**
+ * Name: enter_frame
+ * Construct: Function
+ * Desc: Initializes the strings and arrays of a function being called, empty
+ *   and of the function's arena, and binds them to their registers
+ * Args:
+ *   - layout: The function's frame layout
+ *   - regs: The function's registers
+ */
+static inline void enter_frame(const FrameLayout &layout, Slot *regs) {
+  SoodArena *_arena = reinterpret_cast<SoodArena *>(regs + layout.arena);
+  _arena->chunks = nullptr;
+  Slot *_storage = regs + layout.strings;
+  for (std::uint16_t reg : layout.fn->strings) {
+    SoodString *_str = reinterpret_cast<SoodString *>(_storage);
+    sood_string_init(_str, _arena);
+    regs[reg].p = _str;
+    _storage += STRING_SLOTS;
+  }
+  _storage = regs + layout.arrays;
+  for (std::uint16_t reg : layout.fn->arrays) {
+    SoodArray *_arr = reinterpret_cast<SoodArray *>(_storage);
+    _arr->data = nullptr;
+    _arr->length = 0;
+    _arr->capacity = 0;
+    _arr->arena = _arena;
+    regs[reg].p = _arr;
+    _storage += ARRAY_SLOTS;
+  }
+}
+
+/** Reports a nesting of calls too deep for the VM's stack, and exits */
+static void stack_overflow() {
+  std::fprintf(stderr, "Sood: stack overflow, calls nested too deeply\n");
+  std::exit(1);
+}
+
+/**
+ * Name: run_bytecode
+ * Construct: Function
+ * Desc: Runs a module's top-level code on the VM, returning once it has
+ *   finished
+ * Args:
+ *   - module: The module, which must be well formed (see `verify_bytecode`)
+ * Notes:
+ *   - Integer arithmetic wraps, and dividing by zero traps, as they do in a
+ *     compiled program
+ */
+int run_bytecode(const BytecodeModule &module) {
+  std::vector<FrameLayout> _layouts;
+  for (const BytecodeFunction &fn : module.functions) {
+    FrameLayout _layout;
+    _layout.fn = &fn;
+    _layout.strings = fn.registers;
+    _layout.arrays = _layout.strings + fn.strings.size() * STRING_SLOTS;
+    _layout.arena = _layout.arrays + fn.arrays.size() * ARRAY_SLOTS;
+    _layout.size = _layout.arena + 1;
+    _layouts.push_back(_layout);
+  }
+
+  /** The literals are constant strings, as for the LLVM back end */
+  std::vector<SoodString> _literals(module.strings.size());
+  for (std::size_t i = 0; i < module.strings.size(); i++) {
+    _literals[i].data = const_cast<char *>(module.strings[i].c_str());
+    _literals[i].length = module.strings[i].size();
+    _literals[i].capacity = -1;
+    _literals[i].arena = nullptr;
+  }
+
+  std::unique_ptr<Slot[]> _stack(new Slot[STACK_SLOTS]);
+  std::unique_ptr<Call[]> _calls(new Call[MAX_CALLS]);
+  const Slot *_stack_end = _stack.get() + STACK_SLOTS;
+  std::size_t _depth = 0;
+
+  const FrameLayout *_layout = &_layouts[0];
+  Slot *regs = _stack.get();
+  if (_layout->size > STACK_SLOTS)
+    stack_overflow();
+  enter_frame(*_layout, regs);
+  const Instruction *code = _layout->fn->code.data();
+  const Instruction *pc = code;
+  const Slot *_constants = module.constants.data();
+  Instruction inst;
+
+#define RA regs[inst.a]
+#define RB regs[inst.b]
+#define RC regs[inst.c]
+#define STR(slot) static_cast<SoodString *>((slot).p)
+#define ARR(slot) static_cast<SoodArray *>((slot).p)
+#define WRAP(expr) static_cast<std::int64_t>(expr)
+#define U(slot) static_cast<std::uint64_t>((slot).i)
+
+#ifdef __GNUC__
+  static const void *HANDLERS[] = {
+      &&L_BC_MOVE,          &&L_BC_CONST,         &&L_BC_STRING,
+      &&L_BC_INT_TO_FLOAT,  &&L_BC_FLOAT_TO_INT,  &&L_BC_ADD,
+      &&L_BC_SUB,           &&L_BC_MUL,           &&L_BC_DIV,
+      &&L_BC_MOD,           &&L_BC_FADD,          &&L_BC_FSUB,
+      &&L_BC_FMUL,          &&L_BC_FDIV,          &&L_BC_FMOD,
+      &&L_BC_NEG,           &&L_BC_FNEG,          &&L_BC_NOT,
+      &&L_BC_EQ,            &&L_BC_NE,            &&L_BC_LT,
+      &&L_BC_LE,            &&L_BC_GT,            &&L_BC_GE,
+      &&L_BC_FEQ,           &&L_BC_FNE,           &&L_BC_FLT,
+      &&L_BC_FLE,           &&L_BC_FGT,           &&L_BC_FGE,
+      &&L_BC_JUMP,          &&L_BC_JUMP_IF,       &&L_BC_JUMP_IF_NOT,
+      &&L_BC_JUMP_EQ,       &&L_BC_JUMP_NE,       &&L_BC_JUMP_LT,
+      &&L_BC_JUMP_LE,       &&L_BC_JUMP_GT,       &&L_BC_JUMP_GE,
+      &&L_BC_CALL,          &&L_BC_TAIL_CALL,     &&L_BC_RETURN,
+      &&L_BC_RETURN_STRING, &&L_BC_RETURN_VOID,   &&L_BC_UNREACHABLE,
+      &&L_BC_STRING_ASSIGN, &&L_BC_STRING_APPEND, &&L_BC_STRING_CONCAT,
+      &&L_BC_STRING_EQ,     &&L_BC_STRING_NE,     &&L_BC_STRING_LENGTH,
+      &&L_BC_ARRAY_NEW,     &&L_BC_ARRAY_CLEAR,   &&L_BC_ARRAY_GET,
+      &&L_BC_ARRAY_SET,     &&L_BC_ARRAY_PUSH,    &&L_BC_ARRAY_LENGTH,
+      &&L_BC_WRITE_INTEGER, &&L_BC_WRITE_STRING,
+  };
+  static_assert(sizeof(HANDLERS) / sizeof(*HANDLERS) == BC_OP_COUNT,
+                "A handler is needed for each instruction");
+#define CASE(op) L_##op
+#define DISPATCH() goto *HANDLERS[inst.op]
+#else
+#define CASE(op) case op
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT()                                                                 \
+  do {                                                                         \
+    inst = *++pc;                                                              \
+    DISPATCH();                                                                \
+  } while (0)
+#define JUMP_TO(target)                                                        \
+  do {                                                                         \
+    pc = code + (target);                                                      \
+    inst = *pc;                                                                \
+    DISPATCH();                                                                \
+  } while (0)
+#define BINARY(field, expr)                                                    \
+  do {                                                                         \
+    RA.field = (expr);                                                         \
+    NEXT();                                                                    \
+  } while (0)
+#define JUMP_IF(cond)                                                          \
+  do {                                                                         \
+    if (cond)                                                                  \
+      JUMP_TO(inst.c);                                                         \
+    NEXT();                                                                    \
+  } while (0)
+
+  inst = *pc;
+#ifdef __GNUC__
+  DISPATCH();
+  {
+#else
+dispatch:
+  switch (inst.op) {
+#endif
+  CASE(BC_MOVE):
+    RA = RB;
+    NEXT();
+  CASE(BC_CONST):
+    RA = _constants[inst.c];
+    NEXT();
+  CASE(BC_STRING):
+    RA.p = &_literals[inst.c];
+    NEXT();
+  CASE(BC_INT_TO_FLOAT):
+    BINARY(f, static_cast<double>(U(RB)));
+  CASE(BC_FLOAT_TO_INT):
+    BINARY(i, static_cast<std::int64_t>(RB.f));
+
+  CASE(BC_ADD):
+    BINARY(i, WRAP(U(RB) + U(RC)));
+  CASE(BC_SUB):
+    BINARY(i, WRAP(U(RB) - U(RC)));
+  CASE(BC_MUL):
+    BINARY(i, WRAP(U(RB) * U(RC)));
+  CASE(BC_DIV):
+    BINARY(i, RB.i / RC.i);
+  CASE(BC_MOD):
+    BINARY(i, RB.i % RC.i);
+  CASE(BC_FADD):
+    BINARY(f, RB.f + RC.f);
+  CASE(BC_FSUB):
+    BINARY(f, RB.f - RC.f);
+  CASE(BC_FMUL):
+    BINARY(f, RB.f * RC.f);
+  CASE(BC_FDIV):
+    BINARY(f, RB.f / RC.f);
+  CASE(BC_FMOD):
+    BINARY(f, std::fmod(RB.f, RC.f));
+  CASE(BC_NEG):
+    BINARY(i, WRAP(0 - U(RB)));
+  CASE(BC_FNEG):
+    BINARY(f, -RB.f);
+  CASE(BC_NOT):
+    BINARY(i, RB.i == 0);
+
+  CASE(BC_EQ):
+    BINARY(i, RB.i == RC.i);
+  CASE(BC_NE):
+    BINARY(i, RB.i != RC.i);
+  CASE(BC_LT):
+    BINARY(i, RB.i < RC.i);
+  CASE(BC_LE):
+    BINARY(i, RB.i <= RC.i);
+  CASE(BC_GT):
+    BINARY(i, RB.i > RC.i);
+  CASE(BC_GE):
+    BINARY(i, RB.i >= RC.i);
+  /** Ordered comparisons, as LLVM's `fcmp o..`, false for a NaN */
+  CASE(BC_FEQ):
+    BINARY(i, RB.f == RC.f);
+  CASE(BC_FNE):
+    BINARY(i, RB.f < RC.f || RB.f > RC.f);
+  CASE(BC_FLT):
+    BINARY(i, RB.f < RC.f);
+  CASE(BC_FLE):
+    BINARY(i, RB.f <= RC.f);
+  CASE(BC_FGT):
+    BINARY(i, RB.f > RC.f);
+  CASE(BC_FGE):
+    BINARY(i, RB.f >= RC.f);
+
+  CASE(BC_JUMP):
+    JUMP_TO(inst.c);
+  CASE(BC_JUMP_IF):
+    JUMP_IF(RA.i);
+  CASE(BC_JUMP_IF_NOT):
+    JUMP_IF(!RA.i);
+  CASE(BC_JUMP_EQ):
+    JUMP_IF(RA.i == RB.i);
+  CASE(BC_JUMP_NE):
+    JUMP_IF(RA.i != RB.i);
+  CASE(BC_JUMP_LT):
+    JUMP_IF(RA.i < RB.i);
+  CASE(BC_JUMP_LE):
+    JUMP_IF(RA.i <= RB.i);
+  CASE(BC_JUMP_GT):
+    JUMP_IF(RA.i > RB.i);
+  CASE(BC_JUMP_GE):
+    JUMP_IF(RA.i >= RB.i);
+
+  CASE(BC_CALL): {
+    const FrameLayout *_callee = &_layouts[inst.c];
+    Slot *_regs = regs + _layout->size;
+    if (_depth == MAX_CALLS || _callee->size > std::size_t(_stack_end - _regs))
+      stack_overflow();
+    for (std::size_t i = 0; i < _callee->fn->params.size(); i++)
+      _regs[i] = regs[inst.b + i];
+    _calls[_depth++] = Call{pc + 1, regs, _layout, std::uint32_t(inst.a)};
+    regs = _regs;
+    _layout = _callee;
+    enter_frame(*_layout, regs);
+    pc = code = _layout->fn->code.data();
+    inst = *pc;
+    DISPATCH();
+  }
+  CASE(BC_TAIL_CALL): {
+    const FrameLayout *_callee = &_layouts[inst.c];
+    if (_callee->size > std::size_t(_stack_end - regs))
+      stack_overflow();
+    sood_arena_release(reinterpret_cast<SoodArena *>(regs + _layout->arena));
+    /** The arguments are above the parameters, so none is overwritten before
+     *   it's copied */
+    for (std::size_t i = 0; i < _callee->fn->params.size(); i++)
+      regs[i] = regs[inst.b + i];
+    _layout = _callee;
+    enter_frame(*_layout, regs);
+    pc = code = _layout->fn->code.data();
+    inst = *pc;
+    DISPATCH();
+  }
+  CASE(BC_RETURN): {
+    Slot _result = RA;
+    sood_arena_release(reinterpret_cast<SoodArena *>(regs + _layout->arena));
+    if (!_depth)
+      return 0;
+    const Call &_call = _calls[--_depth];
+    regs = _call.regs;
+    _layout = _call.layout;
+    regs[_call.dst] = _result;
+    code = _layout->fn->code.data();
+    pc = _call.ret;
+    inst = *pc;
+    DISPATCH();
+  }
+  CASE(BC_RETURN_STRING): {
+    if (_depth)
+      sood_string_assign(STR(_calls[_depth - 1].regs[_calls[_depth - 1].dst]),
+                         STR(RA));
+    /** The value is the caller's now, return as any other function */
+  }
+  CASE(BC_RETURN_VOID): {
+    sood_arena_release(reinterpret_cast<SoodArena *>(regs + _layout->arena));
+    if (!_depth)
+      return 0;
+    const Call &_call = _calls[--_depth];
+    regs = _call.regs;
+    _layout = _call.layout;
+    code = _layout->fn->code.data();
+    pc = _call.ret;
+    inst = *pc;
+    DISPATCH();
+  }
+  CASE(BC_UNREACHABLE): {
+    std::fprintf(stderr, "Sood: function %s ended without returning a value\n",
+                 _layout->fn->name.c_str());
+    std::exit(1);
+  }
+
+  CASE(BC_STRING_ASSIGN):
+    sood_string_assign(STR(RA), STR(RB));
+    NEXT();
+  CASE(BC_STRING_APPEND):
+    sood_string_append(STR(RA), STR(RB));
+    NEXT();
+  CASE(BC_STRING_CONCAT):
+    sood_string_concat(STR(RA), STR(RB), STR(RC));
+    NEXT();
+  CASE(BC_STRING_EQ):
+    BINARY(i, sood_string_equal(STR(RB), STR(RC)) != 0);
+  CASE(BC_STRING_NE):
+    BINARY(i, sood_string_equal(STR(RB), STR(RC)) == 0);
+  CASE(BC_STRING_LENGTH):
+    BINARY(i, STR(RB)->length);
+
+  /** Integers and floats are each the size of a slot */
+  CASE(BC_ARRAY_NEW):
+    sood_array_new(ARR(RA), sizeof(Slot), RB.i);
+    NEXT();
+  CASE(BC_ARRAY_CLEAR):
+    ARR(RA)->length = 0;
+    NEXT();
+  CASE(BC_ARRAY_GET): {
+    SoodArray *_arr = ARR(RB);
+    if (U(RC) >= static_cast<std::uint64_t>(_arr->length))
+      sood_array_bounds_fail(RC.i, _arr->length);
+    RA = static_cast<Slot *>(_arr->data)[RC.i];
+    NEXT();
+  }
+  CASE(BC_ARRAY_SET): {
+    SoodArray *_arr = ARR(RA);
+    if (U(RB) >= static_cast<std::uint64_t>(_arr->length))
+      sood_array_bounds_fail(RB.i, _arr->length);
+    static_cast<Slot *>(_arr->data)[RB.i] = RC;
+    NEXT();
+  }
+  CASE(BC_ARRAY_PUSH):
+    *static_cast<Slot *>(sood_array_push(ARR(RA), sizeof(Slot))) = RB;
+    NEXT();
+  CASE(BC_ARRAY_LENGTH):
+    BINARY(i, ARR(RB)->length);
+
+  CASE(BC_WRITE_INTEGER):
+    std::printf("%d", static_cast<int>(RA.i));
+    NEXT();
+  CASE(BC_WRITE_STRING):
+    std::printf("%s", STR(RA)->data);
+    NEXT();
+#ifndef __GNUC__
+  default:
+    break;
+#endif
+  }
+  return 1;
+
+#undef RA
+#undef RB
+#undef RC
+#undef STR
+#undef ARR
+#undef WRAP
+#undef U
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef JUMP_TO
+#undef BINARY
+#undef JUMP_IF
+}
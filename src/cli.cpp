@@ -1,4 +1,7 @@
+#include <llvm/Support/Path.h>
+
 #include "cli.hpp"
+#include "codegen.hpp"
 
 /* clang-format off */ // The factory pattern will all expand
 
@@ -7,16 +10,48 @@ SoodArgs parse_args(int argc, char **argv) {
   opts.add_options()
     ("h,help",               "Show this help message")
     ("d,debug",              "Enable debugging")
+    ("g,debug-info",         "Emit debug information for debuggers and profilers")
     ("a,print-ast",          "Print generated AST to stdout")
     ("l,print-llvm-ir",      "Print generated LLVM IR to stdout")
     ("V,no-verify",          "Disable LLVM verification")
+    ("fastcc",               "Use the fast calling convention for Sood functions")
+    ("no-tail-calls",        "Disable tail call elimination")
+    ("inline",               "Inline small functions and remove unused ones")
+    ("inline-threshold",     "Largest multi-block function to inline",
+     cxxopts::value<unsigned>()->default_value("32"))
+    ("vectorize",            "Enable the loop and SLP vectorizers")
+    ("memoize",              "Cache the results of pure functions of integers")
+    ("profile",              "Count calls and cycles of each function, reported at exit")
+    ("perf-map",             "Describe code ran in memory to perf, in /tmp/perf-<pid>.map")
+    ("pgo-instrument",       "Count the program's branches, written to default.profraw at exit")
+    ("pgo-use",              "Optimize with a profile merged by llvm-profdata",
+     cxxopts::value<std::string>())
+    ("thin-lto",             "Write bitcode and optimize across modules as they're linked")
+    ("static-minimal",       "Link statically with a minimal runtime, without libc, to start faster")
+    ("cache-dir",            "Compile each function separately, reusing its cached object code",
+     cxxopts::value<std::string>())
+    ("max-errors",           "Most syntax errors to report, 0 for no limit",
+     cxxopts::value<unsigned>()->default_value("20"))
     ("R,run-llvm-ir",        "Run module within the compiler")
+    ("tiered",               "Run the program, interpreted until its hot code is compiled")
+    ("bytecode",             "Run the program on the bytecode VM, not compiled with LLVM")
+    ("print-bytecode",       "Print generated bytecode to stdout")
     ("S,stop-after-ast",     "Stop after generating the AST")
     ("C,stop-after-llvm-ir", "Stop after generating the LLVM IR")
     ("O,stop-after-object",  "Stop after writing object file")
+    ("emit-bc",              "Stop after writing LLVM bitcode")
+    ("emit-ast",             "Stop after writing the AST in binary form")
+    ("emit-bytecode",        "Stop after writing the bytecode, to be ran with --bytecode")
+    ("emit-interface",       "Compile a module to import, writing its object and <name>.sif")
+    ("I,import-path",        "Directories to search for imported modules, separated by ':'",
+     cxxopts::value<std::string>())
     ("i,input",              "Sood source file, else stdin", cxxopts::value<std::string>())
     ("o,output",             "Output file name",
-     cxxopts::value<std::string>()->default_value(DEFAULT_OUT));
+     cxxopts::value<std::string>()->default_value(DEFAULT_OUT))
+    ("socket",               "Unix socket for `sood serve` to listen on",
+     cxxopts::value<std::string>()->default_value(DEFAULT_SOCKET))
+    ("workers",              "Requests `sood serve` compiles at once, 0 for one per core",
+     cxxopts::value<unsigned>()->default_value("0"));
   opts.parse_positional({"input"});
   auto res = opts.parse(argc, argv);
   if (res.count("help")) {
@@ -30,20 +65,86 @@ SoodArgs parse_args(int argc, char **argv) {
       output = input + ".ast";
     else if (res["stop-after-llvm-ir"].as<bool>())
       output = input + ".ll";
-    else if (res["stop-after-object"].as<bool>())
-      output = input + ".o";
+    else if (res["emit-ast"].as<bool>())
+      output = input + ".sast";
+    else if (res["emit-bytecode"].as<bool>())
+      output = input + ".sbc";
+    else if (res["emit-bc"].as<bool>())
+      output = input + ".bc";
+    else if (res["stop-after-object"].as<bool>() ||
+             res["emit-interface"].as<bool>())
+      output = input + (res["thin-lto"].as<bool>() ? ".bc" : ".o");
   }
   return SoodArgs()
     .set_debug(res["debug"].as<bool>())
+    .set_debug_info(res["debug-info"].as<bool>())
     .set_print_ast(res["print-ast"].as<bool>())
     .set_print_llvm_ir(res["print-llvm-ir"].as<bool>())
     .set_no_verify(res["no-verify"].as<bool>())
+    .set_fast_cc(res["fastcc"].as<bool>())
+    .set_no_tail_calls(res["no-tail-calls"].as<bool>())
+    .set_inlining(res["inline"].as<bool>())
+    .set_inline_threshold(res["inline-threshold"].as<unsigned>())
+    .set_vectorize(res["vectorize"].as<bool>())
+    .set_memoize(res["memoize"].as<bool>())
+    .set_profile(res["profile"].as<bool>())
+    .set_perf_map(res["perf-map"].as<bool>())
+    .set_pgo_instrument(res["pgo-instrument"].as<bool>())
+    .set_thin_lto(res["thin-lto"].as<bool>())
+    .set_static_minimal(res["static-minimal"].as<bool>())
+    .set_max_errors(res["max-errors"].as<unsigned>())
     .set_run_llvm_ir(res["run-llvm-ir"].as<bool>())
+    .set_tiered(res["tiered"].as<bool>())
+    .set_bytecode(res["bytecode"].as<bool>())
+    .set_print_bytecode(res["print-bytecode"].as<bool>())
     .set_stop_after_ast(res["stop-after-ast"].as<bool>())
     .set_stop_after_llvm_ir(res["stop-after-llvm-ir"].as<bool>())
-    .set_stop_after_object(res["stop-after-object"].as<bool>())
+    .set_stop_after_object(res["stop-after-object"].as<bool>() ||
+                           res["emit-interface"].as<bool>())
+    .set_emit_bc(res["emit-bc"].as<bool>())
+    .set_emit_ast(res["emit-ast"].as<bool>())
+    .set_emit_bytecode(res["emit-bytecode"].as<bool>())
+    .set_emit_interface(res["emit-interface"].as<bool>())
     .set_input(res.count("input") ? res["input"].as<std::string>() : "")
-    .set_output(output);
+    .set_output(output)
+    .set_socket(res["socket"].as<std::string>())
+    .set_workers(res["workers"].as<unsigned>())
+    .set_cache_dir(res.count("cache-dir") ? res["cache-dir"].as<std::string>() : "")
+    .set_pgo_use(res.count("pgo-use") ? res["pgo-use"].as<std::string>() : "")
+    .set_import_path(res.count("import-path") ? res["import-path"].as<std::string>() : "");
 }
 
 /* clang-format on */
+
+/**
+ * Name: set_codegen_options
+ * Construct: Function
+ * Desc: Sets the options of the code generator from the command line
+ *   options, shared by the compiler and `sood serve`
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - args: The parsed command line options
+ */
+void set_codegen_options(CodeGenContext &ctx, const SoodArgs &args) {
+  ctx.fast_cc = args.fast_cc;
+  ctx.tail_calls = !args.no_tail_calls;
+  ctx.inlining = args.inlining;
+  ctx.inline_threshold = args.inline_threshold;
+  ctx.vectorize = args.vectorize;
+  ctx.memoize = args.memoize;
+  ctx.debug_info = args.debug_info;
+  ctx.profile = args.profile;
+  ctx.perf_map = args.perf_map;
+  ctx.pgo_instrument = args.pgo_instrument;
+  ctx.pgo_use = args.pgo_use;
+  ctx.thin_lto = args.thin_lto;
+  ctx.source_file = args.input;
+
+  /** Imported modules are searched for beside the source, then on the path */
+  std::string source_dir = llvm::sys::path::parent_path(args.input).str();
+  ctx.import_paths = {source_dir.empty() ? "." : source_dir};
+  llvm::SmallVector<llvm::StringRef, 4> dirs;
+  llvm::StringRef(args.import_path).split(dirs, ':', -1, false);
+  for (llvm::StringRef dir : dirs)
+    ctx.import_paths.push_back(dir.str());
+}
@@ -1,6 +1,9 @@
+#include <llvm/Object/ObjectFile.h>
+
 #include "ast.hpp"
 #include "codegen.hpp"
 #include "parser.hpp"
+#include "sood-runtime.h"
 
 /**
  * Name: LLVM_CTX
@@ -18,14 +21,25 @@ llvm::LLVMContext LLVM_CTX;
 llvm::IRBuilder<> BUILDER(LLVM_CTX);
 
 /**
- * Name: DOUBLE_TYPE, STRING_TYPE, INTEGER_TYPE
+ * Name: DOUBLE_TYPE, STRING_TYPE, INTEGER_TYPE, BYTE_PTR_TYPE, ARENA_TYPE
  * Construct: Global variable
  * Desc: To save from frequently calling to `llvm::Type::getXXXTy(LLVM_CTX)`,
- *   these are created once at compiler startup
+ *   these are created once at compiler startup. A string is a pointer to a
+ *   `STRING_STRUCT_TYPE`, the layout of which matches `SoodString` of the
+ *   runtime, likewise `ARENA_STRUCT_TYPE` and `SoodArena`
  */
 llvm::Type *DOUBLE_TYPE = llvm::Type::getDoubleTy(LLVM_CTX);
-llvm::Type *STRING_TYPE = llvm::Type::getInt8PtrTy(LLVM_CTX);
 llvm::Type *INTEGER_TYPE = llvm::Type::getInt64Ty(LLVM_CTX);
+llvm::Type *BYTE_PTR_TYPE = llvm::Type::getInt8PtrTy(LLVM_CTX);
+llvm::StructType *ARENA_STRUCT_TYPE =
+    llvm::StructType::create(LLVM_CTX, {BYTE_PTR_TYPE}, "sood_arena");
+llvm::Type *ARENA_TYPE = ARENA_STRUCT_TYPE->getPointerTo();
+llvm::StructType *STRING_STRUCT_TYPE = llvm::StructType::create(
+    LLVM_CTX,
+    {BYTE_PTR_TYPE, INTEGER_TYPE, INTEGER_TYPE, ARENA_TYPE,
+     llvm::ArrayType::get(llvm::Type::getInt8Ty(LLVM_CTX), SOOD_STRING_SMALL)},
+    "sood_string");
+llvm::Type *STRING_TYPE = STRING_STRUCT_TYPE->getPointerTo();
 
 /**
  * Name: get_i8_str_ptr
@@ -41,11 +55,53 @@ llvm::Constant *get_i8_str_ptr(char const *str, llvm::Twine const &twine) {
   return BUILDER.CreateGlobalStringPtr(str, twine);
 }
 
+/**
+ * Name: create_fmt_specifier
+ * Construct: Function
+ * Desc: Like `get_i8_str_ptr` but for a given module rather than that of the
+ *   builder's insert point, so the format specifiers exist before any code is
+ *   generated (a module may hold a single function, see src/incremental.cpp)
+ * Args:
+ *   - module: The module to create the global string in
+ *   - str: The string to store as a global
+ *   - name: The name of the global
+ */
+static llvm::Constant *create_fmt_specifier(llvm::Module *module,
+                                            llvm::StringRef str,
+                                            llvm::StringRef name) {
+  llvm::Constant *_data = llvm::ConstantDataArray::getString(LLVM_CTX, str);
+  llvm::GlobalVariable *_global = new llvm::GlobalVariable(
+      *module, _data->getType(), true, llvm::GlobalValue::PrivateLinkage,
+      _data, name);
+  _global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+  llvm::Constant *_indices[] = {BUILDER.getInt32(0), BUILDER.getInt32(0)};
+  return llvm::ConstantExpr::getInBoundsGetElementPtr(_data->getType(), _global,
+                                                      _indices);
+}
+
 CodeGenContext::CodeGenContext(std::string module_name) {
   module = new llvm::Module(module_name, LLVM_CTX);
+  /** The builder is shared, its location may be of an abandoned module */
+  BUILDER.SetCurrentDebugLocation(llvm::DebugLoc());
   printf_function = create_fn_printf();
+  fmt_specifiers.insert(
+      {"numeric", create_fmt_specifier(module, "%d", "numeric_fmt_spc")});
+  fmt_specifiers.insert(
+      {"string", create_fmt_specifier(module, "%s", "string_fmt_spc")});
 }
 
+/**
+ * Name: CodeGenContext::CodeGenContext
+ * Construct: Constructor
+ * Desc: Adopts a module read as LLVM IR, rather than one to generate the code
+ *   of, for its optimization and output
+ * Args:
+ *   - module: The module, including its `main` function
+ */
+CodeGenContext::CodeGenContext(llvm::Module *module)
+    : fn_main(module->getFunction("main")), module(module),
+      printf_function(module->getFunction("printf")) {}
+
 /**
  * Name: CodeGenContext::create_fn_printf
  * Construct: Method
@@ -66,6 +122,27 @@ llvm::Function *CodeGenContext::create_fn_printf() {
   return func;
 }
 
+/**
+ * Name: CodeGenContext::runtime_function
+ * Construct: Method
+ * Desc: Returns the declaration of a function of the Sood runtime (see
+ *   include/sood-runtime.h), declaring it in the module on first use, the
+ *   runtime is linked with the object code to create the executable
+ * Args:
+ *   - name: The name of the runtime function
+ *   - type: The type of the runtime function
+ */
+llvm::Function *CodeGenContext::runtime_function(std::string name,
+                                                 llvm::FunctionType *type) {
+  llvm::Function *func = module->getFunction(name);
+  if (!func) {
+    func = llvm::Function::Create(type, llvm::Function::ExternalLinkage, name,
+                                  module);
+    func->setCallingConv(llvm::CallingConv::C);
+  }
+  return func;
+}
+
 /**
  * Name: CodeGenContext::code_generate
  * Construct: Method
@@ -88,23 +165,91 @@ void CodeGenContext::code_generate(NBlock &root) {
   push_block(_block);
 
   BUILDER.SetInsertPoint(_block);
+  di_scope = debug_function(fn_main, "main", root);
 
-  fmt_specifiers.insert({"numeric", get_i8_str_ptr("%d", "numeric_fmt_spc")});
-  fmt_specifiers.insert({"string", get_i8_str_ptr("%s", "string_fmt_spc")});
-
+  function_body = &root;
   root.code_generate(*this);  // emit bytecode for the toplevel block
   BUILDER.CreateRet(nullptr); // return `void`
+  release_arena(fn_main);
+
+  pop_block();
+  di_scope = nullptr;
+  if (profile)
+    instrument_profile();
+  finalize_debug_info();
+}
+
+/**
+ * Name: CodeGenContext::code_generate_top_level
+ * Construct: Method
+ * Desc: Generates top-level code into a function of its own, rather than
+ *   `main`, for `sood repl` (see src/repl.cpp). The function's arena is not
+ *   released, the values of the top-level code live as long as the session
+ * Args:
+ *   - root: The root block of the input's AST
+ *   - name: The name of the function
+ *   - locals: The variables of earlier inputs, set to the variables in scope
+ *     after the input
+ */
+llvm::Function *CodeGenContext::code_generate_top_level(
+    NBlock &root, const std::string &name,
+    std::map<std::string, ValTypeTuple> &locals) {
+  llvm::Function *_fn = llvm::Function::Create(
+      llvm::FunctionType::get(llvm::Type::getVoidTy(LLVM_CTX), false),
+      llvm::GlobalValue::ExternalLinkage, name, module);
+  llvm::BasicBlock *_block = llvm::BasicBlock::Create(LLVM_CTX, "entry", _fn);
+
+  push_block(_block);
+  blocks.top()->locals = locals;
+  BUILDER.SetInsertPoint(_block);
+  di_scope = debug_function(_fn, name, root);
+
+  function_body = &root;
+  root.code_generate(*this);
+  BUILDER.CreateRet(nullptr);
 
+  locals = blocks.top()->locals;
   pop_block();
+  di_scope = nullptr;
+  finalize_debug_info();
+  return _fn;
+}
+
+/**
+ * Name: CodeGenContext::release_arena
+ * Construct: Method
+ * Desc: Releases the arena of a function, if it has one, before each of its
+ *   returns
+ * Args:
+ *   - fn: The function whose code has been generated
+ * Notes:
+ *   - A self-recursive call returned directly is no longer in a tail
+ *     position, so a function with an arena is not turned into a loop
+ */
+void CodeGenContext::release_arena(llvm::Function *fn) {
+  if (!arena)
+    return;
+  llvm::Function *_release = runtime_function(
+      "sood_arena_release",
+      llvm::FunctionType::get(llvm::Type::getVoidTy(LLVM_CTX), {ARENA_TYPE},
+                              false));
+  for (llvm::BasicBlock &_block : *fn)
+    if (llvm::ReturnInst *_ret =
+            llvm::dyn_cast_or_null<llvm::ReturnInst>(_block.getTerminator()))
+      llvm::CallInst::Create(_release, {arena}, "", _ret)
+          ->setDebugLoc(_ret->getDebugLoc());
 }
 
 /**
  * Name: CodeGenContext::verify_module
  * Construct: Method
- * Desc: Optionally verify the LLVM module
+ * Desc: Optionally verify the LLVM module, returns whether the module is
+ *   broken
+ * Args:
+ *   - out: The stream to report any problems to
  */
-void CodeGenContext::verify_module() {
-  llvm::verifyModule(*module, &llvm::outs());
+bool CodeGenContext::verify_module(llvm::raw_ostream &out) {
+  return llvm::verifyModule(*module, &out);
 }
 
 /**
@@ -121,36 +266,100 @@ void CodeGenContext::print_llvm_ir() { module->print(llvm::outs(), nullptr); }
  * Args:
  *   - filename: String reference to the filename
  */
-void CodeGenContext::print_llvm_ir_to_file(std::string &filename) {
+void CodeGenContext::print_llvm_ir_to_file(const std::string &filename) {
   std::error_code error_code;
   llvm::raw_fd_ostream ost(filename, error_code, llvm::sys::fs::F_None);
   module->print(ost, nullptr);
 }
 
+/**
+ * Name: runtime_symbols
+ * Construct: Function
+ * Desc: The Sood runtime is linked into the compiler itself, so the runtime
+ *   functions called by a module ran within the compiler resolve to the
+ *   compiler's own copies, these are their addresses by name
+ */
+const std::map<std::string, void *> &runtime_symbols() {
+  static const std::map<std::string, void *> symbols = {
+      {"sood_array_new", reinterpret_cast<void *>(&sood_array_new)},
+      {"sood_array_push", reinterpret_cast<void *>(&sood_array_push)},
+      {"sood_array_bounds_fail",
+       reinterpret_cast<void *>(&sood_array_bounds_fail)},
+      {"sood_arena_release", reinterpret_cast<void *>(&sood_arena_release)},
+      {"sood_string_init", reinterpret_cast<void *>(&sood_string_init)},
+      {"sood_string_assign", reinterpret_cast<void *>(&sood_string_assign)},
+      {"sood_string_append", reinterpret_cast<void *>(&sood_string_append)},
+      {"sood_string_concat", reinterpret_cast<void *>(&sood_string_concat)},
+      {"sood_string_equal", reinterpret_cast<void *>(&sood_string_equal)},
+      {"sood_profile_register",
+       reinterpret_cast<void *>(&sood_profile_register)},
+  };
+  return symbols;
+}
+
+/** Makes the runtime's functions visible to the execution engine */
+static void register_runtime_symbols() {
+  for (auto &symbol : runtime_symbols())
+    llvm::sys::DynamicLibrary::AddSymbol(symbol.first, symbol.second);
+}
+
+/**
+ * Name: CodeGenContext::code_load
+ * Construct: Method
+ * Desc: Compiles the module for the host with MCJIT, along with the objects
+ *   of any imported modules, into the LLVM execution engine returned, which
+ *   then owns the module. Without the host's target initialized (see
+ *   `get_target_machine`) the engine would fall back to interpreting the IR
+ */
+llvm::ExecutionEngine *CodeGenContext::code_load() {
+  register_runtime_symbols();
+  get_target_machine();
+  std::string err;
+  llvm::ExecutionEngine *engine =
+      llvm::EngineBuilder(std::unique_ptr<llvm::Module>(module))
+          .setEngineKind(llvm::EngineKind::JIT)
+          .setErrorStr(&err)
+          .create();
+  if (!engine)
+    throw CodeGenException("Could not create the execution engine: " + err);
+  if (perf_map)
+    for (llvm::JITEventListener *listener : perf_listeners())
+      engine->RegisterJITEventListener(listener);
+  /** The functions of imported modules are those of their objects */
+  for (auto &imported : imported_modules) {
+    auto object =
+        llvm::object::ObjectFile::createObjectFile(imported.second.object);
+    if (!object)
+      throw CodeGenException("Could not load " + imported.second.object +
+                             ": " + llvm::toString(object.takeError()));
+    engine->addObjectFile(std::move(*object));
+  }
+  engine->finalizeObject();
+  engine->runStaticConstructorsDestructors(false);
+  return engine;
+}
+
 /**
  * Name: CodeGenContext::code_run
  * Construct: Method
  * Desc: Runs the main function of the module with the LLVM execution engine
+ *   (see `code_load`)
  */
 llvm::GenericValue CodeGenContext::code_run() {
-  llvm::ExecutionEngine *engine =
-      llvm::EngineBuilder(std::unique_ptr<llvm::Module>(module)).create();
-  engine->finalizeObject();
+  if (!fn_main)
+    throw CodeGenException("The module has no main function to run");
+  llvm::ExecutionEngine *engine = code_load();
   std::vector<llvm::GenericValue> no_args;
   llvm::GenericValue v = engine->runFunction(fn_main, no_args);
   return v;
 }
 
 /**
- * Name: CodeGenContext::write_object
- * Construct: Method
- * Desc: Optionally write module, as native object code, to the specified
- *   filename
- * Args:
- *   - filename: String reference to the filename
+ * Name: create_host_target_machine
+ * Construct: Function
+ * Desc: Initializes LLVM's targets and creates a target machine for the host
  */
-int CodeGenContext::write_object(std::string &filename) {
-
+static llvm::TargetMachine *create_host_target_machine() {
   llvm::InitializeAllTargetInfos();
   llvm::InitializeAllTargets();
   llvm::InitializeAllTargetMCs();
@@ -158,14 +367,13 @@ int CodeGenContext::write_object(std::string &filename) {
   llvm::InitializeAllAsmPrinters();
 
   std::string target_triple = llvm::sys::getDefaultTargetTriple();
-  module->setTargetTriple(target_triple);
 
   std::string err;
   const llvm::Target *target =
       llvm::TargetRegistry::lookupTarget(target_triple, err);
   if (!target) {
     llvm::errs() << err;
-    return 1;
+    return nullptr;
   }
 
   /**
@@ -174,19 +382,43 @@ int CodeGenContext::write_object(std::string &filename) {
    *   relocation model
    */
   llvm::TargetOptions opt;
-  llvm::TargetMachine *target_machine = target->createTargetMachine(
-      target_triple, "generic", "", opt, llvm::Reloc::PIC_);
+  return target->createTargetMachine(target_triple, "generic", "", opt,
+                                     llvm::Reloc::PIC_);
+}
 
+/**
+ * Name: CodeGenContext::get_target_machine
+ * Construct: Method
+ * Desc: Returns the target machine for the host and sets the module's target
+ *   triple and data layout to match, this is needed by both the optimizer's
+ *   cost models and the writing of object code. The target machine is created
+ *   once per process and shared by every CodeGenContext, so only the first
+ *   compile (e.g. of `sood serve`) pays for initializing LLVM's targets
+ */
+llvm::TargetMachine *CodeGenContext::get_target_machine() {
+  static llvm::TargetMachine *host_target_machine =
+      create_host_target_machine();
+
+  target_machine = host_target_machine;
+  if (!target_machine)
+    return nullptr;
+
+  module->setTargetTriple(target_machine->getTargetTriple().str());
   module->setDataLayout(target_machine->createDataLayout());
 
-  std::error_code error_code;
-  llvm::raw_fd_ostream dest(filename, error_code, llvm::sys::fs::OF_None);
+  return target_machine;
+}
 
-  if (error_code) {
-    llvm::errs() << "File open error { " << filename
-                 << " }: " << error_code.message();
+/**
+ * Name: CodeGenContext::write_object
+ * Construct: Method
+ * Desc: Write module, as native object code, to a stream
+ * Args:
+ *   - dest: The stream to write the object code to
+ */
+int CodeGenContext::write_object(llvm::raw_pwrite_stream &dest) {
+  if (!get_target_machine())
     return 1;
-  }
 
   llvm::legacy::PassManager pass;
   llvm::CodeGenFileType file_type = llvm::CGFT_ObjectFile;
@@ -197,9 +429,56 @@ int CodeGenContext::write_object(std::string &filename) {
   }
 
   pass.run(*module);
+  return 0;
+}
+
+/**
+ * Name: CodeGenContext::write_object
+ * Construct: Method
+ * Desc: Optionally write module, as native object code, to the specified
+ *   filename
+ * Args:
+ *   - filename: String reference to the filename
+ */
+int CodeGenContext::write_object(std::string &filename) {
+  std::error_code error_code;
+  llvm::raw_fd_ostream dest(filename, error_code, llvm::sys::fs::OF_None);
+
+  if (error_code) {
+    llvm::errs() << "File open error { " << filename
+                 << " }: " << error_code.message();
+    return 1;
+  }
+
+  if (write_object(dest))
+    return 1;
   dest.flush();
 
   llvm::outs() << "LLVM: Object code written to { " + filename + " }\n";
 
   return 0;
 }
+
+/**
+ * Name: CodeGenContext::write_bitcode
+ * Construct: Method
+ * Desc: Write module, as LLVM bitcode, to a stream. With `thin_lto` the
+ *   bitcode has a ThinLTO summary of its functions and their calls, for
+ *   optimization across modules when they're linked (see src/lto.cpp)
+ * Args:
+ *   - dest: The stream to write the bitcode to
+ */
+int CodeGenContext::write_bitcode(llvm::raw_ostream &dest) {
+  if (!get_target_machine())
+    return 1;
+
+  if (!thin_lto) {
+    llvm::WriteBitcodeToFile(*module, dest);
+    return 0;
+  }
+
+  llvm::legacy::PassManager pass;
+  pass.add(llvm::createWriteThinLTOBitcodePass(dest));
+  pass.run(*module);
+  return 0;
+}
@@ -0,0 +1,142 @@
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <llvm/Support/Path.h>
+
+#include "ast.hpp"
+#include "codegen.hpp"
+
+/**
+ * Name: src/codegen-debug.cpp
+ * Construct: Module
+ * Desc: DWARF debug information (`-g`), a compile unit for the source, a
+ *   subprogram for each function, and the location in the source of each
+ *   statement's instructions, so debuggers and profilers (`gdb`, `perf`) map
+ *   the code of a Sood binary back to its source lines
+ * Notes:
+ *   - Locations are by statement, the expressions of a statement share its
+ *     location
+ *   - Variables are not described, only their code's locations
+ */
+
+/** The producer named by the compile unit */
+static const char *DEBUG_PRODUCER = "sood";
+
+/**
+ * Name: CodeGenContext::create_debug_unit
+ * Construct: Method
+ * Desc: Creates the builder of the debug information and the compile unit of
+ *   the source, on the first function to describe
+ */
+void CodeGenContext::create_debug_unit() {
+  di_builder.reset(new llvm::DIBuilder(*module));
+
+  llvm::SmallString<128> _path(source_file.empty() ? "<stdin>" : source_file);
+  llvm::sys::fs::make_absolute(_path);
+  di_file = di_builder->createFile(llvm::sys::path::filename(_path),
+                                   llvm::sys::path::parent_path(_path));
+
+  /** DWARF has no language code for Sood, C is the nearest */
+  di_builder->createCompileUnit(llvm::dwarf::DW_LANG_C, di_file,
+                                DEBUG_PRODUCER, true, "", 0);
+
+  module->addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                        llvm::DEBUG_METADATA_VERSION);
+  module->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+}
+
+/**
+ * Name: CodeGenContext::debug_type
+ * Construct: Method
+ * Desc: The debug type of an LLVM type of the language, strings and arrays
+ *   are described as pointers to opaque types of their names
+ * Args:
+ *   - type: The LLVM type, or null for `void`
+ */
+llvm::DIType *CodeGenContext::debug_type(llvm::Type *type) {
+  if (!type || type->isVoidTy())
+    return nullptr;
+
+  auto it = di_types.find(type);
+  if (it != di_types.end())
+    return it->second;
+
+  llvm::DIType *_di_type;
+  if (type == INTEGER_TYPE)
+    _di_type =
+        di_builder->createBasicType("integer", 64, llvm::dwarf::DW_ATE_signed);
+  else if (type == DOUBLE_TYPE)
+    _di_type =
+        di_builder->createBasicType("float", 64, llvm::dwarf::DW_ATE_float);
+  else if (type->isIntegerTy(1))
+    _di_type =
+        di_builder->createBasicType("boolean", 8, llvm::dwarf::DW_ATE_boolean);
+  else
+    _di_type = di_builder->createPointerType(
+        di_builder->createUnspecifiedType(type == STRING_TYPE ? "string"
+                                                              : "array"),
+        64);
+
+  di_types[type] = _di_type;
+  return _di_type;
+}
+
+/**
+ * Name: CodeGenContext::debug_function
+ * Construct: Method
+ * Desc: Describes a function as a subprogram of the compile unit, returns
+ *   the subprogram, or null without debug information
+ * Args:
+ *   - fn: The function
+ *   - name: The name of the function in the source
+ *   - node: The node declaring the function, for its location
+ */
+llvm::DISubprogram *CodeGenContext::debug_function(llvm::Function *fn,
+                                                   const std::string &name,
+                                                   const Node &node) {
+  if (!debug_info)
+    return nullptr;
+  if (!di_builder)
+    create_debug_unit();
+
+  std::vector<llvm::Metadata *> _types = {debug_type(fn->getReturnType())};
+  for (llvm::Argument &_arg : fn->args())
+    _types.push_back(debug_type(_arg.getType()));
+
+  llvm::DISubprogram::DISPFlags _flags = llvm::DISubprogram::SPFlagDefinition;
+  if (fn->hasLocalLinkage())
+    _flags |= llvm::DISubprogram::SPFlagLocalToUnit;
+
+  llvm::DISubprogram *_subprogram = di_builder->createFunction(
+      di_file, name, llvm::StringRef(), di_file, node.line,
+      di_builder->createSubroutineType(
+          di_builder->getOrCreateTypeArray(_types)),
+      node.line, llvm::DINode::FlagPrototyped, _flags);
+  fn->setSubprogram(_subprogram);
+  return _subprogram;
+}
+
+/**
+ * Name: CodeGenContext::set_debug_location
+ * Construct: Method
+ * Desc: Gives the instructions generated from here on the location of a
+ *   node, within the current function's subprogram (see `di_scope`)
+ * Args:
+ *   - node: The node whose code is to be generated
+ */
+void CodeGenContext::set_debug_location(const Node &node) {
+  if (!di_scope)
+    return;
+  BUILDER.SetCurrentDebugLocation(
+      llvm::DILocation::get(LLVM_CTX, node.line, node.column, di_scope));
+}
+
+/**
+ * Name: CodeGenContext::finalize_debug_info
+ * Construct: Method
+ * Desc: Completes the debug information once the code of the module has
+ *   been generated, before it's verified or written
+ */
+void CodeGenContext::finalize_debug_info() {
+  BUILDER.SetCurrentDebugLocation(llvm::DebugLoc());
+  if (di_builder)
+    di_builder->finalize();
+}
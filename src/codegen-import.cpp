@@ -0,0 +1,376 @@
+#include <algorithm>
+
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/DebugInfo.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <spdlog/spdlog.h>
+
+#include "ast.hpp"
+#include "codegen.hpp"
+
+/**
+ * Name: src/codegen-import.cpp
+ * Construct: Module
+ * Desc: Modules and `import`, a source compiled with `--emit-interface` is a
+ *   module of functions for other programs to import, compiled once to an
+ *   object of its own along with an interface (`<name>.sif`). The interface
+ *   is LLVM bitcode holding:
+ *   - The signature of each of the module's functions, as written in Sood,
+ *     in the named metadata `sood.functions`
+ *   - The module's name and the path of its object, in `sood.module`, and
+ *     the modules it imports itself, in `sood.imports`
+ *   - A declaration of each function and, for the small functions which can
+ *     be inlined into the importer (see `inlinable`), their optimized bodies
+ *     as `available_externally` definitions
+ *   An import declares the module's functions, links in those bodies when
+ *   inlining (`--inline`), and links the program with the module's object
+ * Notes:
+ *   - The functions of a module are named `sood.<module>.<function>` in its
+ *     object, so two modules may have functions of the same name, and a
+ *     function declared in the source hides an imported one of its name
+ */
+
+/**
+ * Name: export_name
+ * Construct: Function
+ * Desc: The name of a module's function in its object code
+ * Args:
+ *   - module: The name of the module
+ *   - function: The name of the function in Sood
+ */
+static std::string export_name(const std::string &module,
+                               const std::string &function) {
+  return "sood." + module + "." + function;
+}
+
+/** The Sood signatures of the top-level functions of a module's AST */
+static std::vector<NFunctionDeclaration *> top_level_functions(NBlock &root) {
+  std::vector<NFunctionDeclaration *> fns;
+  for (NStatement *stmt : root.stmts)
+    if (NFunctionDeclaration *fn = dynamic_cast<NFunctionDeclaration *>(stmt))
+      fns.push_back(fn);
+  return fns;
+}
+
+/**
+ * Name: CodeGenContext::code_generate_module
+ * Construct: Method
+ * Desc: Generates the code of a module to be imported by other programs
+ *   (`--emit-interface`), rather than that of a program: its functions, with
+ *   external linkage under their exported names (see `export_name`), and no
+ *   `main`
+ * Args:
+ *   - root: The root block of the module's AST, which may only declare
+ *     functions and import other modules
+ *   - name: The name of the module
+ */
+void CodeGenContext::code_generate_module(NBlock &root,
+                                          const std::string &name) {
+  module_name = name;
+  BUILDER.ClearInsertionPoint();
+
+  for (NStatement *stmt : root.stmts) {
+    if (!dynamic_cast<NFunctionDeclaration *>(stmt) &&
+        !dynamic_cast<NImport *>(stmt))
+      throw CodeGenException("Module " + name +
+                             " may only declare functions and import modules");
+    stmt->code_generate(*this);
+  }
+
+  for (NFunctionDeclaration *fn : top_level_functions(root)) {
+    llvm::Function *_fn = module->getFunction(fn->id.val);
+    _fn->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    _fn->setName(export_name(name, fn->id.val));
+  }
+
+  if (profile)
+    instrument_profile();
+  finalize_debug_info();
+}
+
+/** Whether a type is of a string, array, or arena, the types of the runtime */
+static bool is_runtime_type(llvm::Type *type) {
+  if (type->isPointerTy())
+    type = type->getPointerElementType();
+  return type->isStructTy();
+}
+
+/**
+ * Name: inlinable
+ * Construct: Function
+ * Desc: Whether the body of an exported function is written to the interface,
+ *   for importers to inline. As for the inliner (see
+ *   `CodeGenContext::inline_small_functions`) it must be a single block or
+ *   cost no more than the threshold, and it must not use the runtime's
+ *   types, nor the module's internal functions or variables, which the
+ *   importer can't refer to
+ * Args:
+ *   - fn: The exported function
+ *   - threshold: The largest cost of a multi-block function to inline
+ */
+static bool inlinable(llvm::Function &fn, unsigned threshold) {
+  if (is_runtime_type(fn.getReturnType()))
+    return false;
+  for (llvm::Argument &arg : fn.args())
+    if (is_runtime_type(arg.getType()))
+      return false;
+
+  unsigned cost = 0;
+  for (llvm::BasicBlock &bb : fn)
+    for (llvm::Instruction &inst : bb) {
+      if (!llvm::isa<llvm::AllocaInst>(inst))
+        cost++;
+      if (is_runtime_type(inst.getType()))
+        return false;
+      for (llvm::Value *op : inst.operands()) {
+        if (is_runtime_type(op->getType()))
+          return false;
+        if (llvm::Function *callee = llvm::dyn_cast<llvm::Function>(op))
+          if (callee->hasLocalLinkage())
+            return false;
+        if (llvm::GlobalVariable *var =
+                llvm::dyn_cast<llvm::GlobalVariable>(op->stripPointerCasts()))
+          if (!var->isConstant())
+            return false;
+      }
+    }
+  return fn.size() == 1 || cost <= threshold;
+}
+
+/** A tuple of metadata strings */
+static llvm::MDTuple *string_tuple(const std::vector<std::string> &strs) {
+  std::vector<llvm::Metadata *> mds;
+  for (const std::string &str : strs)
+    mds.push_back(llvm::MDString::get(LLVM_CTX, str));
+  return llvm::MDTuple::get(LLVM_CTX, mds);
+}
+
+/** The strings of a tuple of metadata strings */
+static std::vector<std::string> tuple_strings(const llvm::MDNode *node) {
+  std::vector<std::string> strs;
+  for (const llvm::MDOperand &op : node->operands())
+    if (llvm::MDString *str = llvm::dyn_cast_or_null<llvm::MDString>(op.get()))
+      strs.push_back(str->getString().str());
+  return strs;
+}
+
+/**
+ * Name: CodeGenContext::write_interface
+ * Construct: Method
+ * Desc: Writes the interface of a module generated by `code_generate_module`,
+ *   from its optimized code, returns non-zero on failure
+ * Args:
+ *   - root: The root block of the module's AST
+ *   - path: The path of the interface
+ *   - object: The path of the module's object, written to the interface
+ *     relative to the interface if in the same directory
+ */
+int CodeGenContext::write_interface(NBlock &root, const std::string &path,
+                                    const std::string &object) {
+  get_target_machine();
+  std::unique_ptr<llvm::Module> _interface = llvm::CloneModule(*module);
+  llvm::StripDebugInfo(*_interface);
+
+  /**
+   * Bodies which are not inlinable are dropped, then whatever only those
+   *   referred to (internal functions, variables, constructors)
+   */
+  std::vector<llvm::GlobalValue *> _locals;
+  for (llvm::Function &_fn : *_interface) {
+    if (_fn.hasLocalLinkage())
+      _locals.push_back(&_fn);
+    if (_fn.isDeclaration())
+      continue;
+    if (!_fn.hasLocalLinkage() && inlinable(_fn, inline_threshold))
+      _fn.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+    else
+      _fn.deleteBody();
+  }
+  std::vector<llvm::GlobalVariable *> _vars;
+  for (llvm::GlobalVariable &_var : _interface->globals())
+    _vars.push_back(&_var);
+  for (llvm::GlobalVariable *_var : _vars) {
+    if (_var->hasAppendingLinkage())
+      _var->eraseFromParent();
+    else if (_var->hasLocalLinkage())
+      _locals.push_back(_var);
+  }
+  for (llvm::GlobalValue *_local : _locals) {
+    if (!_local->use_empty())
+      continue;
+    if (llvm::GlobalVariable *_var = llvm::dyn_cast<llvm::GlobalVariable>(_local))
+      _var->eraseFromParent();
+    else
+      llvm::cast<llvm::Function>(_local)->eraseFromParent();
+  }
+
+  std::string _object = object;
+  if (llvm::sys::path::parent_path(object) == llvm::sys::path::parent_path(path))
+    _object = llvm::sys::path::filename(object).str();
+  _interface->getOrInsertNamedMetadata("sood.module")
+      ->addOperand(string_tuple({module_name, _object}));
+
+  llvm::NamedMDNode *_functions =
+      _interface->getOrInsertNamedMetadata("sood.functions");
+  for (NFunctionDeclaration *fn : top_level_functions(root)) {
+    std::vector<std::string> _signature = {fn->id.val, fn->type.val};
+    for (NVariableDeclaration *arg : fn->args)
+      _signature.push_back(arg->type.val);
+    _functions->addOperand(string_tuple(_signature));
+  }
+
+  std::vector<std::string> _imports;
+  for (auto &imported : imported_modules)
+    _imports.push_back(imported.first);
+  _interface->getOrInsertNamedMetadata("sood.imports")
+      ->addOperand(string_tuple(_imports));
+
+  std::error_code error_code;
+  llvm::raw_fd_ostream out(path, error_code, llvm::sys::fs::OF_None);
+  if (error_code) {
+    spdlog::error("Could not write interface {}: {}", path,
+                  error_code.message());
+    return 1;
+  }
+  llvm::WriteBitcodeToFile(*_interface, out);
+  return 0;
+}
+
+/**
+ * Name: find_interface
+ * Construct: Function
+ * Desc: The path of the interface of a module, the first found in the
+ *   directories searched, or an empty string
+ * Args:
+ *   - name: The name of the module
+ *   - dirs: The directories to search
+ */
+static std::string find_interface(const std::string &name,
+                                  const std::vector<std::string> &dirs) {
+  for (const std::string &dir : dirs) {
+    llvm::SmallString<128> _path(dir);
+    llvm::sys::path::append(_path, name + ".sif");
+    if (llvm::sys::fs::exists(_path))
+      return _path.str().str();
+  }
+  return "";
+}
+
+/**
+ * Name: CodeGenContext::import_module
+ * Construct: Method
+ * Desc: Imports a module by its interface (see `write_interface`): declares
+ *   its functions for the program to call, links in their inlinable bodies
+ *   when inlining, and imports the modules it imports itself, whose objects
+ *   must also be linked. A module is only imported once
+ * Args:
+ *   - name: The name of the module
+ */
+void CodeGenContext::import_module(const std::string &name) {
+  if (imported_modules.count(name))
+    return;
+
+  std::string _path = find_interface(name, import_paths);
+  if (_path.empty())
+    throw CodeGenException("No interface " + name + ".sif found to import");
+  auto _buffer = llvm::MemoryBuffer::getFile(_path);
+  if (!_buffer)
+    throw CodeGenException("Could not read interface " + _path + ": " +
+                           _buffer.getError().message());
+  auto _read = llvm::parseBitcodeFile((*_buffer)->getMemBufferRef(), LLVM_CTX);
+  if (!_read)
+    throw CodeGenException("Could not read interface " + _path + ": " +
+                           llvm::toString(_read.takeError()));
+  std::unique_ptr<llvm::Module> _interface = std::move(*_read);
+
+  llvm::NamedMDNode *_module = _interface->getNamedMetadata("sood.module");
+  llvm::NamedMDNode *_functions =
+      _interface->getNamedMetadata("sood.functions");
+  llvm::NamedMDNode *_imports = _interface->getNamedMetadata("sood.imports");
+  std::vector<std::string> _names;
+  if (_module && _module->getNumOperands())
+    _names = tuple_strings(_module->getOperand(0));
+  if (_names.size() != 2 || _names[0] != name || !_functions || !_imports)
+    throw CodeGenException("Interface " + _path + " is not of module " + name);
+
+  /** The paths of the module's object and imports are relative to its own */
+  llvm::SmallString<128> _object(llvm::sys::path::parent_path(_path));
+  if (llvm::sys::path::is_absolute(_names[1]))
+    _object = _names[1];
+  else
+    llvm::sys::path::append(_object, _names[1]);
+  imported_modules[name] = {_path, _object.str().str()};
+  spdlog::debug("Importing module {} from {}", name, _path);
+
+  std::string _dir = llvm::sys::path::parent_path(_path).str();
+  if (_dir.empty())
+    _dir = ".";
+  if (std::find(import_paths.begin(), import_paths.end(), _dir) ==
+      import_paths.end())
+    import_paths.push_back(_dir);
+  if (_imports->getNumOperands())
+    for (const std::string &_import : tuple_strings(_imports->getOperand(0)))
+      import_module(_import);
+
+  /**
+   * The functions are declared as those of the source are, from their
+   *   signatures, so they have the types of the program's module, then given
+   *   their exported names and the calling convention they were compiled with
+   */
+  std::vector<const llvm::MDNode *> _signatures(_functions->op_begin(),
+                                                _functions->op_end());
+  for (const llvm::MDNode *_signature : _signatures) {
+    std::vector<std::string> _sig = tuple_strings(_signature);
+    if (_sig.size() < 2)
+      throw CodeGenException("Interface " + _path + " is malformed");
+    NVariableList _args;
+    for (std::size_t i = 2; i < _sig.size(); i++)
+      _args.push_back(new NVariableDeclaration(*new NIdentifier(_sig[i]),
+                                               *new NIdentifier("")));
+    NFunctionDeclaration _decl(*new NIdentifier(_sig[1]),
+                               *new NIdentifier(_sig[0]), _args,
+                               *new NBlock());
+
+    std::string _symbol = export_name(name, _sig[0]);
+    llvm::Function *_fn = _decl.declare(*this);
+    _fn->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    _fn->setName(_symbol);
+    if (llvm::Function *_compiled = _interface->getFunction(_symbol))
+      _fn->setCallingConv(_compiled->getCallingConv());
+    imported_functions[_sig[0]] = _fn;
+  }
+
+  /**
+   * Only what the declarations need is linked, that is, their bodies. The
+   *   linker replaces a declaration with a new function for its body
+   */
+  if (!inlining)
+    return;
+  _interface->eraseNamedMetadata(_module);
+  _interface->eraseNamedMetadata(_functions);
+  _interface->eraseNamedMetadata(_imports);
+  if (llvm::Linker::linkModules(*module, std::move(_interface),
+                                llvm::Linker::Flags::LinkOnlyNeeded))
+    throw CodeGenException("Could not link the interface " + _path);
+  for (const llvm::MDNode *_signature : _signatures)
+    imported_functions[tuple_strings(_signature)[0]] = module->getFunction(
+        export_name(name, tuple_strings(_signature)[0]));
+}
+
+/**
+ * Name: CodeGenContext::get_function
+ * Construct: Method
+ * Desc: The function called by a name, one of the module's own or else one
+ *   of an imported module, or null
+ * Args:
+ *   - name: The name of the function in Sood
+ */
+llvm::Function *CodeGenContext::get_function(const std::string &name) {
+  if (llvm::Function *_fn = module->getFunction(name))
+    return _fn;
+  auto it = imported_functions.find(name);
+  return it == imported_functions.end() ? nullptr : it->second;
+}
@@ -0,0 +1,223 @@
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Transforms/Instrumentation.h>
+#include <spdlog/spdlog.h>
+
+#include "codegen.hpp"
+
+/**
+ * Name: src/codegen-optimize.cpp
+ * Construct: Module
+ * Desc: The optimization passes ran over the module between verification and
+ *   output, kept apart from `src/codegen-context.cpp` which only builds and
+ *   writes the module
+ */
+
+/**
+ * Name: inline_cost
+ * Construct: Function
+ * Desc: A rough estimate of the cost of inlining a function, this is the
+ *   number of instructions in the function's reachable blocks (allocas
+ *   excluded as they are hoisted to the caller's entry block by the inliner)
+ * Args:
+ *   - fn: The function whose body would be inlined
+ */
+static unsigned inline_cost(llvm::Function &fn) {
+  unsigned cost = 0;
+  for (llvm::BasicBlock &bb : fn)
+    for (llvm::Instruction &inst : bb)
+      if (!llvm::isa<llvm::AllocaInst>(inst))
+        cost++;
+  return cost;
+}
+
+/**
+ * Name: is_self_recursive
+ * Construct: Function
+ * Desc: Whether the function contains a call to itself, these are left to tail
+ *   call elimination rather than inlined
+ * Args:
+ *   - fn: The function to check
+ */
+static bool is_self_recursive(llvm::Function &fn) {
+  for (llvm::User *user : fn.users())
+    if (llvm::CallBase *call = llvm::dyn_cast<llvm::CallBase>(user))
+      if (call->getFunction() == &fn)
+        return true;
+  return false;
+}
+
+/** How many times `inline_threshold` a callee hot in the profile may cost */
+static const unsigned HOT_INLINE_FACTOR = 4;
+
+/**
+ * Name: CodeGenContext::inline_small_functions
+ * Construct: Method
+ * Desc: Inlines calls to the module's internal functions, and those of
+ *   imported modules whose bodies are in their interfaces, where the callee
+ *   is either a single block (the `func_decl_single` form, for example) or
+ *   its cost (see `inline_cost`) is within `inline_threshold`, each inlined
+ *   call is reported
+ * Notes:
+ *   - With a profile (`--pgo-use`), the calls of callees the profile found
+ *     cold are left as calls, and callees it found hot may cost
+ *     `HOT_INLINE_FACTOR` times the threshold
+ */
+void CodeGenContext::inline_small_functions() {
+  std::vector<llvm::CallBase *> calls;
+  llvm::ProfileSummaryInfo psi(*module);
+
+  /**
+   * The blocks following each `return` are unreachable, these are removed
+   *   first so they count towards neither the block count nor the cost
+   */
+  for (llvm::Function &fn : *module) {
+    if (fn.isDeclaration())
+      continue;
+    llvm::removeUnreachableBlocks(fn);
+    for (llvm::BasicBlock &bb : fn)
+      for (llvm::Instruction &inst : bb)
+        if (llvm::CallBase *call = llvm::dyn_cast<llvm::CallBase>(&inst))
+          calls.push_back(call);
+  }
+
+  for (llvm::CallBase *call : calls) {
+    llvm::Function *callee = call->getCalledFunction();
+    if (!callee || callee->isDeclaration() ||
+        !(callee->hasLocalLinkage() ||
+          callee->hasAvailableExternallyLinkage()) ||
+        is_self_recursive(*callee))
+      continue;
+
+    unsigned threshold = inline_threshold;
+    if (psi.hasProfileSummary()) {
+      if (psi.isFunctionEntryCold(callee))
+        continue;
+      if (psi.isFunctionEntryHot(callee))
+        threshold *= HOT_INLINE_FACTOR;
+    }
+
+    unsigned cost = inline_cost(*callee);
+    if (callee->size() > 1 && cost > threshold)
+      continue;
+
+    std::string callee_name = callee->getName().str();
+    std::string caller_name = call->getFunction()->getName().str();
+    llvm::InlineFunctionInfo ifi;
+    if (llvm::InlineFunction(*call, ifi).isSuccess())
+      spdlog::info("Inlined {} into {} (cost {})", callee_name, caller_name,
+                   cost);
+  }
+}
+
+/**
+ * Name: CodeGenContext::remove_dead_functions
+ * Construct: Method
+ * Desc: Removes any internal functions (and globals) no longer referenced,
+ *   whether they were never called or all of their calls have been inlined,
+ *   each removed function is reported
+ */
+void CodeGenContext::remove_dead_functions() {
+  std::vector<std::string> internal_fns;
+  for (llvm::Function &fn : *module)
+    if (fn.hasLocalLinkage())
+      internal_fns.push_back(fn.getName().str());
+
+  llvm::legacy::PassManager mpm;
+  mpm.add(llvm::createGlobalDCEPass());
+  mpm.run(*module);
+
+  for (std::string &name : internal_fns)
+    if (!module->getFunction(name))
+      spdlog::info("Removed unreferenced function {}", name);
+}
+
+/**
+ * Name: CodeGenContext::apply_pgo
+ * Construct: Method
+ * Desc: Profile-guided optimization, ran before any other optimization so the
+ *   control flow of each function is the same when instrumented and when its
+ *   profile is used:
+ *   - `--pgo-instrument` counts the edges of each function's control flow
+ *     graph, the counters written to a raw profile by runtime/pgo.c
+ *   - `--pgo-use` reads a profile (merged by `llvm-profdata merge`) back as
+ *     branch weights and entry counts, which guide the inliner (see
+ *     `inline_small_functions`) and the layout of blocks in the object code
+ */
+void CodeGenContext::apply_pgo() {
+  /** The sections of the counters are named for the target */
+  get_target_machine();
+
+  llvm::legacy::PassManager mpm;
+  if (!pgo_use.empty()) {
+    if (!llvm::sys::fs::exists(pgo_use))
+      throw CodeGenException("Profile " + pgo_use + " does not exist");
+    mpm.add(llvm::createPGOInstrumentationUseLegacyPass(pgo_use));
+  }
+  if (pgo_instrument) {
+    mpm.add(llvm::createPGOInstrumentationGenLegacyPass());
+    mpm.add(llvm::createInstrProfilingLegacyPass());
+  }
+  mpm.run(*module);
+}
+
+/**
+ * Name: CodeGenContext::optimize
+ * Construct: Method
+ * Desc: Runs the module-level optimizations, if enabled, followed by the
+ *   function-level optimizations over each function defined in the module:
+ *   - Tail call elimination, which rewrites self-recursive calls in return
+ *     position into a loop back to the top of the function, so deep
+ *     recursion runs in constant stack space
+ *   - Vectorization, the variables are first promoted to registers so the
+ *     induction variables of loops are visible, the loops are put into
+ *     canonical (rotated) form, and the loop and SLP vectorizers are ran with
+ *     the host target's cost model
+ *   Profile-guided optimization, if enabled, comes first (see `apply_pgo`),
+ *   followed by purity inference and memoization (see `infer_purity`)
+ * Notes:
+ *   - The calls themselves are marked `tail` during code generation (see
+ *     `NReturnStatement::code_generate`), this pass is what guarantees the
+ *     stack frame is reused rather than leaving it to the backend
+ */
+void CodeGenContext::optimize() {
+  if (pgo_instrument || !pgo_use.empty())
+    apply_pgo();
+
+  infer_purity();
+
+  if (inlining) {
+    inline_small_functions();
+    remove_dead_functions();
+  }
+
+  llvm::legacy::FunctionPassManager fpm(module);
+
+  if (vectorize) {
+    llvm::TargetMachine *tm = get_target_machine();
+    if (tm)
+      fpm.add(llvm::createTargetTransformInfoWrapperPass(
+          tm->getTargetIRAnalysis()));
+    fpm.add(llvm::createPromoteMemoryToRegisterPass());
+    fpm.add(llvm::createInstructionCombiningPass());
+    fpm.add(llvm::createCFGSimplificationPass());
+  }
+
+  if (tail_calls)
+    fpm.add(llvm::createTailCallEliminationPass());
+
+  if (vectorize) {
+    fpm.add(llvm::createLoopRotatePass());
+    fpm.add(llvm::createLICMPass());
+    fpm.add(llvm::createIndVarSimplifyPass());
+    fpm.add(llvm::createLoopVectorizePass());
+    fpm.add(llvm::createSLPVectorizerPass());
+    fpm.add(llvm::createInstructionCombiningPass());
+    fpm.add(llvm::createCFGSimplificationPass());
+  }
+
+  fpm.doInitialization();
+  for (llvm::Function &fn : *module)
+    if (!fn.isDeclaration())
+      fpm.run(fn);
+  fpm.doFinalization();
+}
@@ -0,0 +1,223 @@
+#include <cstdio>
+#include <unistd.h>
+
+#include <llvm/ExecutionEngine/JITEventListener.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/Object/SymbolSize.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+
+#include "codegen.hpp"
+
+/**
+ * Name: src/codegen-profile.cpp
+ * Construct: Module
+ * Desc: Profiling of Sood code, `--profile` counts the calls of each function
+ *   and the cycles spent in it (see runtime/profile.c for the report), and
+ *   `--perf-map` describes code compiled in memory (`-R`, `sood repl`) to
+ *   Linux `perf`, which otherwise sees only anonymous addresses
+ */
+
+/**
+ * Name: profile_site_type
+ * Construct: Function
+ * Desc: Returns the type of the counters of a profiled function, the layout
+ *   of which matches `SoodProfileSite` of the runtime. It's created on first
+ *   use, not with the other types as that would depend on the order in which
+ *   the globals of the translation units are initialized
+ */
+static llvm::StructType *profile_site_type() {
+  static llvm::StructType *site_type = llvm::StructType::create(
+      LLVM_CTX, {BYTE_PTR_TYPE, INTEGER_TYPE, INTEGER_TYPE, INTEGER_TYPE},
+      "sood_profile_site");
+  return site_type;
+}
+
+/** The fields of `profile_site_type` */
+enum PROFILE_SITE_FIELDS { SITE_NAME, SITE_CALLS, SITE_CYCLES, SITE_DEPTH };
+
+/** Adds to a counter of a site */
+static llvm::Value *add_to_counter(llvm::IRBuilder<> &builder,
+                                   llvm::Constant *site,
+                                   PROFILE_SITE_FIELDS field,
+                                   llvm::Value *value) {
+  llvm::Value *_ptr = builder.CreateStructGEP(profile_site_type(), site, field);
+  llvm::Value *_sum =
+      builder.CreateAdd(builder.CreateLoad(INTEGER_TYPE, _ptr), value);
+  builder.CreateStore(_sum, _ptr);
+  return _sum;
+}
+
+/**
+ * Name: exit_point
+ * Construct: Function
+ * Desc: Where the exit of a function is counted for one of its returns,
+ *   before the return or, for a self-recursive call returned directly,
+ *   before the call, so the call is still in a tail position and may become
+ *   a loop (see `CodeGenContext::optimize`)
+ * Args:
+ *   - ret: The return instruction
+ */
+static llvm::Instruction *exit_point(llvm::ReturnInst *ret) {
+  llvm::Instruction *_prev = ret->getPrevNode();
+  llvm::CallInst *_call = llvm::dyn_cast_or_null<llvm::CallInst>(_prev);
+  if (_call && _call->getCalledFunction() == ret->getFunction() &&
+      (!ret->getReturnValue() || ret->getReturnValue() == _call))
+    return _call;
+  return ret;
+}
+
+/**
+ * Name: CodeGenContext::instrument_profile
+ * Construct: Method
+ * Desc: Counts the calls of each function of the module, and the cycles from
+ *   each outermost call to its return, in counters registered with the
+ *   runtime by a constructor of the module
+ * Notes:
+ *   - The counters are updated inline and without atomics, Sood programs
+ *     have a single thread
+ */
+void CodeGenContext::instrument_profile() {
+  std::vector<llvm::Function *> _fns;
+  for (llvm::Function &_fn : *module)
+    if (!_fn.isDeclarationForLinker())
+      _fns.push_back(&_fn);
+  if (_fns.empty())
+    return;
+
+  std::vector<llvm::Constant *> _inits;
+  llvm::Constant *_zero = llvm::ConstantInt::get(INTEGER_TYPE, 0);
+  for (llvm::Function *_fn : _fns) {
+    llvm::Constant *_name =
+        llvm::ConstantDataArray::getString(LLVM_CTX, _fn->getName());
+    llvm::GlobalVariable *_name_global = new llvm::GlobalVariable(
+        *module, _name->getType(), true, llvm::GlobalValue::PrivateLinkage,
+        _name, "_profile_name");
+    _inits.push_back(llvm::ConstantStruct::get(
+        profile_site_type(),
+        {llvm::ConstantExpr::getPointerCast(_name_global, BYTE_PTR_TYPE), _zero,
+         _zero, _zero}));
+  }
+  llvm::ArrayType *_sites_type =
+      llvm::ArrayType::get(profile_site_type(), _fns.size());
+  llvm::GlobalVariable *_sites = new llvm::GlobalVariable(
+      *module, _sites_type, false, llvm::GlobalValue::PrivateLinkage,
+      llvm::ConstantArray::get(_sites_type, _inits), "_profile_sites");
+
+  llvm::Function *_cycles = llvm::Intrinsic::getDeclaration(
+      module, llvm::Intrinsic::readcyclecounter);
+  llvm::Constant *_one = llvm::ConstantInt::get(INTEGER_TYPE, 1);
+
+  for (std::size_t i = 0; i < _fns.size(); i++) {
+    llvm::Function *_fn = _fns[i];
+    llvm::Constant *_site = llvm::ConstantExpr::getInBoundsGetElementPtr(
+        _sites_type, _sites,
+        llvm::ArrayRef<llvm::Constant *>(
+            {llvm::ConstantInt::get(INTEGER_TYPE, 0),
+             llvm::ConstantInt::get(INTEGER_TYPE, i)}));
+
+    std::vector<llvm::ReturnInst *> _rets;
+    for (llvm::BasicBlock &_block : *_fn)
+      if (llvm::ReturnInst *_ret =
+              llvm::dyn_cast<llvm::ReturnInst>(_block.getTerminator()))
+        _rets.push_back(_ret);
+
+    llvm::BasicBlock &_entry = _fn->getEntryBlock();
+    llvm::IRBuilder<> _builder(&_entry, _entry.getFirstInsertionPt());
+    while (llvm::isa<llvm::AllocaInst>(*_builder.GetInsertPoint()))
+      _builder.SetInsertPoint(_builder.GetInsertPoint()->getNextNode());
+    add_to_counter(_builder, _site, SITE_CALLS, _one);
+    add_to_counter(_builder, _site, SITE_DEPTH, _one);
+    llvm::Value *_start = _builder.CreateCall(_cycles, {}, "_profile_start");
+
+    for (llvm::ReturnInst *_ret : _rets) {
+      _builder.SetInsertPoint(exit_point(_ret));
+      llvm::Value *_depth = add_to_counter(
+          _builder, _site, SITE_DEPTH, llvm::ConstantInt::get(INTEGER_TYPE, -1));
+      llvm::Value *_spent =
+          _builder.CreateSub(_builder.CreateCall(_cycles, {}), _start);
+      add_to_counter(_builder, _site, SITE_CYCLES,
+                     _builder.CreateSelect(_builder.CreateICmpEQ(_depth, _zero),
+                                           _spent, _zero));
+    }
+  }
+
+  llvm::Function *_register = runtime_function(
+      "sood_profile_register",
+      llvm::FunctionType::get(
+          llvm::Type::getVoidTy(LLVM_CTX),
+          {profile_site_type()->getPointerTo(), INTEGER_TYPE}, false));
+  llvm::Function *_ctor = llvm::Function::Create(
+      llvm::FunctionType::get(llvm::Type::getVoidTy(LLVM_CTX), false),
+      llvm::GlobalValue::InternalLinkage, "_profile_register", module);
+  llvm::IRBuilder<> _builder(
+      llvm::BasicBlock::Create(LLVM_CTX, "entry", _ctor));
+  _builder.CreateCall(
+      _register,
+      {_builder.CreateConstInBoundsGEP2_64(_sites_type, _sites, 0, 0),
+       llvm::ConstantInt::get(INTEGER_TYPE, _fns.size())});
+  _builder.CreateRetVoid();
+  llvm::appendToGlobalCtors(*module, _ctor, 0);
+}
+
+/**
+ * Name: PerfMapListener
+ * Construct: Class
+ * Desc: Appends the functions of each object loaded by a JIT to
+ *   `/tmp/perf-<pid>.map`, where `perf report` looks for the names of code
+ *   which isn't in a file
+ */
+class PerfMapListener : public llvm::JITEventListener {
+  std::FILE *map = nullptr;
+
+public:
+  void notifyObjectLoaded(
+      ObjectKey, const llvm::object::ObjectFile &obj,
+      const llvm::RuntimeDyld::LoadedObjectInfo &info) override {
+    /** The object as loaded, its symbols at the addresses they were loaded to */
+    llvm::object::OwningBinary<llvm::object::ObjectFile> _loaded =
+        info.getObjectForDebug(obj);
+    if (!_loaded.getBinary())
+      return;
+    if (!map) {
+      std::string path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+      if (!(map = std::fopen(path.c_str(), "a")))
+        return;
+    }
+
+    for (auto &_sized : llvm::object::computeSymbolSizes(*_loaded.getBinary())) {
+      llvm::object::SymbolRef _sym = _sized.first;
+      auto _type = _sym.getType();
+      auto _name = _sym.getName();
+      auto _addr = _sym.getAddress();
+      if (!_type || !_name || !_addr) {
+        llvm::consumeError(_type.takeError());
+        llvm::consumeError(_name.takeError());
+        llvm::consumeError(_addr.takeError());
+        continue;
+      }
+      if (*_type != llvm::object::SymbolRef::ST_Function || !_sized.second)
+        continue;
+      std::fprintf(map, "%llx %llx %s\n", (unsigned long long)*_addr,
+                   (unsigned long long)_sized.second, _name->str().c_str());
+    }
+    std::fflush(map);
+  }
+};
+
+/**
+ * Name: perf_listeners
+ * Construct: Function
+ * Desc: The listeners describing JIT-compiled code to `perf` (`--perf-map`),
+ *   the perf map, and LLVM's jitdump writer (for `perf inject --jit`) when
+ *   LLVM was built with it. Shared by every JIT of the process
+ */
+const std::vector<llvm::JITEventListener *> &perf_listeners() {
+  static std::vector<llvm::JITEventListener *> listeners;
+  if (listeners.empty()) {
+    listeners.push_back(new PerfMapListener());
+    if (llvm::JITEventListener *jitdump =
+            llvm::JITEventListener::createPerfJITEventListener())
+      listeners.push_back(jitdump);
+  }
+  return listeners;
+}
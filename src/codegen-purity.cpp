@@ -0,0 +1,317 @@
+#include <llvm/Analysis/CFG.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <spdlog/spdlog.h>
+
+#include "codegen.hpp"
+
+/**
+ * Name: src/codegen-purity.cpp
+ * Construct: Module
+ * Desc: Purity inference over the functions of the module, those which
+ *   neither `write` nor `read`, touch no memory but their own variables, and
+ *   call only other pure functions. Pure functions are marked as such so LLVM
+ *   may combine, hoist, and remove their calls, and with `--memoize` those of
+ *   integers are given a cache of their results
+ */
+
+/** The log2 of the number of entries in the cache of a memoized function */
+static const unsigned MEMO_BITS = 12;
+
+/** Fibonacci hashing's multiplier, 2^64 divided by the golden ratio */
+static const std::uint64_t MEMO_HASH = 0x9E3779B97F4A7C15;
+
+/**
+ * Name: is_local_memory
+ * Construct: Function
+ * Desc: Whether a pointer is into one of the variables (allocas) of the
+ *   function it is used in
+ * Args:
+ *   - ptr: The pointer operand of a load or store
+ */
+static bool is_local_memory(llvm::Value *ptr) {
+  return llvm::isa<llvm::AllocaInst>(llvm::getUnderlyingObject(ptr));
+}
+
+/**
+ * Name: is_constant_memory
+ * Construct: Function
+ * Desc: Whether a pointer is into a constant global, e.g. a string literal,
+ *   which reads the same on every call
+ * Args:
+ *   - ptr: The pointer operand of a load
+ */
+static bool is_constant_memory(llvm::Value *ptr) {
+  llvm::GlobalVariable *_global = llvm::dyn_cast<llvm::GlobalVariable>(
+      llvm::getUnderlyingObject(ptr));
+  return _global && _global->isConstant();
+}
+
+/**
+ * Name: locally_pure
+ * Construct: Function
+ * Desc: Whether the instructions of a function, other than its calls of
+ *   functions defined in the module, are pure, collecting those callees
+ * Args:
+ *   - fn: The function to check
+ *   - callees: Set to the functions defined in the module which `fn` calls,
+ *     it is pure only if they are too
+ */
+static bool locally_pure(llvm::Function &fn,
+                         std::set<llvm::Function *> &callees) {
+  for (llvm::BasicBlock &bb : fn)
+    for (llvm::Instruction &inst : bb) {
+      if (llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(&inst)) {
+        if (load->isVolatile() ||
+            !(is_local_memory(load->getPointerOperand()) ||
+              is_constant_memory(load->getPointerOperand())))
+          return false;
+      } else if (llvm::StoreInst *store =
+                     llvm::dyn_cast<llvm::StoreInst>(&inst)) {
+        if (store->isVolatile() ||
+            !is_local_memory(store->getPointerOperand()))
+          return false;
+      } else if (llvm::CallBase *call = llvm::dyn_cast<llvm::CallBase>(&inst)) {
+        llvm::Function *callee = call->getCalledFunction();
+        if (!callee)
+          return false;
+        if (callee->isDeclaration()) {
+          if (!callee->doesNotAccessMemory())
+            return false;
+        } else {
+          callees.insert(callee);
+        }
+      } else if (inst.mayReadOrWriteMemory()) {
+        return false;
+      }
+    }
+  return true;
+}
+
+/**
+ * Name: pure_functions
+ * Construct: Function
+ * Desc: The functions defined in the module which are pure, see
+ *   `locally_pure`
+ * Args:
+ *   - module: The module to search
+ *   - callees: Set to the callees of each pure function, see `locally_pure`
+ * Notes:
+ *   - Every function whose own instructions are pure is assumed pure, then
+ *     those calling a function found not to be are removed until none are,
+ *     so (mutually) recursive functions may be pure
+ */
+static std::set<llvm::Function *>
+pure_functions(llvm::Module &module,
+               std::map<llvm::Function *, std::set<llvm::Function *>> &callees) {
+  std::set<llvm::Function *> pure;
+  for (llvm::Function &fn : module)
+    if (!fn.isDeclaration() && locally_pure(fn, callees[&fn]))
+      pure.insert(&fn);
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto it = pure.begin(); it != pure.end();) {
+      bool impure = false;
+      for (llvm::Function *callee : callees[*it])
+        impure |= !pure.count(callee);
+      if (impure) {
+        it = pure.erase(it);
+        changed = true;
+      } else {
+        it++;
+      }
+    }
+  }
+  return pure;
+}
+
+/**
+ * Name: returning_functions
+ * Construct: Function
+ * Desc: The pure functions which certainly return, those without loops whose
+ *   callees certainly return too
+ * Args:
+ *   - pure: The pure functions, see `pure_functions`
+ *   - callees: The callees of each pure function
+ * Notes:
+ *   - Unlike purity, a function is only added once all of its callees are,
+ *     so no recursive function (which might recurse forever) is included
+ */
+static std::set<llvm::Function *> returning_functions(
+    const std::set<llvm::Function *> &pure,
+    std::map<llvm::Function *, std::set<llvm::Function *>> &callees) {
+  std::set<llvm::Function *> candidates;
+  for (llvm::Function *fn : pure) {
+    llvm::SmallVector<std::pair<const llvm::BasicBlock *,
+                                const llvm::BasicBlock *>, 4> backedges;
+    llvm::FindFunctionBackedges(*fn, backedges);
+    if (backedges.empty())
+      candidates.insert(fn);
+  }
+
+  std::set<llvm::Function *> returning;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (llvm::Function *fn : candidates) {
+      if (returning.count(fn))
+        continue;
+      bool returns = true;
+      for (llvm::Function *callee : callees[fn])
+        returns &= callee != fn && returning.count(callee);
+      if (returns) {
+        returning.insert(fn);
+        changed = true;
+      }
+    }
+  }
+  return returning;
+}
+
+/**
+ * Name: memoizable
+ * Construct: Function
+ * Desc: Whether a pure function may be memoized, it must take only integers
+ *   (at least one), return a number, and have a body the module may replace
+ * Args:
+ *   - fn: The pure function
+ */
+static bool memoizable(llvm::Function &fn) {
+  if (fn.isDeclarationForLinker() || fn.arg_empty())
+    return false;
+  llvm::Type *_ret = fn.getReturnType();
+  if (_ret != INTEGER_TYPE && _ret != DOUBLE_TYPE)
+    return false;
+  for (llvm::Argument &arg : fn.args())
+    if (arg.getType() != INTEGER_TYPE)
+      return false;
+  return true;
+}
+
+/**
+ * Name: memoize_function
+ * Construct: Function
+ * Desc: Puts a cache in front of a pure function. The function is renamed
+ *   `<name>.uncached` and a function of its name and type takes its place,
+ *   including in its own recursive calls, which looks its arguments up in a
+ *   table of `2^MEMO_BITS` entries before calling the original
+ * Args:
+ *   - fn: The pure function, see `memoizable`
+ * Notes:
+ *   - The table is direct-mapped, indexed by a Fibonacci hash of the
+ *     arguments, an entry is overwritten by the next result to hash to it.
+ *     It needs no allocation and its memory is bounded, whereas a growing
+ *     table would keep every result of a long-running program
+ *   - The entry is written after the call returns, so results of recursive
+ *     calls are in the table before those of their callers
+ */
+static void memoize_function(llvm::Function &fn) {
+  llvm::Module &_module = *fn.getParent();
+  std::string _name = fn.getName().str();
+
+  std::vector<llvm::Type *> _fields = {llvm::Type::getInt8Ty(LLVM_CTX)};
+  _fields.insert(_fields.end(), fn.arg_size(), INTEGER_TYPE);
+  _fields.push_back(fn.getReturnType());
+  llvm::StructType *_entry_type = llvm::StructType::get(LLVM_CTX, _fields);
+  llvm::ArrayType *_table_type =
+      llvm::ArrayType::get(_entry_type, std::uint64_t(1) << MEMO_BITS);
+  llvm::GlobalVariable *_table = new llvm::GlobalVariable(
+      _module, _table_type, false, llvm::GlobalValue::InternalLinkage,
+      llvm::ConstantAggregateZero::get(_table_type), _name + ".memo");
+
+  llvm::Function *_memo = llvm::Function::Create(
+      fn.getFunctionType(), fn.getLinkage(), "", &_module);
+  fn.replaceUsesWithIf(_memo, [_memo](llvm::Use &use) {
+    llvm::Instruction *_inst = llvm::dyn_cast<llvm::Instruction>(use.getUser());
+    return !_inst || _inst->getFunction() != _memo;
+  });
+  fn.setName(_name + ".uncached");
+  fn.setLinkage(llvm::GlobalValue::InternalLinkage);
+  _memo->setName(_name);
+  _memo->setCallingConv(fn.getCallingConv());
+
+  llvm::BasicBlock *_entry = llvm::BasicBlock::Create(LLVM_CTX, "entry", _memo);
+  llvm::BasicBlock *_hit = llvm::BasicBlock::Create(LLVM_CTX, "memo_hit", _memo);
+  llvm::BasicBlock *_miss =
+      llvm::BasicBlock::Create(LLVM_CTX, "memo_miss", _memo);
+  llvm::IRBuilder<> _builder(_entry);
+
+  llvm::Value *_hash = _builder.getInt64(0);
+  for (llvm::Argument &arg : _memo->args())
+    _hash = _builder.CreateMul(_builder.CreateXor(_hash, &arg),
+                               _builder.getInt64(MEMO_HASH));
+  llvm::Value *_index = _builder.CreateLShr(_hash, 64 - MEMO_BITS, "memo_index");
+  llvm::Value *_slot = _builder.CreateInBoundsGEP(
+      _table_type, _table, {_builder.getInt64(0), _index}, "memo_slot");
+
+  llvm::Value *_found = _builder.CreateICmpNE(
+      _builder.CreateLoad(_builder.getInt8Ty(),
+                          _builder.CreateStructGEP(_entry_type, _slot, 0)),
+      _builder.getInt8(0));
+  for (llvm::Argument &arg : _memo->args()) {
+    llvm::Value *_key = _builder.CreateLoad(
+        INTEGER_TYPE,
+        _builder.CreateStructGEP(_entry_type, _slot, arg.getArgNo() + 1));
+    _found = _builder.CreateAnd(_found, _builder.CreateICmpEQ(_key, &arg));
+  }
+  unsigned _value_field = fn.arg_size() + 1;
+  _builder.CreateCondBr(_found, _hit, _miss);
+
+  _builder.SetInsertPoint(_hit);
+  _builder.CreateRet(_builder.CreateLoad(
+      fn.getReturnType(),
+      _builder.CreateStructGEP(_entry_type, _slot, _value_field)));
+
+  _builder.SetInsertPoint(_miss);
+  std::vector<llvm::Value *> _args;
+  for (llvm::Argument &arg : _memo->args())
+    _args.push_back(&arg);
+  llvm::CallInst *_result = _builder.CreateCall(&fn, _args);
+  _result->setCallingConv(fn.getCallingConv());
+  _builder.CreateStore(_builder.getInt8(1),
+                       _builder.CreateStructGEP(_entry_type, _slot, 0));
+  for (llvm::Argument &arg : _memo->args())
+    _builder.CreateStore(
+        &arg, _builder.CreateStructGEP(_entry_type, _slot, arg.getArgNo() + 1));
+  _builder.CreateStore(_result,
+                       _builder.CreateStructGEP(_entry_type, _slot, _value_field));
+  _builder.CreateRet(_result);
+}
+
+/**
+ * Name: CodeGenContext::infer_purity
+ * Construct: Method
+ * Desc: Marks the pure functions of the module (see `pure_functions`)
+ *   `readnone` and `nounwind`, and those which certainly return (see
+ *   `returning_functions`) `willreturn`, so their calls may be combined and
+ *   hoisted and, if unused, removed. With `memoize`, the pure functions of
+ *   integers are memoized first (see `memoize_function`), each reported
+ * Notes:
+ *   - A memoized function writes to its table so is no longer pure, nor are
+ *     its callers, the functions are found again after memoizing
+ *   - Ran after the instrumentation of `--profile` and `--pgo-instrument`,
+ *     whose counters make every instrumented function impure
+ */
+void CodeGenContext::infer_purity() {
+  std::map<llvm::Function *, std::set<llvm::Function *>> callees;
+  std::set<llvm::Function *> pure = pure_functions(*module, callees);
+
+  if (memoize) {
+    for (llvm::Function *fn : pure)
+      if (fn != fn_main && memoizable(*fn)) {
+        spdlog::info("Memoized {}", fn->getName().str());
+        memoize_function(*fn);
+      }
+    callees.clear();
+    pure = pure_functions(*module, callees);
+  }
+
+  std::set<llvm::Function *> returning = returning_functions(pure, callees);
+  for (llvm::Function *fn : pure) {
+    fn->setDoesNotAccessMemory();
+    fn->setDoesNotThrow();
+    if (returning.count(fn))
+      fn->addFnAttr(llvm::Attribute::WillReturn);
+  }
+}
@@ -0,0 +1,323 @@
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "ast-binary.hpp"
+#include "ast.hpp"
+#include "cli.hpp"
+#include "codegen.hpp"
+#include "incremental.hpp"
+#include "lto.hpp"
+
+/**
+ * Name: src/incremental.cpp
+ * Construct: Module
+ * Desc: Incremental compilation (`--cache-dir`), each top-level function and
+ *   the top-level code are compiled to separate objects, cached under a
+ *   fingerprint of their source and of the signatures of the functions they
+ *   call. Recompiling after editing a function only generates the code of
+ *   that function (and of its callers if its signature changed), the rest of
+ *   the objects are taken from the cache and linked as before
+ * Notes:
+ *   - A function is only inlined into callers within its own object, the
+ *     price of not recompiling the callers when its body changes, unless the
+ *     units are bitcode optimized together as they're linked (`--thin-lto`,
+ *     see src/lto.cpp)
+ *   - Objects are never removed from the cache, it is safe to delete
+ */
+
+/**
+ * Name: CACHE_VERSION
+ * Construct: Global variable
+ * Desc: Part of every fingerprint, so cached objects are not reused by a
+ *   compiler which would generate them differently. Bump it whenever the
+ *   fingerprint's record format or the generated code changes
+ */
+static const char *CACHE_VERSION = "sood-incremental-2";
+
+/**
+ * Name: CompilationUnit
+ * Construct: Struct
+ * Desc: A top-level function, or the top-level code, compiled to an object
+ *   of its own
+ * Members:
+ *   - name: The name of the unit's module
+ *   - fn: The function, or null for the top-level code
+ *   - callees: The top-level functions the unit calls, by name, which are
+ *     declared in the unit's module
+ *   - code: The binary AST of the unit (see `binary_ast`), with the
+ *     locations of its nodes only with `-g`
+ *   - fingerprint: The hash naming the unit's object in the cache
+ */
+struct CompilationUnit {
+  std::string name;
+  NFunctionDeclaration *fn;
+  std::map<std::string, NFunctionDeclaration *> callees;
+  std::string code;
+  std::string fingerprint;
+};
+
+/**
+ * Name: add_callees
+ * Construct: Function
+ * Desc: Adds the functions called within a subtree to the callees of a unit,
+ *   only functions declared before the unit can be called, as when compiling
+ *   the whole program at once
+ * Args:
+ *   - node: The root of the subtree
+ *   - declared: The top-level functions declared so far
+ *   - unit: The unit to add the callees to
+ */
+static void add_callees(Node &node,
+                        const std::map<std::string, NFunctionDeclaration *> &declared,
+                        CompilationUnit &unit) {
+  if (NFunctionCall *call = dynamic_cast<NFunctionCall *>(&node)) {
+    auto it = declared.find(call->id.val);
+    if (it != declared.end() && it->second != unit.fn)
+      unit.callees.insert(*it);
+  }
+  for (Node *child : ast_children(node))
+    add_callees(*child, declared, unit);
+}
+
+/** The signature of a function as written, all its callers depend on */
+static std::string signature(const NFunctionDeclaration &fn) {
+  std::string sig = fn.type.val + " " + fn.id.val + "(";
+  for (NVariableDeclaration *arg : fn.args)
+    sig += arg->type.val + ",";
+  return sig + ")";
+}
+
+/**
+ * Name: fingerprint
+ * Construct: Function
+ * Desc: Hashes everything the object code of a unit depends on: the compiler,
+ *   the target, the code generation options, the signatures of its callees,
+ *   the interfaces of the imported modules, and its own AST
+ * Args:
+ *   - args: The command line options
+ *   - unit: The unit to fingerprint
+ *   - profile: The contents of the profile of `--pgo-use`, if any
+ *   - interfaces: The contents of the interfaces of the imported modules
+ */
+static std::string fingerprint(const SoodArgs &args,
+                               const CompilationUnit &unit,
+                               const std::string &profile,
+                               const std::string &interfaces) {
+  std::ostringstream key;
+  key << CACHE_VERSION << '\n'
+      << llvm::sys::getDefaultTargetTriple() << '\n'
+      << args.fast_cc << args.no_tail_calls << args.inlining << args.vectorize
+      << args.memoize << args.debug_info << args.profile << args.pgo_instrument
+      << args.thin_lto << ' '
+      << args.inline_threshold << '\n';
+  if (args.debug_info)
+    key << args.input << '\n';
+  if (!args.pgo_use.empty())
+    key << profile << '\n';
+  key << interfaces << '\n';
+  for (auto &callee : unit.callees)
+    key << signature(*callee.second) << '\n';
+  key << unit.code;
+
+  llvm::MD5 hash;
+  hash.update(key.str());
+  llvm::MD5::MD5Result result;
+  hash.final(result);
+  llvm::SmallString<32> hex;
+  llvm::MD5::stringifyResult(result, hex);
+  return std::string(hex.str());
+}
+
+/**
+ * Name: export_functions
+ * Construct: Function
+ * Desc: Gives the top-level functions of a module external linkage, so they
+ *   can be called from the other objects, under a name which can't clash
+ *   with those of the C library. Hidden visibility keeps the calls direct
+ * Args:
+ *   - module: The module of a unit
+ *   - declared: The top-level functions of the program
+ */
+static void export_functions(
+    llvm::Module *module,
+    const std::map<std::string, NFunctionDeclaration *> &declared) {
+  for (auto &entry : declared) {
+    llvm::Function *_fn = module->getFunction(entry.first);
+    if (!_fn)
+      continue;
+    _fn->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    _fn->setVisibility(llvm::GlobalValue::HiddenVisibility);
+    _fn->setName("sood." + entry.first);
+  }
+}
+
+/**
+ * Name: compile_unit
+ * Construct: Function
+ * Desc: Generates, optimizes, and writes the object code (or the bitcode,
+ *   with `--thin-lto`) of a unit to the cache, the object is written under a
+ *   temporary name and then renamed so a compile which is interrupted (or
+ *   running alongside) never leaves a partial object to be reused
+ * Args:
+ *   - args: The command line options
+ *   - unit: The unit to compile
+ *   - imports: The imports of the program, imported into every unit
+ *   - top_level: The top-level code, less the function declarations and
+ *     imports
+ *   - declared: The top-level functions of the program
+ *   - path: The path of the unit's object in the cache
+ */
+static bool
+compile_unit(const SoodArgs &args, CompilationUnit &unit,
+             const std::vector<NImport *> &imports, NBlock &top_level,
+             const std::map<std::string, NFunctionDeclaration *> &declared,
+             const std::string &path) {
+  BUILDER.ClearInsertionPoint();
+  CodeGenContext ctx(unit.name);
+  std::unique_ptr<llvm::Module> module(ctx.module);
+  set_codegen_options(ctx, args);
+
+  for (NImport *import : imports)
+    import->code_generate(ctx);
+  for (auto &callee : unit.callees)
+    callee.second->declare(ctx);
+  if (unit.fn) {
+    unit.fn->code_generate(ctx);
+    if (args.profile)
+      ctx.instrument_profile();
+    ctx.finalize_debug_info();
+  } else {
+    ctx.code_generate(top_level);
+  }
+  export_functions(ctx.module, declared);
+
+  if (!args.no_verify && ctx.verify_module(llvm::errs()))
+    return false;
+  ctx.optimize();
+
+  std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+  std::error_code error_code;
+  llvm::raw_fd_ostream out(tmp_path, error_code, llvm::sys::fs::OF_None);
+  if (error_code) {
+    spdlog::error("Could not write {}: {}", tmp_path, error_code.message());
+    return false;
+  }
+  if (args.thin_lto ? ctx.write_bitcode(out) : ctx.write_object(out))
+    return false;
+  out.close();
+  return !std::rename(tmp_path.c_str(), path.c_str());
+}
+
+/**
+ * Name: compile_incremental
+ * Construct: Function
+ * Desc: Compiles the program to an object per unit, reusing those already
+ *   in the cache (`--cache-dir`), returns whether every unit's object is
+ *   available
+ * Args:
+ *   - program: The root block of the AST
+ *   - args: The command line options
+ *   - objects: Set to the paths of the objects to link
+ */
+bool compile_incremental(NBlock &program, const SoodArgs &args,
+                         std::vector<std::string> &objects) {
+  if (std::error_code error_code =
+          llvm::sys::fs::create_directories(args.cache_dir)) {
+    spdlog::error("Could not create cache directory {}: {}", args.cache_dir,
+                  error_code.message());
+    return false;
+  }
+
+  std::vector<CompilationUnit> units;
+  std::map<std::string, NFunctionDeclaration *> declared;
+  CompilationUnit main_unit = {"mod_main", nullptr, {}, "", ""};
+  NBlock top_level;
+  std::vector<NImport *> imports;
+
+  for (NStatement *stmt : program.stmts) {
+    if (NImport *import = dynamic_cast<NImport *>(stmt)) {
+      imports.push_back(import);
+      continue;
+    }
+    NFunctionDeclaration *fn = dynamic_cast<NFunctionDeclaration *>(stmt);
+    if (!fn) {
+      add_callees(*stmt, declared, main_unit);
+      top_level.stmts.push_back(stmt);
+      continue;
+    }
+    CompilationUnit unit = {"mod_" + fn->id.val, fn, {}, "", ""};
+    add_callees(fn->block, declared, unit);
+    unit.code = binary_ast(*fn, args.debug_info);
+    units.push_back(unit);
+    declared[fn->id.val] = fn;
+  }
+  main_unit.code = binary_ast(top_level, args.debug_info);
+  units.push_back(main_unit);
+
+  /** A new profile of the program may change the code of any unit */
+  std::string profile;
+  if (!args.pgo_use.empty()) {
+    auto buffer = llvm::MemoryBuffer::getFile(args.pgo_use);
+    if (!buffer) {
+      spdlog::error("Could not read profile {}: {}", args.pgo_use,
+                    buffer.getError().message());
+      return false;
+    }
+    profile = (*buffer)->getBuffer().str();
+  }
+
+  /**
+   * The imported modules are found once, for the interfaces every unit
+   *   depends on and the objects linked with the units'
+   */
+  CodeGenContext imports_ctx("mod_imports");
+  std::unique_ptr<llvm::Module> imports_module(imports_ctx.module);
+  set_codegen_options(imports_ctx, args);
+  for (NImport *import : imports)
+    import->code_generate(imports_ctx);
+  std::string interfaces;
+  for (auto &imported : imports_ctx.imported_modules) {
+    auto buffer = llvm::MemoryBuffer::getFile(imported.second.interface);
+    if (!buffer) {
+      spdlog::error("Could not read interface {}: {}",
+                    imported.second.interface, buffer.getError().message());
+      return false;
+    }
+    interfaces += (*buffer)->getBuffer().str();
+  }
+
+  /** Fingerprint every unit first, generating code modifies some of the AST */
+  for (CompilationUnit &unit : units)
+    unit.fingerprint = fingerprint(args, unit, profile, interfaces);
+
+  std::size_t compiled = 0;
+  for (CompilationUnit &unit : units) {
+    std::string path =
+        args.cache_dir + "/" + unit.fingerprint + (args.thin_lto ? ".bc" : ".o");
+    if (access(path.c_str(), R_OK)) {
+      spdlog::debug("Compiling {} to {}", unit.name, path);
+      if (!compile_unit(args, unit, imports, top_level, declared, path))
+        return false;
+      compiled++;
+    }
+    objects.push_back(path);
+  }
+
+  spdlog::info("Compiled {} of {} units, the rest were cached", compiled,
+               units.size());
+  for (auto &imported : imports_ctx.imported_modules)
+    objects.push_back(imported.second.object);
+
+  if (args.thin_lto) {
+    std::vector<std::string> bitcode;
+    bitcode.swap(objects);
+    return link_time_optimize(args, bitcode, objects);
+  }
+  return true;
+}
@@ -0,0 +1,564 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ast.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+
+/**
+ * Name: src/lexer.cpp
+ * Construct: Module
+ * Desc: The lexer, a hand-written scanner over the whole of the source held
+ *   in memory. Words are looked up in a perfect hash table of the keywords,
+ *   and the multi-word keywords (e.g. "is less than or equal to") are matched
+ *   a word at a time against a table of phrases, words read ahead while
+ *   matching a phrase are queued as tokens rather than scanned again
+ * Notes:
+ *   - As in the grammar of the language, the words of a phrase are separated
+ *     by exactly one space, and the longest phrase matched is taken
+ *   - A word beginning a phrase (e.g. "of") which doesn't begin one here is
+ *     an identifier
+ */
+
+FILE *yyin = nullptr;
+int yylineno = 1;
+
+/** The errors of the lexer/parser, a line each, for reporting by `sood serve` */
+std::string yyerror_message;
+
+/** Whether errors go unprinted, `sood repl` reports only those it gives up on */
+bool yyerror_quiet = false;
+
+/** The errors of the lexer/parser in the order they were found */
+std::vector<SyntaxError> syntax_errors;
+
+/** The most errors to report before giving up on the source, 0 for no limit */
+std::size_t max_syntax_errors = 20;
+
+static bool too_many_errors() {
+  return max_syntax_errors && syntax_errors.size() >= max_syntax_errors;
+}
+
+/**
+ * Name: report_error
+ * Construct: Function
+ * Desc: Records an error of the lexer/parser, once there are too many (see
+ *   `max_syntax_errors`) the rest are dropped and the lexer ends the source
+ * Args:
+ *   - line: The line of the error
+ *   - column: The column of the error
+ *   - message: What the error is
+ */
+static void report_error(int line, int column, const std::string &message) {
+  if (too_many_errors())
+    return;
+  syntax_errors.push_back({line, column, message});
+  std::string text = "Lexer/parser error on line " + std::to_string(line) +
+                     ", column " + std::to_string(column) + ": " + message;
+  if (too_many_errors())
+    text += "\nToo many errors, stopping after " +
+            std::to_string(max_syntax_errors);
+  if (!yyerror_message.empty())
+    yyerror_message += '\n';
+  yyerror_message += text;
+  if (!yyerror_quiet)
+    std::printf("%s\n", text.c_str());
+}
+
+/** Errors are of the last token returned, the lexer may have read past it */
+void yyerror(const char *s) {
+  report_error(yylloc.first_line, yylloc.first_column, s);
+}
+
+/* -------- Keywords -------- */
+
+/**
+ * Name: Keyword
+ * Construct: Struct
+ * Desc: A word of the language's keywords or of its multi-word keywords
+ * Members:
+ *   - word: The word
+ *   - token: The token of the word on its own, or 0 if it's only a keyword
+ *     as part of a phrase (and is otherwise an identifier)
+ *   - op: The operation (see `OPS`) of the token, or -1
+ *   - size: The length of the word, set when building the table
+ */
+struct Keyword {
+  const char *word;
+  int token;
+  int op;
+  std::size_t size;
+};
+
+constexpr Keyword KEYWORD_LIST[] = {
+    {"is", TIS, -1, 0},           {"not", TNOT, OP_NOT, 0},
+    {"negative", TNEG, OP_NEGATIVE, 0},
+    {"and", TAND, OP_AND, 0},     {"alternatively", TALT, OP_ALTERNATIVELY, 0},
+    {"plus", TPLS, OP_PLUS, 0},   {"minus", TMNS, OP_MINUS, 0},
+    {"modulo", TMOD, OP_MODULO, 0},
+    {"called", TCALLED, -1, 0},   {"function", TFUNCTION, -1, 0},
+    {"return", TRETURN, -1, 0},   {"with", TWITH, -1, 0},
+    {"a", TAN, -1, 0},            {"an", TAN, -1, 0},
+    {"array", TARRAY, -1, 0},     {"at", TAT, -1, 0},
+    {"append", TAPPEND, -1, 0},   {"if", TIF, -1, 0},
+    {"else", TELSE, -1, 0},       {"while", TWHILE, -1, 0},
+    {"until", TUNTIL, -1, 0},     {"read", TREAD, -1, 0},
+    {"write", TWRITE, -1, 0},     {"to", TTO, -1, 0},
+    {"from", TFROM, -1, 0},       {"import", TIMPORT, -1, 0},
+    /** Only keywords as part of a phrase */
+    {"equal", 0, -1, 0},          {"less", 0, -1, 0},
+    {"than", 0, -1, 0},           {"or", 0, -1, 0},
+    {"more", 0, -1, 0},           {"multiplied", 0, -1, 0},
+    {"by", 0, -1, 0},             {"divided", 0, -1, 0},
+    {"of", 0, -1, 0},             {"default", 0, -1, 0},
+    {"value", 0, -1, 0},          {"type", 0, -1, 0},
+    {"statements", 0, -1, 0},     {"the", 0, -1, 0},
+    {"statement", 0, -1, 0},      {"no", 0, -1, 0},
+    {"arguments", 0, -1, 0},      {"as", 0, -1, 0},
+    {"argument", 0, -1, 0},       {"size", 0, -1, 0},
+    {"length", 0, -1, 0},
+};
+
+/** The number of slots of the keyword table, a power of two */
+constexpr unsigned KEYWORD_SLOTS = 128;
+
+constexpr std::size_t word_size(const char *word) {
+  std::size_t size = 0;
+  while (word[size])
+    size++;
+  return size;
+}
+
+/**
+ * Name: keyword_hash
+ * Construct: Function
+ * Desc: The slot of a word in the keyword table, the multipliers were chosen
+ *   by searching for the first which gives every keyword a slot of its own
+ *   (see the `static_assert` below)
+ * Args:
+ *   - word: The word
+ *   - size: The length of the word, at least 1
+ */
+constexpr unsigned keyword_hash(const char *word, std::size_t size) {
+  return (size + 9 * static_cast<unsigned char>(word[0]) +
+          59 * static_cast<unsigned char>(word[size - 1]) +
+          31 * static_cast<unsigned char>(word[size > 1 ? 1 : 0])) %
+         KEYWORD_SLOTS;
+}
+
+/**
+ * Name: KeywordTable
+ * Construct: Struct
+ * Desc: The keywords by their hash (see `keyword_hash`), built at compile
+ *   time from `KEYWORD_LIST`
+ * Members:
+ *   - slots: The keywords, a slot without one has a null word
+ *   - perfect: Whether every keyword has a slot of its own
+ */
+struct KeywordTable {
+  Keyword slots[KEYWORD_SLOTS];
+  bool perfect;
+};
+
+constexpr KeywordTable build_keyword_table() {
+  KeywordTable table = {};
+  table.perfect = true;
+  for (const Keyword &keyword : KEYWORD_LIST) {
+    std::size_t size = word_size(keyword.word);
+    Keyword &slot = table.slots[keyword_hash(keyword.word, size)];
+    if (slot.word)
+      table.perfect = false;
+    slot.word = keyword.word;
+    slot.token = keyword.token;
+    slot.op = keyword.op;
+    slot.size = size;
+  }
+  return table;
+}
+
+constexpr KeywordTable KEYWORDS = build_keyword_table();
+static_assert(KEYWORDS.perfect, "keyword_hash gives two keywords one slot");
+
+/** The slot of a keyword, or -1 if the word isn't one */
+static int keyword_slot(const char *word, std::size_t size) {
+  unsigned slot = keyword_hash(word, size);
+  const Keyword &keyword = KEYWORDS.slots[slot];
+  if (keyword.size == size && std::memcmp(keyword.word, word, size) == 0)
+    return slot;
+  return -1;
+}
+
+/* -------- Phrases -------- */
+
+/** The most words of a phrase */
+constexpr int PHRASE_WORDS = 6;
+
+/**
+ * Name: Phrase
+ * Construct: Struct
+ * Desc: A multi-word keyword
+ * Members:
+ *   - words: The words of the phrase
+ *   - token: The token of the phrase
+ *   - op: The operation (see `OPS`) of the token, or -1
+ */
+struct Phrase {
+  const char *words[PHRASE_WORDS];
+  int token;
+  int op;
+};
+
+constexpr Phrase PHRASES[] = {
+    {{"is", "equal", "to"}, TEQ, OP_EQUAL_TO},
+    {{"is", "not", "equal", "to"}, TNE, OP_NOT_EQUAL_TO},
+    {{"is", "less", "than"}, TLT, OP_LESS_THAN},
+    {{"is", "less", "than", "or", "equal", "to"}, TLE, OP_LESS_THAN_EQUAL_TO},
+    {{"is", "more", "than"}, TMT, OP_MORE_THAN},
+    {{"is", "more", "than", "or", "equal", "to"}, TME, OP_MORE_THAN_EQUAL_TO},
+    {{"multiplied", "by"}, TMUL, OP_MULTIPLIED_BY},
+    {{"divided", "by"}, TDIV, OP_DIVIDED_BY},
+    {{"of", "default", "value"}, TOFDEFAULT, -1},
+    {{"of", "type"}, TOFTYPE, -1},
+    {{"of", "value"}, TOFVALUE, -1},
+    {{"of", "statements"}, TOFSTMTS, -1},
+    {{"of", "the", "statement"}, TOFSTMT, -1},
+    {{"of", "size"}, TOFSIZE, -1},
+    {{"no", "arguments"}, TNOARGS, -1},
+    {{"as", "an", "argument"}, TASARGS, -1},
+    {{"as", "arguments"}, TASARGS, -1},
+    {{"with", "arguments", "of"}, TWITHARGS, -1},
+    {{"length", "of"}, TLENGTHOF, -1},
+};
+
+constexpr int PHRASE_COUNT = sizeof(PHRASES) / sizeof(PHRASES[0]);
+
+/**
+ * Name: PhraseTable
+ * Construct: Struct
+ * Desc: The phrases as the keyword slots of their words, so matching a word
+ *   of a phrase is comparing two integers, built at compile time from
+ *   `PHRASES`
+ * Members:
+ *   - slots: The slots of the words of each phrase
+ *   - sizes: The number of words of each phrase
+ *   - keywords: Whether every word of every phrase is in the keyword table
+ */
+struct PhraseTable {
+  int slots[PHRASE_COUNT][PHRASE_WORDS];
+  int sizes[PHRASE_COUNT];
+  bool keywords;
+};
+
+constexpr bool same_word(const char *lhs, const char *rhs) {
+  while (*lhs && *lhs == *rhs) {
+    lhs++;
+    rhs++;
+  }
+  return *lhs == *rhs;
+}
+
+constexpr PhraseTable build_phrase_table() {
+  PhraseTable table = {};
+  table.keywords = true;
+  for (int i = 0; i < PHRASE_COUNT; i++) {
+    int size = 0;
+    for (; size < PHRASE_WORDS && PHRASES[i].words[size]; size++) {
+      const char *word = PHRASES[i].words[size];
+      unsigned slot = keyword_hash(word, word_size(word));
+      if (!KEYWORDS.slots[slot].word ||
+          !same_word(KEYWORDS.slots[slot].word, word))
+        table.keywords = false;
+      table.slots[i][size] = slot;
+    }
+    table.sizes[i] = size;
+  }
+  return table;
+}
+
+constexpr PhraseTable PHRASE_TABLE = build_phrase_table();
+static_assert(PHRASE_TABLE.keywords, "A word of a phrase isn't a keyword");
+
+/* -------- Scanning -------- */
+
+/** The kinds of token the scanner finds, before keywords are matched */
+enum RAW_KINDS { RAW_END, RAW_WORD, RAW_INTEGER, RAW_FLOAT, RAW_STRING,
+                 RAW_PUNCT, RAW_INVALID };
+
+/**
+ * Name: RawToken
+ * Construct: Struct
+ * Desc: A token as scanned
+ * Members:
+ *   - kind: The kind of the token (see `RAW_KINDS`)
+ *   - text: The text of the token
+ *   - slot: For a word, its slot in the keyword table or -1, for punctuation
+ *     its token
+ *   - spaced: Whether exactly one space separates the token from the last
+ *   - first_line, first_column, last_line, last_column: The location of the
+ *     token
+ */
+struct RawToken {
+  int kind;
+  TokenText text;
+  int slot;
+  bool spaced;
+  int first_line, first_column, last_line, last_column;
+};
+
+/**
+ * Name: Lexer
+ * Construct: Struct
+ * Desc: The state of the lexer
+ * Members:
+ *   - source: The whole of the source, read on the first call of `yylex`
+ *   - loaded: Whether the source has been read
+ *   - pos: The position of the scanner in the source
+ *   - column: The column of the scanner
+ *   - ahead: Tokens scanned while matching a phrase but not yet returned, a
+ *     ring of `PHRASE_WORDS` tokens from `ahead_first`
+ *   - ahead_size: The number of tokens in `ahead`
+ */
+struct Lexer {
+  std::string source;
+  bool loaded = false;
+  std::size_t pos = 0;
+  int column = 1;
+  RawToken ahead[PHRASE_WORDS];
+  int ahead_first = 0;
+  int ahead_size = 0;
+};
+
+static Lexer lexer;
+
+void yyrestart(FILE *in) {
+  yyin = in;
+  lexer.source.clear();
+  lexer.loaded = false;
+  lexer.pos = 0;
+  lexer.column = 1;
+  lexer.ahead_first = 0;
+  lexer.ahead_size = 0;
+  syntax_errors.clear();
+  yyerror_message.clear();
+}
+
+static void load_source() {
+  FILE *in = yyin ? yyin : stdin;
+  char buf[65536];
+  std::size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), in)) > 0)
+    lexer.source.append(buf, n);
+  lexer.loaded = true;
+}
+
+static bool is_word_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+/** Advances the scanner over a character, keeping count of lines */
+static void advance(char c) {
+  lexer.pos++;
+  if (c == '\n') {
+    yylineno++;
+    lexer.column = 1;
+  } else {
+    lexer.column++;
+  }
+}
+
+/**
+ * Name: scan
+ * Construct: Function
+ * Desc: Scans the next token of the source, skipping whitespace and comments
+ */
+static RawToken scan() {
+  const std::string &src = lexer.source;
+  std::size_t size = src.size();
+
+  std::size_t skipped_from = lexer.pos;
+  bool comment = false;
+  while (lexer.pos < size) {
+    char c = src[lexer.pos];
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+      advance(c);
+    } else if (c == '#') {
+      comment = true;
+      while (lexer.pos < size && src[lexer.pos] != '\n')
+        advance(src[lexer.pos]);
+    } else {
+      break;
+    }
+  }
+
+  RawToken tok = {};
+  tok.spaced = !comment && lexer.pos - skipped_from == 1 &&
+               src[skipped_from] == ' ';
+  tok.first_line = yylineno;
+  tok.first_column = lexer.column;
+  std::size_t start = lexer.pos;
+
+  if (lexer.pos >= size) {
+    tok.kind = RAW_END;
+  } else {
+    char c = src[lexer.pos];
+    if (is_digit(c)) {
+      while (lexer.pos < size && is_digit(src[lexer.pos]))
+        advance(src[lexer.pos]);
+      tok.kind = RAW_INTEGER;
+      if (lexer.pos + 1 < size && src[lexer.pos] == '.' &&
+          is_digit(src[lexer.pos + 1])) {
+        advance('.');
+        while (lexer.pos < size && is_digit(src[lexer.pos]))
+          advance(src[lexer.pos]);
+        tok.kind = RAW_FLOAT;
+      }
+    } else if (is_word_char(c)) {
+      while (lexer.pos < size && is_word_char(src[lexer.pos]))
+        advance(src[lexer.pos]);
+      tok.kind = RAW_WORD;
+      tok.slot = keyword_slot(&src[start], lexer.pos - start);
+    } else if (c == '"' || c == '\'') {
+      std::size_t close = src.find(c, lexer.pos + 1);
+      if (close == std::string::npos) {
+        while (lexer.pos < size && src[lexer.pos] != '\n')
+          advance(src[lexer.pos]);
+        tok.kind = RAW_INVALID;
+      } else {
+        while (lexer.pos <= close)
+          advance(src[lexer.pos]);
+        tok.kind = RAW_STRING;
+      }
+    } else {
+      tok.kind = RAW_PUNCT;
+      switch (c) {
+      case ',': tok.slot = TCOMMA; break;
+      case '.': tok.slot = TPERIOD; break;
+      case ';': tok.slot = TSEMIC; break;
+      case ':': tok.slot = TCOLON; break;
+      case '(': tok.slot = TPARO; break;
+      case ')': tok.slot = TPARC; break;
+      default: tok.kind = RAW_INVALID;
+      }
+      advance(c);
+    }
+  }
+
+  tok.text = {src.data() + start, lexer.pos - start};
+  tok.last_line = yylineno;
+  tok.last_column = lexer.column;
+  return tok;
+}
+
+/** The `n`th token not yet returned, scanning ahead as far as needed */
+static RawToken &peek(int n) {
+  while (lexer.ahead_size <= n) {
+    lexer.ahead[(lexer.ahead_first + lexer.ahead_size) % PHRASE_WORDS] =
+        scan();
+    lexer.ahead_size++;
+  }
+  return lexer.ahead[(lexer.ahead_first + n) % PHRASE_WORDS];
+}
+
+/** Drops the first `n` tokens not yet returned */
+static void consume(int n) {
+  lexer.ahead_first = (lexer.ahead_first + n) % PHRASE_WORDS;
+  lexer.ahead_size -= n;
+}
+
+/**
+ * Name: match_phrase
+ * Construct: Function
+ * Desc: The longest phrase beginning with the next token, or -1
+ */
+static int match_phrase() {
+  int head = peek(0).slot;
+  int best = -1;
+  for (int i = 0; i < PHRASE_COUNT; i++) {
+    const int *slots = PHRASE_TABLE.slots[i];
+    int words = PHRASE_TABLE.sizes[i];
+    if (slots[0] != head || (best >= 0 && words <= PHRASE_TABLE.sizes[best]))
+      continue;
+    int n = 1;
+    for (; n < words; n++) {
+      RawToken &tok = peek(n);
+      if (tok.kind != RAW_WORD || !tok.spaced || tok.slot != slots[n])
+        break;
+    }
+    if (n == words)
+      best = i;
+  }
+  return best;
+}
+
+static void set_location(const RawToken &first, const RawToken &last) {
+  yylloc.first_line = first.first_line;
+  yylloc.first_column = first.first_column;
+  yylloc.last_line = last.last_line;
+  yylloc.last_column = last.last_column;
+}
+
+int yylex() {
+  if (!lexer.loaded)
+    load_source();
+
+  /** Invalid tokens are reported and skipped, the parser never sees them */
+  while (peek(0).kind == RAW_INVALID && !too_many_errors()) {
+    RawToken &invalid = peek(0);
+    std::string text = invalid.text.str();
+    report_error(invalid.first_line, invalid.first_column,
+                 text[0] == '"' || text[0] == '\''
+                     ? "Unterminated string"
+                     : "Invalid token '" + text + "'");
+    consume(1);
+  }
+  if (too_many_errors())
+    return 0;
+
+  RawToken tok = peek(0);
+  set_location(tok, tok);
+
+  switch (tok.kind) {
+  case RAW_END:
+    return 0;
+  case RAW_PUNCT:
+    consume(1);
+    return tok.slot;
+  case RAW_INTEGER:
+    consume(1);
+    yylval.text = tok.text;
+    return TINTEGER;
+  case RAW_FLOAT:
+    consume(1);
+    yylval.text = tok.text;
+    return TFLOAT;
+  case RAW_STRING:
+    consume(1);
+    yylval.text = tok.text;
+    return TSTRING;
+  }
+
+  if (tok.slot >= 0) {
+    int phrase = match_phrase();
+    if (phrase >= 0) {
+      set_location(tok, peek(PHRASE_TABLE.sizes[phrase] - 1));
+      consume(PHRASE_TABLE.sizes[phrase]);
+      yylval.val = PHRASES[phrase].op;
+      return PHRASES[phrase].token;
+    }
+    const Keyword &keyword = KEYWORDS.slots[tok.slot];
+    if (keyword.token) {
+      consume(1);
+      yylval.val = keyword.op;
+      return keyword.token;
+    }
+  }
+
+  consume(1);
+  yylval.text = tok.text;
+  return TIDENT;
+}
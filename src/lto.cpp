@@ -0,0 +1,191 @@
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+#include <llvm/BinaryFormat/Magic.h>
+#include <llvm/LTO/LTO.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Threading.h>
+
+#include "cli.hpp"
+#include "codegen.hpp"
+#include "lto.hpp"
+
+/**
+ * Name: src/lto.cpp
+ * Construct: Module
+ * Desc: Link-time optimization (`--thin-lto`), modules are written as bitcode
+ *   with ThinLTO summaries (see `CodeGenContext::write_bitcode`) rather than
+ *   object code, and optimized together as they're linked. The summaries are
+ *   combined to find which functions are called across modules, then each
+ *   module is optimized and compiled to object code in parallel, importing
+ *   the functions it calls from the others to inline them
+ * Notes:
+ *   - Only `main` (and the counters of `--pgo-instrument`) are referenced by
+ *     the runtime and the C library, the other functions are internal to the
+ *     program once linked, and removed if never called
+ */
+
+/**
+ * Name: visible_to_objects
+ * Construct: Function
+ * Desc: Whether a symbol defined in bitcode is referenced by the object code
+ *   it's linked with, so must be kept as it is
+ * Args:
+ *   - name: The name of the symbol
+ */
+static bool visible_to_objects(llvm::StringRef name) {
+  return name == "main" || name.startswith("__llvm_profile");
+}
+
+/**
+ * Name: temporary_objects
+ * Construct: Global variable
+ * Desc: The paths of the temporary files created for the object code of the
+ *   ThinLTO backends, removed once linked (see `remove_temporary_objects`)
+ */
+static std::vector<std::string> temporary_objects;
+
+/**
+ * Name: temporary_object
+ * Construct: Function
+ * Desc: Creates a temporary file for the object code of a ThinLTO backend,
+ *   named after the output, returns its path or an empty string
+ * Args:
+ *   - args: The command line options
+ *   - task: The backend's task
+ */
+static std::string temporary_object(const SoodArgs &args, std::size_t task) {
+  std::string name = args.output;
+  auto pos = name.rfind("/");
+  if (pos != std::string::npos)
+    name.erase(0, pos + 1);
+  name = "/tmp/" + name + ".lto" + std::to_string(task) + ".o.XXXXXX";
+  int fd = mkstemp(&name[0]);
+  if (fd == -1)
+    return "";
+  close(fd);
+  return name;
+}
+
+/**
+ * Name: remove_temporary_objects
+ * Construct: Function
+ * Desc: Removes the temporary files of the object code of the ThinLTO
+ *   backends, for after they're linked, whether or not that succeeded
+ */
+void remove_temporary_objects() {
+  for (const std::string &path : temporary_objects)
+    unlink(path.c_str());
+  temporary_objects.clear();
+}
+
+/**
+ * Name: link_time_optimize
+ * Construct: Function
+ * Desc: Optimizes modules of bitcode together and compiles them to object
+ *   code, a ThinLTO backend per module ran on as many threads as there are
+ *   cores, returns whether the object code was written
+ * Args:
+ *   - args: The command line options
+ *   - bitcode: The paths of the modules of bitcode, any of object code are
+ *     passed through to `objects`
+ *   - objects: Set to the paths of the objects to link
+ * Notes:
+ *   - The objects written are temporary files, to be removed once linked with
+ *     `remove_temporary_objects`
+ */
+bool link_time_optimize(const SoodArgs &args,
+                        const std::vector<std::string> &bitcode,
+                        std::vector<std::string> &objects) {
+  /** Initializes LLVM's targets, the backends' target is the same generic one */
+  {
+    CodeGenContext warm;
+    std::unique_ptr<llvm::Module> module(warm.module);
+    if (!warm.get_target_machine())
+      return false;
+  }
+
+  llvm::lto::Config conf;
+  conf.CPU = "generic";
+  conf.RelocModel = llvm::Reloc::PIC_;
+  conf.DefaultTriple = llvm::sys::getDefaultTargetTriple();
+  llvm::lto::LTO lto(std::move(conf),
+                     llvm::lto::createInProcessThinBackend(
+                         llvm::heavyweight_hardware_concurrency()));
+
+  /** The inputs refer to the buffers until the modules are optimized */
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> buffers;
+  std::set<std::string> defined;
+  for (const std::string &path : bitcode) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+      spdlog::error("Could not read {}: {}", path, buffer.getError().message());
+      return false;
+    }
+    /** Object code, such as that of a module imported, is linked as it is */
+    if (llvm::identify_magic((*buffer)->getBuffer()) !=
+        llvm::file_magic::bitcode) {
+      objects.push_back(path);
+      continue;
+    }
+    auto input = llvm::lto::InputFile::create((*buffer)->getMemBufferRef());
+    if (!input) {
+      spdlog::error("Could not read bitcode of {}: {}", path,
+                    llvm::toString(input.takeError()));
+      return false;
+    }
+    buffers.push_back(std::move(*buffer));
+
+    /** The first definition of a symbol is kept, as by the linker */
+    std::vector<llvm::lto::SymbolResolution> resolutions;
+    for (const llvm::lto::InputFile::Symbol &sym : (*input)->symbols()) {
+      llvm::lto::SymbolResolution resolution;
+      if (!sym.isUndefined()) {
+        resolution.Prevailing = defined.insert(sym.getName().str()).second;
+        resolution.FinalDefinitionInLinkageUnit = true;
+        resolution.VisibleToRegularObj = visible_to_objects(sym.getName());
+      }
+      resolutions.push_back(resolution);
+    }
+    if (llvm::Error err = lto.add(std::move(*input), resolutions)) {
+      spdlog::error("Could not link {}: {}", path,
+                    llvm::toString(std::move(err)));
+      return false;
+    }
+  }
+
+  std::vector<std::string> paths(lto.getMaxTasks());
+  auto add_stream = [&](size_t task)
+      -> std::unique_ptr<llvm::lto::NativeObjectStream> {
+    paths[task] = temporary_object(args, task);
+    std::error_code error_code;
+    auto out = std::make_unique<llvm::raw_fd_ostream>(
+        paths[task], error_code, llvm::sys::fs::OF_None);
+    if (error_code)
+      spdlog::error("Could not write {}: {}", paths[task],
+                    error_code.message());
+    return std::make_unique<llvm::lto::NativeObjectStream>(std::move(out));
+  };
+  llvm::Error err = lto.run(add_stream);
+
+  /**
+   * The backends run `add_stream` on several threads at once, so the paths
+   *   are only recorded once they're all done, each task wrote its own
+   */
+  for (std::string &path : paths)
+    if (!path.empty())
+      temporary_objects.push_back(path);
+  if (err) {
+    spdlog::error("Link-time optimization failed: {}",
+                  llvm::toString(std::move(err)));
+    remove_temporary_objects();
+    return false;
+  }
+
+  for (std::string &path : paths)
+    if (!path.empty())
+      objects.push_back(path);
+  spdlog::info("Optimized {} modules at link time, to {} objects",
+               buffers.size(), objects.size());
+  return true;
+}
@@ -1,12 +1,27 @@
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <spdlog/cfg/env.h>
 #include <spdlog/spdlog.h>
 
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SourceMgr.h>
+
+#include "ast-binary.hpp"
 #include "ast.hpp"
+#include "bytecode.hpp"
 #include "cli.hpp"
 #include "codegen.hpp"
+#include "incremental.hpp"
+#include "lexer.hpp"
+#include "lto.hpp"
+#include "repl.hpp"
+#include "serve.hpp"
 #include "subprocess.hpp"
+#include "tiered.hpp"
 
 extern int yyparse();
 extern FILE *yyin;
@@ -15,69 +30,93 @@ extern NBlock *prg;
 /** Maximum length of back-trace to be displayed by SPDLog */
 const int BT_VOL = 32;
 
-int main(int argc, char **argv) {
-  spdlog::info("Starting Sood compiler...");
-  spdlog::enable_backtrace(BT_VOL);
-  spdlog::cfg::load_env_levels();
-
-  SoodArgs args = parse_args(argc, argv);
-
-  /**
-   * If an input file is specified on the command line, use that as the source
-   *   of Sood code
-   */
-  if (args.input != "") {
-    spdlog::debug("Reading input from file {}", args.input);
-    /**
-     * The rest of this block verifies that the input file both exists and is
-     *   not empty
-     */
-    if (!(yyin = std::fopen(args.input.c_str(), "r"))) {
-      spdlog::error("Input file {} does not exist, exiting...", args.input);
-      std::exit(1);
+/**
+ * Name: link_objects
+ * Construct: Function
+ * Desc: Links object code into the output, an executable or, when stopping
+ *   after the object code, a single relocatable object
+ * Args:
+ *   - args: The command line options
+ *   - objects: The paths of the objects to link
+ */
+static void link_objects(const SoodArgs &args,
+                         const std::vector<std::string> &objects) {
+  if (args.stop_after_object) {
+    std::vector<std::string> ld_args = {"-r", "-o", args.output};
+    ld_args.insert(ld_args.end(), objects.begin(), objects.end());
+    subprocess::popen ld_cmd("ld", ld_args);
+    if (ld_cmd.wait()) {
+      spdlog::error("LD linking failed:");
+      std::cerr << ld_cmd.stderr().rdbuf() << std::endl;
     }
-    fseek(yyin, 0, SEEK_END);
-    if (!ftell(yyin))
-      spdlog::warn("Input file {} is empty", args.input);
-    fseek(yyin, 0, SEEK_SET);
+    return;
   }
 
-  /** Parse the source code using the generated parser from Bison */
-  yyparse();
-
   /**
-   * If an input file was specified, we are now finished with it and can
-   *   close it
+   * Sub-process to GCC (or LD) to link the object with the Sood runtime (see
+   *   include/sood-runtime.h), the C runtime libraries and, optioinally, libc
    */
-  if (args.input != "")
-    std::fclose(yyin);
-
-  if (args.print_ast) {
-    spdlog::debug("Printing AST to stdout...");
-    std::cout << *prg << std::endl;
-  }
-
+  std::vector<std::string> gcc_args = {"-o", args.output};
+  gcc_args.insert(gcc_args.end(), objects.begin(), objects.end());
+  /** The runtime's writer of profiles is linked in only when needed */
+  if (args.pgo_instrument)
+    gcc_args.insert(gcc_args.end(), {"-u", "__llvm_profile_runtime"});
   /**
-   * If the option has been given to stop after generating the AST, the
-   *   string representation of the AST is written to the output CLI option
+   * With `--static-minimal`, neither libc nor the C runtime's start files are
+   *   linked, the minimal runtime (see runtime/minimal.c) brings `_start`. The
+   *   executable isn't position independent, so nothing needs relocating
+   *   before `_start` runs, and the runtime's unused functions are dropped
    */
-  if (args.stop_after_ast) {
-    spdlog::info("Writing AST to {}...", args.output);
-    std::ofstream ast_out(args.output);
-    ast_out << *prg << std::endl;
-    ast_out.close();
-    spdlog::info("Stopping after AST generation");
-    return 0;
+  if (args.static_minimal) {
+#ifdef SOOD_RUNTIME_MINIMAL_LIB
+    gcc_args.insert(gcc_args.end(),
+                    {"-static", "-no-pie", "-nostdlib", "-Wl,--gc-sections",
+                     "-u", "_start", SOOD_RUNTIME_MINIMAL_LIB, "-lgcc"});
+#endif
+  } else {
+    gcc_args.push_back(SOOD_RUNTIME_LIB);
   }
+  subprocess::popen gcc_cmd("gcc", gcc_args);
+  /*
+   * Note: This also works but I may as well just use GCC
+   *   ld --verbose -L/usr/lib -lc \
+   *     -dynamic-linker \
+   *     /lib64/ld-linux-x86-64.so.2 \
+   *     /usr/lib/Scrt1.o \
+   *     /usr/lib/crti.o \
+   *     /usr/lib/gcc/x86_64-pc-linux-gnu/10.2.0/crtbeginS.o \
+   *     /usr/lib/gcc/x86_64-pc-linux-gnu/10.2.0/crtendS.o  \
+   *     <object file> \
+   *     -o <binary> \
+   *     /usr/lib/crtn.o
+   */
+  if (gcc_cmd.wait()) {
+    spdlog::error("GCC compilation failed:");
+    std::cerr << gcc_cmd.stderr().rdbuf() << std::endl;
+  } else {
+    spdlog::info("Native binary written to {}", args.output);
+  }
+}
 
-  CodeGenContext ctx;
-  ctx.code_generate(*prg);
+/**
+ * Name: compile_module
+ * Construct: Function
+ * Desc: The back end of the compiler, verifies, optimizes, and writes or runs
+ *   a module, whether generated from Sood source or read as LLVM IR
+ * Args:
+ *   - ctx: The CodeGenContext of the module
+ *   - args: The command line options
+ */
+static int compile_module(CodeGenContext &ctx, const SoodArgs &args) {
 
   if (!args.no_verify) {
     spdlog::info("Verifying LLVM module");
     ctx.verify_module();
   }
 
+  spdlog::info("Optimizing LLVM module");
+  ctx.optimize();
+
   if (args.print_llvm_ir) {
     spdlog::debug("Printing LLVM IR to stdout...");
     ctx.print_llvm_ir();
@@ -94,12 +133,40 @@ int main(int argc, char **argv) {
     return 0;
   }
 
+  /** Or as LLVM bitcode, which is smaller and much faster to read back */
+  if (args.emit_bc) {
+    spdlog::info("Writing LLVM bitcode to {}...", args.output);
+    std::error_code error_code;
+    llvm::raw_fd_ostream bc_out(args.output, error_code,
+                                llvm::sys::fs::OF_None);
+    if (error_code || ctx.write_bitcode(bc_out)) {
+      spdlog::error("Could not write bitcode to {}", args.output);
+      std::exit(1);
+    }
+    spdlog::info("Stopping after LLVM bitcode generation");
+    return 0;
+  }
+
   /** Run the code (the LLVM module's main function) from within the compiler */
   if (args.run_llvm_ir) {
     spdlog::info("Running LLVM module...");
     ctx.code_run();
   }
 
+  /**
+   * A module compiled to be imported (`--emit-interface`) has its interface
+   *   written beside its object, see src/codegen-import.cpp
+   */
+  if (args.emit_interface) {
+    llvm::SmallString<128> sif_path(llvm::sys::path::parent_path(args.output));
+    llvm::sys::path::append(sif_path, ctx.module_name + ".sif");
+    std::string sif_fname = sif_path.str().str();
+    spdlog::info("Writing interface of module {} to {}", ctx.module_name,
+                 sif_fname);
+    if (ctx.write_interface(*prg, sif_fname, args.output))
+      std::exit(1);
+  }
+
   std::string obj_fname = args.output;
 
   /**
@@ -123,38 +190,396 @@ int main(int argc, char **argv) {
     obj_fname = std::string(obj_fname_c);
   }
 
+  /** The objects of the imported modules are linked with the program's */
+  std::vector<std::string> inputs = {obj_fname};
+  for (auto &imported : ctx.imported_modules)
+    inputs.push_back(imported.second.object);
+
+  /**
+   * With `--thin-lto` the module is written as bitcode, which is either the
+   *   output or optimized and compiled to object code as it's linked (see
+   *   src/lto.cpp)
+   */
+  if (args.thin_lto) {
+    spdlog::debug("Writing bitcode to {}", obj_fname);
+    std::error_code error_code;
+    llvm::raw_fd_ostream bc_out(obj_fname, error_code, llvm::sys::fs::OF_None);
+    if (error_code || ctx.write_bitcode(bc_out)) {
+      spdlog::error("Could not write bitcode to {}", obj_fname);
+      std::exit(1);
+    }
+    bc_out.close();
+    if (args.stop_after_object)
+      return 0;
+
+    std::vector<std::string> objects;
+    if (!link_time_optimize(args, inputs, objects))
+      std::exit(1);
+    link_objects(args, objects);
+    remove_temporary_objects();
+    spdlog::info("Finishing Sood compiler");
+    return 0;
+  }
+
   spdlog::debug("Writing object code to {}", obj_fname);
   ctx.write_object(obj_fname);
 
   if (args.stop_after_object)
     return 0;
 
+  link_objects(args, inputs);
+
+  spdlog::info("Finishing Sood compiler");
+  return 0;
+}
+
+/**
+ * Name: is_llvm_ir
+ * Construct: Function
+ * Desc: Whether an input is LLVM IR (`.ll`) or bitcode (`.bc`), rather than
+ *   Sood source, going straight to the back end
+ * Args:
+ *   - input: The path of the input
+ */
+static bool is_llvm_ir(const std::string &input) {
+  llvm::StringRef path(input);
+  return path.endswith(".ll") || path.endswith(".bc");
+}
+
+/**
+ * Name: is_binary_ast
+ * Construct: Function
+ * Desc: Whether an input is an AST written by `--emit-ast` (`.sast`), which
+ *   is read back rather than parsed
+ * Args:
+ *   - input: The path of the input
+ */
+static bool is_binary_ast(const std::string &input) {
+  return llvm::StringRef(input).endswith(".sast");
+}
+
+/**
+ * Name: is_bytecode
+ * Construct: Function
+ * Desc: Whether an input is bytecode written by `--emit-bytecode` (`.sbc`),
+ *   which is ran without lexing, parsing, or generating code
+ * Args:
+ *   - input: The path of the input
+ */
+static bool is_bytecode(const std::string &input) {
+  return llvm::StringRef(input).endswith(".sbc");
+}
+
+/**
+ * Name: bytecode_cache_path
+ * Construct: Function
+ * Desc: The path of the input's bytecode in the cache (`--bytecode` with
+ *   `--cache-dir`), named by a hash of its source and the bytecode's version,
+ *   so running an unchanged source skips the front end entirely. Empty if
+ *   there's no input file or no cache
+ * Args:
+ *   - args: The command line options
+ */
+static std::string bytecode_cache_path(const SoodArgs &args) {
+  if (args.cache_dir.empty() || args.input.empty())
+    return "";
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> source =
+      llvm::MemoryBuffer::getFile(args.input);
+  if (!source)
+    return "";
+  if (llvm::sys::fs::create_directories(args.cache_dir)) {
+    spdlog::warn("Could not create cache directory {}", args.cache_dir);
+    return "";
+  }
+  llvm::MD5 hash;
+  hash.update("sood-bytecode-" + std::to_string(BC_VERSION) + "\n");
+  hash.update((*source)->getBuffer());
+  llvm::MD5::MD5Result result;
+  hash.final(result);
+  llvm::SmallString<32> hex;
+  llvm::MD5::stringifyResult(result, hex);
+  return args.cache_dir + "/" + hex.str().str() + ".sbc";
+}
+
+/**
+ * Name: run_bytecode_module
+ * Construct: Function
+ * Desc: The bytecode back end's counterpart of `compile_module`, prints,
+ *   writes, or runs a module of bytecode
+ * Args:
+ *   - module: The module
+ *   - args: The command line options
+ */
+static int run_bytecode_module(const BytecodeModule &module,
+                               const SoodArgs &args) {
+  if (args.print_bytecode) {
+    spdlog::debug("Printing bytecode to stdout...");
+    print_bytecode(module, std::cout);
+  }
+
+  if (args.emit_bytecode) {
+    spdlog::info("Writing bytecode to {}...", args.output);
+    if (!write_bytecode(module, args.output))
+      std::exit(1);
+    spdlog::info("Stopping after bytecode generation");
+    return 0;
+  }
+
+  /** Bytecode read from a file is ran, generated it's ran with `--bytecode` */
+  if (args.bytecode || is_bytecode(args.input)) {
+    spdlog::info("Running bytecode...");
+    return run_bytecode(module);
+  }
+  return 0;
+}
+
+/**
+ * Name: compile_llvm_ir
+ * Construct: Function
+ * Desc: Reads a module of LLVM IR or bitcode, such as one written by `-C` or
+ *   `--emit-bc`, and compiles it without lexing, parsing, or generating code
+ * Args:
+ *   - args: The command line options
+ * Notes:
+ *   - The options of code generation (`-g`, `--fastcc`, `--profile`) were
+ *     those of the compile which wrote the module, the options of the back
+ *     end (optimizations, `--pgo-*`, `--thin-lto`, outputs) still apply
+ */
+static int compile_llvm_ir(const SoodArgs &args) {
+  if (args.print_ast || args.stop_after_ast || args.emit_ast ||
+      args.emit_interface || args.tiered) {
+    spdlog::error("Input {} is LLVM IR, there is no AST", args.input);
+    std::exit(1);
+  }
+
+  llvm::SMDiagnostic err;
+  std::unique_ptr<llvm::Module> module =
+      llvm::parseIRFile(args.input, err, LLVM_CTX);
+  if (!module) {
+    err.print("sood", llvm::errs());
+    std::exit(1);
+  }
+  spdlog::info("Read LLVM module from {}", args.input);
+
+  CodeGenContext ctx(module.release());
+  set_codegen_options(ctx, args);
+  return compile_module(ctx, args);
+}
+
+int main(int argc, char **argv) {
+  spdlog::info("Starting Sood compiler...");
+  spdlog::enable_backtrace(BT_VOL);
+  spdlog::cfg::load_env_levels();
+
+  /** `sood serve [options]` compiles the requests of clients, see serve.cpp */
+  if (argc > 1 && std::string(argv[1]) == "serve")
+    return serve(parse_args(argc - 1, argv + 1));
+
+  /** `sood repl [options]` runs statements as they're entered, see repl.cpp */
+  if (argc > 1 && std::string(argv[1]) == "repl")
+    return repl(parse_args(argc - 1, argv + 1));
+
+  SoodArgs args = parse_args(argc, argv);
+
+  /** The profile's counters are found by the linker, in the executable */
+  if (args.pgo_instrument && (args.run_llvm_ir || args.tiered)) {
+    spdlog::error("Instrumented programs must be linked, not ran with -R");
+    std::exit(1);
+  }
+  /** Interpreted, much of the program would go uncounted */
+  if (args.profile && args.tiered) {
+    spdlog::error("--profile needs the whole program compiled, not --tiered");
+    std::exit(1);
+  }
+  /** A module to import has no `main` to run, and is named by its source */
+  if (args.emit_interface &&
+      (args.run_llvm_ir || args.tiered || args.input.empty())) {
+    spdlog::error("--emit-interface needs an input file and can't run with -R");
+    std::exit(1);
+  }
+  /** The bytecode back end replaces LLVM, its options don't apply */
+  bool use_bytecode = args.bytecode || args.emit_bytecode ||
+                      args.print_bytecode || is_bytecode(args.input);
+  if (use_bytecode &&
+      (args.run_llvm_ir || args.tiered || args.print_llvm_ir ||
+       args.stop_after_llvm_ir || args.stop_after_object || args.emit_bc ||
+       args.profile || args.pgo_instrument || args.memoize)) {
+    spdlog::error("--bytecode runs without LLVM, it can't be combined with "
+                  "LLVM's options");
+    std::exit(1);
+  }
+  if (args.static_minimal) {
+#ifndef SOOD_RUNTIME_MINIMAL_LIB
+    spdlog::error("--static-minimal is only supported on x86-64 Linux");
+    std::exit(1);
+#endif
+    if (use_bytecode || args.run_llvm_ir || args.tiered || args.profile ||
+        args.pgo_instrument) {
+      spdlog::error("--static-minimal links an executable without libc, it "
+                    "can't be combined with running the program in the "
+                    "compiler, --profile, or --pgo-instrument");
+      std::exit(1);
+    }
+  }
+  if (!args.pgo_use.empty() && !llvm::sys::fs::exists(args.pgo_use)) {
+    spdlog::error("Profile {} does not exist, exiting...", args.pgo_use);
+    std::exit(1);
+  }
+
+  /** As does bytecode, see src/bytecode-context.cpp */
+  if (is_bytecode(args.input)) {
+    if (args.print_ast || args.stop_after_ast || args.emit_ast) {
+      spdlog::error("Input {} is bytecode, there is no AST", args.input);
+      std::exit(1);
+    }
+    BytecodeModule module;
+    if (!read_bytecode(module, args.input))
+      std::exit(1);
+    return run_bytecode_module(module, args);
+  }
+
+  /** Running a source unchanged since it was cached skips the front end */
+  std::string bytecode_cache;
+  if (args.bytecode && !args.emit_bytecode)
+    bytecode_cache = bytecode_cache_path(args);
+  if (!bytecode_cache.empty() && llvm::sys::fs::exists(bytecode_cache)) {
+    BytecodeModule module;
+    if (read_bytecode(module, bytecode_cache)) {
+      spdlog::debug("Read bytecode of {} from {}", args.input, bytecode_cache);
+      return run_bytecode_module(module, args);
+    }
+  }
+
+  /** LLVM IR and bitcode skip the front end, see `compile_llvm_ir` */
+  if (is_llvm_ir(args.input))
+    return compile_llvm_ir(args);
+
+  /**
+   * A binary AST is mapped into memory and its nodes created directly, see
+   *   src/ast-binary.cpp, otherwise an input file specified on the command
+   *   line is the source of Sood code
+   */
+  if (is_binary_ast(args.input)) {
+    spdlog::debug("Reading AST from file {}", args.input);
+    if (!(prg = read_binary_ast(args.input)))
+      std::exit(1);
+  } else if (args.input != "") {
+    spdlog::debug("Reading input from file {}", args.input);
+    /**
+     * The rest of this block verifies that the input file both exists and is
+     *   not empty
+     */
+    if (!(yyin = std::fopen(args.input.c_str(), "r"))) {
+      spdlog::error("Input file {} does not exist, exiting...", args.input);
+      std::exit(1);
+    }
+    fseek(yyin, 0, SEEK_END);
+    if (!ftell(yyin))
+      spdlog::warn("Input file {} is empty", args.input);
+    fseek(yyin, 0, SEEK_SET);
+  }
+
+  /**
+   * Parse the source code using the generated parser from Bison, which
+   *   recovers from syntax errors to report as many as `--max-errors`
+   */
+  if (!prg) {
+    max_syntax_errors = args.max_errors;
+    if (yyparse()) {
+      spdlog::error("Found {} syntax error(s), not compiling",
+                    syntax_errors.size());
+      std::exit(1);
+    }
+
+    /**
+     * If an input file was specified, we are now finished with it and can
+     *   close it
+     */
+    if (args.input != "")
+      std::fclose(yyin);
+  }
+
+  if (args.print_ast) {
+    spdlog::debug("Printing AST to stdout...");
+    std::cout << *prg << std::endl;
+  }
+
+  /**
+   * If the option has been given to stop after generating the AST, the
+   *   string representation of the AST is written to the output CLI option
+   */
+  if (args.stop_after_ast) {
+    spdlog::info("Writing AST to {}...", args.output);
+    std::ofstream ast_out(args.output);
+    ast_out << *prg << std::endl;
+    ast_out.close();
+    spdlog::info("Stopping after AST generation");
+    return 0;
+  }
+
+  /** Or in binary form, to be read back without parsing (see `--emit-ast`) */
+  if (args.emit_ast) {
+    spdlog::info("Writing binary AST to {}...", args.output);
+    if (!write_binary_ast(*prg, args.output))
+      std::exit(1);
+    spdlog::info("Stopping after AST generation");
+    return 0;
+  }
+
   /**
-   * Sub-process to GCC (or LD) to link the object with the C runtime
-   *   libraries and, optioinally, libc
+   * The bytecode back end generates its code in microseconds rather than
+   *   LLVM's milliseconds, for programs which run for less time than LLVM
+   *   would take to compile them (see src/ast-bytecode.cpp)
    */
-  subprocess::popen gcc_cmd("gcc",
-                            {"-o", args.output.c_str(), obj_fname.c_str()});
-  /*
-   * Note: This also works but I may as well just use GCC
-   *   ld --verbose -L/usr/lib -lc \
-   *     -dynamic-linker \
-   *     /lib64/ld-linux-x86-64.so.2 \
-   *     /usr/lib/Scrt1.o \
-   *     /usr/lib/crti.o \
-   *     /usr/lib/gcc/x86_64-pc-linux-gnu/10.2.0/crtbeginS.o \
-   *     /usr/lib/gcc/x86_64-pc-linux-gnu/10.2.0/crtendS.o  \
-   *     <object file> \
-   *     -o <binary> \
-   *     /usr/lib/crtn.o
+  if (use_bytecode) {
+    auto start = std::chrono::steady_clock::now();
+    BytecodeContext bctx;
+    try {
+      bctx.code_generate(*prg);
+    } catch (CodeGenException &e) {
+      spdlog::error("Could not generate bytecode: {}", e.what());
+      std::exit(1);
+    }
+    spdlog::debug("Generated bytecode in {}us",
+                  std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count());
+    if (!bytecode_cache.empty())
+      write_bytecode(bctx.module, bytecode_cache);
+    return run_bytecode_module(bctx.module, args);
+  }
+
+  /**
+   * Compiling incrementally, the functions whose objects aren't already in the
+   *   cache are compiled to objects of their own, and every object is linked
+   *   (see src/incremental.cpp). The options needing the whole module in
+   *   memory still compile it as a whole
    */
-  if (gcc_cmd.wait()) {
-    spdlog::error("GCC compilation failed:");
-    std::cerr << gcc_cmd.stderr().rdbuf() << std::endl;
-  } else {
-    spdlog::info("Native binary written to {}", args.output);
+  if (!args.cache_dir.empty() && !args.print_llvm_ir &&
+      !args.stop_after_llvm_ir && !args.emit_bc && !args.run_llvm_ir &&
+      !args.tiered && !args.emit_interface) {
+    std::vector<std::string> objects;
+    if (!compile_incremental(*prg, args, objects))
+      std::exit(1);
+    link_objects(args, objects);
+    remove_temporary_objects();
+    spdlog::info("Finishing Sood compiler");
+    return 0;
   }
 
-  spdlog::info("Finishing Sood compiler");
-  return 0;
+  CodeGenContext ctx;
+  set_codegen_options(ctx, args);
+  if (args.emit_interface)
+    ctx.code_generate_module(*prg, llvm::sys::path::stem(args.input).str());
+  else
+    ctx.code_generate(*prg);
+
+  /**
+   * With `--tiered` the program is ran as it's interpreted, compiling its hot
+   *   functions and loops in the background (see src/tiered.cpp), and nothing
+   *   is written
+   */
+  if (args.tiered)
+    return run_tiered(ctx, *prg, args);
+  return compile_module(ctx, args);
 }
@@ -4,8 +4,33 @@
 extern int yylex();
 extern void yyerror(const char *);
 NBlock *prg;
+int node_line = 0;
+int node_column = 0;
 %}
 
+%code requires {
+#include "lexer.hpp"
+}
+
+%code {
+/** As Bison's default, also giving the nodes of each rule its location */
+#define YYLLOC_DEFAULT(Current, Rhs, N)                                        \
+  do {                                                                         \
+    if (N) {                                                                   \
+      (Current).first_line = YYRHSLOC(Rhs, 1).first_line;                      \
+      (Current).first_column = YYRHSLOC(Rhs, 1).first_column;                  \
+      (Current).last_line = YYRHSLOC(Rhs, N).last_line;                        \
+      (Current).last_column = YYRHSLOC(Rhs, N).last_column;                    \
+    } else {                                                                   \
+      (Current).first_line = (Current).last_line = YYRHSLOC(Rhs, 0).last_line; \
+      (Current).first_column = (Current).last_column =                         \
+          YYRHSLOC(Rhs, 0).last_column;                                        \
+    }                                                                          \
+    node_line = (Current).first_line;                                          \
+    node_column = (Current).first_column;                                      \
+  } while (0)
+}
+
 %locations
 
 %union {
@@ -17,27 +42,31 @@ NBlock *prg;
   NFunctionDeclaration *n_function_decl;
   NVariableDeclaration *n_variable_decl;
   NIfStatement         *n_if_stmt;
+  NArrayIndex          *n_array_index;
 
-  std::string *string;
-  int         val;
+  TokenText text;
+  int       val;
 
   std::vector<NExpression *>          *v_n_expr;
   std::vector<NVariableDeclaration *> *v_n_var_decl;
 }
 
-%token <string> /* types      */ TIDENT TFLOAT TINTEGER TSTRING TVOID
-%token <string> /* grammar    */ TCOMMA TPERIOD TCALLED TSEMIC TCOLON
-%token <string> /*            */ TFUNCTION TIS TOFDEFAULT TOFTYPE TOFVALUE
-%token <string> /*            */ TRETURN TWITHARGS TWITH TAN TPARO TPARC
-%token <string> /*            */ TOFSTMT TOFSTMTS
-%token <string> /* constructs */ TIF TELSE TWHILE TUNTIL TNOARGS TASARGS
-%token <string> /*            */ TREAD TWRITE TTO TFROM
+%token <text>   /* types      */ TIDENT TFLOAT TINTEGER TSTRING TVOID
+%token          /* grammar    */ TCOMMA TPERIOD TCALLED TSEMIC TCOLON
+%token          /*            */ TFUNCTION TIS TOFDEFAULT TOFTYPE TOFVALUE
+%token          /*            */ TRETURN TWITHARGS TWITH TAN TPARO TPARC
+%token          /*            */ TOFSTMT TOFSTMTS
+%token          /* arrays     */ TARRAY TOFSIZE TAT TAPPEND TLENGTHOF
+%token          /* constructs */ TIF TELSE TWHILE TUNTIL TNOARGS TASARGS
+%token          /*            */ TREAD TWRITE TTO TFROM
+%token          /* modules    */ TIMPORT
 %token <val>    /* operators  */ TPLS TMNS TMUL TDIV TMOD
 %token <val>    /* boolean    */ TEQ TNE TLT TLE TMT TME TNOT TNEG TAND TALT
 
 %type <n_expr>          numeric string expr arithmetic
 %type <n_expr>          binary_comparison unary_comparison func_call
 %type <n_identifier>    identifier
+%type <n_array_index>   array_index
 %type <n_block>         program stmts block single_block
 %type <n_statement>     stmt var_decl func_decl func_decl_single
 %type <n_statement>     if_stmt while_stmt until_stmt io_stmt
@@ -54,17 +83,26 @@ NBlock *prg;
 %left TPLS TMNS
 
 %right TELSE
-%right TNOT TNEG
+%right TNOT TNEG TLENGTHOF
+%left TAT
 
 %start program
 
 %%
 
-program : stmts { prg = $1; }
+/** A source with errors is never compiled, however well the parser recovered */
+program : stmts
+          {
+            node_line = node_column = 0;
+            if (!syntax_errors.empty())
+              YYABORT;
+            prg = $1;
+          }
         ;
 
-stmts : stmt       { $$ = new NBlock(); $$->stmts.push_back($1); }
-      | stmts stmt { $1->stmts.push_back($2); }
+/** A statement the parser recovered from is null, and left out of its block */
+stmts : stmt       { $$ = new NBlock(); if ($1) $$->stmts.push_back($1); }
+      | stmts stmt { if ($2) $1->stmts.push_back($2); }
       ;
 
 io_stmt : TREAD TFROM expr TTO expr TPERIOD { $$ = new NRead(*$3, *$5); }
@@ -80,7 +118,11 @@ stmt : var_decl
      | io_stmt
      | expr TPERIOD { $$ = new NExpressionStatement(*$1); }
      | identifier TIS expr TPERIOD  { $$ = new NAssignment(*$1, *$3); }
+     | array_index TIS expr TPERIOD { $$ = new NArrayAssignment(*$1, *$3); }
+     | TAPPEND expr TTO identifier TPERIOD { $$ = new NAppend(*$2, *$4); }
      | TRETURN expr TPERIOD { $$ = new NReturnStatement(*$2); }
+     | TIMPORT identifier TPERIOD { $$ = new NImport(*$2); }
+     | error TPERIOD { $$ = nullptr; } /* Recover at the end of the statement */
      ;
 
 func_call_args : TWITH expr
@@ -101,17 +143,22 @@ expr : identifier { $$ = $1; }
      | binary_comparison
      | unary_comparison
      | func_call
+     | array_index { $$ = $1; }
+     | TLENGTHOF expr { $$ = new NLength(*$2); }
      | TPARO expr TPARC { $$ = $2; }
      ;
 
-identifier : TIDENT { $$ = new NIdentifier(*$1); }
+array_index : identifier TAT expr { $$ = new NArrayIndex(*$1, *$3); }
+            ;
+
+identifier : TIDENT { $$ = new NIdentifier($1.str()); }
            ;
 
-numeric : TINTEGER { $$ = new NInteger(atol($1->c_str())); delete $1; }
-        | TFLOAT   { $$ = new NFloat(atof($1->c_str())); delete $1; }
+numeric : TINTEGER { $$ = new NInteger(atol($1.str().c_str())); }
+        | TFLOAT   { $$ = new NFloat(atof($1.str().c_str())); }
         ;
 
-string : TSTRING { $$ = new NString(*$1); delete $1; }
+string : TSTRING { $$ = new NString($1.str()); }
        ;
 
 arithmetic : expr TPLS expr
@@ -143,9 +190,14 @@ var_decl : identifier TIS TAN identifier TOFVALUE expr TPERIOD
            { $$ = new NVariableDeclaration(*$4, *$1, $6); }
          | identifier TIS TAN identifier TPERIOD
            { $$ = new NVariableDeclaration(*$4, *$1); }
+         | identifier TIS TAN identifier TARRAY TOFSIZE expr TPERIOD
+           { $$ = new NArrayDeclaration(*$4, *$1, $7); }
+         | identifier TIS TAN identifier TARRAY TPERIOD
+           { $$ = new NArrayDeclaration(*$4, *$1); }
          ;
 
-single_block : stmt TPERIOD TPERIOD { $$ = new NBlock(); $$->stmts.push_back($1); }
+single_block : stmt TPERIOD TPERIOD
+               { $$ = new NBlock(); if ($1) $$->stmts.push_back($1); }
              ;
 
 block : stmts TPERIOD TPERIOD { $$ = $1; } /* stmts creates a new block */
@@ -156,6 +208,11 @@ func_decl_arg : TAN identifier identifier
                 { $$ = new NVariableDeclaration(*$2, *$3); }
               | TAN identifier identifier TOFDEFAULT expr
                 { $$ = new NVariableDeclaration(*$2, *$3, $5); }
+              | TAN identifier TARRAY identifier
+                {
+                  NIdentifier *type = new NIdentifier($2->val + " array");
+                  $$ = new NVariableDeclaration(*type, *$4);
+                }
               ;
 
 func_decl_args : func_decl_arg { $$ = new NVariableList(); $$->push_back($1); }
@@ -197,17 +254,25 @@ func_decl : identifier TIS TAN TFUNCTION TOFSTMTS TCOLON block
           | identifier TIS TAN TFUNCTION TOFTYPE identifier TWITHARGS TCOLON
               func_decl_args TSEMIC TAND TOFSTMTS TCOLON block
             { $$ = new NFunctionDeclaration(*$6, *$1, *$9, *$14); }
+          | identifier TIS TAN TFUNCTION error TOFSTMTS TCOLON block
+            { $$ = nullptr; } /* Recover at the block, for the errors within */
           ;
 
+/** As for functions, recovering from an error in the condition at the block */
 if_stmt : TIF expr TCOMMA block { $$ = new NIfStatement(*$2, *$4); }
-        | if_stmt TELSE TCOMMA block { $<n_if_stmt>1->els = new NElseStatement(*$4); }
-        | if_stmt TELSE if_stmt { $<n_if_stmt>1->els = $3; }
+        | TIF error TCOMMA block { $$ = nullptr; }
+        | if_stmt TELSE TCOMMA block
+          { if ($1) $<n_if_stmt>1->els = new NElseStatement(*$4); }
+        | if_stmt TELSE if_stmt
+          { if ($1) $<n_if_stmt>1->els = $3; }
         ;
 
 while_stmt : TWHILE expr TCOMMA block { $$ = new NWhileStatement(*$2, *$4); }
+           | TWHILE error TCOMMA block { $$ = nullptr; }
            ;
 
 until_stmt : TUNTIL expr TCOMMA block { $$ = new NUntilStatement(*$2, *$4); }
+           | TUNTIL error TCOMMA block { $$ = nullptr; }
            ;
 
 %%
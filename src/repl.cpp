@@ -0,0 +1,401 @@
+#include <chrono>
+#include <iostream>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "ast.hpp"
+#include "cli.hpp"
+#include "codegen.hpp"
+#include "lexer.hpp"
+#include "repl.hpp"
+
+/**
+ * Name: src/repl.cpp
+ * Construct: Module
+ * Desc: `sood repl`, an interactive session which runs each statement (or
+ *   function declaration) as it's entered. Each input is compiled to a module
+ *   of its own, as object code, and added to an ORC JIT session, so earlier
+ *   inputs are never compiled again and the time taken to respond doesn't
+ *   grow with the session
+ * Notes:
+ *   - The variables of the top-level code become globals of the input
+ *     declaring them, later inputs refer to them by name, as they do to the
+ *     functions of earlier inputs
+ *   - Redeclaring a variable or function replaces it for later inputs, the
+ *     code of earlier inputs keeps using the one it was compiled against
+ */
+
+extern int yyparse();
+extern void yyrestart(FILE *);
+extern int yylineno;
+extern NBlock *prg;
+extern std::string yyerror_message;
+extern bool yyerror_quiet;
+
+/**
+ * Name: PersistedVariable
+ * Construct: Struct
+ * Desc: A variable of the top-level code, kept between inputs
+ * Members:
+ *   - symbol: The name of the global holding the variable
+ *   - value_type: The type of the global
+ *   - type: The type of the variable, as kept in a CodeGenBlock's locals
+ */
+struct PersistedVariable {
+  std::string symbol;
+  llvm::Type *value_type;
+  llvm::Type *type;
+};
+
+/**
+ * Name: PersistedFunction
+ * Construct: Struct
+ * Desc: A function declared by an earlier input
+ * Members:
+ *   - decl: The function's declaration, for declaring it in later inputs
+ *   - symbol: The name of the function's code in the JIT session
+ */
+struct PersistedFunction {
+  NFunctionDeclaration *decl;
+  std::string symbol;
+};
+
+/**
+ * Name: ReplSession
+ * Construct: Struct
+ * Desc: The state of a `sood repl` session
+ * Members:
+ *   - args: The options the REPL was started with
+ *   - jit: The JIT session every input is added to
+ *   - inputs: The number of inputs run so far
+ *   - programs: The AST of every input, kept for the function declarations
+ *   - variables: The variables of the top-level code, by name
+ *   - functions: The functions of the top-level code, by name
+ */
+struct ReplSession {
+  const SoodArgs &args;
+  std::unique_ptr<llvm::orc::LLJIT> jit;
+  unsigned inputs = 0;
+  std::vector<std::unique_ptr<NBlock>> programs;
+  std::map<std::string, PersistedVariable> variables;
+  std::map<std::string, PersistedFunction> functions;
+};
+
+/** The identifiers and called functions of a subtree */
+static void referenced_names(Node &node, std::set<std::string> &names) {
+  if (NIdentifier *ident = dynamic_cast<NIdentifier *>(&node))
+    names.insert(ident->val);
+  else if (NFunctionCall *call = dynamic_cast<NFunctionCall *>(&node))
+    names.insert(call->id.val);
+  for (Node *child : ast_children(node))
+    referenced_names(*child, names);
+}
+
+/**
+ * Name: parse_input
+ * Construct: Function
+ * Desc: Parses an input, returns null if it doesn't (yet) parse
+ * Args:
+ *   - source: The Sood source of the input
+ */
+static NBlock *parse_input(std::string source) {
+  source.push_back('\n');
+  FILE *in = fmemopen(&source[0], source.size(), "r");
+  if (!in)
+    return nullptr;
+  yyrestart(in);
+  yylineno = 1;
+  yyerror_message.clear();
+  prg = nullptr;
+  int parsed = yyparse();
+  std::fclose(in);
+  return parsed ? nullptr : prg;
+}
+
+/**
+ * Name: persist_allocas
+ * Construct: Function
+ * Desc: Replaces the stack allocations of an input's function with globals,
+ *   as its values outlive it. Variables get a global named after them for
+ *   later inputs, the rest (temporaries, the arena, the storage of arrays)
+ *   private globals
+ * Args:
+ *   - session: The REPL session
+ *   - module: The module of the input
+ *   - fn: The input's function
+ *   - locals: The variables in scope after the input
+ */
+static void persist_allocas(ReplSession &session, llvm::Module *module,
+                            llvm::Function *fn,
+                            std::map<std::string, ValTypeTuple> &locals) {
+  for (auto &local : locals) {
+    llvm::AllocaInst *_alloca =
+        llvm::dyn_cast<llvm::AllocaInst>(std::get<llvm::Value *>(local.second));
+    if (!_alloca)
+      continue;
+    PersistedVariable var = {"sood.repl." + local.first + "." +
+                                 std::to_string(session.inputs),
+                             _alloca->getAllocatedType(),
+                             std::get<llvm::Type *>(local.second)};
+    llvm::GlobalVariable *_global = new llvm::GlobalVariable(
+        *module, var.value_type, false, llvm::GlobalValue::ExternalLinkage,
+        llvm::Constant::getNullValue(var.value_type), var.symbol);
+    _alloca->replaceAllUsesWith(_global);
+    _alloca->eraseFromParent();
+    session.variables[local.first] = var;
+  }
+
+  std::vector<llvm::AllocaInst *> _allocas;
+  for (llvm::Instruction &inst : llvm::instructions(fn))
+    if (llvm::AllocaInst *_alloca = llvm::dyn_cast<llvm::AllocaInst>(&inst))
+      _allocas.push_back(_alloca);
+  for (llvm::AllocaInst *_alloca : _allocas) {
+    llvm::Type *_type = _alloca->getAllocatedType();
+    llvm::GlobalVariable *_global = new llvm::GlobalVariable(
+        *module, _type, false, llvm::GlobalValue::PrivateLinkage,
+        llvm::Constant::getNullValue(_type), _alloca->getName());
+    _alloca->replaceAllUsesWith(_global);
+    _alloca->eraseFromParent();
+  }
+}
+
+/**
+ * Name: compile_input
+ * Construct: Function
+ * Desc: Generates the code of an input into a module of its own, declaring
+ *   the variables and functions of earlier inputs it refers to, and adds the
+ *   module's object code to the JIT session. Returns the name of the input's
+ *   function, throws for any problem with the input
+ * Args:
+ *   - session: The REPL session
+ *   - program: The AST of the input
+ */
+static std::string compile_input(ReplSession &session, NBlock &program) {
+  std::string input = std::to_string(session.inputs);
+  std::string name = "sood.repl.input." + input;
+
+  std::set<std::string> names;
+  referenced_names(program, names);
+
+  BUILDER.ClearInsertionPoint();
+  CodeGenContext ctx("mod_input_" + input);
+  std::unique_ptr<llvm::Module> module(ctx.module);
+  set_codegen_options(ctx, session.args);
+
+  std::map<std::string, ValTypeTuple> locals;
+  for (auto &entry : session.variables) {
+    if (!names.count(entry.first))
+      continue;
+    const PersistedVariable &var = entry.second;
+    llvm::GlobalVariable *_global = new llvm::GlobalVariable(
+        *ctx.module, var.value_type, false, llvm::GlobalValue::ExternalLinkage,
+        nullptr, var.symbol);
+    locals[entry.first] = std::make_tuple(_global, var.type);
+  }
+  /** A function the input redeclares is its own, not that of an earlier one */
+  for (NStatement *stmt : program.stmts)
+    if (NFunctionDeclaration *decl = dynamic_cast<NFunctionDeclaration *>(stmt))
+      names.erase(decl->id.val);
+  std::vector<llvm::Function *> declared;
+  for (auto &entry : session.functions)
+    if (names.count(entry.first))
+      declared.push_back(entry.second.decl->declare(ctx));
+
+  llvm::Function *_fn = ctx.code_generate_top_level(program, name, locals);
+
+  /** Functions are looked up by name while generating code, renamed after */
+  for (llvm::Function *_decl : declared) {
+    _decl->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    _decl->setName(session.functions.at(_decl->getName().str()).symbol);
+  }
+  std::map<std::string, PersistedFunction> defined;
+  for (NStatement *stmt : program.stmts) {
+    NFunctionDeclaration *decl = dynamic_cast<NFunctionDeclaration *>(stmt);
+    if (!decl)
+      continue;
+    llvm::Function *_def = ctx.module->getFunction(decl->id.val);
+    if (!_def)
+      continue;
+    _def->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    _def->setName("sood." + decl->id.val + "." + input);
+    defined[decl->id.val] = {decl, _def->getName().str()};
+  }
+
+  /** The new variables are only persisted once the input has compiled */
+  std::map<std::string, PersistedVariable> variables = session.variables;
+  persist_allocas(session, ctx.module, _fn, locals);
+
+  std::string errors;
+  llvm::raw_string_ostream error_stream(errors);
+  if (!session.args.no_verify && ctx.verify_module(error_stream)) {
+    session.variables = variables;
+    throw CodeGenException(error_stream.str());
+  }
+  ctx.optimize();
+
+  llvm::SmallVector<char, 0> object;
+  llvm::raw_svector_ostream object_stream(object);
+  if (ctx.write_object(object_stream)) {
+    session.variables = variables;
+    throw CodeGenException("Could not write object code");
+  }
+  if (llvm::Error error = session.jit->addObjectFile(
+          llvm::MemoryBuffer::getMemBufferCopy(
+              llvm::StringRef(object.data(), object.size()), name))) {
+    session.variables = variables;
+    throw CodeGenException(llvm::toString(std::move(error)));
+  }
+
+  for (auto &entry : defined)
+    session.functions[entry.first] = entry.second;
+  return name;
+}
+
+/**
+ * Name: run_input
+ * Construct: Function
+ * Desc: Compiles and runs an input, reporting any problem with it
+ * Args:
+ *   - session: The REPL session
+ *   - program: The AST of the input
+ */
+static void run_input(ReplSession &session, NBlock *program) {
+  auto start = std::chrono::steady_clock::now();
+  session.programs.emplace_back(program);
+
+  std::string name;
+  try {
+    name = compile_input(session, *program);
+  } catch (std::exception &e) {
+    std::cout << "Error: " << e.what() << std::endl;
+    return;
+  }
+  session.inputs++;
+
+  auto symbol = session.jit->lookup(name);
+  if (!symbol) {
+    std::cout << "Error: " << llvm::toString(symbol.takeError()) << std::endl;
+    return;
+  }
+  auto *run = llvm::jitTargetAddressToFunction<void (*)()>(symbol->getAddress());
+  run();
+  std::fflush(stdout);
+
+  std::chrono::duration<double, std::milli> took =
+      std::chrono::steady_clock::now() - start;
+  spdlog::debug("Ran input {} in {:.2f}ms", session.inputs, took.count());
+}
+
+/**
+ * Name: create_jit
+ * Construct: Function
+ * Desc: Creates the JIT session, resolving the runtime's functions to the
+ *   compiler's own copies (see `runtime_symbols`) and the C library's to
+ *   those of the compiler's process
+ * Args:
+ *   - args: The options `sood repl` was started with
+ */
+static std::unique_ptr<llvm::orc::LLJIT> create_jit(const SoodArgs &args) {
+  /** Initializes LLVM's targets, as needed by the JIT to detect the host */
+  {
+    CodeGenContext warm;
+    std::unique_ptr<llvm::Module> module(warm.module);
+    if (!warm.get_target_machine())
+      return nullptr;
+  }
+
+  llvm::orc::LLJITBuilder builder;
+  /** Describes each input's code to `perf` as it's loaded (`--perf-map`) */
+  if (args.perf_map)
+    builder.setObjectLinkingLayerCreator(
+        [](llvm::orc::ExecutionSession &session, const llvm::Triple &)
+            -> llvm::Expected<std::unique_ptr<llvm::orc::ObjectLayer>> {
+          auto layer = std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(
+              session, []() {
+                return std::make_unique<llvm::SectionMemoryManager>();
+              });
+          for (llvm::JITEventListener *listener : perf_listeners())
+            layer->registerJITEventListener(*listener);
+          return layer;
+        });
+  auto jit = builder.create();
+  if (!jit) {
+    spdlog::error("Could not create JIT: {}",
+                  llvm::toString(jit.takeError()));
+    return nullptr;
+  }
+
+  llvm::orc::JITDylib &dylib = (*jit)->getMainJITDylib();
+  auto process = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+      (*jit)->getDataLayout().getGlobalPrefix());
+  if (!process) {
+    spdlog::error("Could not search the compiler's process: {}",
+                  llvm::toString(process.takeError()));
+    return nullptr;
+  }
+  dylib.addGenerator(std::move(*process));
+
+  llvm::orc::SymbolMap runtime;
+  for (auto &symbol : runtime_symbols())
+    runtime[(*jit)->mangleAndIntern(symbol.first)] = llvm::JITEvaluatedSymbol(
+        llvm::pointerToJITTargetAddress(symbol.second),
+        llvm::JITSymbolFlags::Exported);
+  if (llvm::Error error = dylib.define(llvm::orc::absoluteSymbols(runtime))) {
+    spdlog::error("Could not define the runtime: {}",
+                  llvm::toString(std::move(error)));
+    return nullptr;
+  }
+
+  return std::move(*jit);
+}
+
+/**
+ * Name: repl
+ * Construct: Function
+ * Desc: Reads, compiles, and runs inputs from stdin until its end. An input
+ *   is run once the lines entered so far parse, an empty line discards lines
+ *   which don't (reporting why)
+ * Args:
+ *   - args: The options `sood repl` was started with
+ */
+int repl(const SoodArgs &args) {
+  ReplSession session = {args, create_jit(args), 0, {}, {}, {}};
+  if (!session.jit)
+    return 1;
+
+  bool interactive = isatty(STDIN_FILENO);
+  yyerror_quiet = true;
+  max_syntax_errors = args.max_errors;
+
+  std::string pending;
+  for (std::string line;;) {
+    if (interactive)
+      std::cout << (pending.empty() ? "sood> " : "  ... ") << std::flush;
+    if (!std::getline(std::cin, line))
+      break;
+
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      if (!pending.empty())
+        std::cout << yyerror_message << std::endl;
+      pending.clear();
+      continue;
+    }
+
+    pending += line + "\n";
+    if (NBlock *program = parse_input(pending)) {
+      run_input(session, program);
+      pending.clear();
+    }
+  }
+
+  if (!pending.empty())
+    std::cout << yyerror_message << std::endl;
+  return 0;
+}
@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <sstream>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "ast.hpp"
+#include "cli.hpp"
+#include "codegen.hpp"
+#include "lexer.hpp"
+#include "serve.hpp"
+
+/**
+ * Name: src/serve.cpp
+ * Construct: Module
+ * Desc: `sood serve`, a compiler daemon listening on a Unix domain socket so
+ *   many small compiles (e.g. of an editor or a test runner) don't each pay
+ *   for starting the compiler and initializing LLVM. A request is a line of
+ *   compiler options followed by the Sood source, ended by the client
+ *   shutting down its side of the connection. The response is a line of
+ *   either `ok <kind> <size>` (where kind is `object`, `ir`, or `ast`) or
+ *   `error <size>`, followed by `size` bytes of the output or diagnostics
+ * Notes:
+ *   - Requests are served at the same time by a pool of worker processes,
+ *     rather than threads, as the LLVM context and IR builder (see
+ *     `LLVM_CTX` and `BUILDER`) and the parser are shared by the whole
+ *     process. Each worker, forked once LLVM is initialized, has its own
+ *     context and TargetMachine and serves its requests one at a time
+ */
+
+extern int yyparse();
+extern void yyrestart(FILE *);
+extern int yylineno;
+extern NBlock *prg;
+extern std::string yyerror_message;
+extern bool yyerror_quiet;
+
+/**
+ * Name: serve_socket
+ * Construct: Global variable
+ * Desc: The path of the socket being served, removed when the server is
+ *   stopped
+ */
+static std::string serve_socket;
+
+/**
+ * Name: serve_pid, workers
+ * Construct: Global variables
+ * Desc: The process ID of the server and of each of its workers, stopped
+ *   with the server. The workers are never resized once forked, so they can
+ *   be read by a signal handler
+ */
+static pid_t serve_pid;
+static std::vector<pid_t> workers;
+
+static void stop_serving(int) {
+  /** A worker forked before resetting its handlers just exits */
+  if (getpid() == serve_pid) {
+    for (pid_t worker : workers)
+      if (worker > 0)
+        kill(worker, SIGTERM);
+    unlink(serve_socket.c_str());
+  }
+  std::_Exit(0);
+}
+
+/** Reads from the client until it shuts down its side of the connection */
+static bool read_request(int fd, std::string &request) {
+  char buf[8192];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) != 0) {
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    request.append(buf, n);
+  }
+  return true;
+}
+
+static void write_all(int fd, const char *data, std::size_t size) {
+  while (size) {
+    ssize_t n = write(fd, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return;
+    data += n;
+    size -= n;
+  }
+}
+
+static void respond(int fd, const std::string &status,
+                    const std::string &payload) {
+  std::string header = status + " " + std::to_string(payload.size()) + "\n";
+  write_all(fd, header.data(), header.size());
+  write_all(fd, payload.data(), payload.size());
+}
+
+/**
+ * Name: parse_request_options
+ * Construct: Function
+ * Desc: Parses the options line of a request as the compiler's command line
+ *   would be, throwing for the options which make no sense for a request
+ * Args:
+ *   - line: The options of the request, separated by whitespace
+ */
+static SoodArgs parse_request_options(const std::string &line) {
+  std::istringstream words(line);
+  std::vector<std::string> opts = {"sood"};
+  for (std::string word; words >> word;) {
+    if (word == "-h" || word == "--help" || word == "-R" ||
+        word == "--run-llvm-ir")
+      throw std::runtime_error("Option " + word + " is not served");
+    opts.push_back(word);
+  }
+  std::vector<char *> argv;
+  for (std::string &opt : opts)
+    argv.push_back(&opt[0]);
+  return parse_args(argv.size(), argv.data());
+}
+
+/**
+ * Name: compile_request
+ * Construct: Function
+ * Desc: Compiles the source of a request, much like the compiler's `main`,
+ *   but to memory rather than files. Returns the output and sets its kind,
+ *   throws for any problem with the source
+ * Args:
+ *   - args: The options of the request
+ *   - source: The Sood source to compile
+ *   - kind: Set to the kind of the output
+ */
+static std::string compile_request(const SoodArgs &args, std::string &source,
+                                   std::string &kind) {
+  /** The lexer reads from a `FILE`, `fmemopen` can't open an empty buffer */
+  source.push_back('\n');
+  FILE *in = fmemopen(&source[0], source.size(), "r");
+  if (!in)
+    throw std::runtime_error("Could not read the request's source");
+  yyrestart(in);
+  yylineno = 1;
+  yyerror_message.clear();
+  prg = nullptr;
+  max_syntax_errors = args.max_errors;
+  int parsed = yyparse();
+  std::fclose(in);
+  std::unique_ptr<NBlock, void (*)(Node *)> program(prg, delete_ast);
+  if (parsed || !prg)
+    throw std::runtime_error(yyerror_message.empty() ? "Could not parse"
+                                                     : yyerror_message);
+
+  if (args.stop_after_ast) {
+    kind = "ast";
+    std::ostringstream ast;
+    ast << *program << std::endl;
+    return ast.str();
+  }
+
+  /** A builder left pointing into a previous request's module is cleared */
+  BUILDER.ClearInsertionPoint();
+  CodeGenContext ctx;
+  std::unique_ptr<llvm::Module> module(ctx.module);
+  set_codegen_options(ctx, args);
+  ctx.code_generate(*program);
+
+  std::string out;
+  llvm::raw_string_ostream out_stream(out);
+
+  if (!args.no_verify && ctx.verify_module(out_stream))
+    throw std::runtime_error(out_stream.str());
+
+  ctx.optimize();
+
+  if (args.stop_after_llvm_ir) {
+    kind = "ir";
+    module->print(out_stream, nullptr);
+    return out_stream.str();
+  }
+
+  kind = "object";
+  llvm::SmallVector<char, 0> object;
+  llvm::raw_svector_ostream object_stream(object);
+  if (ctx.write_object(object_stream))
+    throw std::runtime_error("Could not write object code");
+  return std::string(object.begin(), object.end());
+}
+
+/**
+ * Name: serve_request
+ * Construct: Function
+ * Desc: Reads, compiles, and responds to the request of a client
+ * Args:
+ *   - fd: The client's connection
+ */
+static void serve_request(int fd) {
+  auto start = std::chrono::steady_clock::now();
+
+  std::string request;
+  if (!read_request(fd, request))
+    return;
+
+  std::size_t eol = request.find('\n');
+  std::string options = request.substr(0, eol);
+  std::string source =
+      eol == std::string::npos ? std::string() : request.substr(eol + 1);
+
+  std::string kind;
+  try {
+    std::string out =
+        compile_request(parse_request_options(options), source, kind);
+    respond(fd, "ok " + kind, out);
+  } catch (std::exception &e) {
+    kind = "error";
+    respond(fd, "error", e.what());
+  }
+
+  std::chrono::duration<double, std::milli> took =
+      std::chrono::steady_clock::now() - start;
+  spdlog::debug("Served {} request in {:.2f}ms", kind, took.count());
+}
+
+/**
+ * Name: serve_connections
+ * Construct: Function
+ * Desc: The loop of a worker, accepting clients on the server's socket and
+ *   serving their requests one at a time. Never returns
+ * Args:
+ *   - server: The listening socket, shared by all of the workers
+ */
+static void serve_connections(int server) {
+  for (;;) {
+    int client = accept(server, nullptr, nullptr);
+    if (client < 0) {
+      if (errno == EINTR)
+        continue;
+      spdlog::error("Could not accept connection: {}", std::strerror(errno));
+      std::_Exit(1);
+    }
+    serve_request(client);
+    close(client);
+  }
+}
+
+/** Forks a worker, returning its process ID, or -1 if it couldn't be */
+static pid_t start_worker(int server) {
+  pid_t pid = fork();
+  if (pid < 0)
+    spdlog::error("Could not start a worker: {}", std::strerror(errno));
+  if (pid == 0) {
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    serve_connections(server);
+  }
+  return pid;
+}
+
+/**
+ * Name: serve
+ * Construct: Function
+ * Desc: Listens on the Unix domain socket given by the `--socket` option and
+ *   serves requests until stopped
+ * Args:
+ *   - args: The options `sood serve` was started with
+ */
+int serve(const SoodArgs &args) {
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (args.socket.size() >= sizeof(addr.sun_path)) {
+    spdlog::error("Socket path {} is too long", args.socket);
+    return 1;
+  }
+  std::strcpy(addr.sun_path, args.socket.c_str());
+
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0) {
+    spdlog::error("Could not create socket: {}", std::strerror(errno));
+    return 1;
+  }
+
+  /** A socket left by a server which didn't stop cleanly is replaced */
+  unlink(args.socket.c_str());
+  if (bind(server, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ||
+      listen(server, SOMAXCONN)) {
+    spdlog::error("Could not listen on {}: {}", args.socket,
+                  std::strerror(errno));
+    return 1;
+  }
+
+  serve_socket = args.socket;
+  serve_pid = getpid();
+  /** Syntax errors are returned to the client, not printed by the server */
+  yyerror_quiet = true;
+  std::signal(SIGINT, stop_serving);
+  std::signal(SIGTERM, stop_serving);
+  std::signal(SIGPIPE, SIG_IGN);
+
+  /** Initialize LLVM's targets up front rather than in the first request */
+  {
+    CodeGenContext warm;
+    std::unique_ptr<llvm::Module> module(warm.module);
+    warm.get_target_machine();
+  }
+
+  /** Forked workers have a copy of the initialized targets, not their own */
+  unsigned count = args.workers;
+  if (!count)
+    count = std::max(std::thread::hardware_concurrency(), 1u);
+  workers.assign(count, 0);
+  for (pid_t &worker : workers)
+    worker = start_worker(server);
+
+  spdlog::info("Serving on {} with {} workers", args.socket, count);
+
+  /** A worker which dies, e.g. crashing on a request, is replaced */
+  for (;;) {
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0) {
+      if (errno == EINTR)
+        continue;
+      spdlog::error("No workers are left to serve requests");
+      break;
+    }
+    for (pid_t &worker : workers)
+      if (worker == pid) {
+        spdlog::warn("Worker {} stopped, starting another", pid);
+        worker = start_worker(server);
+      }
+  }
+
+  close(server);
+  unlink(args.socket.c_str());
+  return 1;
+}
@@ -0,0 +1,853 @@
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <spdlog/spdlog.h>
+#include <thread>
+#include <unordered_map>
+
+#include "ast-eval.hpp"
+#include "ast.hpp"
+#include "cli.hpp"
+#include "codegen.hpp"
+#include "sood-runtime.h"
+#include "tiered.hpp"
+
+/**
+ * Name: src/tiered.cpp
+ * Construct: Module
+ * Desc: `--tiered`, running a program without waiting for LLVM. The top-level
+ *   code starts at once in an interpreter of the AST (an extension of the
+ *   compile-time evaluator, see src/ast-eval.cpp) which counts the calls of
+ *   each function and the iterations of each loop. Once one is hot the
+ *   module, already generated and verified, is optimized and compiled by
+ *   MCJIT on a background thread, and from then on hot functions are called
+ *   as native code, and hot loops carry on in native code from their next
+ *   iteration
+ * Notes:
+ *   - Only functions of integers and floats are called natively from the
+ *     interpreter, through a trampoline taking their arguments as an array
+ *     of 64-bit slots, those passing strings or arrays stay interpreted
+ *   - A loop is generated as a function of its own too, taking the variables
+ *     it uses in slots, if they're all integers and floats and it doesn't
+ *     `return`. At the start of an iteration the loop's state is only those
+ *     variables, so the interpreter may switch to it there
+ *   - A program which finishes while it's still being compiled exits without
+ *     waiting for LLVM
+ */
+
+/** The calls, or loop iterations, after which a function or loop is hot */
+static const std::uint64_t TIER_HOT_THRESHOLD = 1000;
+
+/**
+ * The stack of the interpreter's thread, whose calls take far more of it
+ *   than native ones, it is only touched as deep as the program recurses
+ */
+static const std::size_t TIER_STACK_SIZE = std::size_t(1) << 30;
+
+/** The prefix of the names of the trampolines into native code */
+static const std::string TIER_PREFIX = "sood.tier.";
+
+/**
+ * A trampoline, taking the arguments of a function (and storing its result
+ *   to the second slots) or the variables of a loop, as 64-bit slots
+ */
+typedef void (*NativeFunction)(std::int64_t *, std::int64_t *);
+
+/** The variables of a loop, in the order of their slots, and their kinds */
+typedef std::vector<std::pair<std::string, EvalValue::Kind>> LoopVariables;
+
+/**
+ * Name: is_scalar
+ * Construct: Function
+ * Desc: Whether a function only takes and returns integers and floats, and
+ *   so may be called through a trampoline (see `create_trampoline`)
+ * Args:
+ *   - fn: The function
+ */
+static bool is_scalar(llvm::Function *fn) {
+  llvm::Type *_ret_type = fn->getReturnType();
+  if (_ret_type != INTEGER_TYPE && _ret_type != DOUBLE_TYPE &&
+      !_ret_type->isVoidTy())
+    return false;
+  for (llvm::Argument &arg : fn->args())
+    if (arg.getType() != INTEGER_TYPE && arg.getType() != DOUBLE_TYPE)
+      return false;
+  return true;
+}
+
+/** A function of the trampolines' signature (see `NativeFunction`) */
+static llvm::Function *create_native_function(CodeGenContext &ctx,
+                                              const std::string &name) {
+  llvm::Type *_slots_type = INTEGER_TYPE->getPointerTo();
+  llvm::Function *_fn = llvm::Function::Create(
+      llvm::FunctionType::get(BUILDER.getVoidTy(), {_slots_type, _slots_type},
+                              false),
+      llvm::GlobalValue::ExternalLinkage, TIER_PREFIX + name, ctx.module);
+  BUILDER.SetInsertPoint(llvm::BasicBlock::Create(LLVM_CTX, "entry", _fn));
+  BUILDER.SetCurrentDebugLocation(llvm::DebugLoc());
+  return _fn;
+}
+
+/** A pointer to the slot at an index, as a pointer to the given type */
+static llvm::Value *slot(llvm::Value *_slots, unsigned index,
+                         llvm::Type *type) {
+  return BUILDER.CreateBitCast(
+      BUILDER.CreateConstInBoundsGEP1_64(INTEGER_TYPE, _slots, index, "_slot"),
+      type->getPointerTo());
+}
+
+/**
+ * Name: create_trampoline
+ * Construct: Function
+ * Desc: Creates an external function calling a Sood function with the
+ *   arguments loaded from an array of slots, and storing its result to
+ *   another, so the interpreter may call any scalar function with one
+ *   signature (see `NativeFunction`). The function is inlined into it
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - fn: The function to call
+ */
+static llvm::Function *create_trampoline(CodeGenContext &ctx,
+                                         llvm::Function *fn) {
+  llvm::Function *_tramp = create_native_function(ctx, fn->getName().str());
+  std::vector<llvm::Value *> _args;
+  for (llvm::Argument &arg : fn->args())
+    _args.push_back(BUILDER.CreateLoad(
+        arg.getType(), slot(_tramp->getArg(0), arg.getArgNo(), arg.getType()),
+        "_arg"));
+  llvm::CallInst *_call = BUILDER.CreateCall(fn, _args);
+  _call->setCallingConv(fn->getCallingConv());
+  if (!fn->getReturnType()->isVoidTy())
+    BUILDER.CreateStore(_call,
+                        slot(_tramp->getArg(1), 0, fn->getReturnType()));
+  BUILDER.CreateRetVoid();
+  return _tramp;
+}
+
+/**
+ * Name: declared_types
+ * Construct: Function
+ * Desc: Collects the types of the variables declared within a function (or
+ *   the top-level code), which are in scope for the rest of it. A name
+ *   declared with different types is given an empty type
+ * Args:
+ *   - node: The node to search, functions declared within it are not
+ *   - types: The types, by name
+ */
+static void declared_types(Node *node,
+                           std::map<std::string, std::string> &types) {
+  std::string _name, _type;
+  if (NVariableDeclaration *_decl = dynamic_cast<NVariableDeclaration *>(node)) {
+    _name = _decl->lhs.val;
+    _type = _decl->type.val;
+  } else if (NArrayDeclaration *_decl =
+                 dynamic_cast<NArrayDeclaration *>(node)) {
+    _name = _decl->lhs.val;
+    _type = _decl->type.val + " array";
+  } else if (dynamic_cast<NFunctionDeclaration *>(node)) {
+    return;
+  }
+  if (!_name.empty()) {
+    auto it = types.find(_name);
+    types[_name] = it == types.end() || it->second == _type ? _type : "";
+  }
+  for (Node *child : ast_children(*node))
+    declared_types(child, types);
+}
+
+/**
+ * Name: loop_variables
+ * Construct: Function
+ * Desc: Collects the variables used, assigned, or declared within a loop,
+ *   which become its slots (see `create_loop_function`)
+ * Args:
+ *   - node: The node to search
+ *   - types: The types of the variables in scope (see `declared_types`)
+ *   - vars: The loop's variables and their types, by name
+ * Returns: Whether the loop may be ran natively, its variables must all be
+ *   integers or floats and it mustn't return from its function
+ */
+static bool loop_variables(Node *node,
+                           const std::map<std::string, std::string> &types,
+                           std::map<std::string, std::string> &vars) {
+  std::string _name;
+  if (NIdentifier *_ident = dynamic_cast<NIdentifier *>(node))
+    _name = _ident->val;
+  else if (NVariableDeclaration *_decl =
+               dynamic_cast<NVariableDeclaration *>(node))
+    _name = _decl->lhs.val;
+  else if (dynamic_cast<NReturnStatement *>(node))
+    return false;
+  if (!_name.empty()) {
+    auto it = types.find(_name);
+    if (it == types.end() ||
+        (it->second != "integer" && it->second != "float"))
+      return false;
+    vars[_name] = it->second;
+  }
+  for (Node *child : ast_children(*node))
+    if (!loop_variables(child, types, vars))
+      return false;
+  return true;
+}
+
+/**
+ * Name: create_loop_function
+ * Construct: Function
+ * Desc: Generates the code of a loop as an external function of its own,
+ *   which loads the loop's variables from the slots, runs the loop from the
+ *   start of an iteration, and stores them back. Its code is generated as
+ *   that of a function (see `NFunctionDeclaration::code_generate`)
+ * Args:
+ *   - ctx: The CodeGenContext instance
+ *   - loop: The `while` or `until` statement
+ *   - vars: The loop's variables and their types (see `loop_variables`)
+ *   - name: The name of the function, after `TIER_PREFIX`
+ * Returns: The function, or null if its code could not be generated
+ */
+static llvm::Function *
+create_loop_function(CodeGenContext &ctx, NStatement &loop,
+                     const std::map<std::string, std::string> &vars,
+                     const std::string &name) {
+  llvm::Function *_fn = create_native_function(ctx, name);
+  llvm::Value *_slots = _fn->getArg(0);
+  ctx.push_block(&_fn->getEntryBlock());
+
+  std::set<NArrayIndex *> _in_bounds;
+  llvm::Value *_arena = nullptr;
+  llvm::Value *_string_return = nullptr;
+  llvm::DIScope *_di_scope = nullptr;
+  NBlock _body;
+  NBlock *_body_ptr = &_body;
+  _body.stmts.push_back(&loop);
+  std::swap(_in_bounds, ctx.in_bounds);
+  std::swap(_arena, ctx.arena);
+  std::swap(_string_return, ctx.string_return);
+  std::swap(_di_scope, ctx.di_scope);
+  std::swap(_body_ptr, ctx.function_body);
+
+  bool _generated = true;
+  try {
+    unsigned _index = 0;
+    for (auto &var : vars) {
+      llvm::Type *_type = var.second == "float" ? DOUBLE_TYPE : INTEGER_TYPE;
+      llvm::Value *_var = BUILDER.CreateAlloca(_type, 0, var.first);
+      BUILDER.CreateStore(
+          BUILDER.CreateLoad(_type, slot(_slots, _index++, _type)), _var);
+      ctx.set_local(var.first, _var, _type);
+    }
+    loop.code_generate(ctx);
+    _index = 0;
+    for (auto &var : vars) {
+      ValTypeTuple _var = ctx.get_local(var.first);
+      llvm::Type *_type = std::get<llvm::Type *>(_var);
+      BUILDER.CreateStore(
+          BUILDER.CreateLoad(_type, std::get<llvm::Value *>(_var)),
+          slot(_slots, _index++, _type));
+    }
+    BUILDER.CreateRetVoid();
+    ctx.release_arena(_fn);
+  } catch (CodeGenException &e) {
+    spdlog::debug("Loop at line {} stays interpreted: {}", loop.line,
+                  e.what());
+    _generated = false;
+  }
+
+  ctx.pop_block();
+  std::swap(_in_bounds, ctx.in_bounds);
+  std::swap(_arena, ctx.arena);
+  std::swap(_string_return, ctx.string_return);
+  std::swap(_di_scope, ctx.di_scope);
+  std::swap(_body_ptr, ctx.function_body);
+  _body.stmts.clear();
+  if (_generated)
+    return _fn;
+  _fn->dropAllReferences();
+  _fn->eraseFromParent();
+  return nullptr;
+}
+
+/**
+ * Name: BackgroundCompiler
+ * Construct: Class
+ * Desc: Compiles the module on a thread of its own, once the interpreter
+ *   finds a hot function or loop, while the interpreter carries on
+ * Members:
+ *   - ctx - The context of the module, only the thread uses it once started
+ *   - symbols - The trampolines of the scalar functions and of the loops,
+ *     by their declaration or statement
+ *   - loops - The variables of each loop with a trampoline
+ *   - addresses - The native code of the trampolines, once compiled
+ *   - compiled - Whether the thread has finished, successfully or not,
+ *     after which `addresses` is complete
+ *   - thread - The thread, if started
+ */
+class BackgroundCompiler {
+  CodeGenContext &ctx;
+  std::map<Node *, std::string> symbols;
+  std::map<Node *, LoopVariables> loops;
+  std::map<Node *, NativeFunction> addresses;
+  std::atomic<bool> compiled{false};
+  std::thread thread;
+
+  void add_loops(Node *, const std::map<std::string, std::string> &);
+  void compile();
+
+public:
+  BackgroundCompiler(CodeGenContext &ctx, NBlock &root);
+  void start();
+  bool started() { return thread.joinable() || done(); }
+  bool done() { return compiled.load(std::memory_order_acquire); }
+  NativeFunction native(Node &);
+  const LoopVariables &loop_variables(Node &node) { return loops.at(&node); }
+  void join() {
+    if (thread.joinable())
+      thread.join();
+  }
+};
+
+/**
+ * Creates the trampolines of the module's scalar functions, and of the loops
+ *   of the top-level code and of every function, to compile
+ */
+BackgroundCompiler::BackgroundCompiler(CodeGenContext &ctx, NBlock &root)
+    : ctx(ctx) {
+  for (auto &decl : ctx.function_decls) {
+    llvm::Function *_fn = ctx.module->getFunction(decl.first);
+    if (_fn && is_scalar(_fn))
+      symbols[decl.second] = create_trampoline(ctx, _fn)->getName().str();
+
+    std::map<std::string, std::string> _types;
+    for (NVariableDeclaration *arg : decl.second->args)
+      _types[arg->lhs.val] = arg->type.val;
+    declared_types(&decl.second->block, _types);
+    add_loops(&decl.second->block, _types);
+  }
+
+  std::map<std::string, std::string> _types;
+  declared_types(&root, _types);
+  add_loops(&root, _types);
+}
+
+/**
+ * Name: BackgroundCompiler::add_loops
+ * Construct: Method
+ * Desc: Creates the functions of the loops within a node which may be ran
+ *   natively (see `create_loop_function`), nested loops included
+ * Args:
+ *   - node: The node to search, functions declared within it are not
+ *   - types: The types of the variables in scope
+ */
+void BackgroundCompiler::add_loops(
+    Node *node, const std::map<std::string, std::string> &types) {
+  if (dynamic_cast<NFunctionDeclaration *>(node))
+    return;
+  std::map<std::string, std::string> _vars;
+  if ((dynamic_cast<NWhileStatement *>(node) ||
+       dynamic_cast<NUntilStatement *>(node)) &&
+      ::loop_variables(node, types, _vars)) {
+    NStatement *_loop = static_cast<NStatement *>(node);
+    std::string _name = "loop." + std::to_string(loops.size());
+    if (llvm::Function *_fn = create_loop_function(ctx, *_loop, _vars, _name)) {
+      symbols[_loop] = _fn->getName().str();
+      for (auto &var : _vars)
+        loops[_loop].push_back(
+            {var.first,
+             var.second == "float" ? EvalValue::FLOAT : EvalValue::INTEGER});
+    }
+  }
+  for (Node *child : ast_children(*node))
+    add_loops(child, types);
+}
+
+/** Starts compiling, if not already */
+void BackgroundCompiler::start() {
+  if (started())
+    return;
+  spdlog::debug("Compiling the program in the background");
+  thread = std::thread(&BackgroundCompiler::compile, this);
+}
+
+/**
+ * Name: BackgroundCompiler::compile
+ * Construct: Method
+ * Desc: Optimizes and compiles the module, as `-R` does, and finds the native
+ *   code of each trampoline. If it can't be compiled, the program is left to
+ *   run interpreted
+ */
+void BackgroundCompiler::compile() {
+  auto start = std::chrono::steady_clock::now();
+  try {
+    ctx.optimize();
+    llvm::ExecutionEngine *engine = ctx.code_load();
+    for (auto &symbol : symbols)
+      addresses[symbol.first] = reinterpret_cast<NativeFunction>(
+          engine->getFunctionAddress(symbol.second));
+    std::chrono::duration<double, std::milli> took =
+        std::chrono::steady_clock::now() - start;
+    spdlog::debug("Compiled the program in {:.2f}ms", took.count());
+  } catch (CodeGenException &e) {
+    spdlog::warn("Could not compile the program, it stays interpreted: {}",
+                 e.what());
+  }
+  compiled.store(true, std::memory_order_release);
+}
+
+/** The native code of a function or loop, or null if not compiled (yet) */
+NativeFunction BackgroundCompiler::native(Node &node) {
+  if (!done())
+    return nullptr;
+  auto it = addresses.find(&node);
+  return it == addresses.end() ? nullptr : it->second;
+}
+
+/**
+ * Name: Tier
+ * Construct: Struct
+ * Desc: How a function or loop is ran by the interpreter
+ * Members:
+ *   - count: Its calls, or iterations, so far
+ *   - hot: Whether the count has reached `TIER_HOT_THRESHOLD`
+ *   - settled: Whether, hot and compiled, it's to be ran as `native` from
+ *     now on, or is interpreted for good
+ *   - native: Its native code, through its trampoline
+ */
+struct Tier {
+  std::uint64_t count = 0;
+  bool hot = false;
+  bool settled = false;
+  NativeFunction native = nullptr;
+};
+
+/**
+ * Name: TieredEvaluator
+ * Construct: Class
+ * Desc: The interpreter of whole programs, the evaluator (see `Evaluator`)
+ *   with the strings, arrays, and writes of the language, and the counting
+ *   of calls and loop iterations which promotes them to native code
+ * Members:
+ *   - compiler - The compiler of the hot functions and loops
+ *   - tiers - The tier of each function and loop ran so far
+ *   - tier - The tier of the function being interpreted, null for the
+ *     top-level code
+ *   - function - That function
+ */
+class TieredEvaluator : public Evaluator {
+  BackgroundCompiler &compiler;
+  std::unordered_map<Node *, Tier> tiers;
+  Tier *tier = nullptr;
+  NFunctionDeclaration *function = nullptr;
+
+  void heat(Node &, Tier &);
+  EvalValue call_native(NFunctionDeclaration &, NativeFunction,
+                        const std::vector<EvalValue> &);
+  void loop(NStatement &, NExpression &, NBlock &, bool);
+  void loop_native(NStatement &, NativeFunction);
+  std::shared_ptr<EvalArray> array(const NIdentifier &);
+  std::size_t element(EvalArray &, NExpression &);
+  void write(const EvalValue &);
+
+protected:
+  using Evaluator::run;
+  void run(NStatement &) override;
+
+public:
+  TieredEvaluator(const std::map<std::string, NFunctionDeclaration *> &functions,
+                  BackgroundCompiler &compiler)
+      : Evaluator(functions, UINT64_MAX, UINT_MAX), compiler(compiler) {}
+  EvalValue call(NFunctionDeclaration &,
+                 const std::vector<EvalValue> &) override;
+  EvalValue eval(NExpression &) override;
+  void run_program(NBlock &root) { run(root); }
+};
+
+/** The kind of the elements of an array of the given type */
+static EvalValue::Kind element_kind(const NIdentifier &type) {
+  return type.val == "float" ? EvalValue::FLOAT : EvalValue::INTEGER;
+}
+
+/** The value of an index or size, converted to an integer as `to_index` does */
+static std::int64_t to_index(const EvalValue &value) {
+  return convert(value, EvalValue::INTEGER).i;
+}
+
+/** A number as the bits of its slot */
+static std::int64_t to_slot(const EvalValue &value) {
+  if (value.kind != EvalValue::FLOAT)
+    return value.i;
+  std::int64_t _slot;
+  std::memcpy(&_slot, &value.f, sizeof(double));
+  return _slot;
+}
+
+/** The number held in a slot */
+static EvalValue from_slot(std::int64_t slot, EvalValue::Kind kind) {
+  if (kind != EvalValue::FLOAT)
+    return EvalValue::integer(slot);
+  double _f;
+  std::memcpy(&_f, &slot, sizeof(double));
+  return EvalValue::floating(_f);
+}
+
+/**
+ * Name: TieredEvaluator::heat
+ * Construct: Method
+ * Desc: Counts a call of a function or an iteration of a loop, starting the
+ *   compile once it's hot, and settles how it's ran once compiled
+ * Args:
+ *   - node: The function or loop
+ *   - node_tier: Its tier
+ */
+void TieredEvaluator::heat(Node &node, Tier &node_tier) {
+  if (node_tier.settled)
+    return;
+  if (!node_tier.hot && ++node_tier.count >= TIER_HOT_THRESHOLD) {
+    if (NFunctionDeclaration *_fn = dynamic_cast<NFunctionDeclaration *>(&node))
+      spdlog::debug("Function {} is hot", _fn->id.val);
+    else
+      spdlog::debug("Loop at line {} is hot", node.line);
+    node_tier.hot = true;
+    compiler.start();
+  }
+  if (node_tier.hot && compiler.done()) {
+    node_tier.native = compiler.native(node);
+    node_tier.settled = true;
+  }
+}
+
+/**
+ * Name: TieredEvaluator::call
+ * Construct: Method
+ * Desc: Calls a function, natively if it's hot and compiled, otherwise
+ *   interpreting it. Arguments are bound as the code generator passes them,
+ *   numbers and strings by value and arrays by reference
+ * Args:
+ *   - fn: The function called
+ *   - args: The values of the arguments
+ */
+EvalValue TieredEvaluator::call(NFunctionDeclaration &fn,
+                                const std::vector<EvalValue> &args) {
+  Tier &_tier = tiers[&fn];
+  heat(fn, _tier);
+  if (_tier.native)
+    return call_native(fn, _tier.native, args);
+
+  std::map<std::string, EvalValue> _locals;
+  for (std::size_t i = 0; i < args.size(); i++)
+    _locals[fn.args[i]->lhs.val] = args[i];
+  std::swap(_locals, locals);
+  Tier *_tier_ptr = &_tier;
+  NFunctionDeclaration *_fn = &fn;
+  std::swap(_tier_ptr, tier);
+  std::swap(_fn, function);
+
+  run(fn.block);
+
+  std::swap(_fn, function);
+  std::swap(_tier_ptr, tier);
+  std::swap(_locals, locals);
+
+  /** Running off the end of a function, its result is undefined */
+  if (!returned) {
+    if (fn.type.val != "void")
+      throw EvalAbort();
+    return EvalValue::integer(0);
+  }
+  returned = false;
+  return return_value;
+}
+
+/** Calls a function's native code, with its arguments in slots */
+EvalValue TieredEvaluator::call_native(NFunctionDeclaration &fn,
+                                       NativeFunction native,
+                                       const std::vector<EvalValue> &args) {
+  std::vector<std::int64_t> _slots(args.size());
+  for (std::size_t i = 0; i < args.size(); i++)
+    _slots[i] = to_slot(args[i]);
+  std::int64_t _ret = 0;
+  native(_slots.data(), &_ret);
+  return from_slot(_ret, fn.type.val == "float" ? EvalValue::FLOAT
+                                                : EvalValue::INTEGER);
+}
+
+/**
+ * Name: TieredEvaluator::loop
+ * Construct: Method
+ * Desc: Runs a `while` or `until` loop, switching to its native code at the
+ *   start of an iteration once it's hot and compiled
+ * Args:
+ *   - stmt: The loop statement
+ *   - cond: Its condition
+ *   - block: Its body
+ *   - until: Whether it loops until, rather than while, the condition holds
+ */
+void TieredEvaluator::loop(NStatement &stmt, NExpression &cond, NBlock &block,
+                           bool until) {
+  Tier &_tier = tiers[&stmt];
+  while (!returned) {
+    if (_tier.native)
+      return loop_native(stmt, _tier.native);
+    if (condition(cond) == until)
+      return;
+    run(block);
+    heat(stmt, _tier);
+    if (tier)
+      heat(*function, *tier);
+  }
+}
+
+/**
+ * Runs the rest of a loop natively, with its variables in slots. A variable
+ *   first declared within the loop is declared by it
+ */
+void TieredEvaluator::loop_native(NStatement &stmt, NativeFunction native) {
+  const LoopVariables &_vars = compiler.loop_variables(stmt);
+  std::vector<std::int64_t> _slots(_vars.size());
+  for (std::size_t i = 0; i < _vars.size(); i++) {
+    auto it = locals.find(_vars[i].first);
+    if (it != locals.end())
+      _slots[i] = to_slot(it->second);
+  }
+  native(_slots.data(), nullptr);
+  for (std::size_t i = 0; i < _vars.size(); i++)
+    locals[_vars[i].first] = from_slot(_slots[i], _vars[i].second);
+}
+
+/** The array of the given name */
+std::shared_ptr<EvalArray> TieredEvaluator::array(const NIdentifier &ident) {
+  auto it = locals.find(ident.val);
+  if (it == locals.end() || it->second.kind != EvalValue::ARRAY)
+    throw EvalAbort();
+  return it->second.a;
+}
+
+/**
+ * Name: TieredEvaluator::element
+ * Construct: Method
+ * Desc: Evaluates the index of an element of an array, which the runtime
+ *   reports and exits on if it's out of bounds, as the generated code does
+ * Args:
+ *   - arr: The array
+ *   - index: The index expression
+ */
+std::size_t TieredEvaluator::element(EvalArray &arr, NExpression &index) {
+  std::int64_t _idx = to_index(eval(index));
+  std::int64_t _len = arr.elem == EvalValue::FLOAT ? arr.floats.size()
+                                                   : arr.ints.size();
+  if ((std::uint64_t)_idx >= (std::uint64_t)_len)
+    sood_array_bounds_fail(_idx, _len);
+  return _idx;
+}
+
+/**
+ * Name: TieredEvaluator::write
+ * Construct: Method
+ * Desc: Writes a value with `printf`, with the format the generated code
+ *   uses, so an integer is written as its low 32 bits
+ * Args:
+ *   - value: The value
+ */
+void TieredEvaluator::write(const EvalValue &value) {
+  if (value.kind == EvalValue::STRING)
+    std::printf("%s", value.s.c_str());
+  else
+    std::printf("%d", (int)value.i);
+}
+
+/**
+ * Name: TieredEvaluator::eval
+ * Construct: Method
+ * Desc: Evaluates an expression, the strings and arrays here, numbers by the
+ *   evaluator (see `Evaluator::eval`)
+ * Args:
+ *   - exp: The expression
+ * Notes:
+ *   - The code generator has already replaced the escapes of string literals
+ */
+EvalValue TieredEvaluator::eval(NExpression &exp) {
+  if (NString *_str = dynamic_cast<NString *>(&exp))
+    return EvalValue::text(_str->val);
+  if (NArrayIndex *_index = dynamic_cast<NArrayIndex *>(&exp)) {
+    std::shared_ptr<EvalArray> _arr = array(_index->array);
+    std::size_t _idx = element(*_arr, _index->index);
+    if (_arr->elem == EvalValue::FLOAT)
+      return EvalValue::floating(_arr->floats[_idx]);
+    return EvalValue::integer(_arr->ints[_idx]);
+  }
+  if (NLength *_length = dynamic_cast<NLength *>(&exp)) {
+    NIdentifier *_ident = dynamic_cast<NIdentifier *>(&_length->exp);
+    auto it = _ident ? locals.find(_ident->val) : locals.end();
+    if (it != locals.end() && it->second.kind == EvalValue::ARRAY) {
+      EvalArray &_arr = *it->second.a;
+      return EvalValue::integer(_arr.elem == EvalValue::FLOAT
+                                    ? _arr.floats.size()
+                                    : _arr.ints.size());
+    }
+    EvalValue _str = eval(_length->exp);
+    if (_str.kind != EvalValue::STRING)
+      throw EvalAbort();
+    return EvalValue::integer(_str.s.size());
+  }
+  return Evaluator::eval(exp);
+}
+
+/**
+ * Name: TieredEvaluator::run
+ * Construct: Method
+ * Desc: Runs a statement, the strings, arrays, writes, and loops here, the
+ *   rest by the evaluator (see `Evaluator::run`)
+ * Args:
+ *   - stmt: The statement
+ */
+void TieredEvaluator::run(NStatement &stmt) {
+  if (NWrite *_write = dynamic_cast<NWrite *>(&stmt)) {
+    write(eval(_write->exp));
+  } else if (NVariableDeclaration *_decl =
+                 dynamic_cast<NVariableDeclaration *>(&stmt)) {
+    if (_decl->type.val != "string")
+      return Evaluator::run(stmt);
+    locals[_decl->lhs.val] =
+        _decl->rhs ? eval(*_decl->rhs) : EvalValue::text("");
+  } else if (NArrayDeclaration *_decl =
+                 dynamic_cast<NArrayDeclaration *>(&stmt)) {
+    std::int64_t _size = _decl->size ? to_index(eval(*_decl->size)) : 0;
+    if (_size < 0)
+      throw EvalAbort();
+    EvalValue _arr = {EvalValue::ARRAY, 0, 0.0, "",
+                      std::make_shared<EvalArray>()};
+    _arr.a->elem = element_kind(_decl->type);
+    if (_arr.a->elem == EvalValue::FLOAT)
+      _arr.a->floats.resize(_size);
+    else
+      _arr.a->ints.resize(_size);
+    locals[_decl->lhs.val] = _arr;
+  } else if (NArrayAssignment *_assign =
+                 dynamic_cast<NArrayAssignment *>(&stmt)) {
+    std::shared_ptr<EvalArray> _arr = array(_assign->lhs.array);
+    std::size_t _idx = element(*_arr, _assign->lhs.index);
+    EvalValue _value = convert(eval(_assign->rhs), _arr->elem);
+    if (_arr->elem == EvalValue::FLOAT)
+      _arr->floats[_idx] = _value.f;
+    else
+      _arr->ints[_idx] = _value.i;
+  } else if (NAppend *_append = dynamic_cast<NAppend *>(&stmt)) {
+    std::shared_ptr<EvalArray> _arr = array(_append->array);
+    EvalValue _value = convert(eval(_append->exp), _arr->elem);
+    if (_arr->elem == EvalValue::FLOAT)
+      _arr->floats.push_back(_value.f);
+    else
+      _arr->ints.push_back(_value.i);
+  } else if (NWhileStatement *_while = dynamic_cast<NWhileStatement *>(&stmt)) {
+    loop(stmt, _while->cond, _while->block, false);
+  } else if (NUntilStatement *_until = dynamic_cast<NUntilStatement *>(&stmt)) {
+    loop(stmt, _until->cond, _until->block, true);
+  } else if (!dynamic_cast<NFunctionDeclaration *>(&stmt)) {
+    Evaluator::run(stmt);
+  }
+}
+
+/**
+ * Name: TieredRun
+ * Construct: Struct
+ * Desc: The program ran on the interpreter's thread
+ * Members:
+ *   - evaluator: The interpreter
+ *   - root: The top-level code
+ *   - aborted: Set if the program did anything whose behaviour is undefined
+ */
+struct TieredRun {
+  TieredEvaluator *evaluator;
+  NBlock *root;
+  bool aborted;
+};
+
+/** The body of the interpreter's thread */
+static void *interpret(void *data) {
+  TieredRun *_run = static_cast<TieredRun *>(data);
+  try {
+    _run->evaluator->run_program(*_run->root);
+  } catch (EvalAbort &) {
+    _run->aborted = true;
+  }
+  return nullptr;
+}
+
+/** The compiler running while the program does, if any */
+static BackgroundCompiler *background = nullptr;
+
+/**
+ * An exit while compiling waits for the compile, rather than destroying
+ *   LLVM's state underneath it
+ */
+static void join_background() {
+  if (background)
+    background->join();
+}
+
+/**
+ * Name: run_tiered
+ * Construct: Function
+ * Desc: Runs a program with `--tiered`, see above. A program importing
+ *   modules, whose functions are only object code, is ran as with `-R`
+ * Args:
+ *   - ctx: The CodeGenContext of the generated module
+ *   - root: The program's AST
+ *   - args: The command line options
+ */
+int run_tiered(CodeGenContext &ctx, NBlock &root, const SoodArgs &args) {
+  if (!ctx.imported_modules.empty()) {
+    spdlog::info("Imported modules are only ran compiled, running with -R");
+    if (!args.no_verify)
+      ctx.verify_module();
+    ctx.optimize();
+    ctx.code_run();
+    return 0;
+  }
+
+  BackgroundCompiler compiler(ctx, root);
+  if (!args.no_verify) {
+    spdlog::info("Verifying LLVM module");
+    if (ctx.verify_module()) {
+      spdlog::error("The module is broken, not running it");
+      std::exit(1);
+    }
+  }
+
+  TieredEvaluator evaluator(ctx.function_decls, compiler);
+  background = &compiler;
+  std::atexit(join_background);
+
+  spdlog::info("Running the program, interpreted until it's compiled");
+  TieredRun _run = {&evaluator, &root, false};
+  pthread_attr_t _attr;
+  pthread_t _thread;
+  pthread_attr_init(&_attr);
+  pthread_attr_setstacksize(&_attr, TIER_STACK_SIZE);
+  if (pthread_create(&_thread, &_attr, interpret, &_run)) {
+    spdlog::error("Could not start the interpreter's thread");
+    std::exit(1);
+  }
+  pthread_join(_thread, nullptr);
+  pthread_attr_destroy(&_attr);
+
+  if (_run.aborted) {
+    spdlog::error("The program's behaviour is undefined, stopping");
+    std::exit(1);
+  }
+
+  /** LLVM isn't waited for, the compile is abandoned with the process */
+  if (compiler.started() && !compiler.done()) {
+    spdlog::info("Finishing Sood compiler, before the program was compiled");
+    std::fflush(nullptr);
+    std::_Exit(0);
+  }
+
+  compiler.join();
+  background = nullptr;
+  spdlog::info("Finishing Sood compiler");
+  return 0;
+}